@@ -0,0 +1,120 @@
+/*******************************************************************************
+  Frame Arena Source File
+
+  File Name:
+    arena.c
+
+  Summary:
+    Static arena of fixed blocks for frames, accumulators and transmit buffers.
+
+  Description:
+    A block is free while its owner entry is ARENA_FREE. The arena is
+    zeroed .bss, so allocations from the initialization functions need no
+    ARENA_Initialize before them, USBCDC_Initialize runs first.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stddef.h>
+#include "arena.h"
+#include "dmabuf.h"
+#include "ccd.h"
+#include "usbcdc.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define ARENA_FREE              0       //owner entry of a free block, else CCD_MEM_xxx+1
+
+//what the firmware takes at start-up and keeps: transmit buffer, capture slots
+//(samples and fractions), dark/flat-field sums and the shared bench output
+#define ARENA_STARTUP_BLOCKS    (CCD_MEM_BLOCKS(USBCDC_WRITE_BUFFER_SIZE)+\
+                                 CCD_FRAME_BUFFERS*(CCD_MEM_BLOCKS(ARENA_FRAME_BYTES)+CCD_MEM_BLOCKS(CCD_DATA_SIZE))+\
+                                 CCD_MEM_BLOCKS(ARENA_SUM_BYTES)+\
+                                 CCD_MEM_BLOCKS(ARENA_FRAME_BYTES))
+
+_Static_assert(CCD_MEM_BLOCK_SIZE==DMABUF_SIZE(CCD_DATA_SIZE),"a block is a byte per output in whole cache lines");
+_Static_assert(ARENA_STARTUP_BLOCKS==CCD_MEM_STARTUP_BLOCKS,"hosts budget bursts with CCD_MEM_STARTUP_BLOCKS");
+_Static_assert(ARENA_STARTUP_BLOCKS<=ARENA_BLOCKS,"ARENA_BLOCKS is too small for the start-up buffers");
+_Static_assert(ARENA_BLOCKS<=UINT16_MAX,"block counts are 16-bit");
+
+uint8_t DMABUF_CACHED arenaPool[ARENA_BLOCKS][CCD_MEM_BLOCK_SIZE];
+
+static uint8_t arenaOwner[ARENA_BLOCKS];
+static uint32_t arenaFailures=0;
+static void *arenaScratch=NULL;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//bytes in the first run of free blocks long enough for them, NULL if none is
+void *ARENA_Alloc(uint8_t owner, uint32_t bytes)
+{
+    uint32_t n=CCD_MEM_BLOCKS(bytes), run=0;
+
+    if(n==0||owner>=CCD_MEM_OWNERS)return NULL;
+    for(uint32_t i=0;i<ARENA_BLOCKS;i++)
+    {
+        run=arenaOwner[i]==ARENA_FREE?run+1:0;
+        if(run<n)continue;
+        for(uint32_t k=i+1-n;k<=i;k++)arenaOwner[k]=owner+1;
+        return arenaPool[i+1-n];
+    }
+    arenaFailures++;
+    return NULL;
+}
+/******************************************************************************/
+//Returns the blocks of an ARENA_Alloc of bytes at p
+void ARENA_Free(void *p, uint32_t bytes)
+{
+    uint32_t first;
+
+    if(p==NULL)return;
+    first=((uint8_t *)p-&arenaPool[0][0])/CCD_MEM_BLOCK_SIZE;
+    for(uint32_t k=first;k<first+CCD_MEM_BLOCKS(bytes)&&k<ARENA_BLOCKS;k++)arenaOwner[k]=ARENA_FREE;
+}
+/******************************************************************************/
+//A frame of 16-bit samples the benches write to and nothing reads, taken on first use
+void *ARENA_Scratch(void)
+{
+    if(arenaScratch==NULL)arenaScratch=ARENA_Alloc(CCD_MEM_SCRATCH,ARENA_FRAME_BYTES);
+    return arenaScratch;
+}
+/******************************************************************************/
+void ARENA_Report(CCD_MEM_REPLY *reply)
+{
+    uint16_t run=0;
+
+    reply->blockSize=CCD_MEM_BLOCK_SIZE;
+    reply->blocks=ARENA_BLOCKS;
+    reply->free=0;
+    reply->largestFree=0;
+    for(uint8_t k=0;k<CCD_MEM_OWNERS;k++)reply->owned[k]=0;
+    for(uint32_t i=0;i<ARENA_BLOCKS;i++)
+    {
+        if(arenaOwner[i]==ARENA_FREE)
+        {
+            reply->free++;
+            if(++run>reply->largestFree)reply->largestFree=run;
+        }
+        else
+        {
+            reply->owned[arenaOwner[i]-1]++;
+            run=0;
+        }
+    }
+    reply->failures=arenaFailures;
+}
+
+/*******************************************************************************
+ End of File
+ */
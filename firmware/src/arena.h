@@ -0,0 +1,79 @@
+/*******************************************************************************
+  Frame Arena Header File
+
+  File Name:
+    arena.h
+
+  Summary:
+    Static arena of fixed blocks for frames, accumulators and transmit buffers.
+
+  Description:
+    One statically placed array of ARENA_BLOCKS blocks of CCD_MEM_BLOCK_SIZE
+    bytes holds every frame-sized buffer, so the map file shows the whole
+    budget as one symbol (arenaPool) and the rest of RAM is what is left
+    for everything else. Every block starts on a cache line (dmabuf.h).
+
+    An allocation takes the first run of free blocks long enough and is
+    tagged with its owner (CCD_MEM_xxx) for the "MEM" report. Buffers the
+    firmware keeps from start-up are taken in the initialization functions,
+    their sum (ARENA_STARTUP_BLOCKS) is checked against ARENA_BLOCKS when
+    arena.c is compiled. Allocation and release are for the main loop and
+    initialization only, never from an interrupt.
+
+    ARENA_BLOCKS (e.g. -DARENA_BLOCKS=96) sizes the arena per build, "ccdtool
+    memory" reads the map file and tells how many frames of each mode fit.
+ *******************************************************************************/
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#ifndef ARENA_BLOCKS
+#define ARENA_BLOCKS            80      //295680 bytes
+#endif
+
+#define ARENA_FRAME_BYTES       (CCD_DATA_SIZE*sizeof(uint16_t))    //a frame of samples
+#define ARENA_SUM_BYTES         (CCD_DATA_SIZE*sizeof(uint32_t))    //a frame of sums
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void *ARENA_Alloc(uint8_t owner, uint32_t bytes);
+void ARENA_Free(void *p, uint32_t bytes);
+void *ARENA_Scratch(void);
+void ARENA_Report(CCD_MEM_REPLY *reply);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _ARENA_H */
+
+/*******************************************************************************
+ End of File
+ */
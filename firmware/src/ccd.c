@@ -0,0 +1,880 @@
+/*******************************************************************************
+  CCD Acquisition Source File
+
+  File Name:
+    ccd.c
+
+  Summary:
+    TCD1304AP timing and frame acquisition.
+
+  Description:
+    Interrupt routines that drive SH/ICG, collect ADC samples into the
+    acquisition buffer and publish completed frames to the main loop.
+ *******************************************************************************/
+
+//Author: J. Bajic, 2022 (REV1)
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <string.h>
+#include "ccd.h"
+#include "correction.h"
+#include "interleave.h"
+#include "phase.h"
+#include "linearity.h"
+#include "latency.h"
+#include "trace.h"
+#include "arena.h"
+#include "definitions.h"
+
+#define CCD_NO_FRAME            0xFF
+#define CCD_ADC_TQ_NS           5       //ADC clock period, ADCCON3: SYSCLK, CONCLKDIV=0
+#define CCD_TRGSRC1_MASK        0x1F00  //ADCTRG1 trigger source of ADC1
+#define CCD_TRGSRC1_OCMP3       0x0900
+#define CCD_PIXEL_RATE_MAX      (CCD_CLOCK_BASE_HZ/(4*CCD_CLOCK_DIVIDER(CCD_CLOCK_4M0)))   //outputs/s at the sensor limit
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data Definitions
+// *****************************************************************************
+// *****************************************************************************
+CCD_t ccd;
+
+static CCD_FRAME ccdFrame[CCD_FRAME_BUFFERS];
+
+//frame slots, acquisition slot is always different from the other three
+static volatile uint8_t acqSlot=0, pubSlot=CCD_NO_FRAME, useSlot=CCD_NO_FRAME, txSlot=CCD_NO_FRAME;
+static uint32_t frameSequence=0;
+static uint32_t icgTimestamp=0;
+static uint32_t icgIntegrationTime=CCD_INTEGRATION_MIN;    //integration time of the exposure ended by the last ICG pulse
+static uint8_t icgExposure=HDR_EXPOSURE_NONE;   //HDR exposure ended by the last ICG pulse
+
+static EDGES_STATE edgesState;
+static EDGES_CONFIG edgesConfig;
+static bool edgesEnabled=false;         //requested by CCD_EdgesSetup
+static bool edgesRunning=false;         //detector started for the current readout
+static bool correctRunning=false;       //current readout is corrected
+
+//CCD_MODE_CHANGE reference frames, the last one sent and the one before. The main
+//loop writes the one readouts no longer start with: a frame is sent at most once
+//per readout, so the readout running still has its reference.
+static CHANGE_STATE changeState;
+static uint16_t *changeReference[2]={NULL,NULL};    //CCD_MEM_REFERENCE blocks while the mode is on
+static uint32_t changeGeneration[2]={0,0};          //of the frame in each, 0: none yet
+static uint32_t changeCount=0;                      //references made since power up
+static volatile uint8_t changeActive=0;             //reference of the readouts starting from now on
+static bool changeRunning=false;                    //current readout is compared
+
+static CCD_FRAME_STATS stats;           //of the current readout
+static uint16_t statsLevel=CCD_ADC_MAX; //raw saturation level
+static bool statsInvert=false;          //saturation at or below statsLevel
+
+static EXPOSURE_STATE exposureState;
+static EXPOSURE_CONFIG exposureConfig;
+static bool exposureEnabled=false;
+
+static HDR_STATE hdrState;
+static bool hdrEnabled=false;
+
+static TIMING_STATE timingState;        //SH period being generated
+static TIMING_SCHEDULE timingNext;      //schedule of the following frames
+
+static uint16_t data_cnt=CCD_DATA_SIZE; //readout counter, no readout until first ICG pulse
+
+static uint8_t clockRunning=CCD_CLOCK_0M8;  //master clock mode of Timer 2 and 5 (initialized for 0.8MHz)
+static uint32_t captureTicks=0;         //CORETIMER ticks in the ADC interrupt, current readout
+static uint32_t captureLast=0;          //and last complete readout
+static uint32_t overruns=0;             //readouts cut short by the next one
+
+static uint8_t oversampleNext=0;        //2^n conversions per output from the next ICG pulse on
+static uint8_t oversampleRunning=0;     //of Timer 5
+static uint8_t oversampleSlots=1;       //conversion slots per output
+static uint8_t oversamplePhase=0;       //slots in oversampleSum
+static uint32_t oversampleSum=0;        //x16
+static bool fineRunning=false;          //current readout keeps the oversampled fraction
+static bool linearRunning=false;        //current readout is linearized
+
+static uint8_t coresRunning=1;          //ADC cores converting every slot
+static INTERLEAVE_MATCH match={INTERLEAVE_GAIN_ONE,0};  //of ADC1 to ADC0
+static INTERLEAVE_SUMS matchSums;
+static uint8_t matchFrames=0;           //readouts still to collect pairs from
+static bool matchCollecting=false;      //current readout collects pairs
+static uint8_t matchOperation=CCD_ADC_QUERY;    //CCD_ADC_MATCH or CHECK collecting
+static uint16_t matchRequested=0;       //frames
+
+static uint8_t phaseNext=CCD_PHASE_DEFAULT; //sampling phase from the next ICG pulse on
+static uint8_t phaseRunning=CCD_PHASE_DEFAULT;
+static PHASE_SWEEP phaseSweep;
+static uint8_t phasePrevious;           //before the sweep
+static uint32_t phaseLastFrame;         //sequence of the last frame scored
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Takes effect with the next ICG pulse, the time is fitted to the frame period
+static void CCD_IntegrationTimeSet(uint32_t integrationTime)
+{
+    TIMING_SCHEDULE schedule;
+    integrationTime=TIMING_Fit(integrationTime,ccd.framePeriod);
+    TIMING_Schedule(&schedule,integrationTime,ccd.framePeriod,ccd.clock);
+
+    bool state=SYS_INT_Disable();
+    timingNext=schedule;
+    ccd.integrationTime=integrationTime;
+    SYS_INT_Restore(state);
+}
+
+//Master clock (Timer 2, OC5) and ADC triggers (Timer 5, OC1 and OC3) for mode, 2^oversampling
+//conversions per output, cores and sampling phase, called while ICG is low so no readout is
+//running. Both timers restart together, so the ADC triggers keep their phase to the clock and
+//every group of slots summed by the ADC interrupt is one output period. OC5 is high for the
+//second half of a clock cycle. OC1 triggers ADC0 phase/CCD_PHASE_STEPS of the conversion
+//spacing into every slot (a quarter as set up for 0.8MHz); with two cores OC3 triggers ADC1
+//there and ADC0 follows one spacing, half a slot, later. The ADC interrupt preempts this
+//one, the timers start once its state is set.
+static void CCD_ClockApply(uint8_t mode, uint8_t oversampling, uint8_t cores, uint8_t phase)
+{
+    uint16_t divider=CCD_CLOCK_DIVIDER(mode);
+    uint8_t slotShift=oversampling-(cores>1?1:0);
+    uint16_t slot=(4*divider)>>slotShift;
+    uint16_t spacing=(4*divider)>>oversampling;
+    uint16_t trigger=phase*spacing/CCD_PHASE_STEPS;     //compare match one tick before the trigger
+    trigger=trigger?trigger-1:0;
+
+    TMR2_Stop();
+    TMR5_Stop();
+    TMR2_PeriodSet(divider-1);
+    OCMP5_CompareValueSet(divider/2);
+    OCMP5_CompareSecondaryValueSet(divider-1);
+    TMR5_PeriodSet(slot-1);
+    OCMP1_CompareValueSet(cores>1?trigger+spacing:trigger);
+    OCMP1_CompareSecondaryValueSet(slot-1);
+    OC3R=trigger;
+    OC3RS=slot-1;
+    ADCTRG1=(ADCTRG1&~CCD_TRGSRC1_MASK)|(cores>1?CCD_TRGSRC1_OCMP3:0);
+    TMR2=0;
+    TMR5=0;
+    oversamplePhase=0;
+    oversampleSum=0;
+    clockRunning=mode;
+    oversampleRunning=oversampling;
+    oversampleSlots=1u<<slotShift;
+    coresRunning=cores;
+    phaseRunning=phase;
+    latencyAdcRestart=true;             //no conversions while the timers were stopped
+    TMR2_Start();
+    TMR5_Start();
+}
+
+//Called from ADC interrupt when the last pixel of a readout is stored
+static void CCD_FramePublish(void)
+{
+    ccdFrame[acqSlot].hdr=HDR_End(&hdrState,&ccdFrame[acqSlot].hdrInfo);
+    if(exposureEnabled&&!hdrEnabled)    //HDR sets the integration times itself
+    {
+        uint32_t t=EXPOSURE_Update(&exposureState,&exposureConfig,&ccdFrame[acqSlot].stats,
+                                   ccdFrame[acqSlot].integrationTime);
+        if(t)CCD_IntegrationTimeSet(t);
+    }
+    if(matchCollecting)
+    {
+        matchFrames--;
+        matchCollecting=false;
+    }
+    TRACE_Event(CCD_TRACE_FRAME,CCD_TRACE_INSTANT,(uint16_t)frameSequence);
+    ccdFrame[acqSlot].sequence=frameSequence++;
+    pubSlot=acqSlot;
+    for(uint8_t i=0;i<CCD_FRAME_BUFFERS;i++) //next free slot
+    {
+        if(i!=pubSlot&&i!=useSlot&&i!=txSlot)
+        {
+            acqSlot=i;
+            break;
+        }
+    }
+}
+
+//Timer 5 triggers this interrupt
+static void ADC_ResultHandler(ADCHS_CHANNEL_NUM channel, uintptr_t context)
+{
+    uint32_t start=CORETIMER_CounterGet();
+    /* Read the ADC result, x16 from here on */
+    uint16_t raw=ADCHS_ChannelResultGet(ADCHS_CH0);
+    uint16_t fine=linearRunning?LIN_Fine(raw):(uint16_t)(raw<<CCD_FINE_SHIFT);
+    uint16_t sample;
+    if(coresRunning>1)                  //ADC1 converted the same output half a slot earlier
+    {
+        uint16_t other=INTERLEAVE_Apply(&match,ADCHS_ChannelResultGet(ADCHS_CH1));
+        if(matchCollecting&&data_cnt>=CCD_SIGNAL_FIRST&&data_cnt<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT)
+            INTERLEAVE_Add(&matchSums,other,(fine+(1u<<(CCD_FINE_SHIFT-1)))>>CCD_FINE_SHIFT);
+        oversampleSum+=(uint32_t)other<<CCD_FINE_SHIFT;
+    }
+    if(oversampleRunning)               //sum 2^n conversions, the last slot completes the output
+    {
+        oversampleSum+=fine;
+        if(++oversamplePhase<oversampleSlots)
+        {
+            if(data_cnt<CCD_DATA_SIZE)captureTicks+=CORETIMER_CounterGet()-start;
+            return;
+        }
+        fine=(uint16_t)(oversampleSum>>oversampleRunning);
+        oversamplePhase=0;
+        oversampleSum=0;
+    }
+    sample=fine>>CCD_FINE_SHIFT;
+    if(linearRunning&&!oversampleRunning)sample=LIN_Round(fine);   //a single conversion, to the nearest code
+    if(data_cnt<CCD_DATA_SIZE)
+    {
+        uint16_t i=data_cnt++;
+        bool saturated=statsInvert?sample<=statsLevel:sample>=statsLevel;
+        if(fineRunning)
+        {
+            if(correctRunning)fine=CORR_SampleFine(i,fine);
+            sample=fine>>CCD_FINE_SHIFT;
+            ccdFrame[acqSlot].fraction[i]=fine&((1u<<CCD_FINE_SHIFT)-1);
+        }
+        else if(correctRunning)sample=CORR_Sample(i,sample);
+        if(hdrState.running)sample=HDR_Sample(&hdrState,i,sample,saturated);
+        ccdFrame[acqSlot].data[i]=sample;
+        if(i>=CCD_SIGNAL_FIRST&&i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT)
+        {
+            if(sample<stats.minimum)stats.minimum=sample;
+            if(sample>stats.maximum)stats.maximum=sample;
+            stats.sum+=sample;
+            if(saturated)stats.saturated++;
+            if(edgesRunning)EDGES_Sample(&edgesState,i,sample);
+            if(changeRunning)CHANGE_Sample(&changeState,i,sample);
+        }
+        if(data_cnt==CCD_DATA_SIZE)
+        {
+            ccdFrame[acqSlot].stats=stats;
+            ccdFrame[acqSlot].changeSum=changeState.sum;
+            ccdFrame[acqSlot].changeMaximum=changeState.maximum;
+            if(edgesRunning)
+            {
+                bool truncated;
+                EDGES_End(&edgesState,&ccdFrame[acqSlot].edges,&truncated);
+                ccdFrame[acqSlot].edgeFlags=truncated?CCD_FLAG_TRUNCATED:0;
+            }
+            CCD_FramePublish();
+        }
+        captureTicks+=CORETIMER_CounterGet()-start;
+    }
+}
+
+//Timer 3 generates SH pulses on pin RE5 and ICG pulse on pin RG8
+//Every Timer 3 period is one segment of the SH period (timing.h), its length
+//is loaded here as it starts, so the interrupt must not lag by 10us
+//ICG low state duration is one SH segment (10us, the whole SH period below 20us)
+//SH period determines integration time
+//The ADC interrupt has the higher priority and preempts this one (latency.h)
+static void TIMER3_InterruptSvcRoutine(uint32_t status, uintptr_t context)
+{
+    uint8_t events=TIMING_Events(&timingState);
+    if(!ICG_Get()) //Reset ICG and readout counter (data_cnt)
+    {
+        //stop a readout still running, the new one is set up before ICG rises and starts it
+        bool state=SYS_INT_Disable();
+        uint16_t count=data_cnt;
+        data_cnt=CCD_DATA_SIZE;
+        SYS_INT_Restore(state);
+        TRACE_Event(CCD_TRACE_READOUT,CCD_TRACE_INSTANT,count<CCD_DATA_SIZE);
+        if(count<CCD_DATA_SIZE)overruns++;  //previous readout not complete, dropped
+        else captureLast=captureTicks;
+        captureTicks=0;
+        ccdFrame[acqSlot].timestamp=icgTimestamp;
+        ccdFrame[acqSlot].integrationTime=icgIntegrationTime;
+        HDR_Begin(&hdrState,hdrEnabled?icgExposure:HDR_EXPOSURE_NONE,icgIntegrationTime);
+        fineRunning=oversampleRunning&&!hdrState.running;    //merged HDR samples are 12-bit
+        ccdFrame[acqSlot].oversampled=fineRunning;
+        linearRunning=LIN_Active();
+        ccdFrame[acqSlot].linearized=linearRunning;
+        matchCollecting=matchFrames>0;
+        ccdFrame[acqSlot].phase=phaseRunning;
+        ccdFrame[acqSlot].autoExposure=exposureEnabled;
+        stats.minimum=0xFFFF;
+        stats.maximum=0;
+        stats.sum=0;
+        stats.saturated=0;
+        stats.saturationLevel=statsLevel;
+        correctRunning=CORR_Active();
+        ccdFrame[acqSlot].corrected=correctRunning;
+        edgesRunning=edgesEnabled;
+        ccdFrame[acqSlot].hasEdges=edgesRunning;
+        if(edgesRunning)EDGES_Begin(&edgesState,&edgesConfig,ccdFrame[acqSlot].edge,CCD_EDGES_MAX);
+        changeRunning=changeGeneration[changeActive]!=0;
+        ccdFrame[acqSlot].changeGeneration=changeGeneration[changeActive];
+        if(changeRunning)CHANGE_Begin(&changeState,changeReference[changeActive]);
+        state=SYS_INT_Disable();        //outputs and samples are counted from the same instant
+        ICG_Set();
+        data_cnt=0;
+        SYS_INT_Restore(state);
+    }
+    if(events&TIMING_SH)//Generate SH pulse
+    {
+        OCMP4_Enable();
+
+        if(events&TIMING_ICG) //Generate ICG pulse
+        {
+            ICG_Clear();
+            icgTimestamp=CORETIMER_CounterGet();
+            icgIntegrationTime=timingState.period->length;
+            //the next SH pulses already use the time of the next HDR exposure
+            icgExposure=hdrEnabled?hdrState.next:HDR_EXPOSURE_NONE;
+            if(hdrEnabled)CCD_IntegrationTimeSet(HDR_Time(&hdrState,HDR_Advance(&hdrState)));
+        }
+    }
+    uint32_t ticks;
+    if(events&TIMING_ICG)   //auto exposure reschedules from the ADC interrupt, take the schedule in one piece
+    {
+        bool state=SYS_INT_Disable();
+        ticks=TIMING_Next(&timingState,&timingNext);
+        SYS_INT_Restore(state);
+    }
+    else ticks=TIMING_Next(&timingState,&timingNext);
+    TMR3_PeriodSet((uint16_t)(ticks-1));
+    //a new schedule is taken at the ICG pulse, the readout that follows runs at its clock
+    if(events&TIMING_ICG&&(timingState.active.clock!=clockRunning||oversampleNext!=oversampleRunning||
+                           ccd.cores!=coresRunning||phaseNext!=phaseRunning))
+        CCD_ClockApply(timingState.active.clock,oversampleNext,ccd.cores,phaseNext);
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void CCD_Initialize(void)
+{
+    ccd.integrationTime=CCD_INTEGRATION_MIN;    //10us
+    ccd.framePeriod=0;          //free running
+    ccd.clock=CCD_CLOCK_0M8;    //0.8MHz, set up by the Timer 2/5 and OC1/5 initialization
+    ccd.oversampling=0;         //one conversion per output
+    ccd.cores=1;                //ADC0 only
+    ccd.horzontalResolution=0;  //3648 points
+    ccd.verticalResolution=1;   //8 bits
+
+    for(uint8_t i=0;i<CCD_FRAME_BUFFERS;i++)
+    {
+        ccdFrame[i].data=ARENA_Alloc(CCD_MEM_FRAMES,ARENA_FRAME_BYTES);    //blocks of the frame arena, zeroed
+        ccdFrame[i].fraction=ARENA_Alloc(CCD_MEM_FRAMES,CCD_DATA_SIZE);
+    }
+
+    TIMING_Schedule(&timingNext,ccd.integrationTime,ccd.framePeriod,ccd.clock);
+    TIMING_Reset(&timingState,&timingNext);
+
+    //ADC1 trigger for two cores: continuous pulses on Timer 5 (OCACLK set with OC1), no pin
+    OC3CON=0xd;
+    OC3R=CCD_CLOCK_DIVIDER(ccd.clock)-1;
+    OC3RS=4*CCD_CLOCK_DIVIDER(ccd.clock)-1;
+    OC3CONSET=_OC3CON_ON_MASK;
+
+    ADCHS_CallbackRegister(ADCHS_CH0, ADC_ResultHandler, (uintptr_t)NULL);
+    TMR3_CallbackRegister(TIMER3_InterruptSvcRoutine, (uintptr_t) NULL);
+}
+/******************************************************************************/
+void CCD_Setup(uint32_t integrationTime, uint8_t h_res, uint8_t v_res)
+{
+    ccd.horzontalResolution=h_res;
+    ccd.verticalResolution=CCD_VRES_FORMAT(v_res);
+    ccd.oversampling=CCD_VRES_OVERSAMPLING(v_res);
+    oversampleNext=TIMING_Oversampling(ccd.clock,ccd.oversampling,ccd.cores);  //Timer 5 follows at the ICG pulse
+
+    //reschedule SH and ICG from the next frame on, free running
+    ccd.framePeriod=0;
+    CCD_IntegrationTimeSet(integrationTime);
+    if(hdrEnabled)      //new longest exposure, restart the cycle
+    {
+        bool state=SYS_INT_Disable();
+        HDR_Setup(&hdrState,&hdrState.config,ccd.integrationTime);
+        SYS_INT_Restore(state);
+    }
+
+    //16-bit samples are averaged 12-bit conversions
+    ADC0TIME =(0x00010001)|((ccd.verticalResolution<CCD_VRES_16BIT?ccd.verticalResolution:3)<<24);
+    ADC1TIME =ADC0TIME;
+}
+/******************************************************************************/
+//Sets integration time and frame period (0: free running) from the next frame on.
+//Returns CCD_TIMING_OK or why the combination is impossible, the timing is kept then.
+//reply receives the timing in effect.
+uint8_t CCD_TimingSetup(uint32_t integrationTime, uint32_t framePeriod, CCD_TIMING_REPLY *reply)
+{
+    TIMING_SCHEDULE schedule;
+    uint8_t status=TIMING_Schedule(&schedule,integrationTime,framePeriod,ccd.clock);
+
+    reply->status=status;
+    switch(status)
+    {
+        case CCD_TIMING_EXPOSURE_SHORT: reply->limit=CCD_INTEGRATION_MIN; break;
+        case CCD_TIMING_PERIOD_SHORT:   reply->limit=TIMING_ICG_MIN(ccd.clock)+1; break;
+        case CCD_TIMING_EXPOSURE_LONG:  reply->limit=framePeriod; break;
+        case CCD_TIMING_FLUSH_SHORT:    reply->limit=framePeriod-CCD_INTEGRATION_MIN; break;
+        default:                        reply->limit=0; break;
+    }
+    if(status==CCD_TIMING_OK)
+    {
+        bool state=SYS_INT_Disable();
+        timingNext=schedule;
+        ccd.integrationTime=integrationTime;
+        ccd.framePeriod=framePeriod;
+        if(hdrEnabled)HDR_Setup(&hdrState,&hdrState.config,integrationTime);
+        SYS_INT_Restore(state);
+    }
+    else
+    {
+        bool state=SYS_INT_Disable();
+        schedule=timingNext;
+        SYS_INT_Restore(state);
+    }
+    reply->integrationTime=ccd.integrationTime;
+    reply->framePeriod=schedule.framePeriod;
+    reply->flushes=schedule.flushes;
+    return status;
+}
+/******************************************************************************/
+//Selects the master clock from the next frame on (CCD_CLOCK_QUERY: no change), the
+//requested oversampling is fitted to it. Returns CCD_CLOCK_OK or why the mode is
+//refused, reply describes the mode in effect.
+uint8_t CCD_ClockSetup(uint8_t mode, CCD_CLOCK_REPLY *reply)
+{
+    uint8_t status=CCD_CLOCK_OK;
+
+    if(mode!=CCD_CLOCK_QUERY)
+    {
+        if(mode>=CCD_CLOCK_MODES)status=CCD_CLOCK_BAD_MODE;
+        else if(ccd.framePeriod&&ccd.framePeriod<=TIMING_ICG_MIN(mode))status=CCD_CLOCK_PERIOD_SHORT;
+        else
+        {
+            TIMING_SCHEDULE schedule;
+            TIMING_Schedule(&schedule,ccd.integrationTime,ccd.framePeriod,mode);
+            bool state=SYS_INT_Disable();
+            timingNext=schedule;
+            ccd.clock=mode;
+            oversampleNext=TIMING_Oversampling(mode,ccd.oversampling,ccd.cores);
+            SYS_INT_Restore(state);
+        }
+    }
+
+    //sampling (SAMC+2) and conversion (bits+1) in TAD=2*ADCDIV*TQ
+    uint32_t time=ADC0TIME;
+    uint32_t tad=2*((time>>16)&0x7F)*CCD_ADC_TQ_NS;
+    uint32_t bits=6+2*((time>>24)&0x03);
+    reply->status=status;
+    reply->mode=ccd.clock;
+    reply->adcConversion=(uint16_t)(((time&0x3FF)+2+bits+1)*tad);
+    reply->masterClock=CCD_CLOCK_BASE_HZ/CCD_CLOCK_DIVIDER(ccd.clock);
+    reply->readoutTicks=TIMING_READOUT_TICKS(ccd.clock);
+    reply->framePeriodMin=TIMING_ICG_MIN(ccd.clock)+1;
+    bool state=SYS_INT_Disable();
+    reply->captureTicks=captureLast;
+    reply->overruns=overruns;
+    reply->oversampling=1u<<oversampleNext;
+    SYS_INT_Restore(state);
+    reply->cores=ccd.cores;
+    reply->phase=phaseNext;
+    reply->conversionRate=(CCD_CLOCK_BASE_HZ/(4*CCD_CLOCK_DIVIDER(ccd.clock)))*reply->oversampling;
+    return status;
+}
+/******************************************************************************/
+//Cores, oversampling and rates of the next frames and the match in effect
+static void CCD_AdcReport(CCD_ADC_REPLY *reply)
+{
+    uint32_t outputRate=CCD_CLOCK_BASE_HZ/(4*CCD_CLOCK_DIVIDER(ccd.clock));
+    uint32_t pixelRateMax=CCD_CAPTURE_RATE_MAX*ccd.cores;
+
+    bool state=SYS_INT_Disable();
+    reply->oversampling=1u<<oversampleNext;
+    reply->offset=match.offset;
+    reply->gain=match.gain;
+    SYS_INT_Restore(state);
+    pixelRateMax/=reply->oversampling;
+    reply->cores=ccd.cores;
+    reply->conversionRate=outputRate*reply->oversampling;
+    reply->pixelRateMax=pixelRateMax<CCD_PIXEL_RATE_MAX?pixelRateMax:CCD_PIXEL_RATE_MAX;
+}
+/******************************************************************************/
+//Starts an "ADC" operation. Returns true when the reply waits for collected frames
+//(CCD_AdcDone), otherwise reply is complete.
+bool CCD_AdcSetup(uint8_t operation, uint8_t cores, uint8_t frames, CCD_ADC_REPLY *reply)
+{
+    reply->operation=operation;
+    reply->status=CCD_ADC_OK;
+    reply->frames=0;
+    reply->mean=0;
+    reply->mismatch=0;
+    reply->residual=0;
+
+    switch(operation)
+    {
+        case CCD_ADC_CORES:
+            if(cores<1||cores>CCD_ADC_CORES_MAX)reply->status=CCD_ADC_BAD_REQUEST;
+            else
+            {
+                bool state=SYS_INT_Disable();
+                ccd.cores=cores;            //Timer 5 follows at the ICG pulse
+                oversampleNext=TIMING_Oversampling(ccd.clock,ccd.oversampling,cores);
+                matchFrames=0;              //ends a pending MATCH or CHECK
+                matchCollecting=false;
+                SYS_INT_Restore(state);
+            }
+            break;
+        case CCD_ADC_MATCH:
+        case CCD_ADC_CHECK:
+            if(!frames)reply->status=CCD_ADC_BAD_REQUEST;
+            else if(ccd.cores<2)reply->status=CCD_ADC_NOT_INTERLEAVED;
+            else
+            {
+                bool state=SYS_INT_Disable();
+                if(operation==CCD_ADC_MATCH)INTERLEAVE_Identity(&match);
+                INTERLEAVE_Reset(&matchSums);
+                matchOperation=operation;
+                matchRequested=frames;
+                matchFrames=frames;         //from the next readout on
+                SYS_INT_Restore(state);
+                return true;
+            }
+            break;
+        case CCD_ADC_QUERY:
+            break;
+        default:
+            reply->status=CCD_ADC_BAD_REQUEST;
+            break;
+    }
+    CCD_AdcReport(reply);
+    return false;
+}
+/******************************************************************************/
+//Completes a pending MATCH or CHECK once its frames are collected, returns false
+//while they are not.
+bool CCD_AdcDone(CCD_ADC_REPLY *reply)
+{
+    INTERLEAVE_SUMS sums;
+    INTERLEAVE_REPORT report;
+
+    bool state=SYS_INT_Disable();
+    bool done=!matchFrames&&!matchCollecting;
+    sums=matchSums;
+    SYS_INT_Restore(state);
+    if(!done)return false;
+
+    reply->operation=matchOperation;
+    reply->status=CCD_ADC_OK;
+    reply->frames=matchRequested;
+    if(matchOperation==CCD_ADC_MATCH)
+    {
+        INTERLEAVE_MATCH fitted;
+        INTERLEAVE_Identity(&fitted);
+        INTERLEAVE_Fit(&sums,&fitted,&report);
+        if(!report.gainFitted)reply->status=CCD_ADC_FLAT;
+        state=SYS_INT_Disable();
+        match=fitted;
+        SYS_INT_Restore(state);
+    }
+    else
+    {
+        INTERLEAVE_Mismatch(&sums,&report);
+        report.residual=0;
+    }
+    reply->mean=report.mean;
+    reply->mismatch=report.rms;
+    reply->residual=report.residual;
+    CCD_AdcReport(reply);
+    return true;
+}
+/******************************************************************************/
+//Sampling phase from the next frame on, kept in the correction table so "CAL" SAVE
+//stores it
+void CCD_PhaseSet(uint8_t phase)
+{
+    if(phase>=CCD_PHASE_STEPS)return;
+    bool state=SYS_INT_Disable();
+    phaseNext=phase;
+    SYS_INT_Restore(state);
+    corrTable.phase=phase+1;
+}
+/******************************************************************************/
+static void CCD_PhaseReport(CCD_PHASE_REPLY *reply)
+{
+    reply->phase=phaseNext;
+    reply->spacing=(uint16_t)(((4u*CCD_CLOCK_DIVIDER(ccd.clock))>>oversampleNext)*(1000000000u/CCD_CLOCK_BASE_HZ));
+}
+/******************************************************************************/
+//Starts a "PHS" operation. Returns true when the reply waits for the sweep
+//(CCD_PhaseDone), otherwise reply is complete.
+bool CCD_PhaseSetup(uint8_t operation, uint8_t frames, uint8_t phase, CCD_PHASE_REPLY *reply)
+{
+    reply->operation=operation;
+    reply->status=CCD_PHASE_OK;
+    reply->previous=phaseNext;
+
+    switch(operation)
+    {
+        case CCD_PHASE_SWEEP:
+            if(frames<2)reply->status=CCD_PHASE_BAD_REQUEST;
+            else if(hdrEnabled)reply->status=CCD_PHASE_HDR;
+            else
+            {
+                PHASE_Start(&phaseSweep,frames);
+                phasePrevious=phaseNext;
+                phaseLastFrame=frameSequence-1;     //frames published from now on
+                bool state=SYS_INT_Disable();
+                phaseNext=phaseSweep.step;
+                SYS_INT_Restore(state);
+                return true;
+            }
+            break;
+        case CCD_PHASE_SET:
+            if(phase>=CCD_PHASE_STEPS)reply->status=CCD_PHASE_BAD_REQUEST;
+            else CCD_PhaseSet(phase);
+            break;
+        case CCD_PHASE_QUERY:
+            break;
+        default:
+            reply->status=CCD_PHASE_BAD_REQUEST;
+            break;
+    }
+    CCD_PhaseReport(reply);
+    return false;
+}
+/******************************************************************************/
+//Scores the newest frame of a running sweep if it was read out at the phase being
+//swept and moves on; returns true with the best phase set once every phase has its
+//frames
+bool CCD_PhaseDone(CCD_PHASE_REPLY *reply)
+{
+    CCD_FRAME *frame=CCD_FrameAcquire();
+    bool done=false;
+
+    if(frame&&frame->sequence!=phaseLastFrame&&frame->phase==phaseSweep.step)
+    {
+        phaseLastFrame=frame->sequence;
+        done=PHASE_Frame(&phaseSweep,frame->data,frame->oversampled?frame->fraction:NULL);
+    }
+    if(frame)CCD_FrameRelease(frame);
+    if(!done)
+    {
+        bool state=SYS_INT_Disable();
+        phaseNext=phaseSweep.step;
+        SYS_INT_Restore(state);
+        return false;
+    }
+
+    uint8_t best=PHASE_Best(&phaseSweep);
+    reply->operation=CCD_PHASE_SWEEP;
+    reply->status=best<CCD_PHASE_STEPS?CCD_PHASE_OK:CCD_PHASE_DARK;
+    reply->previous=phasePrevious;
+    reply->frames=phaseSweep.frames;
+    for(uint8_t k=0;k<CCD_PHASE_STEPS;k++)
+    {
+        reply->signal[k]=phaseSweep.signalMean[k];
+        reply->noise[k]=phaseSweep.noise[k];
+    }
+    if(best<CCD_PHASE_STEPS)CCD_PhaseSet(best);
+    else
+    {
+        bool state=SYS_INT_Disable();
+        phaseNext=phasePrevious;
+        SYS_INT_Restore(state);
+    }
+    CCD_PhaseReport(reply);
+    return true;
+}
+/******************************************************************************/
+//Interrupt latency histograms since the last RESET (latency.h), RESET starts them over
+void CCD_IrqSetup(uint8_t operation, CCD_IRQ_REPLY *reply)
+{
+    reply->operation=operation;
+    reply->status=operation<=CCD_IRQ_RESET?CCD_IRQ_OK:CCD_IRQ_BAD_REQUEST;
+    LATENCY_Report(reply);
+    reply->overruns=overruns;
+    if(operation==CCD_IRQ_RESET)LATENCY_Reset();
+}
+/******************************************************************************/
+//Acquisition and interrupt counters of "STA", the main loop and usbcdc add theirs
+void CCD_StatusReport(CCD_STATUS_REPLY *reply)
+{
+    reply->framesCaptured=frameSequence;
+    reply->overruns=overruns;
+    reply->samplesMissed=latencyMissed;
+    for(uint8_t k=0;k<CCD_IRQ_SOURCES;k++)reply->isrTicks[k]=latencyTicks[k];
+}
+/******************************************************************************/
+//Returns the most recently published frame, NULL if none is available yet.
+//The frame is not overwritten until CCD_FrameRelease is called.
+CCD_FRAME *CCD_FrameAcquire(void)
+{
+    bool state=SYS_INT_Disable();
+    useSlot=pubSlot;
+    SYS_INT_Restore(state);
+
+    return useSlot==CCD_NO_FRAME?NULL:&ccdFrame[useSlot];
+}
+/******************************************************************************/
+void CCD_FrameRelease(CCD_FRAME *frame)
+{
+    useSlot=CCD_NO_FRAME;
+}
+/******************************************************************************/
+//Keeps an acquired frame from being overwritten after CCD_FrameRelease while USB
+//reads it in place, one frame at a time, until CCD_FrameUnhold is called
+void CCD_FrameHold(CCD_FRAME *frame)
+{
+    txSlot=frame-ccdFrame;
+}
+/******************************************************************************/
+//Called from the USB write-complete event
+void CCD_FrameUnhold(void)
+{
+    txSlot=CCD_NO_FRAME;
+}
+/******************************************************************************/
+//Enables the edge detector with config (NULL disables it), from the next readout on
+void CCD_EdgesSetup(const EDGES_CONFIG *config)
+{
+    bool state=SYS_INT_Disable();
+    if(config)edgesConfig=*config;
+    edgesEnabled=config!=NULL;
+    SYS_INT_Restore(state);
+}
+/******************************************************************************/
+//Takes the two reference frames of CCD_MODE_CHANGE from the arena (enable) or gives
+//them back, false if the arena has no room. The next frame has no reference.
+bool CCD_ChangeSetup(bool enable)
+{
+    uint16_t *reference[2]={changeReference[0],changeReference[1]};
+
+    if(enable&&reference[0]==NULL)
+    {
+        reference[0]=ARENA_Alloc(CCD_MEM_REFERENCE,ARENA_FRAME_BYTES);
+        reference[1]=ARENA_Alloc(CCD_MEM_REFERENCE,ARENA_FRAME_BYTES);
+        if(reference[0]==NULL||reference[1]==NULL)
+        {
+            ARENA_Free(reference[0],ARENA_FRAME_BYTES);
+            ARENA_Free(reference[1],ARENA_FRAME_BYTES);
+            return false;
+        }
+    }
+    bool state=SYS_INT_Disable();
+    changeRunning=false;
+    changeGeneration[0]=changeGeneration[1]=0;
+    changeReference[0]=enable?reference[0]:NULL;
+    changeReference[1]=enable?reference[1]:NULL;
+    SYS_INT_Restore(state);
+    if(!enable)
+    {
+        ARENA_Free(reference[0],ARENA_FRAME_BYTES);
+        ARENA_Free(reference[1],ARENA_FRAME_BYTES);
+    }
+    return true;
+}
+/******************************************************************************/
+//Makes the frame just sent the reference of the readouts starting from now on
+void CCD_ChangeReference(const CCD_FRAME *frame)
+{
+    uint8_t next=changeActive^1;
+
+    if(changeReference[next]==NULL)return;
+    memcpy(changeReference[next],frame->data,ARENA_FRAME_BYTES);
+    bool state=SYS_INT_Disable();
+    changeGeneration[next]=++changeCount;
+    changeActive=next;
+    SYS_INT_Restore(state);
+}
+/******************************************************************************/
+//Differences of frame to the current reference, false if there is none yet. They
+//were taken during the readout, or are taken here if the reference changed since.
+bool CCD_ChangeMeasure(const CCD_FRAME *frame, uint32_t *sum, uint16_t *maximum)
+{
+    uint8_t active=changeActive;
+
+    if(changeGeneration[active]==0)return false;
+    if(frame->changeGeneration==changeGeneration[active])
+    {
+        *sum=frame->changeSum;
+        *maximum=frame->changeMaximum;
+        return true;
+    }
+    CHANGE_STATE s;
+    CHANGE_Compare(&s,frame->data,changeReference[active],CCD_SIGNAL_FIRST,CCD_SIGNAL_COUNT);
+    *sum=s.sum;
+    *maximum=s.maximum;
+    return true;
+}
+/******************************************************************************/
+//Raw ADC level counted as saturated, 0 selects full scale (or 0 with CCD_STATS_INVERT)
+void CCD_StatsSetup(uint16_t saturationLevel, uint8_t options)
+{
+    bool state=SYS_INT_Disable();
+    statsInvert=options&CCD_STATS_INVERT;
+    statsLevel=saturationLevel||statsInvert?saturationLevel:CCD_ADC_MAX;
+    SYS_INT_Restore(state);
+}
+
+/******************************************************************************/
+//Enables auto exposure with config (NULL disables it), from the next frame on
+void CCD_ExposureSetup(const EXPOSURE_CONFIG *config)
+{
+    bool state=SYS_INT_Disable();
+    if(config)exposureConfig=*config;
+    EXPOSURE_Reset(&exposureState);
+    exposureEnabled=config!=NULL;
+    SYS_INT_Restore(state);
+}
+
+/******************************************************************************/
+//Interleaves and merges exposures with config (NULL disables it), false if config is
+//invalid or the arena has no room for the merge buffer. The current integration time
+//is the longest exposure.
+bool CCD_HdrSetup(const HDR_CONFIG *config)
+{
+    uint32_t *data=hdrState.data;
+    uint8_t *saturated=hdrState.saturated;
+    bool ok=config==NULL;
+
+    if(config&&data==NULL)
+    {
+        data=ARENA_Alloc(CCD_MEM_HDR,CCD_DATA_SIZE*sizeof(uint32_t));
+        saturated=ARENA_Alloc(CCD_MEM_HDR,CCD_DATA_SIZE);
+        if(data==NULL||saturated==NULL)config=NULL;     //switched off as for invalid settings
+    }
+    bool state=SYS_INT_Disable();
+    uint32_t base=hdrEnabled?hdrState.base:ccd.integrationTime;
+    if(config&&HDR_Setup(&hdrState,config,base))
+    {
+        hdrState.data=data;
+        hdrState.saturated=saturated;
+        hdrEnabled=true;
+        ok=true;
+    }
+    else
+    {
+        if(hdrEnabled)                  //back to the longest exposure
+        {
+            hdrEnabled=false;
+            CCD_IntegrationTimeSet(base);
+        }
+        hdrState.running=false;         //a merge in progress ends, its readout is kept unmerged
+        hdrState.data=NULL;
+        hdrState.saturated=NULL;
+    }
+    SYS_INT_Restore(state);
+    if(!hdrEnabled)
+    {
+        ARENA_Free(data,CCD_DATA_SIZE*sizeof(uint32_t));
+        ARENA_Free(saturated,CCD_DATA_SIZE);
+    }
+    return ok;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,178 @@
+/*******************************************************************************
+  CCD Acquisition Header File
+
+  File Name:
+    ccd.h
+
+  Summary:
+    TCD1304AP timing and frame acquisition.
+
+  Description:
+    Timer 3 interrupt generates SH and ICG pulses on the schedule computed
+    by timing.c, ADC interrupt (triggered by Timer 5 / Output Compare 1)
+    stores one pixel per conversion. Every completed readout is published
+    as a frame. Frames have four slots: the one being acquired, the last
+    one published, the one the main loop is reading and the one USB is
+    sending in place (CCD_FrameHold), so neither reader ever has its frame
+    overwritten by the acquisition interrupts. When enabled, dark/flat-field
+    correction and the edge detector run on the samples as they arrive, so
+    the corrected frame and the edge list are ready with the last pixel.
+ *******************************************************************************/
+
+#ifndef _CCD_H
+#define _CCD_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+#include "edges.h"
+#include "change.h"
+#include "exposure.h"
+#include "hdr.h"
+#include "timing.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define CCD_FRAME_BUFFERS       4       //acquiring, published, in use by main loop, sent in place
+
+typedef struct
+{
+    uint32_t    integrationTime;
+    uint32_t    framePeriod;
+    uint8_t     clock;
+    uint8_t     oversampling;
+    uint8_t     cores;
+    uint8_t     horzontalResolution;
+    uint8_t     verticalResolution;
+}CCD_t;
+/*********INTEGRATION TIME**********/
+//  affects sensitivity, Timer 3 ticks (80ns)
+//  MIN=125         ->  10us    (DEFAULT)
+//  MAX=4294967295  ->  343.6s
+
+/*********FRAME PERIOD**********/
+//  ICG to ICG, Timer 3 ticks
+//  0 -> free running, smallest number of integration times longer than a readout (DEFAULT)
+//  otherwise more than TIMING_ICG_MIN of the clock mode (18.48ms at 0.8MHz)
+//  and not below the integration time
+
+/*********READOUT CLOCK**********/
+//  CCD master clock, one output every 4 cycles
+//  0 -> 0.8MHz, 5us    (DEFAULT)
+//  1 -> 2.0MHz, 2us
+//  2 -> 2.5MHz, 1.6us
+//  3 -> 4.0MHz, 1us
+
+/*********OVERSAMPLING**********/
+//  "SET" v_res bits 4..5, ADC conversions averaged per output (requested)
+//  0 -> 1                  (DEFAULT)
+//  1 -> 2
+//  2 -> 4
+//  3 -> 8
+//  lowered to what the readout clock and cores allow (TIMING_Oversampling)
+
+/*********ADC CORES**********/
+//  "ADC" CCD_ADC_CORES, cores converting every output
+//  1 -> ADC0 on AN0        (DEFAULT)
+//  2 -> ADC1 on AN1 interleaved, at least 2 conversions per output
+
+/*********HORIZONTAL RESOLUTION**********/
+//  affects number of data points
+//  0 -> CCD_DATA_SIZE      (DEFAULT)
+//  1 -> CCD_DATA_SIZE/2
+//  2 -> CCD_DATA_SIZE/4
+//  3 -> CCD_DATA_SIZE/8
+//  4 -> CCD_DATA_SIZE/16
+//  5 -> CCD_DATA_SIZE/32
+
+/*********VERTICAL RESOLUTION**********/
+//  affects A/D convertor resolution (number of bits)
+//  0 -> 6 bits
+//  1 -> 8 bits             (DEFAULT)
+//  2 -> 10 bits
+//  3 -> 12 bits
+//  4 -> 16 bits, 12-bit conversions with oversampling (CCD_VRES_16BIT)
+//  5 -> 12 bits as stored, little-endian (CCD_VRES_NATIVE)
+
+typedef struct
+{
+    uint16_t    *data;              //CCD_DATA_SIZE samples
+    uint8_t     *fraction;          //CCD_DATA_SIZE low CCD_FINE_SHIFT bits of oversampled samples
+    bool        oversampled;        //fraction is valid
+    uint8_t     phase;              //sampling phase the frame was read out with
+    uint32_t    sequence;           //frame counter
+    uint32_t    timestamp;          //CORETIMER at ICG pulse (end of integration)
+    uint32_t    integrationTime;    //integration time the frame was taken with, ticks
+    CCD_FRAME_STATS stats;          //collected while the frame was read out
+    bool        corrected;          //dark and flat-field correction applied to data
+    bool        linearized;         //ADC nonlinearity corrected (linearity.h)
+    bool        autoExposure;       //integrationTime was chosen by auto exposure
+    bool        hdr;                //data is a merged HDR frame described by hdrInfo
+    CCD_HDR     hdrInfo;
+    bool        hasEdges;           //edge detector ran during this readout
+    uint8_t     edgeFlags;          //CCD_FLAG_xxx of the edge list
+    CCD_EDGES   edges;
+    CCD_EDGE    edge[CCD_EDGES_MAX];
+    uint32_t    changeGeneration;   //CCD_MODE_CHANGE reference compared with during readout, 0: none
+    uint32_t    changeSum;          //absolute differences to it over the signal outputs
+    uint16_t    changeMaximum;      //largest of them
+}CCD_FRAME;
+
+extern CCD_t ccd;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void CCD_Initialize(void);
+void CCD_Setup(uint32_t integrationTime, uint8_t h_res, uint8_t v_res);
+uint8_t CCD_TimingSetup(uint32_t integrationTime, uint32_t framePeriod, CCD_TIMING_REPLY *reply);
+uint8_t CCD_ClockSetup(uint8_t mode, CCD_CLOCK_REPLY *reply);
+bool CCD_AdcSetup(uint8_t operation, uint8_t cores, uint8_t frames, CCD_ADC_REPLY *reply);
+bool CCD_AdcDone(CCD_ADC_REPLY *reply);
+void CCD_PhaseSet(uint8_t phase);
+bool CCD_PhaseSetup(uint8_t operation, uint8_t frames, uint8_t phase, CCD_PHASE_REPLY *reply);
+bool CCD_PhaseDone(CCD_PHASE_REPLY *reply);
+void CCD_IrqSetup(uint8_t operation, CCD_IRQ_REPLY *reply);
+void CCD_StatusReport(CCD_STATUS_REPLY *reply);
+CCD_FRAME *CCD_FrameAcquire(void);
+void CCD_FrameRelease(CCD_FRAME *frame);
+void CCD_FrameHold(CCD_FRAME *frame);
+void CCD_FrameUnhold(void);
+void CCD_EdgesSetup(const EDGES_CONFIG *config);
+void CCD_StatsSetup(uint16_t saturationLevel, uint8_t options);
+void CCD_ExposureSetup(const EXPOSURE_CONFIG *config);
+bool CCD_HdrSetup(const HDR_CONFIG *config);
+bool CCD_ChangeSetup(bool enable);
+void CCD_ChangeReference(const CCD_FRAME *frame);
+bool CCD_ChangeMeasure(const CCD_FRAME *frame, uint32_t *sum, uint16_t *maximum);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _CCD_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,938 @@
+/*******************************************************************************
+  CCD Wire Protocol Header File
+
+  File Name:
+    ccd_protocol.h
+
+  Summary:
+    Definitions shared by the firmware and the host tools.
+
+  Description:
+    Commands are 3 ASCII characters, optionally followed by parameters:
+
+      "GET"                     -> frame payload (see USBCDC_TrasferData)
+      "SET" + 4 bytes           -> echo of the 4 setup bytes
+                                   [integration time MSB, LSB, h_res, v_res]
+                                   integration time x10us, v_res bits 4..5
+                                   select oversampling (see CCD_CLOCK_REPLY)
+      "SET" + 8 bytes           -> echo of the 8 setup bytes, the 4 above
+                                   followed by the integration time in
+                                   CCD_TIMER_HZ ticks, MSB first, which
+                                   replaces the x10us time; "SET" selects
+                                   the free running frame period
+      "TIM" + 8 bytes           -> CCD_TIMING_REPLY
+                                   [integration time, frame period], both in
+                                   CCD_TIMER_HZ ticks, MSB first
+      "CLK" + 4 bytes           -> CCD_CLOCK_REPLY
+                                   [readout mode, 0, 0, 0]
+      "ADC" + 4 bytes           -> CCD_ADC_REPLY when the operation is done
+                                   [operation, cores, frames, 0]
+      "PHS" + 4 bytes           -> CCD_PHASE_REPLY when the operation is done
+                                   [operation, frames per phase, phase, 0]
+      "LIN" + 4 bytes           -> CCD_LIN_REPLY
+                                   [operation, block, options, 0], LOAD
+                                   followed by CCD_LIN_BLOCK entries
+      "IRQ" + 4 bytes           -> CCD_IRQ_REPLY
+                                   [operation, 0, 0, 0]
+      "STA" + 4 bytes           -> CCD_STATUS_REPLY
+                                   [0, 0, 0, 0]
+      "TRC" + 4 bytes           -> CCD_TRACE_REPLY
+                                   [operation, block, event mask MSB, LSB]
+      "BUF" + 4 bytes           -> CCD_BUF_REPLY
+                                   [operation, placement, 0, 0]
+      "MEM" + 4 bytes           -> CCD_MEM_REPLY
+                                   [0, 0, 0, 0]
+      "FRM"                     -> CCD_FRAME_HEADER + payload of the next frame
+                                   not yet sent on this link
+      "SYN" + 8 bytes           -> CCD_SYNC_REPLY, time synchronization
+      "MOD" + 4 bytes           -> echo of the 4 mode bytes
+                                   [mode, options, parameter MSB, LSB]
+      "CAL" + 4 bytes           -> CCD_CAL_REPLY when the operation is done
+                                   [operation, frames, options, 0]
+      "EXP" + 4 bytes           -> echo of the 4 auto exposure bytes
+                                   [options, maximum time MSB, setpoint MSB, LSB]
+
+    All multi-byte header fields are little-endian (native on PIC32 and x86).
+    Structures are laid out with natural alignment so they need no packing.
+
+    This header must only depend on <stdint.h>; it is included by host code.
+ *******************************************************************************/
+
+#ifndef _CCD_PROTOCOL_H
+#define _CCD_PROTOCOL_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCD_DATA_SIZE           3694        //total number of outputs [32(dummy)+3648(signal)+14(dummy)]
+#define CCD_SIGNAL_FIRST        32          //first light sensitive output
+#define CCD_SIGNAL_COUNT        3648        //light sensitive outputs
+#define CCD_ADC_MAX             4095        //full scale of a stored sample
+#define CCD_TIMESTAMP_HZ        100000000u  //CORETIMER rate, device timestamps are in these ticks
+#define CCD_TIMER_HZ            12500000u   //SH timer rate, integration times are in these ticks (80ns)
+#define CCD_TICKS_PER_10US      125         //integration time ticks per x10us unit
+#define CCD_INTEGRATION_MIN     125         //shortest integration time, ticks (10us)
+#define CCD_CLOCK_BASE_HZ       100000000u  //timer clock the CCD master clock is divided from (PBCLK3)
+#define CCD_CAPTURE_RATE_MAX    2000000u    //ADC interrupts/s (conversion slots) the capture path keeps up with
+
+#define CCD_VRES_FORMAT(v)      ((v)&0x0F)          //"SET" v_res bits 0..3: vertical resolution code
+#define CCD_VRES_OVERSAMPLING(v) (((v)>>4)&0x03)    //bits 4..5: 2^n ADC conversions per output
+#define CCD_VRES_16BIT          4           //vertical resolution code of oversampled 16-bit samples
+#define CCD_VRES_NATIVE         5           //12-bit samples as stored, 2 bytes little-endian
+#define CCD_FINE_SHIFT          4           //bits they carry below the 12-bit ADC range
+
+#define CCD_COMMAND_SIZE        3
+
+// *****************************************************************************
+/* Frame header
+
+  Summary:
+    Prefixed to every frame sent in response to "FRM".
+
+  Remarks:
+    Hosts must use headerSize to locate the payload so that fields appended
+    by later versions are skipped by older hosts.
+
+    Version 2 appends the frame statistics, collected over the light
+    sensitive outputs while the frame is read out. minimum, maximum and sum
+    are taken from the stored samples (corrected if CCD_FLAG_CORRECTED),
+    saturated counts raw ADC results at or beyond saturationLevel, so an
+    exposure loop needs no payload at all (see CCD_MODE_STATS).
+
+    Version 3 appends the exact integration time in CCD_TIMER_HZ ticks;
+    integrationTime keeps the x10us value, rounded and limited to 0xFFFF.
+    Hosts reading an older header use integrationTime*CCD_TICKS_PER_10US.
+
+    Vertical resolution code CCD_VRES_NATIVE sends the 12-bit samples the
+    way the firmware stores them, 2 bytes little-endian. At full horizontal
+    resolution a CCD_FORMAT_RAW frame is then written to USB straight from
+    its capture slot, without packing it into the transmit buffer first.
+*/
+
+#define CCD_FRAME_MAGIC         0xCCD1
+#define CCD_FRAME_VERSION       3
+#define CCD_FRAME_HEADER_V1_SIZE    20      //headerSize of version 1, without statistics
+#define CCD_FRAME_HEADER_V2_SIZE    32      //headerSize of version 2, without integrationTicks
+
+/* Payload formats */
+#define CCD_FORMAT_RAW          0           //USBCDC_TrasferData layout selected by vRes
+#define CCD_FORMAT_PEAKS        1           //array of CCD_PEAK, sorted by position
+#define CCD_FORMAT_EDGES        2           //CCD_EDGES followed by count CCD_EDGE, sorted by position
+#define CCD_FORMAT_STATS        3           //no payload, header statistics only
+#define CCD_FORMAT_HDR          4           //CCD_HDR followed by uint16_t merged samples
+#define CCD_FORMAT_RICE         5           //CCD_FORMAT_RAW samples delta and Rice coded (see "Compression")
+#define CCD_FORMAT_CHANGE       6           //CCD_CHANGE keep-alive, no frame changed meanwhile
+
+/* Header flags */
+#define CCD_FLAG_TRUNCATED      0x01        //payload list was cut to its maximum length
+#define CCD_FLAG_CORRECTED      0x02        //samples are dark and flat-field corrected
+#define CCD_FLAG_AUTO_EXPOSURE  0x04        //integration time was chosen by auto exposure
+#define CCD_FLAG_LINEARIZED     0x08        //ADC nonlinearity corrected ("LIN")
+
+typedef struct
+{
+    uint16_t    minimum;            //darkest signal sample
+    uint16_t    maximum;            //brightest signal sample
+    uint32_t    sum;                //of CCD_SIGNAL_COUNT samples, mean=sum/CCD_SIGNAL_COUNT
+    uint16_t    saturated;          //signal outputs at saturation
+    uint16_t    saturationLevel;    //raw ADC level counted as saturated
+} CCD_FRAME_STATS;                  //12 bytes
+
+typedef struct
+{
+    uint16_t    magic;              //CCD_FRAME_MAGIC
+    uint8_t     version;            //CCD_FRAME_VERSION
+    uint8_t     headerSize;         //bytes, payload starts right after
+    uint32_t    sequence;           //incremented for every completed frame
+    uint32_t    timestamp;          //CORETIMER at the end of integration (ICG pulse)
+    uint16_t    integrationTime;    //x10us, integration time of this frame (rounded)
+    uint8_t     hRes;
+    uint8_t     vRes;
+    uint8_t     format;             //CCD_FORMAT_xxx
+    uint8_t     flags;
+    uint16_t    payloadLength;      //bytes following the header
+    CCD_FRAME_STATS stats;          //version 2
+    uint32_t    integrationTicks;   //version 3, integration time in CCD_TIMER_HZ ticks
+} CCD_FRAME_HEADER;                 //36 bytes
+
+// *****************************************************************************
+/* Output modes
+
+  Summary:
+    Selected with "MOD", decides what "FRM" sends for every frame.
+
+  Remarks:
+    CCD_MODE_FRAME: options are CCD_FRAME_xxx, parameter is not used.
+
+    CCD_MODE_PEAKS: options are CCD_PEAKS_xxx, parameter is the detection
+    threshold in sample units (after inversion if CCD_PEAKS_INVERT is set).
+    Peaks are searched in the light sensitive outputs only; positions are
+    output indices (CCD_SIGNAL_FIRST is the first pixel) in 1/256 steps.
+
+    CCD_MODE_EDGES: options are CCD_EDGES_xxx, parameter is the threshold in
+    sample units (ignored with CCD_EDGES_AUTO). Edges are threshold crossings
+    confirmed by leaving the hysteresis band, positions are interpolated
+    between the two samples around the crossing, same units as peaks.
+
+    CCD_MODE_STATS: options are CCD_STATS_xxx, parameter is the raw ADC level
+    counted as saturated (0: CCD_ADC_MAX, or 0 with CCD_STATS_INVERT). Only
+    the header is sent; the saturation level applies to all modes.
+
+    CCD_MODE_HDR: options bits 0..3 are the number of exposures (2..4),
+    CCD_HDR_INVERT when light lowers the output; parameter MSB is log2 of
+    the ratio between consecutive integration times (1..8, longest/shortest
+    at most 2^16), LSB is the raw dark level /16 (0 with correction). The
+    integration time set with "SET" is the longest. One merged frame is
+    sent per cycle: dark subtracted, in units of the longest exposure,
+    saturated pixels taken from the longest exposure that did not saturate
+    (saturation level of CCD_MODE_STATS). Samples are little-endian,
+    decimated by hRes, vRes does not apply.
+
+    CCD_MODE_CHANGE: options are CCD_CHANGE_xxx, parameter is the threshold.
+    Every frame is compared with the last one sent, over the light sensitive
+    outputs while it is read out: by the mean absolute difference in 1/16
+    LSB, or the largest one in LSB with CCD_CHANGE_MAXIMUM. "FRM" answers
+    only with a frame above the threshold, sent as in CCD_MODE_FRAME, which
+    becomes the new reference. After CCD_CHANGE_KEEPALIVE_MS(options) without
+    one it answers with a header of the latest frame, format CCD_FORMAT_CHANGE
+    and a CCD_CHANGE payload, so a "FRM" never waits longer than that plus a
+    frame period. The first frame after "MOD" is always sent.
+*/
+
+#define CCD_MODE_FRAME          0           //full frame, CCD_FORMAT_RAW (default)
+#define CCD_MODE_PEAKS          1           //peak list, CCD_FORMAT_PEAKS
+#define CCD_MODE_EDGES          2           //edge list, CCD_FORMAT_EDGES
+#define CCD_MODE_STATS          3           //header with statistics, CCD_FORMAT_STATS
+#define CCD_MODE_HDR            4           //merged interleaved exposures, CCD_FORMAT_HDR
+#define CCD_MODE_CHANGE         5           //changed frames, CCD_FORMAT_RAW/RICE, or CCD_FORMAT_CHANGE
+
+#define CCD_FRAME_RICE          0x01        //send CCD_FORMAT_RICE when it is shorter than CCD_FORMAT_RAW
+
+#define CCD_STATS_INVERT        0x01        //light lowers the output, saturation is at or below the level
+
+#define CCD_CHANGE_RICE         CCD_FRAME_RICE  //changed frames as in CCD_MODE_FRAME with CCD_FRAME_RICE
+#define CCD_CHANGE_MAXIMUM      0x02        //threshold on the largest difference instead of the mean
+#define CCD_CHANGE_KEEPALIVE_MS(o)  ((((o)>>4)+1)*100u)     //options bits 4..7, 100..1600 ms
+
+#define CCD_HDR_EXPOSURES(o)    ((o)&0x0F)
+#define CCD_HDR_INVERT          0x10        //light lowers the output
+#define CCD_HDR_MAX_EXPOSURES   4
+
+typedef struct
+{
+    uint8_t     exposures;          //merged exposures
+    uint8_t     shift;              //sample=merged>>shift, merged=sample<<shift
+    uint16_t    dark;               //raw dark level subtracted
+    uint16_t    integrationTime[CCD_HDR_MAX_EXPOSURES];    //x10us (rounded), longest first
+    uint32_t    dynamicRange;       //merged full scale in LSB of the longest exposure
+} CCD_HDR;                          //16 bytes
+
+#define CCD_PEAKS_INVERT        0x01        //light lowers the output, search for minima
+#define CCD_PEAKS_CENTROID      0x02        //centroid over the peak instead of parabola through the maximum
+#define CCD_PEAKS_MAX           32          //longest list, the tallest peaks are kept
+
+typedef struct
+{
+    uint32_t    position;           //output index x256
+    uint16_t    height;             //sample value at the maximum
+    uint16_t    width;              //outputs above threshold
+} CCD_PEAK;                         //8 bytes
+
+#define CCD_EDGES_RISING        0x01        //report rising edges (none of the two bits: both)
+#define CCD_EDGES_FALLING       0x02        //report falling edges
+#define CCD_EDGES_AUTO          0x04        //threshold halfway between minimum and maximum of the previous frame
+#define CCD_EDGES_HYSTERESIS(o) (((o)>>4)*16)   //options bits 4..7, +-sample units around the threshold
+#define CCD_EDGES_MAX           32
+
+typedef struct
+{
+    uint16_t    count;              //CCD_EDGE entries following
+    uint16_t    threshold;          //threshold used for this frame
+    uint16_t    minimum;            //darkest and brightest signal sample, maximum-minimum
+    uint16_t    maximum;            //is the contrast the edges were found with
+} CCD_EDGES;                        //8 bytes
+
+typedef struct
+{
+    uint32_t    position;           //output index x256
+    uint16_t    slope;              //sample difference across the crossing, edge sharpness
+    uint8_t     rising;             //1 rising, 0 falling
+    uint8_t     reserved;
+} CCD_EDGE;                         //8 bytes
+
+typedef struct
+{
+    CCD_FRAME_STATS stats;          //of the latest frame, as in its header
+    uint32_t    unchanged;          //frames below the threshold since the last reply, this one included
+    uint32_t    reference;          //sequence of the last frame sent, the one compared with
+    uint32_t    difference;         //mean absolute difference of the latest frame, 1/16 LSB
+    uint16_t    deviation;          //largest difference of the latest frame, LSB
+    uint16_t    peakDeviation;      //largest difference of the unchanged frames
+} CCD_CHANGE;                       //28 bytes
+
+// *****************************************************************************
+/* Auto exposure
+
+  Summary:
+    Options of the "EXP" command.
+
+  Remarks:
+    With CCD_EXPOSURE_ENABLE the device retargets the integration time after
+    every frame so that the frame peak (maximum, or CCD_ADC_MAX-minimum with
+    CCD_EXPOSURE_INVERT) stays near the setpoint. The maximum time byte is
+    the upper limit in 2.56ms steps (x256 x10us, 0: 655.35ms); the lower
+    limit is 10us, times in between are set in CCD_TIMER_HZ ticks.
+    Saturation is detected with the level set by CCD_MODE_STATS. Every
+    frame header carries the integration time it was taken with. "SET" still sets the time, the loop continues from there.
+*/
+
+#define CCD_EXPOSURE_ENABLE     0x01
+#define CCD_EXPOSURE_INVERT     0x02        //light lowers the output (not needed with correction)
+
+// *****************************************************************************
+/* Dark and flat-field calibration
+
+  Summary:
+    Operations of the "CAL" command.
+
+  Remarks:
+    DARK averages the next frames (frames byte, 1..255) of the covered sensor
+    into the dark table, options bit 0 (CCD_CAL_INVERT) tells that light
+    lowers the output. FLAT averages frames of a uniformly lit sensor and
+    computes per-pixel gains relative to the mean response; it needs a dark
+    table. Corrected samples are (raw-dark)*gain, or (dark-raw)*gain when
+    inverted, so 0 is the dark level and values grow with light. SAVE writes
+    the tables to flash, they are loaded at boot. ENABLE switches correction
+    on (options bit 0 set) or off. BENCH returns the CPU cycles correction
+    adds to one frame in value.
+*/
+
+#define CCD_CAL_DARK            0
+#define CCD_CAL_FLAT            1
+#define CCD_CAL_SAVE            2
+#define CCD_CAL_CLEAR           3
+#define CCD_CAL_ENABLE          4
+#define CCD_CAL_BENCH           5
+
+#define CCD_CAL_INVERT          0x01        //DARK options
+#define CCD_CAL_ON              0x01        //ENABLE options
+
+#define CCD_CAL_OK              0
+#define CCD_CAL_BAD_REQUEST     1           //unknown operation or 0 frames
+#define CCD_CAL_NO_DARK         2           //flat-field needs a dark table
+#define CCD_CAL_FLASH_ERROR     3
+
+typedef struct
+{
+    uint8_t     operation;          //CCD_CAL_xxx
+    uint8_t     status;             //CCD_CAL_OK or error
+    uint16_t    frames;             //frames averaged
+    uint32_t    value;              //operation specific
+} CCD_CAL_REPLY;                    //8 bytes
+
+// *****************************************************************************
+/* Frame timing
+
+  Summary:
+    Reply to "TIM", which sets integration time and frame period together.
+
+  Remarks:
+    The frame period is the time from one ICG pulse to the next, so frames
+    follow each other at exactly this rate. SH pulses before the exposure
+    of a frame flush the sensor: the frame is a number of flush periods
+    followed by the integration time, and only the charge of the last
+    period is read out. Flush periods are no longer than the integration
+    time where possible and never shorter than CCD_INTEGRATION_MIN.
+
+    Frame period 0 runs free as "SET" does: the frame is the smallest
+    number of integration times longer than a readout.
+
+    A combination that cannot be scheduled is rejected and the timing in
+    effect is kept; status tells why and limit is the bound that was
+    violated. Otherwise the new timing starts with the next frame and
+    flushes tells the flush periods per frame. The reply always carries
+    the timing in effect afterwards. Auto exposure and HDR keep the frame
+    period, their integration times are limited to it.
+*/
+
+#define CCD_TIMING_OK               0
+#define CCD_TIMING_EXPOSURE_SHORT   1       //integration time below limit (CCD_INTEGRATION_MIN)
+#define CCD_TIMING_PERIOD_SHORT     2       //frame period below limit, a readout and ICG pulse
+#define CCD_TIMING_EXPOSURE_LONG    3       //integration time above limit, the frame period
+#define CCD_TIMING_FLUSH_SHORT      4       //frame period minus integration time shorter than a
+                                            //flush period, limit is the longest integration time
+                                            //below the frame period (the frame period itself fits)
+
+typedef struct
+{
+    uint8_t     status;             //CCD_TIMING_xxx
+    uint8_t     reserved[3];
+    uint32_t    integrationTime;    //ticks, in effect
+    uint32_t    framePeriod;        //ticks, in effect (with 0 requested: the free running period)
+    uint32_t    flushes;            //flush periods per frame in effect
+    uint32_t    limit;              //ticks, bound violated by the request
+} CCD_TIMING_REPLY;                 //20 bytes
+
+// *****************************************************************************
+/* Readout clock
+
+  Summary:
+    Reply to "CLK", which selects the CCD master clock f_M.
+
+  Remarks:
+    The sensor shifts out one output every 4 master clock cycles and the ADC
+    converts once per output (or oversampling times), so f_M sets the
+    readout time and with it the shortest frame period. f_M is CCD_CLOCK_BASE_HZ divided by
+    CCD_CLOCK_DIVIDER, which must be a whole number: 1.6MHz is not
+    available, 2.0 and 2.5MHz are. The ADC trigger stays at the same fraction
+    of the output period (the sampling phase set with "PHS", a quarter by
+    default) in every mode.
+
+    A new mode takes effect at the next ICG pulse, before the readout of the
+    frame ending there. It is rejected if the frame period set with "TIM" is
+    not longer than a readout in that mode. Mode CCD_CLOCK_QUERY only
+    reports. "SET" and "TIM" keep the mode.
+
+    captureTicks is the CORETIMER time spent in the ADC interrupt during the
+    last complete readout (without the interrupt entry and exit), so
+    captureTicks/readout time is the CPU share the capture path needs in
+    this mode. overruns counts readouts that were cut short by the next one
+    because the interrupt fell behind; such frames are never published.
+
+    Oversampling is requested with bits 4..5 of the "SET" v_res byte: Timer 5
+    triggers 2^n conversions evenly spread over every output period (with
+    two ADC cores, see "ADC", half as many slots of two conversions) and the
+    ADC interrupt stores their average, which lowers the noise of every
+    output mode. Vertical resolution code CCD_VRES_16BIT sends the average
+    with CCD_FINE_SHIFT more bits (2 bytes, big-endian, full scale
+    CCD_ADC_MAX*16), the other codes keep their 12-bit layout. The
+    conversion slots must divide the output period into whole timer cycles
+    and not exceed CCD_CAPTURE_RATE_MAX, so the factor is lowered to what
+    the mode allows (one core: at most 4 at 0.8 and 2.0MHz, 2 at 2.5 and
+    4.0MHz; two cores: 8 and 4); oversampling and conversionRate report the
+    factor in effect, which changes together with the mode at the ICG pulse.
+*/
+
+#define CCD_CLOCK_0M8           0           //f_M 0.8MHz, 5us per output, 18.47ms readout (DEFAULT)
+#define CCD_CLOCK_2M0           1           //2.0MHz, 2us per output, 7.39ms readout
+#define CCD_CLOCK_2M5           2           //2.5MHz, 1.6us per output, 5.91ms readout
+#define CCD_CLOCK_4M0           3           //4.0MHz, 1us per output, 3.69ms readout (sensor maximum)
+#define CCD_CLOCK_MODES         4
+#define CCD_CLOCK_QUERY         0xFF        //report the mode in effect only
+
+//CCD_CLOCK_BASE_HZ cycles per master clock cycle, CCD_TIMER_HZ ticks per output are half of it
+#define CCD_CLOCK_DIVIDER(mode) ((mode)==CCD_CLOCK_2M0?50u:(mode)==CCD_CLOCK_2M5?40u:(mode)==CCD_CLOCK_4M0?25u:125u)
+
+#define CCD_CLOCK_OK            0
+#define CCD_CLOCK_BAD_MODE      1           //no such mode
+#define CCD_CLOCK_PERIOD_SHORT  2           //frame period in effect is too short for the readout
+
+typedef struct
+{
+    uint8_t     status;             //CCD_CLOCK_xxx
+    uint8_t     mode;               //in effect (or scheduled for the next ICG pulse)
+    uint16_t    adcConversion;      //ns, ADC sampling and conversion of one sample
+    uint32_t    masterClock;        //Hz, f_M
+    uint32_t    readoutTicks;       //CCD_TIMER_HZ ticks of one readout
+    uint32_t    framePeriodMin;     //ticks, shortest frame period in this mode
+    uint32_t    captureTicks;       //CORETIMER ticks in the ADC interrupt during the last readout
+    uint32_t    overruns;           //readouts cut short since power up
+    uint32_t    conversionRate;     //ADC conversions/s during a readout, all cores
+    uint8_t     oversampling;       //conversions averaged per output
+    uint8_t     cores;              //ADC cores converting every output (0: older firmware, one)
+    uint8_t     phase;              //sampling phase in effect, CCD_PHASE_STEPS of the conversion spacing
+    uint8_t     reserved[1];
+} CCD_CLOCK_REPLY;                  //32 bytes
+
+// *****************************************************************************
+/* Interleaved ADC cores
+
+  Summary:
+    Operations of the "ADC" command.
+
+  Remarks:
+    CORES selects one (ADC0 on AN0) or two ADC cores from the next ICG pulse
+    on. With two, OS must also be wired to AN1: the dedicated cores only
+    convert their own pin (or an alternate pin of their own), so there is no
+    internal route from AN0 to ADC1. Output Compare 3 triggers ADC1 at the
+    sampling phase of every conversion slot and Output Compare 1 triggers
+    ADC0 half a slot later, both on Timer 5, and the ADC0 interrupt takes both
+    results, so every interrupt carries two conversions. This doubles the
+    conversions per output the capture path sustains at every clock mode
+    (see CCD_CLOCK_REPLY), and with it the pixel rate a given oversampling
+    reaches; pixelRateMax is the lower of the sensor limit (4MHz master
+    clock) and CCD_CAPTURE_RATE_MAX*cores/oversampling.
+
+    ADC1 results are matched to the ADC0 scale (interleave.h) before they
+    are summed. MATCH resets the match, collects the pairs of the light
+    sensitive outputs of the next frames (frames byte, 1..255, a scene with
+    a range of levels) and fits offset and gain; mismatch is the difference
+    of the cores before and residual the rest after the fit. CHECK collects
+    pairs with the match in effect and reports their difference in
+    mismatch. QUERY only reports. The match is kept in RAM until the next
+    MATCH or a reset. cores, oversampling, conversionRate and pixelRateMax
+    describe what the next frames run with.
+*/
+
+#define CCD_ADC_CORES           0           //select the cores byte (1 or 2)
+#define CCD_ADC_MATCH           1
+#define CCD_ADC_CHECK           2
+#define CCD_ADC_QUERY           3
+#define CCD_ADC_CORES_MAX       2
+
+#define CCD_ADC_OK              0
+#define CCD_ADC_BAD_REQUEST     1           //unknown operation, cores or 0 frames
+#define CCD_ADC_NOT_INTERLEAVED 2           //MATCH and CHECK need two cores
+#define CCD_ADC_FLAT            3           //MATCH: too few levels for the gain, offset matched only
+
+typedef struct
+{
+    uint8_t     operation;          //CCD_ADC_xxx
+    uint8_t     status;             //CCD_ADC_OK or error
+    uint8_t     cores;              //in effect
+    uint8_t     oversampling;       //conversions averaged per output
+    uint16_t    frames;             //frames the pairs were collected from
+    int16_t     offset;             //match of ADC1, 1/16 LSB
+    uint16_t    gain;               //match of ADC1, Q2.14
+    int16_t     mean;               //mean ADC1-ADC0 difference, 1/16 LSB
+    uint16_t    mismatch;           //RMS ADC1-ADC0 difference, 1/16 LSB
+    uint16_t    residual;           //MATCH: RMS left after the fit, 1/16 LSB
+    uint32_t    conversionRate;     //ADC conversions/s during a readout, all cores
+    uint32_t    pixelRateMax;       //outputs/s the capture path sustains at this oversampling
+} CCD_ADC_REPLY;                    //24 bytes
+
+// *****************************************************************************
+/* Sampling phase
+
+  Summary:
+    Operations of the "PHS" command, which places the ADC trigger within
+    the conversion spacing.
+
+  Remarks:
+    The conversions of a readout are evenly spaced (one output period, or
+    the output period divided by the conversions per output), and the phase
+    moves all of them within that spacing in CCD_PHASE_STEPS steps: step k
+    triggers k/CCD_PHASE_STEPS of the spacing after the start, phase 4, a
+    quarter, is the default. A new phase takes effect at the next ICG pulse
+    together with clock and oversampling changes.
+
+    SWEEP takes frames (2..255) frames at every phase in turn, from the
+    frame rate in effect, so with a short frame period the sweep takes
+    seconds. The scene must be stable and lit: each phase is scored by the
+    mean of the light sensitive outputs above the light shielded ones
+    (signal) against the variance of the difference of consecutive frames
+    (noise), and the phase with the highest signal^2/noise is set. Without
+    signal at any phase (CCD_PHASE_DARK) the previous phase is kept. SET
+    selects the phase byte, QUERY only reports. The phase in effect is
+    saved with the correction tables ("CAL" SAVE) and loaded at boot.
+*/
+
+#define CCD_PHASE_SWEEP         0
+#define CCD_PHASE_SET           1
+#define CCD_PHASE_QUERY         2
+#define CCD_PHASE_STEPS         16
+#define CCD_PHASE_DEFAULT       4           //a quarter of the spacing
+
+#define CCD_PHASE_OK            0
+#define CCD_PHASE_BAD_REQUEST   1           //unknown operation, phase or frames
+#define CCD_PHASE_DARK          2           //SWEEP: no phase saw enough signal
+#define CCD_PHASE_HDR           3           //SWEEP: HDR mode changes the exposure every frame
+
+typedef struct
+{
+    uint8_t     operation;          //CCD_PHASE_xxx
+    uint8_t     status;             //CCD_PHASE_OK or error
+    uint8_t     phase;              //in effect
+    uint8_t     previous;           //SWEEP: phase before the sweep
+    uint8_t     frames;             //SWEEP: frames per phase
+    uint8_t     reserved;
+    uint16_t    spacing;            //ns between conversions, CCD_PHASE_STEPS phases
+    uint16_t    signal[CCD_PHASE_STEPS];    //SWEEP: mean signal per phase, 1/16 LSB
+    uint32_t    noise[CCD_PHASE_STEPS];     //SWEEP: noise variance per phase, 1/256 LSB^2
+} CCD_PHASE_REPLY;                  //104 bytes
+
+// *****************************************************************************
+/* ADC linearity correction
+
+  Summary:
+    Operations of the "LIN" command, a lookup table of the ideal value of
+    every 12-bit ADC code.
+
+  Remarks:
+    LOAD stores block (0..CCD_LIN_BLOCKS-1) of the table: the command is
+    followed by CCD_LIN_BLOCK entries, big-endian, each the ideal value of
+    its code in 1/16 LSB (identity: code*16, at most CCD_LIN_ENTRY_MAX).
+    Block 0 starts a new table. Blocks are refused while the table is
+    switched on (CCD_LIN_ENABLED), ENABLE switches it on (options bit 0
+    set) once all blocks are loaded, or off. SAVE writes the table to
+    flash, it is loaded at boot; CLEAR restores the identity, switched
+    off. BENCH returns the CPU cycles the lookup adds to one frame in
+    value, QUERY only reports.
+
+    The table is applied to the ADC0 conversions from the next ICG pulse
+    on, before oversampling and dark and flat-field correction; capture
+    the "CAL" tables with it in the state they will be used with. With two
+    ADC cores ("ADC") the ADC1 conversions are not linearized, "ADC" MATCH
+    maps them onto the linearized ADC0 scale.
+*/
+
+#define CCD_LIN_LOAD            0
+#define CCD_LIN_ENABLE          1
+#define CCD_LIN_SAVE            2
+#define CCD_LIN_CLEAR           3
+#define CCD_LIN_BENCH           4
+#define CCD_LIN_QUERY           5
+
+#define CCD_LIN_ON              0x01        //ENABLE options
+
+#define CCD_LIN_SIZE            4096        //entries, one per 12-bit code
+#define CCD_LIN_BLOCK           256         //entries per LOAD
+#define CCD_LIN_BLOCKS          (CCD_LIN_SIZE/CCD_LIN_BLOCK)
+#define CCD_LIN_COMPLETE        0xFFFF      //loaded mask with every block
+#define CCD_LIN_ENTRY_MAX       (CCD_ADC_MAX<<CCD_FINE_SHIFT)
+
+#define CCD_LIN_OK              0
+#define CCD_LIN_BAD_REQUEST     1           //unknown operation, block or short LOAD
+#define CCD_LIN_ENABLED         2           //LOAD: switch the table off first
+#define CCD_LIN_INCOMPLETE      3           //ENABLE, SAVE: blocks are missing
+#define CCD_LIN_RANGE           4           //LOAD: entry above CCD_LIN_ENTRY_MAX
+#define CCD_LIN_FLASH_ERROR     5
+
+typedef struct
+{
+    uint8_t     operation;          //CCD_LIN_xxx
+    uint8_t     status;             //CCD_LIN_OK or error
+    uint8_t     enabled;            //table switched on
+    uint8_t     reserved;
+    uint16_t    loaded;             //blocks in the table, bit per block
+    uint16_t    size;               //CCD_LIN_SIZE
+    uint32_t    value;              //operation specific
+} CCD_LIN_REPLY;                    //12 bytes
+
+// *****************************************************************************
+/* Interrupt latency
+
+  Summary:
+    Reply to "IRQ", histograms of interrupt entry latency and duration.
+
+  Remarks:
+    Every source counts its interrupts and sorts their entry latency (from
+    the event that raised the interrupt, 0 where there is no such event)
+    and duration into CCD_IRQ_BINS power of two bins of CORETIMER ticks
+    (CCD_TIMESTAMP_HZ): bin 0 holds 0 ticks, bin k 2^(k-1) up to 2^k-1
+    ticks, the last bin everything longer. QUERY reports the counts since
+    the last RESET, RESET reports them and starts over. missed counts ADC
+    conversions whose result was overwritten before the ADC interrupt read
+    it; with no missed conversions and no overruns every frame holds every
+    output.
+*/
+
+#define CCD_IRQ_QUERY           0
+#define CCD_IRQ_RESET           1
+
+#define CCD_IRQ_ADC             0           //ADC_DATA0, pixel capture
+#define CCD_IRQ_SH              1           //TIMER_3, SH and ICG
+#define CCD_IRQ_USB             2
+#define CCD_IRQ_USB_DMA         3
+#define CCD_IRQ_SOURCES         4
+#define CCD_IRQ_BINS            16
+
+#define CCD_IRQ_OK              0
+#define CCD_IRQ_BAD_REQUEST     1
+
+typedef struct
+{
+    uint32_t    count;              //interrupts
+    uint32_t    latencyMax;         //ticks
+    uint32_t    durationMax;        //ticks
+    uint32_t    latency[CCD_IRQ_BINS];
+    uint32_t    duration[CCD_IRQ_BINS];
+} CCD_IRQ_SOURCE;                   //140 bytes
+
+typedef struct
+{
+    uint8_t     operation;          //CCD_IRQ_xxx
+    uint8_t     status;             //CCD_IRQ_OK or error
+    uint8_t     sources;            //CCD_IRQ_SOURCES
+    uint8_t     bins;               //CCD_IRQ_BINS
+    uint8_t     priority[CCD_IRQ_SOURCES];  //interrupt priority level per source
+    uint32_t    elapsed;            //ms since the last RESET, wraps after 42.9 s
+    uint32_t    missed;             //ADC conversions lost since the last RESET
+    uint32_t    overruns;           //readouts cut short since power up
+    CCD_IRQ_SOURCE source[CCD_IRQ_SOURCES];
+} CCD_IRQ_REPLY;                    //580 bytes
+
+// *****************************************************************************
+/* Compression
+
+  Summary:
+    Lossless CCD_FORMAT_RICE payload of CCD_MODE_FRAME with CCD_FRAME_RICE.
+
+  Remarks:
+    The coded values are the ones CCD_FORMAT_RAW sends for the same hRes
+    and vRes, CCD_RICE_BITS(vRes) wide: the 12-bit sample shifted down for
+    vRes 0..3, (sample<<CCD_FINE_SHIFT)|fraction for CCD_VRES_16BIT, the
+    sample for CCD_VRES_NATIVE. Each is predicted by the one before it (the
+    first by 0); the difference modulo 2^bits, taken as signed, is mapped to
+    u=2d for d>=0 and u=-2d-1 below.
+
+    The payload is a bit stream, most significant bit of each byte first,
+    of blocks of CCD_RICE_BLOCK values (the last one shorter), so a frame is
+    coded and decoded in one pass. A block starts with its 4-bit parameter
+    k. k=CCD_RICE_RAW: the block has every u in bits. Otherwise each u is
+    q=u>>k one bits, a zero bit and the low k bits of u; with q at or above
+    CCD_RICE_ESCAPE it is CCD_RICE_ESCAPE one bits followed by u in bits
+    instead. The stream ends with zero bits to a whole byte.
+
+    A frame whose stream would not be shorter than its CCD_FORMAT_RAW
+    payload is sent as CCD_FORMAT_RAW, so a host must accept both formats.
+*/
+
+#define CCD_RICE_BLOCK          32          //values sharing one parameter k
+#define CCD_RICE_RAW            15          //k of a block of bits-wide values
+#define CCD_RICE_ESCAPE         16          //one bits before a value sent in full
+#define CCD_RICE_BITS(vRes)     ((vRes)==CCD_VRES_16BIT?16:(vRes)==CCD_VRES_NATIVE?12:6+2*(vRes))
+
+// *****************************************************************************
+/* Status
+
+  Summary:
+    Reply to "STA", counters of the acquisition, the USB link and the CPU.
+
+  Remarks:
+    The counters run from power up and wrap around at 2^32, hosts poll them
+    and take the differences (modulo 2^32) between two replies; the tick
+    counters wrap after 42.9 s, so poll at least every 20 s. CPU time is in
+    CORETIMER ticks (CCD_TIMESTAMP_HZ): per interrupt source without the
+    higher priority interrupts that preempted it, and idle, the main loop
+    waiting with nothing to do, again without the interrupts meanwhile. The
+    main loop had the rest of the ticks between two timestamps. size lets
+    hosts accept replies of later firmware that append counters.
+
+    Version 2 appends the CCD_FRAME_RICE counters: compressTicks is the time
+    spent coding, raw and compressed bytes are summed over the frames sent
+    as CCD_FORMAT_RICE, fallbacks were coded but sent as CCD_FORMAT_RAW.
+
+    Version 3 appends the frames CCD_MODE_CHANGE found unchanged and did not
+    send; framesSkipped does not count them.
+*/
+
+#define CCD_STATUS_VERSION      3
+#define CCD_STATUS_V1_SIZE      64          //size of version 1, without the compression counters
+
+typedef struct
+{
+    uint8_t     version;            //CCD_STATUS_VERSION
+    uint8_t     size;               //sizeof(CCD_STATUS_REPLY)
+    uint8_t     framesQueued;       //1 if the newest frame was not sent yet
+    uint8_t     reserved;
+    uint32_t    timestamp;          //CORETIMER when the counters were taken
+    uint32_t    framesCaptured;     //readouts completed
+    uint32_t    framesSent;         //"FRM" and "GET" replies with a frame
+    uint32_t    framesSkipped;      //completed between two "FRM" frames, never sent
+    uint32_t    overruns;           //readouts cut short by the next ICG pulse
+    uint32_t    samplesMissed;      //ADC conversions lost (see CCD_IRQ_REPLY)
+    uint32_t    usbBytesSent;
+    uint32_t    usbBytesReceived;
+    uint32_t    usbCommands;        //USB reads completed
+    uint32_t    isrTicks[CCD_IRQ_SOURCES];  //CCD_IRQ_xxx sources
+    uint32_t    idleTicks;
+    uint32_t    loops;              //main loop passes
+    uint32_t    compressFrames;     //version 2, frames coded with CCD_FRAME_RICE
+    uint32_t    compressValues;     //samples in them
+    uint32_t    compressTicks;      //CORETIMER ticks coding them
+    uint32_t    compressRawBytes;   //CCD_FORMAT_RAW size of the frames sent as CCD_FORMAT_RICE
+    uint32_t    compressBytes;      //their CCD_FORMAT_RICE size
+    uint32_t    compressFallbacks;  //coded frames sent as CCD_FORMAT_RAW
+    uint32_t    framesUnchanged;    //version 3, held back by CCD_MODE_CHANGE
+} CCD_STATUS_REPLY;                 //92 bytes
+
+// *****************************************************************************
+/* Event trace
+
+  Summary:
+    Operations and reply of the "TRC" command, a ring of timestamped events.
+
+  Remarks:
+    START clears the ring and records the events of the mask (bit per
+    CCD_TRACE_xxx event, 0 selects CCD_TRACE_DEFAULT), STOP freezes it and
+    READ returns block of the frozen ring, oldest entries first: the ring
+    keeps the last CCD_TRACE_SIZE of the written events. Timestamps are
+    CORETIMER ticks (CCD_TIMESTAMP_HZ) and wrap every 42.9 s. Entries of
+    interrupts that preempt a trace point can be a few ticks out of order.
+    BEGIN and END entries of an event bracket a span, every event has its
+    own track so spans of one event never overlap. Firmware built without
+    trace points (TRACE_ENABLED 0 in trace.h) answers CCD_TRACE_DISABLED.
+*/
+
+#define CCD_TRACE_START         0
+#define CCD_TRACE_STOP          1
+#define CCD_TRACE_READ          2
+#define CCD_TRACE_QUERY         3
+
+/* Events, the interrupts numbered like CCD_IRQ_xxx */
+#define CCD_TRACE_IRQ_ADC       0           //span, ADC_DATA0 handler
+#define CCD_TRACE_IRQ_SH        1           //span, TIMER_3 handler
+#define CCD_TRACE_IRQ_USB       2           //span, USB handler
+#define CCD_TRACE_IRQ_USB_DMA   3           //span, USB DMA handler
+#define CCD_TRACE_READOUT       4           //ICG pulse started a readout, arg 1 if the last one was cut short
+#define CCD_TRACE_FRAME         5           //readout complete, arg sequence
+#define CCD_TRACE_USB_READ      6           //command received, arg bytes
+#define CCD_TRACE_USB_WRITE     7           //span, USB_DEVICE_CDC_Write to write complete, arg bytes
+#define CCD_TRACE_USB_STATE     8           //USBCDC_Tasks state changed, arg the new state
+#define CCD_TRACE_TASKS         9           //span, SYS_Tasks
+#define CCD_TRACE_SEND          10          //span, frame reply prepared by the main loop, arg sequence
+#define CCD_TRACE_IDLE          11          //span, main loop waiting
+#define CCD_TRACE_EVENTS        12
+#define CCD_TRACE_DEFAULT       0x0FFE      //all but the ADC interrupt, up to a million a second
+
+/* Entry phases */
+#define CCD_TRACE_INSTANT       0
+#define CCD_TRACE_BEGIN         1
+#define CCD_TRACE_END           2
+
+#define CCD_TRACE_SIZE          2048        //entries in the ring
+#define CCD_TRACE_BLOCK         256         //entries per READ
+#define CCD_TRACE_BLOCKS        (CCD_TRACE_SIZE/CCD_TRACE_BLOCK)
+
+#define CCD_TRACE_OK            0
+#define CCD_TRACE_BAD_REQUEST   1
+#define CCD_TRACE_RUNNING       2           //READ before STOP
+#define CCD_TRACE_DISABLED      3
+
+typedef struct
+{
+    uint32_t    timestamp;          //CORETIMER
+    uint8_t     event;              //CCD_TRACE_xxx event
+    uint8_t     phase;              //CCD_TRACE_INSTANT, BEGIN or END
+    uint16_t    arg;                //event specific
+} CCD_TRACE_ENTRY;                  //8 bytes
+
+typedef struct
+{
+    uint8_t     operation;          //CCD_TRACE_xxx
+    uint8_t     status;             //CCD_TRACE_OK or error
+    uint8_t     running;            //events are being recorded
+    uint8_t     block;              //of READ
+    uint16_t    mask;               //events recorded, bit per event
+    uint16_t    count;              //valid entries in entry (READ)
+    uint32_t    written;            //events since START
+    CCD_TRACE_ENTRY entry[CCD_TRACE_BLOCK];
+} CCD_TRACE_REPLY;                  //2060 bytes
+
+// *****************************************************************************
+/* DMA buffer placement
+
+  Summary:
+    Operations and reply of the "BUF" command.
+
+  Remarks:
+    SET selects how the CPU writes the USB write buffer: through its
+    uncached alias (COHERENT, no maintenance) or cached with the written
+    bytes cleaned before every USB write (CACHED). BENCH measures both on
+    a full frame of 12-bit samples, in CPU cycles: capture stores every
+    sample as the ADC interrupt does (cached: and cleans the frame for a
+    DMA), read sums them as the main loop does (cached: after invalidating
+    what a DMA would have written), pack formats the newest frame into the
+    USB write buffer (cached: and cleans it, 0 without a frame). Every
+    figure is the fastest of a few runs, interrupts keep running.
+*/
+
+#define CCD_BUF_QUERY           0
+#define CCD_BUF_SET             1
+#define CCD_BUF_BENCH           2
+
+#define CCD_BUF_COHERENT        0           //uncached alias (DEFAULT)
+#define CCD_BUF_CACHED          1
+
+#define CCD_BUF_OK              0
+#define CCD_BUF_BAD_REQUEST     1
+
+typedef struct
+{
+    uint8_t     operation;          //CCD_BUF_xxx
+    uint8_t     status;             //CCD_BUF_OK or error
+    uint8_t     placement;          //of the USB write buffer, CCD_BUF_COHERENT or CACHED
+    uint8_t     reserved;
+    uint32_t    captureCached;      //BENCH, CPU cycles per frame
+    uint32_t    captureCoherent;
+    uint32_t    readCached;
+    uint32_t    readCoherent;
+    uint32_t    packCached;
+    uint32_t    packCoherent;
+    uint32_t    clean;              //of one frame, included in the cached figures; all a
+                                    //CCD_VRES_NATIVE frame costs, it is sent in place
+} CCD_BUF_REPLY;                    //32 bytes
+
+// *****************************************************************************
+/* Frame arena
+
+  Summary:
+    Owners and reply of the "MEM" command.
+
+  Remarks:
+    Frames, accumulators and the USB transmit buffer are blocks of one
+    static arena, CCD_MEM_BLOCK_SIZE bytes each (a byte per output, whole
+    cache lines). What the firmware takes at start-up (CCD_MEM_STARTUP_BLOCKS)
+    is checked against the arena size at build time, the rest is free for
+    burst captures and the buffers of output modes while they are on. A
+    12-bit frame takes 2 blocks, an oversampled frame 3 (with its
+    fractions), the HDR merge buffer 5 (32-bit sums and saturation flags).
+*/
+
+#define CCD_MEM_TX              0           //USB transmit buffer
+#define CCD_MEM_FRAMES          1           //capture slots, data and fractions
+#define CCD_MEM_ACCUMULATOR     2           //dark/flat-field capture sums
+#define CCD_MEM_SCRATCH         3           //bench output, shared
+#define CCD_MEM_BURST           4           //burst capture frames
+#define CCD_MEM_REFERENCE       5           //CCD_MODE_CHANGE reference frames, while the mode is on
+#define CCD_MEM_HDR             6           //CCD_MODE_HDR merge buffer, while the mode is on
+#define CCD_MEM_OWNERS          7
+
+#define CCD_MEM_BLOCK_SIZE      3696        //CCD_DATA_SIZE rounded up to 16-byte cache lines
+#define CCD_MEM_BLOCKS(bytes)   (((bytes)+CCD_MEM_BLOCK_SIZE-1)/CCD_MEM_BLOCK_SIZE)
+#define CCD_MEM_STARTUP_BLOCKS  21          //TX 3, frames 4x(2+1), sums 4, scratch 2 (checked in arena.c)
+
+typedef struct
+{
+    uint16_t    blockSize;          //CCD_MEM_BLOCK_SIZE
+    uint16_t    blocks;             //in the arena
+    uint16_t    free;
+    uint16_t    largestFree;        //longest run of free blocks, the largest allocation possible
+    uint16_t    owned[CCD_MEM_OWNERS];  //blocks per CCD_MEM_xxx owner
+    uint16_t    reserved;
+    uint32_t    failures;           //allocations refused since power up
+} CCD_MEM_REPLY;                    //28 bytes
+
+// *****************************************************************************
+/* Time synchronization
+
+  Summary:
+    Reply to "SYN", carries device timestamps of the request and the reply.
+
+  Remarks:
+    The 8 bytes following "SYN" are opaque to the device and are echoed back
+    (0 if the request was shorter), hosts put their transmit time there.
+    rxTimestamp is captured when the USB read of the request completes,
+    txTimestamp right before the reply is queued, so the device turnaround
+    (txTimestamp-rxTimestamp) can be removed from the round trip measured by
+    the host.
+*/
+
+#define CCD_SYNC_DATA_SIZE      8
+
+typedef struct
+{
+    uint64_t    hostTimestamp;      //echo of the request parameter
+    uint32_t    rxTimestamp;        //CORETIMER when the request was received
+    uint32_t    txTimestamp;        //CORETIMER when the reply was queued
+} CCD_SYNC_REPLY;                   //16 bytes
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_PROTOCOL_H */
@@ -0,0 +1,59 @@
+/*******************************************************************************
+  Change Detection Source File
+
+  File Name:
+    change.c
+
+  Summary:
+    Difference of a frame to a reference frame, sample by sample.
+
+  Description:
+    The per sample work is in CHANGE_Sample (change.h), a subtraction, an
+    addition and a comparison in the ADC interrupt. The decision is made
+    once per frame in the main loop.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "change.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void CHANGE_Begin(CHANGE_STATE *s, const uint16_t *reference)
+{
+    s->reference=reference;
+    s->sum=0;
+    s->maximum=0;
+}
+/******************************************************************************/
+//Runs the streaming comparison over count stored samples from first on
+void CHANGE_Compare(CHANGE_STATE *s, const uint16_t *data, const uint16_t *reference, uint16_t first, uint16_t count)
+{
+    CHANGE_Begin(s,reference);
+    for(uint16_t i=first;i<first+count;i++)CHANGE_Sample(s,i,data[i]);
+}
+/******************************************************************************/
+//Mean absolute difference of count samples in 1/16 LSB, rounded
+uint32_t CHANGE_Mean(uint32_t sum, uint16_t count)
+{
+    return count?(uint32_t)(((uint64_t)sum*16+count/2)/count):0;
+}
+/******************************************************************************/
+//True if a frame with these differences over count samples is to be sent
+bool CHANGE_Exceeds(const CHANGE_CONFIG *config, uint32_t sum, uint16_t maximum, uint16_t count)
+{
+    if(config->options&CCD_CHANGE_MAXIMUM)return maximum>config->threshold;
+    return (uint64_t)sum*16>(uint64_t)config->threshold*count;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,90 @@
+/*******************************************************************************
+  Change Detection Header File
+
+  File Name:
+    change.h
+
+  Summary:
+    Difference of a frame to a reference frame, sample by sample.
+
+  Description:
+    The comparison sees one sample at a time, so it runs from the ADC
+    interrupt while the frame is read out and the result is there with the
+    last pixel: the sum of absolute differences to the reference and the
+    largest one. CHANGE_Exceeds decides against the threshold of
+    CCD_MODE_CHANGE, either on the mean difference or on the largest one.
+
+    The module has no hardware dependencies, the host tools build the same
+    code (CHANGE_Compare runs the comparison over a stored frame).
+ *******************************************************************************/
+
+#ifndef _CHANGE_H
+#define _CHANGE_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+typedef struct
+{
+    uint16_t    threshold;          //1/16 LSB of the mean, LSB with CCD_CHANGE_MAXIMUM
+    uint8_t     options;            //CCD_CHANGE_xxx
+}CHANGE_CONFIG;
+
+typedef struct
+{
+    const uint16_t *reference;      //CCD_DATA_SIZE samples
+    uint32_t    sum;                //of absolute differences
+    uint16_t    maximum;            //largest absolute difference
+}CHANGE_STATE;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void CHANGE_Begin(CHANGE_STATE *s, const uint16_t *reference);
+void CHANGE_Compare(CHANGE_STATE *s, const uint16_t *data, const uint16_t *reference, uint16_t first, uint16_t count);
+uint32_t CHANGE_Mean(uint32_t sum, uint16_t count);
+bool CHANGE_Exceeds(const CHANGE_CONFIG *config, uint32_t sum, uint16_t maximum, uint16_t count);
+
+//Called for every compared sample of the frame (ADC interrupt)
+static inline void CHANGE_Sample(CHANGE_STATE *s, uint16_t index, uint16_t value)
+{
+    uint16_t ref=s->reference[index];
+    uint16_t d=value>ref?value-ref:ref-value;
+
+    s->sum+=d;
+    if(d>s->maximum)s->maximum=d;
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _CHANGE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -52,6 +52,8 @@
 #include "configuration.h"
 #include "interrupts.h"
 #include "definitions.h"
+#include "latency.h"
+#include "trace.h"
 
 
 // *****************************************************************************
@@ -69,24 +71,43 @@ void DRV_USBHS_DMAInterruptHandler( void );
 
 
 /* All the handlers are defined here.  Each will call its PLIB-specific function. */
-void __ISR(_TIMER_3_VECTOR, ipl1SRS) TIMER_3_Handler (void)
+/* Pixel capture above SH/ICG above USB, priorities and shadow sets in latency.h */
+void __ISR(_TIMER_3_VECTOR, ipl6SRS) TIMER_3_Handler (void)
 {
+    uint32_t start=_CP0_GET_COUNT(), above=LATENCY_Above(CCD_IRQ_SH);
+    uint32_t latency=LATENCY_Sh();
+    TRACE_EventAt(CCD_TRACE_IRQ_SH,CCD_TRACE_BEGIN,0,start);
     TIMER_3_InterruptHandler();
+    TRACE_Event(CCD_TRACE_IRQ_SH,CCD_TRACE_END,0);
+    LATENCY_Add(CCD_IRQ_SH,start,above,latency);
 }
 
-void __ISR(_ADC_DATA0_VECTOR, ipl1SRS) ADC_DATA0_Handler (void)
+void __ISR(_ADC_DATA0_VECTOR, ipl7SRS) ADC_DATA0_Handler (void)
 {
+    uint32_t start=_CP0_GET_COUNT();
+    uint32_t latency=LATENCY_Adc(start);
+    TRACE_EventAt(CCD_TRACE_IRQ_ADC,CCD_TRACE_BEGIN,0,start);
     ADC_DATA0_InterruptHandler();
+    TRACE_Event(CCD_TRACE_IRQ_ADC,CCD_TRACE_END,0);
+    LATENCY_Add(CCD_IRQ_ADC,start,0,latency);
 }
 
 void __ISR(_USB_VECTOR, ipl1SRS) USB_Handler (void)
 {
+    uint32_t start=_CP0_GET_COUNT(), above=LATENCY_Above(CCD_IRQ_USB);
+    TRACE_EventAt(CCD_TRACE_IRQ_USB,CCD_TRACE_BEGIN,0,start);
     DRV_USBHS_InterruptHandler();
+    TRACE_Event(CCD_TRACE_IRQ_USB,CCD_TRACE_END,0);
+    LATENCY_Add(CCD_IRQ_USB,start,above,0);
 }
 
 void __ISR(_USB_DMA_VECTOR, ipl1SRS) USB_DMA_Handler (void)
 {
+    uint32_t start=_CP0_GET_COUNT(), above=LATENCY_Above(CCD_IRQ_USB_DMA);
+    TRACE_EventAt(CCD_TRACE_IRQ_USB_DMA,CCD_TRACE_BEGIN,0,start);
     DRV_USBHS_DMAInterruptHandler();
+    TRACE_Event(CCD_TRACE_IRQ_USB_DMA,CCD_TRACE_END,0);
+    LATENCY_Add(CCD_IRQ_USB_DMA,start,above,0);
 }
 
 
@@ -60,6 +60,8 @@ void ADCHS_Initialize()
     ADCCON1bits.ON = 0;
 ADC0CFG = DEVADC0;
 ADC0TIME = 0x1010001;
+ADC1CFG = DEVADC1;
+ADC1TIME = 0x1010001;
 
     ADCCON1 = 0x600000;
     ADCCON2 = 0x20004;
@@ -109,6 +111,11 @@ IEC3SET = 0x0;
     while(!ADCANCONbits.WKRDY0); // Wait until ADC is ready
     ADCCON3bits.DIGEN0 = 1;      // Enable ADC
 
+    /* ADC 1 */
+    ADCANCONbits.ANEN1 = 1;      // Enable the clock to analog bias
+    while(!ADCANCONbits.WKRDY1); // Wait until ADC is ready
+    ADCCON3bits.DIGEN1 = 1;      // Enable ADC
+
 
 
 }
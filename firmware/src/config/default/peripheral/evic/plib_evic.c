@@ -55,8 +55,8 @@ void EVIC_Initialize( void )
     INTCONSET = _INTCON_MVEC_MASK;
 
     /* Set up priority and subpriority of enabled interrupts */
-    IPC3SET = 0x40000 | 0x0;  /* TIMER_3:  Priority 1 / Subpriority 0 */
-    IPC14SET = 0x4000000 | 0x0;  /* ADC_DATA0:  Priority 1 / Subpriority 0 */
+    IPC3SET = 0x180000 | 0x0;  /* TIMER_3:  Priority 6 / Subpriority 0 */
+    IPC14SET = 0x1c000000 | 0x0;  /* ADC_DATA0:  Priority 7 / Subpriority 0 */
     IPC33SET = 0x4 | 0x0;  /* USB:  Priority 1 / Subpriority 0 */
     IPC33SET = 0x400 | 0x0;  /* USB_DMA:  Priority 1 / Subpriority 0 */
 
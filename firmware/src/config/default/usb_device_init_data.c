@@ -53,7 +53,7 @@
 const USB_DEVICE_CDC_INIT cdcInit0 =
 {
 	.queueSizeRead = 1,
-	.queueSizeWrite = 1,
+	.queueSizeWrite = 2,
 	.queueSizeSerialStateNotification = 1
 };
 
@@ -0,0 +1,197 @@
+/*******************************************************************************
+  Dark and Flat-Field Correction Source File
+
+  File Name:
+    correction.c
+
+  Summary:
+    Per-pixel dark offset and gain (PRNU) tables, capture and storage.
+
+  Description:
+    Capture runs in the main loop: every new uncorrected frame is added to a
+    per-pixel sum until the requested number of frames is reached, then the
+    tables are computed from the averages.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <string.h>
+#include "correction.h"
+#include "flash.h"
+#include "arena.h"
+#include "definitions.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data Definitions
+// *****************************************************************************
+// *****************************************************************************
+CORR_TABLE corrTable;
+volatile bool corrCapturing=false;
+
+//Flash copy, the page is reserved so the linker places nothing else there
+typedef union
+{
+    CORR_TABLE  table;
+    uint8_t     page[FLASH_PAGE_SIZE];
+}CORR_FLASH_PAGE;
+
+static const CORR_FLASH_PAGE corrFlash __attribute__((space(prog),address(CORR_FLASH_ADDRESS)));
+
+static uint32_t *corrSum;                   //capture accumulator, in the frame arena
+static uint8_t corrOperation, corrOptions;
+static uint8_t corrFrames, corrCount;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+static uint32_t CORR_Checksum(const CORR_TABLE *t)
+{
+    uint32_t sum=t->flags+((uint32_t)t->phase<<8);
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)
+        sum+=t->dark[i]+((uint32_t)t->gain[i]<<16);
+    return sum;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Loads the tables from flash, identity if none were saved
+void CORR_Initialize(void)
+{
+    const CORR_TABLE *t=&corrFlash.table;
+
+    corrSum=ARENA_Alloc(CCD_MEM_ACCUMULATOR,ARENA_SUM_BYTES);
+    if(t->magic==CORR_MAGIC&&t->version==CORR_VERSION&&t->size==CCD_DATA_SIZE&&t->checksum==CORR_Checksum(t))
+        corrTable=*t;
+    else
+        CORR_Clear();
+}
+/******************************************************************************/
+void CORR_Clear(void)
+{
+    corrTable.magic=CORR_MAGIC;
+    corrTable.version=CORR_VERSION;
+    corrTable.size=CCD_DATA_SIZE;
+    corrTable.flags=0;
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)
+    {
+        corrTable.dark[i]=0;
+        corrTable.gain[i]=CORR_GAIN_ONE;
+    }
+}
+/******************************************************************************/
+uint8_t CORR_Enable(bool enable)
+{
+    if(!enable)corrTable.flags&=~CORR_ENABLED;
+    else if(corrTable.flags&CORR_HAS_DARK)corrTable.flags|=CORR_ENABLED;
+    else return CCD_CAL_NO_DARK;
+    return CCD_CAL_OK;
+}
+/******************************************************************************/
+//Starts averaging frames for CCD_CAL_DARK or CCD_CAL_FLAT
+uint8_t CORR_CaptureStart(uint8_t operation, uint8_t frames, uint8_t options)
+{
+    if(!frames||(operation!=CCD_CAL_DARK&&operation!=CCD_CAL_FLAT))return CCD_CAL_BAD_REQUEST;
+    if(operation==CCD_CAL_FLAT&&!(corrTable.flags&CORR_HAS_DARK))return CCD_CAL_NO_DARK;
+
+    memset(corrSum,0,ARENA_SUM_BYTES);
+    corrOperation=operation;
+    corrOptions=options;
+    corrFrames=frames;
+    corrCount=0;
+    corrCapturing=true;                 //readouts from now on are not corrected
+    return CCD_CAL_OK;
+}
+/******************************************************************************/
+//Adds an uncorrected frame, returns true when enough frames were collected
+bool CORR_CaptureFrame(const uint16_t *data)
+{
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)
+        corrSum[i]+=data[i];
+    return ++corrCount>=corrFrames;
+}
+/******************************************************************************/
+uint8_t CORR_CaptureFinish(void)
+{
+    uint32_t n=corrCount;
+
+    if(corrOperation==CCD_CAL_DARK)
+    {
+        for(uint16_t i=0;i<CCD_DATA_SIZE;i++)
+            corrTable.dark[i]=(uint16_t)(((corrSum[i]<<CORR_DARK_SHIFT)+n/2)/n);
+        corrTable.flags|=CORR_HAS_DARK;
+        if(corrOptions&CCD_CAL_INVERT)corrTable.flags|=CORR_INVERT;
+        else corrTable.flags&=~CORR_INVERT;
+    }
+    else
+    {
+        /* Response above dark, then gain to the mean response of the signal pixels */
+        uint64_t total=0;
+        uint16_t valid=0;
+        for(uint16_t i=0;i<CCD_DATA_SIZE;i++)
+        {
+            int32_t s=(int32_t)(((corrSum[i]<<CORR_DARK_SHIFT)+n/2)/n)-corrTable.dark[i];
+            if(corrTable.flags&CORR_INVERT)s=-s;
+            corrSum[i]=s>0?(uint32_t)s:0;
+            if(i>=CCD_SIGNAL_FIRST&&i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT&&s>0)
+            {
+                total+=(uint32_t)s;
+                valid++;
+            }
+        }
+        uint32_t mean=valid?(uint32_t)(total/valid):0;
+        for(uint16_t i=0;i<CCD_DATA_SIZE;i++)
+        {
+            uint32_t g=CORR_GAIN_ONE;
+            //dummy outputs and dead pixels keep unity gain
+            if(i>=CCD_SIGNAL_FIRST&&i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT&&corrSum[i])
+                g=(mean<<CORR_GAIN_SHIFT)/corrSum[i];
+            corrTable.gain[i]=g>0xFFFF?0xFFFF:(uint16_t)g;
+        }
+        corrTable.flags|=CORR_HAS_FLAT;
+    }
+    corrTable.flags|=CORR_ENABLED;
+    corrCapturing=false;
+    return CCD_CAL_OK;
+}
+/******************************************************************************/
+uint8_t CORR_Save(void)
+{
+    corrTable.checksum=CORR_Checksum(&corrTable);
+    if(!FLASH_PageErase(&corrFlash))return CCD_CAL_FLASH_ERROR;
+    if(!FLASH_Write(&corrFlash,&corrTable,sizeof(corrTable)))return CCD_CAL_FLASH_ERROR;
+    CACHE_DataCacheInvalidate((uint32_t)&corrFlash,sizeof(corrTable));    //read back, not the lines cached at boot
+    return memcmp(&corrFlash.table,&corrTable,sizeof(corrTable))?CCD_CAL_FLASH_ERROR:CCD_CAL_OK;
+}
+/******************************************************************************/
+//CPU cycles CORR_Sample adds to one frame (CORETIMER runs at half the CPU clock)
+uint32_t CORR_Bench(const uint16_t *data)
+{
+    volatile uint16_t *corrBenchOut=ARENA_Scratch();  //volatile, so neither bench loop is optimized away
+    uint32_t start, copy, corrected;
+
+    start=CORETIMER_CounterGet();
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)corrBenchOut[i]=data[i];
+    copy=CORETIMER_CounterGet()-start;
+
+    start=CORETIMER_CounterGet();
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)corrBenchOut[i]=CORR_Sample(i,data[i]);
+    corrected=CORETIMER_CounterGet()-start;
+
+    return corrected>copy?(corrected-copy)*2:0;
+}
+
+/*******************************************************************************
+ End of File
+ */
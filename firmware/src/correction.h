@@ -0,0 +1,127 @@
+/*******************************************************************************
+  Dark and Flat-Field Correction Header File
+
+  File Name:
+    correction.h
+
+  Summary:
+    Per-pixel dark offset and gain (PRNU) tables, capture and storage.
+
+  Description:
+    The tables are captured on request ("CAL" command) by averaging frames of
+    the covered and of the uniformly lit sensor, stored in the last page of
+    program flash and loaded at boot. CORR_Sample is applied by the ADC
+    interrupt to every sample as it arrives, so frames (and everything
+    computed from them) are already corrected when they are published.
+
+    Fixed point: dark levels are stored x16 (CORR_DARK_SHIFT) so averaging
+    keeps sub-LSB precision, gains are Q2.14 (CORR_GAIN_ONE is 1.0).
+ *******************************************************************************/
+
+#ifndef _CORRECTION_H
+#define _CORRECTION_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define CORR_DARK_SHIFT         4
+#define CORR_GAIN_SHIFT         14
+#define CORR_GAIN_ONE           (1<<CORR_GAIN_SHIFT)
+
+#define CORR_MAGIC              0x52524F43  //"CORR"
+#define CORR_VERSION            1
+#define CORR_FLASH_ADDRESS      0x9D0FC000  //last 16KB page of program flash
+
+/* Table flags */
+#define CORR_HAS_DARK           0x01
+#define CORR_HAS_FLAT           0x02
+#define CORR_INVERT             0x04        //light lowers the output
+#define CORR_ENABLED            0x08
+
+typedef struct
+{
+    uint32_t    magic;              //CORR_MAGIC
+    uint16_t    version;            //CORR_VERSION
+    uint16_t    size;               //CCD_DATA_SIZE
+    uint8_t     flags;              //CORR_xxx
+    uint8_t     phase;              //sampling phase ("PHS") + 1, 0: none saved
+    uint8_t     reserved[2];
+    uint32_t    checksum;           //sum of dark and gain entries
+    uint16_t    dark[CCD_DATA_SIZE];//x16
+    uint16_t    gain[CCD_DATA_SIZE];//Q2.14
+}CORR_TABLE;
+
+extern CORR_TABLE corrTable;
+extern volatile bool corrCapturing;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void CORR_Initialize(void);
+void CORR_Clear(void);
+uint8_t CORR_Enable(bool enable);
+uint8_t CORR_CaptureStart(uint8_t operation, uint8_t frames, uint8_t options);
+bool CORR_CaptureFrame(const uint16_t *data);
+uint8_t CORR_CaptureFinish(void);
+uint8_t CORR_Save(void);
+uint32_t CORR_Bench(const uint16_t *data);
+
+//True if the next readout is to be corrected
+static inline bool CORR_Active(void)
+{
+    return (corrTable.flags&CORR_ENABLED)&&!corrCapturing;
+}
+
+//Corrected value of raw sample i, 0 is the dark level (ADC interrupt)
+static inline uint16_t CORR_Sample(uint16_t i, uint16_t raw)
+{
+    int32_t s=((int32_t)raw<<CORR_DARK_SHIFT)-corrTable.dark[i];
+    if(corrTable.flags&CORR_INVERT)s=-s;
+    if(s<=0)return 0;
+    uint32_t v=((uint32_t)s*corrTable.gain[i])>>(CORR_DARK_SHIFT+CORR_GAIN_SHIFT);
+    return v>CCD_ADC_MAX?CCD_ADC_MAX:(uint16_t)v;
+}
+
+//CORR_Sample of an oversampled sample kept x16 (the dark level scale), result x16
+static inline uint16_t CORR_SampleFine(uint16_t i, uint16_t fine)
+{
+    int32_t s=(int32_t)fine-corrTable.dark[i];
+    if(corrTable.flags&CORR_INVERT)s=-s;
+    if(s<=0)return 0;
+    uint32_t v=((uint32_t)s*corrTable.gain[i])>>CORR_GAIN_SHIFT;
+    return v>(CCD_ADC_MAX<<CORR_DARK_SHIFT)?(CCD_ADC_MAX<<CORR_DARK_SHIFT):(uint16_t)v;
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _CORRECTION_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,107 @@
+/*******************************************************************************
+  DMA Buffer Placement Source File
+
+  File Name:
+    dmabuf.c
+
+  Summary:
+    Cached against uncached access to a frame, for the "BUF" bench.
+
+  Description:
+    The bench works on the scratch frame of the arena, so capture goes on
+    undisturbed. The scratch frame is cleaned before it is used through its
+    uncached alias, no dirty line of it can be written back over it then.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "dmabuf.h"
+#include "arena.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define DMABUF_FRAME_BYTES      DMABUF_SIZE(ARENA_FRAME_BYTES)
+#define DMABUF_RUNS             4       //the fastest counts, interrupts keep running
+
+static volatile uint32_t dmabufSum;     //keeps the read loops
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//One sample per store, as the ADC interrupt writes them
+static void DMABUF_Capture(volatile uint16_t *frame)
+{
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)frame[i]=i&CCD_ADC_MAX;
+}
+/******************************************************************************/
+static void DMABUF_Read(const volatile uint16_t *frame)
+{
+    uint32_t sum=0;
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)sum+=frame[i];
+    dmabufSum=sum;
+}
+/******************************************************************************/
+static uint32_t DMABUF_Min(uint32_t a, uint32_t b)
+{
+    return a<b?a:b;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Capture, read and clean figures of reply in CPU cycles per frame (CORETIMER
+//runs at half the CPU clock), pack is left to the USB side
+void DMABUF_Bench(CCD_BUF_REPLY *reply)
+{
+    uint16_t *frame=ARENA_Scratch();
+    volatile uint16_t *uncached=DMABUF_Uncached(frame);
+    uint32_t start, t;
+
+    reply->captureCached=reply->captureCoherent=UINT32_MAX;
+    reply->readCached=reply->readCoherent=reply->clean=UINT32_MAX;
+    for(uint8_t run=0;run<DMABUF_RUNS;run++)
+    {
+        DMABUF_Clean(frame,DMABUF_FRAME_BYTES);
+        start=CORETIMER_CounterGet();
+        DMABUF_Capture(uncached);
+        reply->captureCoherent=DMABUF_Min(reply->captureCoherent,CORETIMER_CounterGet()-start);
+
+        start=CORETIMER_CounterGet();
+        DMABUF_Read(uncached);
+        reply->readCoherent=DMABUF_Min(reply->readCoherent,CORETIMER_CounterGet()-start);
+
+        start=CORETIMER_CounterGet();
+        DMABUF_Capture(frame);
+        t=CORETIMER_CounterGet();
+        DMABUF_Clean(frame,DMABUF_FRAME_BYTES);
+        reply->clean=DMABUF_Min(reply->clean,CORETIMER_CounterGet()-t);
+        reply->captureCached=DMABUF_Min(reply->captureCached,CORETIMER_CounterGet()-start);
+
+        start=CORETIMER_CounterGet();
+        DMABUF_Invalidate(frame,DMABUF_FRAME_BYTES);
+        DMABUF_Read(frame);
+        reply->readCached=DMABUF_Min(reply->readCached,CORETIMER_CounterGet()-start);
+    }
+    reply->captureCached*=2;
+    reply->captureCoherent*=2;
+    reply->readCached*=2;
+    reply->readCoherent*=2;
+    reply->clean*=2;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,101 @@
+/*******************************************************************************
+  DMA Buffer Placement Header File
+
+  File Name:
+    dmabuf.h
+
+  Summary:
+    Placement and cache maintenance of buffers a DMA engine reads or writes.
+
+  Description:
+    The L1 data cache is write-back and the DMA engines (USBHS) see memory
+    only, so a buffer shared with one is placed in one of two ways:
+
+      DMABUF_COHERENT   KSEG1, uncached. No maintenance, every CPU access
+                        goes to memory (the Harmony USB buffers).
+      DMABUF_CACHED     KSEG0, whole cache lines. DMABUF_Clean before a DMA
+                        reads it, DMABUF_Invalidate before the CPU reads
+                        what a DMA wrote; the CPU leaves it alone meanwhile.
+
+    A cached buffer can also be reached uncached through DMABUF_Uncached,
+    the KSEG1 alias of the same memory, after DMABUF_Clean made sure no
+    dirty line of it is left to be written back over it later. Cached
+    buffers start and end on a line and are DMABUF_SIZE long, so
+    maintaining one never touches a neighbour.
+
+    The USB write buffer is cached or reached through its alias ("BUF",
+    usbcdc.c), the read buffer stays coherent: commands are a few bytes and
+    invalidating before every read would cost more. The frame buffers are
+    written by the ADC interrupt and read by the main loop only, they are
+    cached blocks of the frame arena (arena.h), line aligned and padded, so
+    a DMA can take them over with the maintenance above.
+ *******************************************************************************/
+
+#ifndef _DMABUF_H
+#define _DMABUF_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/kmem.h>
+#include "definitions.h"
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define DMABUF_SIZE(bytes)      CACHE_ALIGNED_SIZE_GET(bytes)
+#define DMABUF_CACHED           __attribute__((aligned(CACHE_LINE_SIZE)))
+#define DMABUF_COHERENT         __attribute__((coherent,aligned(CACHE_LINE_SIZE)))
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void DMABUF_Bench(CCD_BUF_REPLY *reply);
+
+//Uncached (KSEG1) alias of the cached buffer p
+static inline void *DMABUF_Uncached(void *p)
+{
+    return (void *)KVA0_TO_KVA1((uint32_t)p);
+}
+
+//Writes the cached lines of bytes at p back and drops them, before a DMA reads them
+static inline void DMABUF_Clean(const void *p, size_t bytes)
+{
+    CACHE_DataCacheClean((uint32_t)p,bytes);
+}
+
+//Drops the cached lines of bytes at p unwritten, before the CPU reads what a DMA wrote
+static inline void DMABUF_Invalidate(void *p, size_t bytes)
+{
+    CACHE_DataCacheInvalidate((uint32_t)p,bytes);
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _DMABUF_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,83 @@
+/*******************************************************************************
+  Edge Finder Source File
+
+  File Name:
+    edges.c
+
+  Summary:
+    Streaming threshold crossing detection with sub-pixel interpolation.
+
+  Description:
+    EDGES_Begin is called at the start of a readout, EDGES_Sample (edges.h)
+    for every signal sample and EDGES_End after the last one.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "edges.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void EDGES_Begin(EDGES_STATE *s, const EDGES_CONFIG *config, CCD_EDGE *edge, uint8_t max)
+{
+    int32_t hysteresis=CCD_EDGES_HYSTERESIS(config->options);
+
+    if((config->options&CCD_EDGES_AUTO)&&s->lastValid)
+        s->threshold=((int32_t)s->lastMinimum+s->lastMaximum)>>1;
+    else
+        s->threshold=config->threshold;
+    s->high=s->threshold+hysteresis;
+    s->low=s->threshold-hysteresis;
+    s->report=config->options&(CCD_EDGES_RISING|CCD_EDGES_FALLING);
+    if(!s->report)s->report=CCD_EDGES_RISING|CCD_EDGES_FALLING;
+
+    s->level=EDGES_LEVEL_UNKNOWN;
+    s->started=false;
+    s->rise.rising=1;
+    s->rise.reserved=0;
+    s->fall.rising=0;
+    s->fall.reserved=0;
+    s->minimum=0xFFFF;
+    s->maximum=0;
+
+    s->edge=edge;
+    s->count=0;
+    s->max=max;
+    s->truncated=false;
+}
+/******************************************************************************/
+void EDGES_End(EDGES_STATE *s, CCD_EDGES *summary, bool *truncated)
+{
+    summary->count=s->count;
+    summary->threshold=(uint16_t)s->threshold;
+    summary->minimum=s->minimum;
+    summary->maximum=s->maximum;
+    *truncated=s->truncated;
+
+    s->lastMinimum=s->minimum;
+    s->lastMaximum=s->maximum;
+    s->lastValid=s->started;
+}
+/******************************************************************************/
+//Runs the detector over data[first..first+count-1], returns the number of edges stored
+uint8_t EDGES_Find(EDGES_STATE *s, const uint16_t *data, uint16_t first, uint16_t count, const EDGES_CONFIG *config,
+                   CCD_EDGES *summary, CCD_EDGE *edge, uint8_t max, bool *truncated)
+{
+    EDGES_Begin(s,config,edge,max);
+    for(uint16_t i=first;i<first+count;i++)
+        EDGES_Sample(s,i,data[i]);
+    EDGES_End(s,summary,truncated);
+    return s->count;
+}
+
+/*******************************************************************************
+ End of File
+ */
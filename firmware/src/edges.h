@@ -0,0 +1,151 @@
+/*******************************************************************************
+  Edge Finder Header File
+
+  File Name:
+    edges.h
+
+  Summary:
+    Streaming threshold crossing detection with sub-pixel interpolation.
+
+  Description:
+    The detector sees one sample at a time, so it runs from the ADC interrupt
+    while the frame is read out and the edge list is complete with the last
+    pixel. A crossing of the threshold is remembered and reported once the
+    signal leaves the hysteresis band on the other side, so noise around the
+    threshold does not produce edge pairs. The position is interpolated
+    linearly between the two samples around the crossing.
+
+    The module has no hardware dependencies, the host tools build the same
+    code (EDGES_Find runs the streaming detector over a stored frame).
+ *******************************************************************************/
+
+#ifndef _EDGES_H
+#define _EDGES_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+typedef struct
+{
+    uint16_t    threshold;          //sample units, unless CCD_EDGES_AUTO
+    uint8_t     options;            //CCD_EDGES_xxx
+}EDGES_CONFIG;
+
+#define EDGES_LEVEL_UNKNOWN     0
+#define EDGES_LEVEL_LOW         1
+#define EDGES_LEVEL_HIGH        2
+
+typedef struct
+{
+    /* Per frame settings */
+    int32_t     threshold;
+    int32_t     high;               //threshold+hysteresis
+    int32_t     low;                //threshold-hysteresis
+    uint8_t     report;             //CCD_EDGES_RISING|CCD_EDGES_FALLING
+
+    /* Detector */
+    uint8_t     level;              //EDGES_LEVEL_xxx
+    bool        started;
+    int32_t     prev;
+    CCD_EDGE    rise;               //last upward crossing, reported when HIGH is reached
+    CCD_EDGE    fall;               //last downward crossing, reported when LOW is reached
+    uint16_t    minimum;
+    uint16_t    maximum;
+
+    /* Output */
+    CCD_EDGE    *edge;
+    uint8_t     count;
+    uint8_t     max;
+    bool        truncated;
+
+    /* Previous frame, for CCD_EDGES_AUTO */
+    uint16_t    lastMinimum;
+    uint16_t    lastMaximum;
+    bool        lastValid;
+}EDGES_STATE;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void EDGES_Begin(EDGES_STATE *s, const EDGES_CONFIG *config, CCD_EDGE *edge, uint8_t max);
+void EDGES_End(EDGES_STATE *s, CCD_EDGES *summary, bool *truncated);
+uint8_t EDGES_Find(EDGES_STATE *s, const uint16_t *data, uint16_t first, uint16_t count, const EDGES_CONFIG *config,
+                   CCD_EDGES *summary, CCD_EDGE *edge, uint8_t max, bool *truncated);
+
+static inline void EDGES_Emit(EDGES_STATE *s, const CCD_EDGE *e)
+{
+    if(!(s->report&(e->rising?CCD_EDGES_RISING:CCD_EDGES_FALLING)))return;
+    if(s->count<s->max)s->edge[s->count++]=*e;
+    else s->truncated=true;
+}
+
+//Called for every sample of the frame, in index order (ADC interrupt)
+static inline void EDGES_Sample(EDGES_STATE *s, uint16_t index, uint16_t value)
+{
+    int32_t v=value;
+
+    if(value<s->minimum)s->minimum=value;
+    if(value>s->maximum)s->maximum=value;
+
+    if(s->started)
+    {
+        int32_t p=s->prev;
+        if(p<=s->threshold&&v>s->threshold)
+        {
+            s->rise.position=((uint32_t)(index-1)<<8)+(uint32_t)(((s->threshold-p)<<8)/(v-p));
+            s->rise.slope=(uint16_t)(v-p);
+        }
+        else if(p>s->threshold&&v<=s->threshold)
+        {
+            s->fall.position=((uint32_t)(index-1)<<8)+(uint32_t)(((p-s->threshold)<<8)/(p-v));
+            s->fall.slope=(uint16_t)(p-v);
+        }
+    }
+    s->prev=v;
+    s->started=true;
+
+    if(v>s->high&&s->level!=EDGES_LEVEL_HIGH)
+    {
+        if(s->level==EDGES_LEVEL_LOW)EDGES_Emit(s,&s->rise);
+        s->level=EDGES_LEVEL_HIGH;
+    }
+    else if(v<s->low&&s->level!=EDGES_LEVEL_LOW)
+    {
+        if(s->level==EDGES_LEVEL_HIGH)EDGES_Emit(s,&s->fall);
+        s->level=EDGES_LEVEL_LOW;
+    }
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _EDGES_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,71 @@
+/*******************************************************************************
+  Auto Exposure Source File
+
+  File Name:
+    exposure.c
+
+  Summary:
+    Closed-loop integration time control from the frame statistics.
+
+  Description:
+    EXPOSURE_Update is called for every completed frame (ADC interrupt),
+    one division per frame. Times are in CCD_TIMER_HZ ticks.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "exposure.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void EXPOSURE_Reset(EXPOSURE_STATE *s)
+{
+    s->skip=0;
+}
+/******************************************************************************/
+//Returns the integration time for the next frames, 0 if it stays unchanged.
+//integrationTime is the time the frame with these statistics was taken with.
+uint32_t EXPOSURE_Update(EXPOSURE_STATE *s, const EXPOSURE_CONFIG *config, const CCD_FRAME_STATS *stats,
+                         uint32_t integrationTime)
+{
+    uint64_t t=integrationTime, next;
+    uint64_t maximum=config->maximum?config->maximum:0xFFFFu*CCD_TICKS_PER_10US;
+    uint32_t peak=(config->options&CCD_EXPOSURE_INVERT)?CCD_ADC_MAX-stats->minimum:stats->maximum;
+    uint32_t setpoint=config->setpoint;
+
+    if(s->skip)
+    {
+        s->skip--;
+        return 0;
+    }
+
+    if(stats->saturated)
+        next=t/EXPOSURE_STEP_SATURATED;
+    else
+    {
+        uint32_t error=peak>setpoint?peak-setpoint:setpoint-peak;
+        if(error<=(setpoint>>EXPOSURE_DEADBAND_SHIFT))return 0;
+        if(peak*EXPOSURE_STEP_UP<=setpoint)
+            next=t*EXPOSURE_STEP_UP;
+        else
+            next=(t*setpoint+peak/2)/peak;
+    }
+    if(next<CCD_INTEGRATION_MIN)next=CCD_INTEGRATION_MIN;
+    if(next>maximum)next=maximum;
+    if(next==t)return 0;
+
+    s->skip=1;
+    return (uint32_t)next;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,86 @@
+/*******************************************************************************
+  Auto Exposure Header File
+
+  File Name:
+    exposure.h
+
+  Summary:
+    Closed-loop integration time control from the frame statistics.
+
+  Description:
+    The signal above dark grows linearly with integration time, so the next
+    integration time is the one that would have put the frame peak on the
+    setpoint: t*setpoint/peak. Steps are limited to x8 up (dark frames say
+    little about the scene) and a saturated frame divides the time by 8,
+    since its peak is clipped. A dark offset makes the first step fall
+    short of the setpoint, the following ones close the gap geometrically.
+    Peaks within 1/32 of the setpoint leave the time unchanged so the loop
+    does not hunt on noise.
+
+    The frame after a change may have been exposed partly with the old
+    time, it is not used for control. The module has no hardware
+    dependencies, the host tools simulate the loop with the same code.
+ *******************************************************************************/
+
+#ifndef _EXPOSURE_H
+#define _EXPOSURE_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define EXPOSURE_STEP_UP        8       //largest increase factor per step
+#define EXPOSURE_STEP_SATURATED 8       //decrease factor for a saturated frame
+#define EXPOSURE_DEADBAND_SHIFT 5       //no change within setpoint/32
+
+typedef struct
+{
+    uint16_t    setpoint;           //peak sample value to hold
+    uint32_t    maximum;            //longest integration time, ticks (0: 655.35ms)
+    uint8_t     options;            //CCD_EXPOSURE_xxx
+}EXPOSURE_CONFIG;
+
+typedef struct
+{
+    uint8_t     skip;               //frames to ignore after a change
+}EXPOSURE_STATE;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void EXPOSURE_Reset(EXPOSURE_STATE *s);
+uint32_t EXPOSURE_Update(EXPOSURE_STATE *s, const EXPOSURE_CONFIG *config, const CCD_FRAME_STATS *stats,
+                         uint32_t integrationTime);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _EXPOSURE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,92 @@
+/*******************************************************************************
+  Flash Programming Source File
+
+  File Name:
+    flash.c
+
+  Summary:
+    Page erase and row programming of the PIC32MZ program flash.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <string.h>
+#include <sys/kmem.h>
+#include "flash.h"
+#include "definitions.h"
+
+#define FLASH_OP_ROW_PROGRAM    0x3
+#define FLASH_OP_PAGE_ERASE     0x4
+
+//The NVM controller reads the source row from physical memory, the buffer is
+//coherent (uncached) so no cache maintenance is needed before programming
+static uint8_t CACHE_ALIGN flashRow[FLASH_ROW_SIZE];
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Runs one NVM operation on the physical address set up by the caller
+static bool FLASH_Operation(uint32_t op)
+{
+    bool state;
+
+    NVMCON=_NVMCON_WREN_MASK|op;
+
+    state=SYS_INT_Disable();
+    NVMKEY=0x0;
+    NVMKEY=0xAA996655;
+    NVMKEY=0x556699AA;
+    NVMCONSET=_NVMCON_WR_MASK;
+    SYS_INT_Restore(state);
+
+    while(NVMCON&_NVMCON_WR_MASK);
+    NVMCONCLR=_NVMCON_WREN_MASK;
+
+    return !(NVMCON&(_NVMCON_WRERR_MASK|_NVMCON_LVDERR_MASK));
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+bool FLASH_PageErase(const void *page)
+{
+    NVMADDR=KVA_TO_PA((uint32_t)page);
+    return FLASH_Operation(FLASH_OP_PAGE_ERASE);
+}
+/******************************************************************************/
+//dst must be row aligned and erased, the tail of the last row is padded with 0xFF
+bool FLASH_Write(const void *dst, const void *src, size_t len)
+{
+    uint32_t addr=(uint32_t)dst;
+    const uint8_t *p=src;
+
+    while(len)
+    {
+        size_t n=len<FLASH_ROW_SIZE?len:FLASH_ROW_SIZE;
+
+        memset(flashRow,0xFF,FLASH_ROW_SIZE);
+        memcpy(flashRow,p,n);
+        NVMADDR=KVA_TO_PA(addr);
+        NVMSRCADDR=KVA_TO_PA((uint32_t)flashRow);
+        if(!FLASH_Operation(FLASH_OP_ROW_PROGRAM))return false;
+
+        addr+=FLASH_ROW_SIZE;
+        p+=n;
+        len-=n;
+    }
+    return true;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,65 @@
+/*******************************************************************************
+  Flash Programming Header File
+
+  File Name:
+    flash.h
+
+  Summary:
+    Page erase and row programming of the PIC32MZ program flash.
+
+  Description:
+    Minimal NVM controller access for storing calibration data. The CPU
+    stalls while the panel it executes from is programmed and interrupts are
+    disabled for the unlock sequence, so acquisition timing is disturbed
+    while a page is erased or written; call only on request, not during
+    measurements.
+ *******************************************************************************/
+
+#ifndef _FLASH_H
+#define _FLASH_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define FLASH_PAGE_SIZE         16384   //erase unit
+#define FLASH_ROW_SIZE          2048    //program unit
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+bool FLASH_PageErase(const void *page);
+bool FLASH_Write(const void *dst, const void *src, size_t len);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _FLASH_H */
+
+/*******************************************************************************
+ End of File
+ */
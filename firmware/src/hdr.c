@@ -0,0 +1,113 @@
+/*******************************************************************************
+  HDR Merge Source File
+
+  File Name:
+    hdr.c
+
+  Summary:
+    High dynamic range frames from interleaved integration times.
+
+  Description:
+    HDR_Advance is called at every ICG pulse to pick the next integration
+    time, HDR_Begin at the start of a readout, HDR_Sample (hdr.h) for every
+    sample and HDR_End after the last one.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "hdr.h"
+#include "timing.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Largest dark subtracted raw value
+static uint32_t HDR_Range(const HDR_CONFIG *config)
+{
+    uint32_t dark=config->dark>CCD_ADC_MAX?CCD_ADC_MAX:config->dark;
+    return (config->options&CCD_HDR_INVERT)?dark:CCD_ADC_MAX-dark;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Starts a new cycle with base as the longest integration time, false if config is invalid
+bool HDR_Setup(HDR_STATE *s, const HDR_CONFIG *config, uint32_t base)
+{
+    if(config->exposures<2||config->exposures>CCD_HDR_MAX_EXPOSURES)return false;
+    if(!config->ratioShift||config->ratioShift>HDR_RATIO_SHIFT_MAX)return false;
+    if((config->exposures-1)*config->ratioShift>HDR_RANGE_SHIFT_MAX)return false;
+
+    s->config=*config;
+    s->base=base>CCD_INTEGRATION_MIN?base:CCD_INTEGRATION_MIN;
+    s->next=HDR_EXPOSURE_NONE;          //the integration in progress is not part of a cycle
+    s->running=false;
+    s->index=HDR_EXPOSURE_NONE;
+    s->count=0;
+    return true;
+}
+/******************************************************************************/
+//Integration time of an exposure, ticks
+uint32_t HDR_Time(const HDR_STATE *s, uint8_t exposure)
+{
+    uint32_t t=s->base>>(exposure*s->config.ratioShift);
+    return t>CCD_INTEGRATION_MIN?t:CCD_INTEGRATION_MIN;
+}
+/******************************************************************************/
+//Called when an integration ends (ICG pulse), returns the exposure to integrate next
+uint8_t HDR_Advance(HDR_STATE *s)
+{
+    if(s->next==HDR_EXPOSURE_NONE||s->next+1>=s->config.exposures)s->next=0;
+    else s->next++;
+    return s->next;
+}
+/******************************************************************************/
+//Start of the readout of exposure (HDR_EXPOSURE_NONE: not merged)
+void HDR_Begin(HDR_STATE *s, uint8_t exposure, uint32_t integrationTime)
+{
+    s->index=exposure;
+    if(!exposure)s->count=0;
+    s->running=exposure!=HDR_EXPOSURE_NONE&&exposure==s->count;
+    if(!s->running)return;
+
+    s->integrationTime[exposure]=integrationTime;
+    s->scale=(uint32_t)(((uint64_t)s->integrationTime[0]<<8)/integrationTime);
+    if(!exposure)
+    {
+        //output range of the cycle, the shortest exposure sets it
+        uint32_t last=HDR_Time(s,s->config.exposures-1);
+        uint64_t max=((uint64_t)HDR_Range(&s->config)*(((uint64_t)integrationTime<<8)/last))>>8;
+        s->shift=0;
+        while((max>>s->shift)>0xFFFF)s->shift++;
+    }
+}
+/******************************************************************************/
+//End of a readout, true when it completed a merged frame described by info
+bool HDR_End(HDR_STATE *s, CCD_HDR *info)
+{
+    if(!s->running)return false;
+    s->running=false;
+    if(++s->count<s->config.exposures)return false;
+
+    info->exposures=s->config.exposures;
+    info->shift=s->shift;
+    info->dark=s->config.dark;
+    for(uint8_t j=0;j<CCD_HDR_MAX_EXPOSURES;j++)
+        info->integrationTime[j]=j<s->config.exposures?TIMING_Time10us(s->integrationTime[j]):0;
+    info->dynamicRange=(uint32_t)(((uint64_t)HDR_Range(&s->config)*s->scale)>>8);
+    return true;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,126 @@
+/*******************************************************************************
+  HDR Merge Header File
+
+  File Name:
+    hdr.h
+
+  Summary:
+    High dynamic range frames from interleaved integration times.
+
+  Description:
+    A cycle of 2..4 exposures runs from the longest integration time down,
+    each 2^ratioShift times shorter than the previous one. Samples are
+    merged while they are read out: the first (longest) exposure fills the
+    merge buffer, every shorter one replaces only the pixels that were
+    saturated so far, scaled by the ratio of integration times. During the
+    readout of the last exposure the merged value is what gets stored in
+    the frame, so the published frame is the HDR frame and no pass over the
+    data is needed after the readout.
+
+    Merged values are dark subtracted and in units of the longest exposure,
+    shifted right by shift when the range exceeds 16 bits. The merge buffer
+    belongs to the caller: the firmware takes it from the frame arena while
+    HDR is on, the host tools from static arrays.
+
+    The module has no hardware dependencies, the host tools simulate the
+    merge with the same code.
+ *******************************************************************************/
+
+#ifndef _HDR_H
+#define _HDR_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define HDR_EXPOSURE_NONE       0xFF    //exposure not set by the HDR cycle
+#define HDR_RATIO_SHIFT_MAX     8
+#define HDR_RANGE_SHIFT_MAX     16      //longest/shortest up to 2^16
+
+typedef struct
+{
+    uint8_t     exposures;          //2..CCD_HDR_MAX_EXPOSURES
+    uint8_t     ratioShift;         //log2 of the ratio between consecutive exposures
+    uint16_t    dark;               //raw dark level, 0 with correction
+    uint8_t     options;            //CCD_HDR_xxx
+}HDR_CONFIG;
+
+typedef struct
+{
+    HDR_CONFIG  config;
+    uint32_t    base;               //longest integration time, ticks
+
+    /* Integration */
+    uint8_t     next;               //exposure being integrated
+
+    /* Readout */
+    bool        running;            //current readout is merged
+    uint8_t     index;              //exposure of the current readout
+    uint8_t     count;              //exposures of this cycle merged so far
+    uint8_t     shift;              //output shift of this cycle
+    uint32_t    scale;              //longest/current integration time, Q8
+    uint32_t    integrationTime[CCD_HDR_MAX_EXPOSURES];    //ticks
+
+    /* Merge buffer, CCD_DATA_SIZE entries each */
+    uint32_t    *data;
+    uint8_t     *saturated;
+}HDR_STATE;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+bool HDR_Setup(HDR_STATE *s, const HDR_CONFIG *config, uint32_t base);
+uint32_t HDR_Time(const HDR_STATE *s, uint8_t exposure);
+uint8_t HDR_Advance(HDR_STATE *s);
+void HDR_Begin(HDR_STATE *s, uint8_t exposure, uint32_t integrationTime);
+bool HDR_End(HDR_STATE *s, CCD_HDR *info);
+
+//Called for every sample of a readout while s->running, returns the value to store
+static inline uint16_t HDR_Sample(HDR_STATE *s, uint16_t i, uint16_t sample, bool saturated)
+{
+    int32_t d=(s->config.options&CCD_HDR_INVERT)?(int32_t)s->config.dark-sample:(int32_t)sample-s->config.dark;
+    uint32_t v=d>0?(uint32_t)(((uint64_t)(uint32_t)d*s->scale)>>8):0;
+
+    if(!s->index||s->saturated[i])
+    {
+        s->data[i]=v;
+        s->saturated[i]=saturated;
+    }
+    if(s->index+1<s->config.exposures)return sample;
+
+    v=s->data[i]>>s->shift;
+    return v>0xFFFF?0xFFFF:(uint16_t)v;
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _HDR_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,127 @@
+/*******************************************************************************
+  Interleaved ADC Cores Source File
+
+  File Name:
+    interleave.c
+
+  Summary:
+    Offset and gain matching of the second ADC core to the first one.
+
+  Description:
+    INTERLEAVE_Add runs in the ADC interrupt while pairs are collected,
+    INTERLEAVE_Fit and INTERLEAVE_Mismatch once in the main loop when they
+    are complete. The fit works on exact 64-bit sums of products, offsets
+    and the mismatch are reported in 1/16 LSB.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "interleave.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+static uint16_t INTERLEAVE_Sqrt(int64_t v)
+{
+    if(v<=0)return 0;
+    uint64_t r=0, bit=(uint64_t)1<<62;
+    uint64_t u=(uint64_t)v;
+    while(bit>u)bit>>=2;
+    while(bit)
+    {
+        if(u>=r+bit)
+        {
+            u-=r+bit;
+            r=(r>>1)+bit;
+        }
+        else r>>=1;
+        bit>>=2;
+    }
+    return r>0xFFFF?0xFFFF:(uint16_t)r;
+}
+
+static int16_t INTERLEAVE_Clamp16(int64_t v)
+{
+    return v<INT16_MIN?INT16_MIN:v>INT16_MAX?INT16_MAX:(int16_t)v;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void INTERLEAVE_Identity(INTERLEAVE_MATCH *m)
+{
+    m->gain=INTERLEAVE_GAIN_ONE;
+    m->offset=0;
+}
+/******************************************************************************/
+void INTERLEAVE_Reset(INTERLEAVE_SUMS *s)
+{
+    s->n=0;
+    s->x=s->y=0;
+    s->xx=s->xy=s->yy=0;
+}
+/******************************************************************************/
+//Mean and RMS of the difference of the collected pairs, residual is not set
+void INTERLEAVE_Mismatch(const INTERLEAVE_SUMS *s, INTERLEAVE_REPORT *report)
+{
+    report->mean=0;
+    report->rms=0;
+    if(!s->n)return;
+    //sum of (x-y)^2 over n, in 1/256 LSB^2
+    int64_t d2=(int64_t)(((s->xx+s->yy-2*s->xy)<<(2*INTERLEAVE_FINE_SHIFT))/s->n);
+    int64_t d=((int64_t)s->x-(int64_t)s->y)*(1<<INTERLEAVE_FINE_SHIFT)/(int64_t)s->n;
+    report->mean=INTERLEAVE_Clamp16(d);
+    report->rms=INTERLEAVE_Sqrt(d2);
+}
+/******************************************************************************/
+//Least squares match y=gain*x+offset of the collected pairs, false if there are none.
+//report receives the mismatch before the fit and the residual after it.
+bool INTERLEAVE_Fit(const INTERLEAVE_SUMS *s, INTERLEAVE_MATCH *m, INTERLEAVE_REPORT *report)
+{
+    INTERLEAVE_Mismatch(s,report);
+    report->residual=0;
+    report->gainFitted=false;
+    if(!s->n)return false;
+
+    //n times the (co)variances in LSB^2: n*sum(xy)-sum(x)*sum(y) is exact in 64 bits
+    //for up to 255 frames of 12-bit pairs and wraps back into range when negative
+    uint64_t n=s->n;
+    int64_t cxx=(int64_t)((n*s->xx-s->x*s->x)/n);
+    int64_t cxy=(int64_t)(n*s->xy-s->x*s->y)/(int64_t)n;
+    int64_t cyy=(int64_t)((n*s->yy-s->y*s->y)/n);
+    int64_t gain=INTERLEAVE_GAIN_ONE;
+
+    //a gain beyond 1/2..2 is a wiring fault rather than a core mismatch
+    if(cxx>=(int64_t)n*INTERLEAVE_SPREAD_MIN*INTERLEAVE_SPREAD_MIN&&cxy>=cxx/2&&cxy<2*cxx)
+    {
+        gain=(cxy*INTERLEAVE_GAIN_ONE)/cxx;
+        report->gainFitted=true;
+    }
+    //variance of y-gain*x with the gain as stored, cyy-2g*cxy+g^2*cxx, as
+    //(cyy-g*cxy)-g*(cxy-g*cxx) whose terms stay within 64 bits
+    int64_t f=cyy*INTERLEAVE_GAIN_ONE-gain*cxy;
+    int64_t e=cxy*INTERLEAVE_GAIN_ONE-gain*cxx;
+    int64_t r=f-((gain*e)>>INTERLEAVE_GAIN_SHIFT);
+    report->residual=INTERLEAVE_Sqrt(r/((int64_t)n<<(INTERLEAVE_GAIN_SHIFT-2*INTERLEAVE_FINE_SHIFT)));
+
+    //offset=mean(y)-gain*mean(x), rounded to 1/16 LSB
+    int64_t den=(int64_t)n*INTERLEAVE_GAIN_ONE;
+    int64_t num=((int64_t)s->y*INTERLEAVE_GAIN_ONE-gain*(int64_t)s->x)*(1<<INTERLEAVE_FINE_SHIFT);
+    m->gain=(uint16_t)gain;
+    m->offset=INTERLEAVE_Clamp16((num+(num<0?-den/2:den/2))/den);
+    return true;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,118 @@
+/*******************************************************************************
+  Interleaved ADC Cores Header File
+
+  File Name:
+    interleave.h
+
+  Summary:
+    Offset and gain matching of the second ADC core to the first one.
+
+  Description:
+    With two cores the OS signal is converted by ADC1 (AN1) a quarter into
+    every conversion slot and by ADC0 (AN0) three quarters into it, both
+    cores see the same output. Their offsets and gains differ by a few LSB,
+    which would add a pattern that changes with the sample phase, so ADC1
+    results are mapped onto the ADC0 scale before they are summed:
+    x' = x*gain+offset.
+
+    The match is found from pairs (x of ADC1, y of ADC0) of the same
+    conversion slot collected over the light sensitive outputs of a few
+    frames: a least squares line y=gain*x+offset. The scene needs a range
+    of levels for the gain, with a uniform scene only the offset is matched.
+    Sums are 64-bit integers, the fit uses integer arithmetic only. The
+    module has no hardware dependencies, the host tools check the fit with
+    the same code.
+ *******************************************************************************/
+
+#ifndef _INTERLEAVE_H
+#define _INTERLEAVE_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define INTERLEAVE_GAIN_SHIFT   14      //gain is Q2.14
+#define INTERLEAVE_GAIN_ONE     (1<<INTERLEAVE_GAIN_SHIFT)
+#define INTERLEAVE_FINE_SHIFT   4       //offsets and mismatch in 1/16 LSB
+#define INTERLEAVE_SPREAD_MIN   32      //LSB, standard deviation of x needed to fit the gain
+
+typedef struct
+{
+    uint16_t    gain;               //Q2.14
+    int16_t     offset;             //1/16 LSB
+}INTERLEAVE_MATCH;
+
+typedef struct
+{
+    uint32_t    n;                  //pairs
+    uint64_t    x, y;               //sums of ADC1 and ADC0 results
+    uint64_t    xx, xy, yy;         //and of their products
+}INTERLEAVE_SUMS;
+
+typedef struct
+{
+    int16_t     mean;               //mean of x-y, 1/16 LSB
+    uint16_t    rms;                //RMS of x-y, 1/16 LSB
+    uint16_t    residual;           //RMS of y around the fitted line, 1/16 LSB
+    bool        gainFitted;         //false: x did not spread enough, offset only
+}INTERLEAVE_REPORT;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void INTERLEAVE_Identity(INTERLEAVE_MATCH *m);
+void INTERLEAVE_Reset(INTERLEAVE_SUMS *s);
+void INTERLEAVE_Mismatch(const INTERLEAVE_SUMS *s, INTERLEAVE_REPORT *report);
+bool INTERLEAVE_Fit(const INTERLEAVE_SUMS *s, INTERLEAVE_MATCH *m, INTERLEAVE_REPORT *report);
+
+//ADC1 result x on the ADC0 scale (ADC interrupt)
+static inline uint16_t INTERLEAVE_Apply(const INTERLEAVE_MATCH *m, uint16_t x)
+{
+    int32_t v=(int32_t)x*m->gain+(int32_t)m->offset*(1<<(INTERLEAVE_GAIN_SHIFT-INTERLEAVE_FINE_SHIFT));
+    v=(v+(1<<(INTERLEAVE_GAIN_SHIFT-1)))>>INTERLEAVE_GAIN_SHIFT;
+    return v<0?0:v>CCD_ADC_MAX?CCD_ADC_MAX:(uint16_t)v;
+}
+
+//One pair of the same conversion slot, x from ADC1 as summed (matched), y from ADC0 (ADC interrupt)
+static inline void INTERLEAVE_Add(INTERLEAVE_SUMS *s, uint16_t x, uint16_t y)
+{
+    s->n++;
+    s->x+=x;
+    s->y+=y;
+    s->xx+=(uint32_t)x*x;
+    s->xy+=(uint32_t)x*y;
+    s->yy+=(uint32_t)y*y;
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _INTERLEAVE_H */
+
+/*******************************************************************************
+ End of File
+ */
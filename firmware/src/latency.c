@@ -0,0 +1,89 @@
+/*******************************************************************************
+  Interrupt Latency Source File
+
+  File Name:
+    latency.c
+
+  Summary:
+    Entry latency and duration histograms of the interrupt handlers.
+
+  Description:
+    The handlers only ever add to the histograms. RESET keeps a copy as the
+    base that reports are taken against, so the main loop never has to
+    stop the interrupts to clear or read them; a report can be off by the
+    interrupts that come while it is copied. Maxima are cleared by the
+    handlers themselves (latencyGeneration), a source that did not run
+    since RESET reports none.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <string.h>
+#include "latency.h"
+#include "definitions.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data Definitions
+// *****************************************************************************
+// *****************************************************************************
+CCD_IRQ_SOURCE latencySource[CCD_IRQ_SOURCES];
+uint32_t latencyMissed=0;
+uint32_t latencyAdcLast=0;
+bool latencyAdcRestart=true;            //no ADC interrupt yet
+uint32_t latencyTicks[CCD_IRQ_SOURCES];
+volatile uint8_t latencyGeneration=0;
+uint8_t latencySeen[CCD_IRQ_SOURCES];
+
+static CCD_IRQ_SOURCE latencyBase[CCD_IRQ_SOURCES];    //at the last RESET
+static uint32_t latencyMissedBase=0;
+static uint32_t latencyResetTime=0;     //CORETIMER
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Starts the counts over, maxima included
+void LATENCY_Reset(void)
+{
+    memcpy(latencyBase,latencySource,sizeof(latencyBase));
+    latencyGeneration++;
+    latencyMissedBase=latencyMissed;
+    latencyResetTime=CORETIMER_CounterGet();
+}
+/******************************************************************************/
+//Counts since the last RESET, overruns is left to the caller
+void LATENCY_Report(CCD_IRQ_REPLY *reply)
+{
+    static const uint8_t priority[CCD_IRQ_SOURCES]={LATENCY_IPL_ADC,LATENCY_IPL_SH,LATENCY_IPL_USB,LATENCY_IPL_USB};
+
+    reply->sources=CCD_IRQ_SOURCES;
+    reply->bins=CCD_IRQ_BINS;
+    memcpy(reply->priority,priority,sizeof(priority));
+    reply->elapsed=(CORETIMER_CounterGet()-latencyResetTime)/(CCD_TIMESTAMP_HZ/1000);
+    reply->missed=latencyMissed-latencyMissedBase;
+    for(uint8_t k=0;k<CCD_IRQ_SOURCES;k++)
+    {
+        const CCD_IRQ_SOURCE *s=&latencySource[k], *b=&latencyBase[k];
+        CCD_IRQ_SOURCE *r=&reply->source[k];
+        bool current=latencySeen[k]==latencyGeneration;   //the maxima are older than RESET if not
+        r->count=s->count-b->count;
+        r->latencyMax=current?s->latencyMax:0;
+        r->durationMax=current?s->durationMax:0;
+        for(uint8_t i=0;i<CCD_IRQ_BINS;i++)
+        {
+            r->latency[i]=s->latency[i]-b->latency[i];
+            r->duration[i]=s->duration[i]-b->duration[i];
+        }
+    }
+}
+
+/*******************************************************************************
+ End of File
+ */
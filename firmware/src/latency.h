@@ -0,0 +1,160 @@
+/*******************************************************************************
+  Interrupt Latency Header File
+
+  File Name:
+    latency.h
+
+  Summary:
+    Entry latency and duration histograms of the interrupt handlers.
+
+  Description:
+    Interrupt priorities, each level with its own shadow register set
+    (PRISS), so no handler saves registers on entry:
+
+      ADC_DATA0 (pixel capture)     ipl7SRS  nothing may delay a conversion
+                                             result past the next one
+      TIMER_3 (SH/ICG)              ipl6SRS  segment lengths are loaded as
+                                             the segment starts
+      USB, USB_DMA                  ipl1SRS  host transfers wait
+
+    The handlers in interrupts.c time themselves with the CORETIMER
+    (CCD_TIMESTAMP_HZ, 10ns) and add entry latency and duration to the
+    histograms of their source ("IRQ" command). Latency is measured from
+    the event that raised the interrupt: for ADC_DATA0 from the OC1 trigger
+    (so it includes the conversion), for TIMER_3 from the period match; the
+    USB interrupts have no timestamped event and record durations only.
+    Durations include the time spent in higher priority handlers.
+    latencyTicks adds up the CPU time of every source without them ("STA"):
+    each handler subtracts the ticks its higher priority sources added
+    while it ran. Every counter has one writer, the handler of its source:
+    RESET only advances latencyGeneration, and a handler that finds its
+    source behind clears its maxima before it adds to them.
+
+    An ADC interrupt that comes later than the next conversion loses a
+    sample, the next result overwrites it. The gap between consecutive ADC
+    interrupts shows that: every further conversion slot in it is counted
+    as missed.
+ *******************************************************************************/
+
+#ifndef _LATENCY_H
+#define _LATENCY_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device.h"
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define LATENCY_IPL_ADC         7
+#define LATENCY_IPL_SH          6
+#define LATENCY_IPL_USB         1
+#define LATENCY_TMR3_TICKS      8       //CORETIMER ticks per Timer 3 tick (80ns)
+
+extern CCD_IRQ_SOURCE latencySource[CCD_IRQ_SOURCES];
+extern uint32_t latencyMissed;          //ADC conversions lost since power up
+extern uint32_t latencyAdcLast;         //CORETIMER at the last ADC interrupt
+extern bool latencyAdcRestart;          //Timer 5 restarted, no gap to the last ADC interrupt
+extern uint32_t latencyTicks[CCD_IRQ_SOURCES];  //CORETIMER ticks in the handlers, preemption excluded
+extern volatile uint8_t latencyGeneration;      //advanced by every RESET
+extern uint8_t latencySeen[CCD_IRQ_SOURCES];    //generation each source cleared its maxima for
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void LATENCY_Reset(void);
+void LATENCY_Report(CCD_IRQ_REPLY *reply);
+
+//Histogram bin of ticks: 0 for 0, k for 2^(k-1)..2^k-1, the last bin is open ended
+static inline uint8_t LATENCY_Bin(uint32_t ticks)
+{
+    uint8_t bin=ticks?(uint8_t)(32-__builtin_clz(ticks)):0;
+    return bin<CCD_IRQ_BINS?bin:CCD_IRQ_BINS-1;
+}
+
+//Ticks of the sources that can preempt source (handler entry and exit)
+static inline uint32_t LATENCY_Above(uint8_t source)
+{
+    uint32_t ticks=0;
+    for(uint8_t k=0;k<source&&k<=CCD_IRQ_SH;k++)ticks+=latencyTicks[k];   //the USB sources share a level
+    return ticks;
+}
+
+//Ticks of all sources, taken around a stretch of the main loop
+static inline uint32_t LATENCY_Total(void)
+{
+    uint32_t ticks=0;
+    for(uint8_t k=0;k<CCD_IRQ_SOURCES;k++)ticks+=latencyTicks[k];
+    return ticks;
+}
+
+//Adds one interrupt entered at CORETIMER start with LATENCY_Above ticks above,
+//latency ticks after its event (handler exit)
+static inline void LATENCY_Add(uint8_t source, uint32_t start, uint32_t above, uint32_t latency)
+{
+    CCD_IRQ_SOURCE *s=&latencySource[source];
+    uint32_t duration=_CP0_GET_COUNT()-start;
+
+    if(latencySeen[source]!=latencyGeneration)
+    {
+        latencySeen[source]=latencyGeneration;
+        s->latencyMax=0;
+        s->durationMax=0;
+    }
+    latencyTicks[source]+=duration-(LATENCY_Above(source)-above);
+    s->count++;
+    s->latency[LATENCY_Bin(latency)]++;
+    s->duration[LATENCY_Bin(duration)]++;
+    if(latency>s->latencyMax)s->latencyMax=latency;
+    if(duration>s->durationMax)s->durationMax=duration;
+}
+
+//Ticks since the OC1 compare that triggered the ADC0 conversion, counts missed
+//conversions from the gap to the last ADC interrupt (ADC_DATA0 entry)
+static inline uint32_t LATENCY_Adc(uint32_t start)
+{
+    uint32_t slot=PR5+1, t=TMR5, trigger=OC1R+1;   //Timer 5 counts CORETIMER ticks (PBCLK3)
+    uint32_t gap=start-latencyAdcLast;
+
+    latencyAdcLast=start;
+    if(latencyAdcRestart)latencyAdcRestart=false;
+    else if(gap>=slot+slot/2)latencyMissed+=(gap+slot/2)/slot-1;
+    return t>=trigger?t-trigger:t+slot-trigger;
+}
+
+//Ticks since the Timer 3 period match (TIMER_3 entry)
+static inline uint32_t LATENCY_Sh(void)
+{
+    return TMR3*LATENCY_TMR3_TICKS;
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _LATENCY_H */
+
+/*******************************************************************************
+ End of File
+ */
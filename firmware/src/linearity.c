@@ -0,0 +1,152 @@
+/*******************************************************************************
+  ADC Linearity Correction Source File
+
+  File Name:
+    linearity.c
+
+  Summary:
+    Lookup table of the ADC integral nonlinearity, loading and storage.
+
+  Description:
+    The table is loaded in CCD_LIN_BLOCKS blocks of CCD_LIN_BLOCK entries.
+    Blocks are only taken while the lookup is off, block 0 starts a new
+    table and the lookup can be switched on once every block has arrived,
+    so a half loaded table is never applied.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <string.h>
+#include "linearity.h"
+#include "flash.h"
+#include "arena.h"
+#include "definitions.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data Definitions
+// *****************************************************************************
+// *****************************************************************************
+LIN_TABLE linTable;
+
+//Flash copy, the page is reserved so the linker places nothing else there
+typedef union
+{
+    LIN_TABLE   table;
+    uint8_t     page[FLASH_PAGE_SIZE];
+}LIN_FLASH_PAGE;
+
+static const LIN_FLASH_PAGE linFlash __attribute__((space(prog),address(LIN_FLASH_ADDRESS)));
+
+static uint16_t linLoaded=0;            //blocks of the table in RAM, bit per block
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+static uint32_t LIN_Checksum(const LIN_TABLE *t)
+{
+    uint32_t sum=t->flags;
+    for(uint16_t i=0;i<CCD_LIN_SIZE;i++)
+        sum+=(uint32_t)t->entry[i]<<(i&1?16:0);
+    return sum;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Loads the table from flash, identity (switched off) if none was saved
+void LIN_Initialize(void)
+{
+    const LIN_TABLE *t=&linFlash.table;
+
+    if(t->magic==LIN_MAGIC&&t->version==LIN_VERSION&&t->size==CCD_LIN_SIZE&&t->checksum==LIN_Checksum(t))
+    {
+        linTable=*t;
+        linLoaded=CCD_LIN_COMPLETE;
+    }
+    else
+        LIN_Clear();
+}
+/******************************************************************************/
+void LIN_Clear(void)
+{
+    linTable.magic=LIN_MAGIC;
+    linTable.version=LIN_VERSION;
+    linTable.size=CCD_LIN_SIZE;
+    linTable.flags=0;
+    for(uint16_t i=0;i<CCD_LIN_SIZE;i++)
+        linTable.entry[i]=(uint16_t)(i<<CCD_FINE_SHIFT);
+    linLoaded=CCD_LIN_COMPLETE;
+}
+/******************************************************************************/
+//Stores block (CCD_LIN_BLOCK entries, MSB first), block 0 starts a new table
+uint8_t LIN_Load(uint8_t block, const uint8_t *data)
+{
+    if(block>=CCD_LIN_BLOCKS)return CCD_LIN_BAD_REQUEST;
+    if(linTable.flags&LIN_ENABLED)return CCD_LIN_ENABLED;   //the ADC interrupt may be reading it
+    for(uint16_t i=0;i<CCD_LIN_BLOCK;i++)
+        if(((data[2*i]<<8)|data[2*i+1])>CCD_LIN_ENTRY_MAX)return CCD_LIN_RANGE;
+
+    uint16_t *entry=&linTable.entry[block*CCD_LIN_BLOCK];
+    for(uint16_t i=0;i<CCD_LIN_BLOCK;i++)
+        entry[i]=(uint16_t)((data[2*i]<<8)|data[2*i+1]);
+    if(block==0)linLoaded=0;
+    linLoaded|=1u<<block;
+    return CCD_LIN_OK;
+}
+/******************************************************************************/
+uint8_t LIN_Enable(bool enable)
+{
+    if(!enable)linTable.flags&=~LIN_ENABLED;
+    else if(linLoaded==CCD_LIN_COMPLETE)linTable.flags|=LIN_ENABLED;
+    else return CCD_LIN_INCOMPLETE;
+    return CCD_LIN_OK;
+}
+/******************************************************************************/
+uint8_t LIN_Save(void)
+{
+    if(linLoaded!=CCD_LIN_COMPLETE)return CCD_LIN_INCOMPLETE;
+    linTable.checksum=LIN_Checksum(&linTable);
+    if(!FLASH_PageErase(&linFlash))return CCD_LIN_FLASH_ERROR;
+    if(!FLASH_Write(&linFlash,&linTable,sizeof(linTable)))return CCD_LIN_FLASH_ERROR;
+    CACHE_DataCacheInvalidate((uint32_t)&linFlash,sizeof(linTable));      //read back, not the lines cached at boot
+    return memcmp(&linFlash.table,&linTable,sizeof(linTable))?CCD_LIN_FLASH_ERROR:CCD_LIN_OK;
+}
+/******************************************************************************/
+//Blocks of the table in RAM, CCD_LIN_COMPLETE when it can be switched on
+uint16_t LIN_Loaded(void)
+{
+    return linLoaded;
+}
+/******************************************************************************/
+//CPU cycles the lookup adds to one frame of 12-bit conversions over the plain
+//shift to x16 (CORETIMER runs at half the CPU clock)
+uint32_t LIN_Bench(const uint16_t *data)
+{
+    volatile uint16_t *linBenchOut=ARENA_Scratch();    //volatile, so neither bench loop is optimized away
+    uint32_t start, shifted, linear;
+
+    start=CORETIMER_CounterGet();
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)linBenchOut[i]=(uint16_t)((data[i]&CCD_ADC_MAX)<<CCD_FINE_SHIFT);
+    shifted=CORETIMER_CounterGet()-start;
+
+    start=CORETIMER_CounterGet();
+    for(uint16_t i=0;i<CCD_DATA_SIZE;i++)linBenchOut[i]=LIN_Fine(data[i]);
+    linear=CORETIMER_CounterGet()-start;
+
+    return linear>shifted?(linear-shifted)*2:0;
+}
+
+/*******************************************************************************
+ End of File
+ */
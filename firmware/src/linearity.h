@@ -0,0 +1,115 @@
+/*******************************************************************************
+  ADC Linearity Correction Header File
+
+  File Name:
+    linearity.h
+
+  Summary:
+    Lookup table of the ADC integral nonlinearity, loading and storage.
+
+  Description:
+    The SAR ADC codes are not evenly spaced: the code boundaries of the
+    PIC32MZ ADC wander up to a few LSB from the ideal straight line (INL),
+    most around the major carries of its capacitor array, which shows as
+    steps in smooth spectra. The table holds the ideal value of every
+    12-bit code, measured by the host with a reference ramp or a code
+    density histogram, and is loaded in blocks ("LIN" command), stored in
+    its own flash page and loaded at boot.
+
+    LIN_Fine is applied by the ADC interrupt to every ADC0 conversion before
+    the conversions are summed for oversampling, dark and flat-field
+    correction, HDR and the statistics, so everything computed from a frame
+    sees linear samples. Entries are x16 (CCD_FINE_SHIFT) so the table
+    corrects below one LSB. 6-, 8- and 10-bit conversions are stored at
+    the 12-bit scale like every sample, so they index it as they are.
+ *******************************************************************************/
+
+#ifndef _LINEARITY_H
+#define _LINEARITY_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define LIN_MAGIC               0x524E494C  //"LINR"
+#define LIN_VERSION             1
+#define LIN_FLASH_ADDRESS       0x9D0F8000  //16KB page below the correction tables
+
+/* Table flags */
+#define LIN_ENABLED             0x01
+
+typedef struct
+{
+    uint32_t    magic;              //LIN_MAGIC
+    uint16_t    version;            //LIN_VERSION
+    uint16_t    size;               //CCD_LIN_SIZE
+    uint8_t     flags;              //LIN_xxx
+    uint8_t     reserved[3];
+    uint32_t    checksum;           //sum of the entries
+    uint16_t    entry[CCD_LIN_SIZE];//ideal value of every 12-bit code, x16
+}LIN_TABLE;
+
+extern LIN_TABLE linTable;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void LIN_Initialize(void);
+void LIN_Clear(void);
+uint8_t LIN_Load(uint8_t block, const uint8_t *data);
+uint8_t LIN_Enable(bool enable);
+uint8_t LIN_Save(void);
+uint16_t LIN_Loaded(void);
+uint32_t LIN_Bench(const uint16_t *data);
+
+//True if the next readout is to be linearized
+static inline bool LIN_Active(void)
+{
+    return linTable.flags&LIN_ENABLED;
+}
+
+//Linear value x16 of ADC result raw, at the 12-bit scale at every resolution (ADC interrupt)
+static inline uint16_t LIN_Fine(uint16_t raw)
+{
+    return linTable.entry[raw&CCD_ADC_MAX];
+}
+
+//Single linearized conversion rounded to the nearest code
+static inline uint16_t LIN_Round(uint16_t fine)
+{
+    uint16_t sample=(fine+(1u<<(CCD_FINE_SHIFT-1)))>>CCD_FINE_SHIFT;
+    return sample>CCD_ADC_MAX?CCD_ADC_MAX:sample;
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _LINEARITY_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -36,86 +36,48 @@
 #include <stddef.h>                     // Defines NULL
 #include <stdbool.h>                    // Defines true
 #include <stdlib.h>                     // Defines EXIT_FAILURE
+#include <string.h>
 #include "definitions.h"                // SYS function prototypes
+#include "ccd.h"
+#include "peaks.h"
+#include "rice.h"
+#include "correction.h"
+#include "linearity.h"
+#include "latency.h"
+#include "trace.h"
+#include "dmabuf.h"
+#include "arena.h"
 
-#define CCD_DATA_SIZE 3694      //total number of outputs [32(dummy)+3648(signal)+14(dummy)]
-#define ICG_PERIOD_MIN 18470    //Min. time between two ICG pulses (3694*5us, 5us is data rate)
-
-uint16_t ccd_data[CCD_DATA_SIZE]={};
 uint8_t rx_data[20]={};
-uint16_t data_cnt=0, integration_cnt=0, ICG_period_cnt=0; //counters
-uint16_t ICG_period=1847;       //x10us, this parameter is adjusted based on integration time so that ICG pulse is aligned with SH pulse
-
-typedef struct
-{
-    uint16_t    integrationTime;
-    uint8_t     horzontalResolution;
-    uint8_t     verticalResolution;
-    uint16_t    *data;
-}CCD_t;
-
-CCD_t ccd;
-/*********INTEGRATION TIME**********/
-//  affects sensitivity
-//  MIN=1       ->  10us    (DEFAULT)
-//  MAX=65535   ->  655.35ms 
-
-/*********HORIZONTAL RESOLUTION**********/
-//  affects number of data points
-//  0 -> CCD_DATA_SIZE      (DEFAULT)
-//  1 -> CCD_DATA_SIZE/2
-//  2 -> CCD_DATA_SIZE/4
-//  3 -> CCD_DATA_SIZE/8
-//  4 -> CCD_DATA_SIZE/16
-//  5 -> CCD_DATA_SIZE/32 
-
-/*********VERTICAL RESOLUTION**********/
-//  affects A/D convertor resolution (number of bits)
-//  0 -> 6 bits
-//  1 -> 8 bits             (DEFAULT)
-//  2 -> 10 bits
-//  3 -> 12 bits
-         
-void CCD_Initialize(void)
-{
-    ccd.integrationTime=1;      //10us
-    ccd.horzontalResolution=0;  //3648 points
-    ccd.verticalResolution=1;   //8 bits
-    ccd.data=&ccd_data[0];      //data array
-}
-
-//Timer 5 triggers this interrupt
-void ADC_ResultHandler(ADCHS_CHANNEL_NUM channel, uintptr_t context)
-{
-    /* Read the ADC result */
-    ccd.data[data_cnt]=ADCHS_ChannelResultGet(ADCHS_CH0); 
-    if(data_cnt<(CCD_DATA_SIZE))data_cnt++;
-}
+uint32_t lastFrameSent=0xFFFFFFFF;  //sequence of the last frame sent on "FRM" request
+uint8_t outputMode=CCD_MODE_FRAME;  //what "FRM" sends, selected with "MOD"
+uint8_t frameOptions=0;             //CCD_FRAME_xxx of CCD_MODE_FRAME
+PEAKS_CONFIG peaksConfig={CCD_ADC_MAX/2,0};
+EDGES_CONFIG edgesConfig={CCD_ADC_MAX/2,0};
+HDR_CONFIG hdrConfig={2,4,0,0};
+CHANGE_CONFIG changeConfig={16,0};
+uint32_t changeSent=0;              //timestamp of the last frame CCD_MODE_CHANGE replied with
+uint32_t changeReferenceSequence=0; //sequence of the last frame it sent whole
+CCD_CHANGE changeSummary={0};       //frames held back since, the keep-alive payload
+bool calPending=false;              //"CAL" dark/flat capture running, reply when done
+uint32_t calLastFrame=0xFFFFFFFF;   //sequence of the last frame added to the capture
+uint8_t cal_data[4]={};             //"CAL" request, kept until the reply is sent
+bool adcPending=false;              //"ADC" match/check collecting frames, reply when done
+bool phasePending=false;            //"PHS" sweep running, reply when done
+uint8_t lin_data[LINEARITY_DATA_SIZE]={};  //"LIN" request with a LOAD block
+uint32_t framesSent=0;              //"STA" counters of the main loop
+uint32_t framesSkipped=0;
+uint32_t idleTicks=0;               //CORETIMER ticks waiting, interrupts excluded
+uint32_t loops=0;
+uint32_t compressFrames=0;          //"STA" counters of CCD_FRAME_RICE
+uint32_t compressValues=0;
+uint32_t compressTicks=0;
+uint32_t compressRawBytes=0;
+uint32_t compressBytes=0;
+uint32_t compressFallbacks=0;
+uint32_t framesUnchanged=0;
+CCD_TRACE_REPLY traceReply;         //"TRC" reply, a block of the ring is too big for the stack
 
-//Timer 3 generates SH pulses on pin RE5 and ICG pulse on pin RG8
-//ICG low state duration is 10us
-//SH period determines integration time
-void TIMER3_InterruptSvcRoutine(uint32_t status, uintptr_t context)
-{
-    integration_cnt++;
-    if(!ICG_period_cnt&&!ICG_Get()) //Reset ICG and readout counter (data_cnt)
-    {
-        ICG_Set();
-        data_cnt=0;
-    }
-    if(integration_cnt>=ccd.integrationTime)//Generate SH pulse
-    {
-        ICG_period_cnt++;
-        integration_cnt=0;
-        OCMP4_Enable();
-        
-        if(ICG_period_cnt>=ICG_period) //Generate ICG pulse
-        {
-            ICG_period_cnt=0;
-            ICG_Clear();
-        }
-    }
-}
 // *****************************************************************************
 // *****************************************************************************
 // Section: Main Entry Point
@@ -128,14 +90,15 @@ int main ( void )
     SYS_Initialize ( NULL );
     
     CCD_Initialize();
-    
-    ADCHS_CallbackRegister(ADCHS_CH0, ADC_ResultHandler, (uintptr_t)NULL);
-    TMR3_CallbackRegister(TIMER3_InterruptSvcRoutine, (uintptr_t) NULL);
+    CORR_Initialize();  //dark and flat-field tables saved in flash
+    if(corrTable.phase)CCD_PhaseSet(corrTable.phase-1); //sampling phase saved with them
+    LIN_Initialize();   //ADC linearity table saved in flash
   
     CORETIMER_Start();
     
     //Using Timer 2 and Output Compare 5 CLK is generated on pin RE3 
     //OCMP5 generates continuous pulses
+    //"CLK" raises f_CLK up to 4MHz at an ICG pulse (CCD_ClockSetup), with Timer 5
     OCMP5_Enable();//CLK (RE3) -------------------> f_CLK=0.8MHz (T_CLK=1.25us))
     TMR2_Start();   
 
@@ -147,37 +110,498 @@ int main ( void )
     
     //Output compare 1 (Timer 5) triggers A/D conversion on pin RB0
     //CCD output data rate is f_CLK/4 -> T_ADC=4*T_CLK=5us
+    //with oversampling ("SET" v_res bits 4..5) it triggers 2 or 4 times per output
+    //with two ADC cores ("ADC") Output compare 3 triggers ADC1 (AN1) in between
     TMR5_Start();
     OCMP1_Enable(); 
     
     while ( true )
     {
-        CORETIMER_DelayMs(1);
+        //no pause while a frame is requested, the reply goes out as soon as the frame is complete
+        if(!USBCDC_FrameRequest())
+        {
+            uint32_t start=CORETIMER_CounterGet(), isr=LATENCY_Total();
+            TRACE_EventAt(CCD_TRACE_IDLE,CCD_TRACE_BEGIN,0,start);
+            CORETIMER_DelayMs(1);
+            idleTicks+=CORETIMER_CounterGet()-start-(LATENCY_Total()-isr);
+            TRACE_Event(CCD_TRACE_IDLE,CCD_TRACE_END,0);
+        }
+        loops++;
 
         /* Maintain state machines of all polled MPLAB Harmony modules. */
+        TRACE_Event(CCD_TRACE_TASKS,CCD_TRACE_BEGIN,0);
         SYS_Tasks ( ); // USBCDC tasks
+        TRACE_Event(CCD_TRACE_TASKS,CCD_TRACE_END,0);
         
         //if "GET" command is received
         if(USBCDC_ReadRequest())
         {
-            DATA_LED_Toggle();
-            USBCDC_TrasferData(ccd.data,CCD_DATA_SIZE,ccd.horzontalResolution,ccd.verticalResolution);
+            CCD_FRAME *frame=CCD_FrameAcquire();
+            if(frame)
+            {
+                DATA_LED_Toggle();
+                USBCDC_TrasferData(frame->data,frame->oversampled?frame->fraction:NULL,CCD_DATA_SIZE,
+                                   ccd.horzontalResolution,ccd.verticalResolution);
+                CCD_FrameRelease(frame);
+                framesSent++;
+            }
+        }
+        //if "FRM" command is received, send the next frame not sent yet
+        if(USBCDC_FrameRequest())
+        {
+            CCD_FRAME *frame=CCD_FrameAcquire();
+            bool keepAlive=false;
+            if(frame&&frame->sequence!=lastFrameSent&&outputMode==CCD_MODE_CHANGE)
+            {
+                uint32_t sum;
+                uint16_t maximum;
+                if(CCD_ChangeMeasure(frame,&sum,&maximum)&&
+                   !CHANGE_Exceeds(&changeConfig,sum,maximum,CCD_SIGNAL_COUNT))
+                {
+                    //unchanged, held back unless nothing was sent for the keep-alive period
+                    changeSummary.unchanged++;
+                    changeSummary.difference=CHANGE_Mean(sum,CCD_SIGNAL_COUNT);
+                    changeSummary.deviation=maximum;
+                    if(maximum>changeSummary.peakDeviation)changeSummary.peakDeviation=maximum;
+                    keepAlive=frame->timestamp-changeSent>=
+                              CCD_CHANGE_KEEPALIVE_MS(changeConfig.options)*(CCD_TIMESTAMP_HZ/1000);
+                    if(!keepAlive)
+                    {
+                        lastFrameSent=frame->sequence;
+                        framesUnchanged++;
+                    }
+                }
+            }
+            if(frame&&frame->sequence!=lastFrameSent&&((outputMode==CCD_MODE_EDGES&&!frame->hasEdges)||
+                                                       (outputMode==CCD_MODE_HDR&&!frame->hdr)))
+                lastFrameSent=frame->sequence; //no edges or not a merged frame, wait for the next one
+            else if(frame&&frame->sequence!=lastFrameSent)
+            {
+                CCD_FRAME_HEADER header={0};
+                TRACE_Event(CCD_TRACE_SEND,CCD_TRACE_BEGIN,(uint16_t)frame->sequence);
+                header.sequence=frame->sequence;
+                header.timestamp=frame->timestamp;
+                header.integrationTime=TIMING_Time10us(frame->integrationTime);
+                header.integrationTicks=frame->integrationTime;
+                header.hRes=ccd.horzontalResolution;
+                header.vRes=ccd.verticalResolution;
+                header.stats=frame->stats;
+                uint8_t flags=(frame->corrected?CCD_FLAG_CORRECTED:0)|(frame->autoExposure?CCD_FLAG_AUTO_EXPOSURE:0)|
+                              (frame->linearized?CCD_FLAG_LINEARIZED:0);
+
+                DATA_LED_Toggle();
+                if(outputMode==CCD_MODE_PEAKS)
+                {
+                    bool truncated;
+                    uint8_t n=PEAKS_Find(frame->data,CCD_SIGNAL_FIRST,CCD_SIGNAL_COUNT,&peaksConfig,
+                                         (CCD_PEAK *)USBCDC_FramePayload(),CCD_PEAKS_MAX,&truncated);
+                    header.format=CCD_FORMAT_PEAKS;
+                    header.flags=(truncated?CCD_FLAG_TRUNCATED:0)|flags;
+                    header.payloadLength=n*sizeof(CCD_PEAK);
+                    USBCDC_TrasferFramePayload(&header);
+                }
+                else if(outputMode==CCD_MODE_EDGES)
+                {
+                    uint8_t *payload=USBCDC_FramePayload();
+                    memcpy(payload,&frame->edges,sizeof(CCD_EDGES));
+                    memcpy(payload+sizeof(CCD_EDGES),frame->edge,frame->edges.count*sizeof(CCD_EDGE));
+                    header.format=CCD_FORMAT_EDGES;
+                    header.flags=frame->edgeFlags|flags;
+                    header.payloadLength=sizeof(CCD_EDGES)+frame->edges.count*sizeof(CCD_EDGE);
+                    USBCDC_TrasferFramePayload(&header);
+                }
+                else if(outputMode==CCD_MODE_HDR)
+                {
+                    uint8_t *payload=USBCDC_FramePayload();
+                    uint16_t *sample=(uint16_t *)(payload+sizeof(CCD_HDR));
+                    uint16_t n=CCD_DATA_SIZE>>header.hRes;
+                    memcpy(payload,&frame->hdrInfo,sizeof(CCD_HDR));
+                    for(uint16_t i=0;i<n;i++)sample[i]=frame->data[i<<header.hRes];
+                    header.format=CCD_FORMAT_HDR;
+                    header.flags=flags;
+                    header.payloadLength=sizeof(CCD_HDR)+n*sizeof(uint16_t);
+                    USBCDC_TrasferFramePayload(&header);
+                }
+                else if(outputMode==CCD_MODE_STATS)
+                {
+                    header.format=CCD_FORMAT_STATS;
+                    header.flags=flags;
+                    header.payloadLength=0;
+                    USBCDC_TrasferFramePayload(&header);
+                }
+                else if(keepAlive)
+                {
+                    changeSummary.stats=frame->stats;
+                    changeSummary.reference=changeReferenceSequence;
+                    memcpy(USBCDC_FramePayload(),&changeSummary,sizeof(CCD_CHANGE));
+                    header.format=CCD_FORMAT_CHANGE;
+                    header.flags=flags;
+                    header.payloadLength=sizeof(CCD_CHANGE);
+                    USBCDC_TrasferFramePayload(&header);
+                    changeSummary.unchanged=0;
+                    changeSummary.peakDeviation=0;
+                    changeSent=frame->timestamp;
+                }
+                else
+                {
+                    const uint8_t *fraction=frame->oversampled?frame->fraction:NULL;
+                    uint16_t rawLength=(CCD_DATA_SIZE>>header.hRes)*(header.vRes>=2?2:1), length=0;
+                    header.flags=flags;
+                    if(frameOptions&CCD_FRAME_RICE)     //raw unless the code is shorter
+                    {
+                        uint32_t start=CORETIMER_CounterGet();
+                        length=RICE_Encode(frame->data,fraction,CCD_DATA_SIZE,header.hRes,header.vRes,
+                                           USBCDC_FramePayload(),rawLength-1);
+                        compressTicks+=CORETIMER_CounterGet()-start;
+                        compressFrames++;
+                        compressValues+=CCD_DATA_SIZE>>header.hRes;
+                        if(length)
+                        {
+                            compressRawBytes+=rawLength;
+                            compressBytes+=length;
+                        }
+                        else compressFallbacks++;
+                    }
+                    if(length)
+                    {
+                        header.format=CCD_FORMAT_RICE;
+                        header.payloadLength=length;
+                        USBCDC_TrasferFramePayload(&header);
+                    }
+                    else if(header.vRes==CCD_VRES_NATIVE&&header.hRes==0)     //the slot is the payload
+                    {
+                        header.format=CCD_FORMAT_RAW;
+                        header.payloadLength=CCD_DATA_SIZE*sizeof(uint16_t);
+                        CCD_FrameHold(frame);   //kept after CCD_FrameRelease until it is sent
+                        USBCDC_TrasferFrameZeroCopy(&header,frame->data,CCD_FrameUnhold);
+                    }
+                    else
+                    {
+                        header.format=CCD_FORMAT_RAW;
+                        USBCDC_TrasferFrame(&header,frame->data,fraction,CCD_DATA_SIZE);
+                    }
+                    if(outputMode==CCD_MODE_CHANGE)     //the frames that follow are compared with this one
+                    {
+                        CCD_ChangeReference(frame);
+                        changeReferenceSequence=frame->sequence;
+                        changeSent=frame->timestamp;
+                        changeSummary.unchanged=0;
+                        changeSummary.peakDeviation=0;
+                    }
+                }
+                if(lastFrameSent!=0xFFFFFFFF)framesSkipped+=frame->sequence-lastFrameSent-1;
+                lastFrameSent=frame->sequence;
+                framesSent++;
+                TRACE_Event(CCD_TRACE_SEND,CCD_TRACE_END,(uint16_t)frame->sequence);
+            }
+            if(frame)CCD_FrameRelease(frame);
         }
         //if "SET" command is received
         if(USBCDC_SetupRequest())
         {
-            USBCDC_GetSetupData(rx_data);
-            uint16_t temp=0;
-            temp=rx_data[0]<<8;
-            temp+=rx_data[1];
-            ccd.horzontalResolution=rx_data[2];
-            ccd.verticalResolution=rx_data[3];
-
-            //recalculate ICG period to match SH and update integration time
-            ICG_period=ICG_PERIOD_MIN/(temp*10)+1;
-            ccd.integrationTime=temp;
-        
-            ADC0TIME =(0x00010001)|(ccd.verticalResolution<<24); 
+            uint32_t temp=0;
+            if(USBCDC_GetSetupData(rx_data)>=SETUP_EXT_DATA_SIZE)   //extended, in timer ticks
+                temp=((uint32_t)rx_data[4]<<24)|((uint32_t)rx_data[5]<<16)|(rx_data[6]<<8)|rx_data[7];
+            else
+                temp=((rx_data[0]<<8)|rx_data[1])*CCD_TICKS_PER_10US;
+            CCD_Setup(temp,rx_data[2],rx_data[3]);
+        }
+        //if "MOD" command is received
+        if(USBCDC_ModeRequest())
+        {
+            USBCDC_GetModeData(rx_data);
+            if(rx_data[0]<=CCD_MODE_CHANGE)     //an unknown mode leaves mode and settings as they are
+            {
+                outputMode=rx_data[0];
+                if(outputMode==CCD_MODE_FRAME)
+                    frameOptions=rx_data[1];
+                if(outputMode==CCD_MODE_CHANGE)
+                {
+                    changeConfig.options=rx_data[1];
+                    changeConfig.threshold=(rx_data[2]<<8)|rx_data[3];
+                    frameOptions=rx_data[1]&CCD_CHANGE_RICE;
+                    memset(&changeSummary,0,sizeof(changeSummary));
+                }
+                if(outputMode==CCD_MODE_PEAKS)
+                {
+                    peaksConfig.options=rx_data[1];
+                    peaksConfig.threshold=(rx_data[2]<<8)|rx_data[3];
+                }
+                if(outputMode==CCD_MODE_EDGES)
+                {
+                    edgesConfig.options=rx_data[1];
+                    edgesConfig.threshold=(rx_data[2]<<8)|rx_data[3];
+                }
+                if(outputMode==CCD_MODE_STATS)
+                    CCD_StatsSetup((rx_data[2]<<8)|rx_data[3],rx_data[1]);
+                if(outputMode==CCD_MODE_HDR)
+                {
+                    hdrConfig.exposures=CCD_HDR_EXPOSURES(rx_data[1]);
+                    hdrConfig.options=rx_data[1]&CCD_HDR_INVERT;
+                    hdrConfig.ratioShift=rx_data[2];
+                    hdrConfig.dark=rx_data[3]<<4;
+                }
+                if(!CCD_HdrSetup(outputMode==CCD_MODE_HDR?&hdrConfig:NULL))
+                    outputMode=CCD_MODE_FRAME;  //invalid HDR settings or no room for the merge buffer
+                if(!CCD_ChangeSetup(outputMode==CCD_MODE_CHANGE))
+                    outputMode=CCD_MODE_FRAME;  //no room for the reference frames
+                CCD_EdgesSetup(outputMode==CCD_MODE_EDGES?&edgesConfig:NULL);
+            }
+        }
+        //if "EXP" command is received
+        if(USBCDC_ExposureRequest())
+        {
+            EXPOSURE_CONFIG config;
+            USBCDC_GetExposureData(rx_data);
+            config.options=rx_data[0];
+            config.maximum=rx_data[1]?((rx_data[1]<<8)|0xFF)*CCD_TICKS_PER_10US:0;
+            config.setpoint=(rx_data[2]<<8)|rx_data[3];
+            CCD_ExposureSetup(config.options&CCD_EXPOSURE_ENABLE?&config:NULL);
+        }
+        //if "TIM" command is received
+        if(USBCDC_TimingRequest())
+        {
+            CCD_TIMING_REPLY reply={0};
+            uint32_t integrationTime, framePeriod;
+            USBCDC_GetTimingData(rx_data);
+            integrationTime=((uint32_t)rx_data[0]<<24)|((uint32_t)rx_data[1]<<16)|(rx_data[2]<<8)|rx_data[3];
+            framePeriod=((uint32_t)rx_data[4]<<24)|((uint32_t)rx_data[5]<<16)|(rx_data[6]<<8)|rx_data[7];
+            CCD_TimingSetup(integrationTime,framePeriod,&reply);
+            USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //if "CLK" command is received
+        if(USBCDC_ClockRequest())
+        {
+            CCD_CLOCK_REPLY reply={0};
+            USBCDC_GetClockData(rx_data);
+            CCD_ClockSetup(rx_data[0],&reply);
+            USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //if "ADC" command is received
+        if(USBCDC_AdcRequest())
+        {
+            CCD_ADC_REPLY reply={0};
+            USBCDC_GetAdcData(rx_data);
+            adcPending=CCD_AdcSetup(rx_data[0],rx_data[1],rx_data[2],&reply);
+            if(!adcPending)USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //reply to "ADC" match/check when its frames are collected
+        if(adcPending)
+        {
+            CCD_ADC_REPLY reply={0};
+            if(CCD_AdcDone(&reply))
+            {
+                USBCDC_TrasferReply(&reply,sizeof(reply));
+                adcPending=false;
+            }
+        }
+        //if "PHS" command is received
+        if(USBCDC_PhaseRequest())
+        {
+            CCD_PHASE_REPLY reply={0};
+            USBCDC_GetPhaseData(rx_data);
+            phasePending=CCD_PhaseSetup(rx_data[0],rx_data[1],rx_data[2],&reply);
+            if(!phasePending)USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //score every new frame of the "PHS" sweep, reply when every phase is done
+        if(phasePending)
+        {
+            CCD_PHASE_REPLY reply={0};
+            if(CCD_PhaseDone(&reply))
+            {
+                USBCDC_TrasferReply(&reply,sizeof(reply));
+                phasePending=false;
+            }
+        }
+        //if "IRQ" command is received
+        if(USBCDC_IrqRequest())
+        {
+            CCD_IRQ_REPLY reply={0};
+            USBCDC_GetIrqData(rx_data);
+            CCD_IrqSetup(rx_data[0],&reply);
+            USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //if "STA" command is received
+        if(USBCDC_StatusRequest())
+        {
+            CCD_STATUS_REPLY reply={0};
+            CCD_FRAME *frame=CCD_FrameAcquire();
+            reply.version=CCD_STATUS_VERSION;
+            reply.size=sizeof(reply);
+            reply.framesQueued=frame&&frame->sequence!=lastFrameSent;
+            if(frame)CCD_FrameRelease(frame);
+            reply.framesSent=framesSent;
+            reply.framesSkipped=framesSkipped;
+            reply.idleTicks=idleTicks;
+            reply.loops=loops;
+            reply.compressFrames=compressFrames;
+            reply.compressValues=compressValues;
+            reply.compressTicks=compressTicks;
+            reply.compressRawBytes=compressRawBytes;
+            reply.compressBytes=compressBytes;
+            reply.compressFallbacks=compressFallbacks;
+            reply.framesUnchanged=framesUnchanged;
+            CCD_StatusReport(&reply);
+            USBCDC_StatusReport(&reply);
+            reply.timestamp=CORETIMER_CounterGet();
+            USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //if "TRC" command is received
+        if(USBCDC_TraceRequest())
+        {
+            USBCDC_GetTraceData(rx_data);
+            TRACE_Command(rx_data[0],rx_data[1],(rx_data[2]<<8)|rx_data[3],&traceReply);
+            USBCDC_TrasferReply(&traceReply,sizeof(traceReply));
+        }
+        //if "BUF" command is received
+        if(USBCDC_BufRequest())
+        {
+            CCD_BUF_REPLY reply={0};
+            USBCDC_GetBufData(rx_data);
+            reply.operation=rx_data[0];
+            switch(rx_data[0])
+            {
+                case CCD_BUF_SET:
+                    reply.status=USBCDC_WritePlacement(rx_data[1]);
+                    break;
+                case CCD_BUF_BENCH:
+                {
+                    CCD_FRAME *frame=CCD_FrameAcquire();
+                    DMABUF_Bench(&reply);
+                    if(frame)
+                    {
+                        reply.packCached=USBCDC_PackBench(frame->data,CCD_BUF_CACHED);
+                        reply.packCoherent=USBCDC_PackBench(frame->data,CCD_BUF_COHERENT);
+                        CCD_FrameRelease(frame);
+                    }
+                    reply.status=CCD_BUF_OK;
+                    break;
+                }
+                case CCD_BUF_QUERY:
+                    reply.status=CCD_BUF_OK;
+                    break;
+                default:
+                    reply.status=CCD_BUF_BAD_REQUEST;
+                    break;
+            }
+            reply.placement=USBCDC_WritePlacementGet();
+            USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //if "MEM" command is received
+        if(USBCDC_MemoryRequest())
+        {
+            CCD_MEM_REPLY reply={0};
+            USBCDC_GetMemoryData(rx_data);
+            ARENA_Report(&reply);
+            USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //if "LIN" command is received
+        if(USBCDC_LinearityRequest())
+        {
+            CCD_LIN_REPLY reply={0};
+            uint16_t len=USBCDC_GetLinearityData(lin_data);
+            reply.operation=lin_data[0];
+            switch(len<SETUP_DATA_SIZE?0xFF:lin_data[0])
+            {
+                case CCD_LIN_LOAD:
+                    if(len<LINEARITY_DATA_SIZE)reply.status=CCD_LIN_BAD_REQUEST;
+                    else reply.status=LIN_Load(lin_data[1],&lin_data[SETUP_DATA_SIZE]);
+                    break;
+                case CCD_LIN_ENABLE:
+                    reply.status=LIN_Enable(lin_data[2]&CCD_LIN_ON);
+                    break;
+                case CCD_LIN_SAVE:
+                    reply.status=LIN_Save();
+                    break;
+                case CCD_LIN_CLEAR:
+                    LIN_Clear();
+                    reply.status=CCD_LIN_OK;
+                    break;
+                case CCD_LIN_BENCH:
+                {
+                    CCD_FRAME *frame=CCD_FrameAcquire();
+                    if(frame)
+                    {
+                        reply.value=LIN_Bench(frame->data);
+                        CCD_FrameRelease(frame);
+                    }
+                    reply.status=CCD_LIN_OK;
+                    break;
+                }
+                case CCD_LIN_QUERY:
+                    reply.status=CCD_LIN_OK;
+                    break;
+                default:
+                    reply.status=CCD_LIN_BAD_REQUEST;
+                    break;
+            }
+            reply.enabled=LIN_Active();
+            reply.loaded=LIN_Loaded();
+            reply.size=CCD_LIN_SIZE;
+            USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //if "CAL" command is received
+        if(USBCDC_CalibrationRequest())
+        {
+            CCD_CAL_REPLY reply={0};
+            USBCDC_GetCalibrationData(cal_data);
+            reply.operation=cal_data[0];
+            switch(cal_data[0])
+            {
+                case CCD_CAL_DARK:
+                case CCD_CAL_FLAT:
+                    reply.status=CORR_CaptureStart(cal_data[0],cal_data[1],cal_data[2]);
+                    if(reply.status==CCD_CAL_OK)
+                    {
+                        calPending=true;
+                        calLastFrame=0xFFFFFFFF;
+                    }
+                    break;
+                case CCD_CAL_SAVE:
+                    reply.status=CORR_Save();
+                    break;
+                case CCD_CAL_CLEAR:
+                    CORR_Clear();
+                    reply.status=CCD_CAL_OK;
+                    break;
+                case CCD_CAL_ENABLE:
+                    reply.status=CORR_Enable(cal_data[2]&CCD_CAL_ON);
+                    break;
+                case CCD_CAL_BENCH:
+                {
+                    CCD_FRAME *frame=CCD_FrameAcquire();
+                    if(frame)
+                    {
+                        reply.value=CORR_Bench(frame->data);
+                        CCD_FrameRelease(frame);
+                    }
+                    reply.status=CCD_CAL_OK;
+                    break;
+                }
+                default:
+                    reply.status=CCD_CAL_BAD_REQUEST;
+                    break;
+            }
+            if(!calPending)USBCDC_TrasferReply(&reply,sizeof(reply));
+        }
+        //average uncorrected frames for "CAL" dark/flat, reply when enough were taken
+        if(calPending)
+        {
+            CCD_FRAME *frame=CCD_FrameAcquire();
+            if(frame&&frame->sequence!=calLastFrame&&!frame->corrected)
+            {
+                calLastFrame=frame->sequence;
+                if(CORR_CaptureFrame(frame->data))
+                {
+                    CCD_CAL_REPLY reply={0};
+                    reply.operation=cal_data[0];
+                    reply.frames=cal_data[1];
+                    reply.status=CORR_CaptureFinish();
+                    USBCDC_TrasferReply(&reply,sizeof(reply));
+                    calPending=false;
+                }
+            }
+            if(frame)CCD_FrameRelease(frame);
         }
     }
     /* Execution should not come here during normal operation */
@@ -0,0 +1,120 @@
+/*******************************************************************************
+  Peak Finder Source File
+
+  File Name:
+    peaks.c
+
+  Summary:
+    Threshold and local maximum peak detection with sub-pixel position.
+
+  Description:
+    Runs on a completed frame in the main loop. One pass over the samples,
+    per peak work is a handful of multiplications and one division.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "peaks.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+static inline int32_t PEAKS_Sample(const uint16_t *data, uint16_t i, uint8_t invert)
+{
+    return invert?CCD_ADC_MAX-(int32_t)data[i]:(int32_t)data[i];
+}
+
+//Vertex of the parabola through a,b,c relative to b, in 1/256 steps (|offset|<=128 when b is the maximum)
+static int32_t PEAKS_Parabola(int32_t a, int32_t b, int32_t c)
+{
+    int32_t den=a-2*b+c;
+    if(den>=0)return 0;                 //flat top
+    return ((a-c)*128)/den;
+}
+
+//Adds a peak, when the list is full the lowest peak is replaced by a taller one
+static uint8_t PEAKS_Add(CCD_PEAK *peaks, uint8_t n, uint8_t max, const CCD_PEAK *peak, bool *truncated)
+{
+    if(n<max)
+    {
+        peaks[n]=*peak;
+        return n+1;
+    }
+    *truncated=true;
+    if(!max)return 0;
+
+    uint8_t lowest=0;
+    for(uint8_t i=1;i<n;i++)
+        if(peaks[i].height<peaks[lowest].height)lowest=i;
+    if(peak->height>peaks[lowest].height)
+    {
+        //keep the list ordered by position
+        for(uint8_t i=lowest;i+1<n;i++)peaks[i]=peaks[i+1];
+        peaks[n-1]=*peak;
+    }
+    return n;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Finds peaks in data[first..first+count-1], returns the number of peaks stored.
+//truncated is set when more than max peaks were found.
+uint8_t PEAKS_Find(const uint16_t *data, uint16_t first, uint16_t count, const PEAKS_CONFIG *config,
+                   CCD_PEAK *peaks, uint8_t max, bool *truncated)
+{
+    uint8_t invert=config->options&CCD_PEAKS_INVERT;
+    int32_t threshold=config->threshold;
+    uint16_t end=first+count;
+    uint8_t n=0;
+
+    *truncated=false;
+    for(uint16_t i=first;i<end;i++)
+    {
+        if(PEAKS_Sample(data,i,invert)<=threshold)continue;
+
+        /* One run above threshold */
+        uint16_t start=i, top=i;
+        int32_t topValue=0;
+        uint64_t sumW=0, sumIW=0;
+        for(;i<end;i++)
+        {
+            int32_t v=PEAKS_Sample(data,i,invert);
+            if(v<=threshold)break;
+            if(v>topValue)
+            {
+                topValue=v;
+                top=i;
+            }
+            sumW+=(uint32_t)(v-threshold);
+            sumIW+=(uint64_t)(i-start)*(uint32_t)(v-threshold);
+        }
+
+        CCD_PEAK peak;
+        peak.height=(uint16_t)topValue;
+        peak.width=i-start;
+        if(config->options&CCD_PEAKS_CENTROID)
+            peak.position=((uint32_t)start<<8)+(uint32_t)((sumIW*256+sumW/2)/sumW);
+        else if(top>first&&top+1<end)
+            peak.position=(uint32_t)(((int32_t)top<<8)+PEAKS_Parabola(PEAKS_Sample(data,top-1,invert),topValue,
+                                                                      PEAKS_Sample(data,top+1,invert)));
+        else
+            peak.position=(uint32_t)top<<8;
+        n=PEAKS_Add(peaks,n,max,&peak,truncated);
+    }
+    return n;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,69 @@
+/*******************************************************************************
+  Peak Finder Header File
+
+  File Name:
+    peaks.h
+
+  Summary:
+    Threshold and local maximum peak detection with sub-pixel position.
+
+  Description:
+    Every run of samples above the threshold is one peak. Its height is the
+    run maximum and its position is refined in fixed point, either with a
+    parabola through the maximum and its two neighbours or with the centroid
+    of the run weighted by the height above threshold. Only integer
+    arithmetic is used; the module has no hardware dependencies so the host
+    tools build the same code.
+ *******************************************************************************/
+
+#ifndef _PEAKS_H
+#define _PEAKS_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+typedef struct
+{
+    uint16_t    threshold;          //sample units, after inversion
+    uint8_t     options;            //CCD_PEAKS_xxx
+}PEAKS_CONFIG;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+uint8_t PEAKS_Find(const uint16_t *data, uint16_t first, uint16_t count, const PEAKS_CONFIG *config,
+                   CCD_PEAK *peaks, uint8_t max, bool *truncated);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _PEAKS_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,117 @@
+/*******************************************************************************
+  Sampling Phase Sweep Source File
+
+  File Name:
+    phase.c
+
+  Summary:
+    Scores the ADC sampling phase from frames of a stable scene.
+
+  Description:
+    PHASE_Frame adds one frame taken at the current step and moves to the
+    next step once the step has its frames; the caller switches the
+    sampling phase when step changes. Scores compare signal^2/noise, so no
+    square root is needed.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "phase.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Sample i on the x16 scale
+static inline uint16_t PHASE_Sample(const uint16_t *data, const uint8_t *fraction, uint16_t i)
+{
+    return fraction?(uint16_t)((data[i]<<CCD_FINE_SHIFT)|fraction[i]):(uint16_t)(data[i]<<CCD_FINE_SHIFT);
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+void PHASE_Start(PHASE_SWEEP *s, uint8_t frames)
+{
+    s->frames=frames<2?2:frames;
+    s->step=0;
+    s->count=0;
+    s->done=false;
+    s->d2=0;
+    s->signal=0;
+    for(uint8_t k=0;k<CCD_PHASE_STEPS;k++)
+    {
+        s->signalMean[k]=0;
+        s->noise[k]=0;
+    }
+}
+/******************************************************************************/
+//Adds a frame taken at phase s->step (fraction NULL unless oversampled), returns
+//true when the sweep is complete
+bool PHASE_Frame(PHASE_SWEEP *s, const uint16_t *data, const uint8_t *fraction)
+{
+    if(s->done)return true;
+
+    uint32_t black=0, light=0;
+    for(uint16_t i=PHASE_SHIELDED_FIRST;i<PHASE_SHIELDED_FIRST+PHASE_SHIELDED_COUNT;i++)
+        black+=PHASE_Sample(data,fraction,i);
+    for(uint16_t i=CCD_SIGNAL_FIRST;i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT;i++)
+    {
+        uint16_t v=PHASE_Sample(data,fraction,i);
+        if(s->count)
+        {
+            uint32_t d=v>s->previous[i]?v-s->previous[i]:s->previous[i]-v;
+            s->d2+=d*d;
+        }
+        s->previous[i]=v;
+        light+=v;
+    }
+    //light lowers the output of inverted front ends, the signal is the distance either way
+    int32_t signal=(int32_t)(light/CCD_SIGNAL_COUNT)-(int32_t)(black/PHASE_SHIELDED_COUNT);
+    s->signal+=(uint32_t)(signal<0?-signal:signal);
+
+    if(++s->count<s->frames)return false;
+    s->signalMean[s->step]=(uint16_t)(s->signal/s->count);
+    s->noise[s->step]=(uint32_t)(s->d2/(2u*(s->count-1)*CCD_SIGNAL_COUNT));
+    s->count=0;
+    s->d2=0;
+    s->signal=0;
+    if(++s->step<CCD_PHASE_STEPS)return false;
+    s->done=true;
+    return true;
+}
+/******************************************************************************/
+//True if phase a has a higher signal to noise ratio than phase b
+bool PHASE_Better(const PHASE_SWEEP *s, uint8_t a, uint8_t b)
+{
+    //signal^2/noise, a noise-free phase counts as 1/256 LSB^2
+    uint64_t na=s->noise[a]?s->noise[a]:1, nb=s->noise[b]?s->noise[b]:1;
+    uint64_t sa=(uint64_t)s->signalMean[a]*s->signalMean[a], sb=(uint64_t)s->signalMean[b]*s->signalMean[b];
+    return sa*nb>sb*na;
+}
+/******************************************************************************/
+//Phase with the highest signal to noise ratio, CCD_PHASE_STEPS if no phase saw
+//PHASE_SIGNAL_MIN
+uint8_t PHASE_Best(const PHASE_SWEEP *s)
+{
+    uint8_t best=CCD_PHASE_STEPS;
+    for(uint8_t k=0;k<CCD_PHASE_STEPS;k++)
+    {
+        if(s->signalMean[k]<PHASE_SIGNAL_MIN)continue;
+        if(best==CCD_PHASE_STEPS||PHASE_Better(s,k,best))best=k;
+    }
+    return best;
+}
+
+/*******************************************************************************
+ End of File
+ */
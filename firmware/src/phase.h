@@ -0,0 +1,92 @@
+/*******************************************************************************
+  Sampling Phase Sweep Header File
+
+  File Name:
+    phase.h
+
+  Summary:
+    Scores the ADC sampling phase from frames of a stable scene.
+
+  Description:
+    The output of the sensor settles after every change, how fast depends on
+    the analog front end and the cable, so the best instant to sample it
+    within the conversion spacing differs from board to board. The sweep
+    takes a few frames at every one of CCD_PHASE_STEPS phases and scores
+    each phase by its signal, the mean of the light sensitive outputs above
+    the light shielded ones, against its temporal noise, the variance of the
+    difference of consecutive frames (halved, two frames contribute). The
+    phase with the highest signal to noise ratio wins; a scene without
+    signal cannot be scored.
+
+    Frames are fed from the main loop, samples on the x16 scale of
+    oversampled frames. The module has no hardware dependencies, the host
+    tools run the same sweep on a simulated front end.
+ *******************************************************************************/
+
+#ifndef _PHASE_H
+#define _PHASE_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define PHASE_SHIELDED_FIRST    16      //light shielded outputs D16..D28, black reference
+#define PHASE_SHIELDED_COUNT    13
+#define PHASE_SIGNAL_MIN        (64<<CCD_FINE_SHIFT)    //mean signal a phase needs to be scored
+
+typedef struct
+{
+    /* Per sweep settings */
+    uint8_t     frames;             //per phase, at least 2
+    /* Running state */
+    uint8_t     step;               //phase the next frame must be taken at
+    uint8_t     count;              //frames of this phase so far
+    bool        done;
+    uint64_t    d2;                 //sum of squared frame differences, x16 scale
+    uint64_t    signal;             //sum of frame signals, x16 scale
+    uint16_t    previous[CCD_DATA_SIZE];    //last frame of this phase, x16 scale
+    /* Results */
+    uint16_t    signalMean[CCD_PHASE_STEPS];    //1/16 LSB
+    uint32_t    noise[CCD_PHASE_STEPS];         //variance, 1/256 LSB^2
+}PHASE_SWEEP;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+void PHASE_Start(PHASE_SWEEP *s, uint8_t frames);
+bool PHASE_Frame(PHASE_SWEEP *s, const uint16_t *data, const uint8_t *fraction);
+uint8_t PHASE_Best(const PHASE_SWEEP *s);
+bool PHASE_Better(const PHASE_SWEEP *s, uint8_t a, uint8_t b);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _PHASE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,207 @@
+/*******************************************************************************
+  Frame Compression Source File
+
+  File Name:
+    rice.c
+
+  Summary:
+    Lossless delta and Rice coding of frame samples (CCD_FORMAT_RICE).
+
+  Description:
+    Runs on a completed frame in the main loop, straight into the transmit
+    buffer. Per value the work is a subtraction, the sign mapping and two
+    code length sums, the parameters compared are the one the block mean
+    suggests and the next lower one. A block whose code would pass the
+    given maximum ends the frame early, the caller sends it raw then.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stddef.h>
+#include "rice.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+typedef struct
+{
+    uint8_t     *out;               //next byte to write
+    uint32_t    acc;                //bits not written yet, the low count ones
+    uint8_t     count;
+}RICE_WRITER;
+
+typedef struct
+{
+    const uint8_t *in;
+    uint32_t    len;
+    uint32_t    pos;                //next byte to read, bytes past len read as 0
+    uint32_t    acc;                //bits read ahead, the low count ones
+    uint8_t     count;
+}RICE_READER;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Value CCD_FORMAT_RAW sends for output i
+static inline uint16_t RICE_Value(const uint16_t *data, const uint8_t *fraction, uint16_t i, uint8_t vRes)
+{
+    if(vRes==CCD_VRES_16BIT)return (data[i]<<CCD_FINE_SHIFT)|(fraction?fraction[i]:0);
+    if(vRes==CCD_VRES_NATIVE)return data[i];
+    return data[i]>>(2*(3-vRes));
+}
+
+//n<=24 bits of value, most significant first
+static inline void RICE_Put(RICE_WRITER *w, uint32_t value, uint8_t n)
+{
+    w->acc=(w->acc<<n)|(value&((1u<<n)-1));
+    w->count+=n;
+    while(w->count>=8)
+    {
+        w->count-=8;
+        *w->out++=(uint8_t)(w->acc>>w->count);
+    }
+}
+
+//Code length of the block u[0..n-1] with parameter k
+static uint32_t RICE_Cost(const uint16_t *u, uint8_t n, uint8_t k, uint8_t bits)
+{
+    uint32_t cost=0;
+    for(uint8_t j=0;j<n;j++)
+    {
+        uint16_t q=u[j]>>k;
+        cost+=q<CCD_RICE_ESCAPE?q+1+k:CCD_RICE_ESCAPE+bits;
+    }
+    return cost;
+}
+
+//n<=16 bits
+static inline uint32_t RICE_Get(RICE_READER *r, uint8_t n)
+{
+    while(r->count<n)
+    {
+        r->acc=(r->acc<<8)|(r->pos<r->len?r->in[r->pos]:0);
+        r->pos++;
+        r->count+=8;
+    }
+    r->count-=n;
+    return (r->acc>>r->count)&((1u<<n)-1);
+}
+
+//One bits before the first zero, at most CCD_RICE_ESCAPE; the zero is taken too
+static inline uint8_t RICE_Ones(RICE_READER *r)
+{
+    uint32_t x=RICE_Get(r,16);
+    uint8_t ones=x==0xFFFF?CCD_RICE_ESCAPE:(uint8_t)(__builtin_clz(~x&0xFFFF)-16);
+    r->count+=16-(ones==CCD_RICE_ESCAPE?ones:ones+1);     //give back what follows
+    return ones;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Codes the len>>hRes values CCD_FORMAT_RAW would send into out, returns the bytes
+//used or 0 if that would be more than max
+uint16_t RICE_Encode(const uint16_t *data, const uint8_t *fraction, uint16_t len, uint8_t hRes, uint8_t vRes,
+                     uint8_t *out, uint16_t max)
+{
+    RICE_WRITER w={out,0,0};
+    uint8_t bits=CCD_RICE_BITS(vRes);
+    uint16_t mask=(uint16_t)((1u<<bits)-1), half=(uint16_t)(1u<<(bits-1));
+    uint16_t n=len>>hRes, prev=0, u[CCD_RICE_BLOCK];
+    uint32_t used=0;                //bits
+
+    for(uint16_t first=0;first<n;first+=CCD_RICE_BLOCK)
+    {
+        uint8_t m=n-first<CCD_RICE_BLOCK?(uint8_t)(n-first):CCD_RICE_BLOCK, k=0;
+        uint32_t sum=0, cost, lower;
+
+        for(uint8_t j=0;j<m;j++)
+        {
+            uint16_t v=RICE_Value(data,fraction,(uint16_t)(first+j)<<hRes,vRes);
+            uint16_t d=(v-prev)&mask;
+            prev=v;
+            u[j]=d<half?(uint16_t)(d<<1):(uint16_t)((((~d)&mask)<<1)|1);
+            sum+=u[j];
+        }
+        //k near log2 of the mean, the lower one wins when most values are small
+        if(sum>=m)k=(uint8_t)(31-__builtin_clz(sum/m));
+        if(k>CCD_RICE_RAW-1)k=CCD_RICE_RAW-1;
+        cost=RICE_Cost(u,m,k,bits);
+        if(k>0&&(lower=RICE_Cost(u,m,k-1,bits))<=cost)
+        {
+            cost=lower;
+            k--;
+        }
+        if(cost>=(uint32_t)m*bits)
+        {
+            cost=(uint32_t)m*bits;
+            k=CCD_RICE_RAW;
+        }
+        used+=4+cost;
+        if((used+7)/8>max)return 0;
+
+        RICE_Put(&w,k,4);
+        for(uint8_t j=0;j<m;j++)
+        {
+            uint16_t q=u[j]>>k;
+            if(k==CCD_RICE_RAW)RICE_Put(&w,u[j],bits);
+            else if(q<CCD_RICE_ESCAPE)
+            {
+                RICE_Put(&w,(1u<<(q+1))-2,q+1);
+                RICE_Put(&w,u[j],k);
+            }
+            else
+            {
+                RICE_Put(&w,0xFFFF,CCD_RICE_ESCAPE);
+                RICE_Put(&w,u[j],bits);
+            }
+        }
+    }
+    if(w.count)RICE_Put(&w,0,8-w.count);
+    return (uint16_t)(w.out-out);
+}
+/******************************************************************************/
+//Decodes count values of bits each from len bytes at in, returns the bytes used
+//or -1 if the stream is shorter than that
+int32_t RICE_Decode(const uint8_t *in, uint32_t len, uint16_t count, uint8_t bits, uint16_t *out)
+{
+    RICE_READER r={in,len,0,0,0};
+    uint16_t mask=(uint16_t)((1u<<bits)-1), prev=0;
+
+    for(uint16_t first=0;first<count;first+=CCD_RICE_BLOCK)
+    {
+        uint16_t m=count-first<CCD_RICE_BLOCK?count-first:CCD_RICE_BLOCK;
+        uint8_t k=(uint8_t)RICE_Get(&r,4);
+
+        for(uint16_t j=0;j<m;j++)
+        {
+            uint16_t u;
+            if(k==CCD_RICE_RAW)u=(uint16_t)RICE_Get(&r,bits);
+            else
+            {
+                uint8_t q=RICE_Ones(&r);
+                u=q<CCD_RICE_ESCAPE?(uint16_t)((q<<k)|RICE_Get(&r,k)):(uint16_t)RICE_Get(&r,bits);
+            }
+            prev=(prev+((u&1)?~(u>>1):(u>>1)))&mask;
+            out[first+j]=prev;
+        }
+        if(r.pos*8-r.count>len*8)return -1;    //read past the end
+    }
+    return (int32_t)((r.pos*8-r.count+7)/8);
+}
+
+/*******************************************************************************
+ End of File
+ */
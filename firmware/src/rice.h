@@ -0,0 +1,59 @@
+/*******************************************************************************
+  Frame Compression Header File
+
+  File Name:
+    rice.h
+
+  Summary:
+    Lossless delta and Rice coding of frame samples (CCD_FORMAT_RICE).
+
+  Description:
+    Neighbouring outputs of the sensor differ by little, so a sample is
+    predicted by the one before it and only the difference is coded, with
+    a Rice code whose parameter is chosen per block of CCD_RICE_BLOCK
+    values from their sum (see "Compression" in ccd_protocol.h). Coding is
+    one pass over the frame, nothing has to be buffered beyond a block. The
+    module has no hardware dependencies so the host tools decode with the
+    same code.
+ *******************************************************************************/
+
+#ifndef _RICE_H
+#define _RICE_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+uint16_t RICE_Encode(const uint16_t *data, const uint8_t *fraction, uint16_t len, uint8_t hRes, uint8_t vRes,
+                     uint8_t *out, uint16_t max);
+int32_t RICE_Decode(const uint8_t *in, uint32_t len, uint16_t count, uint8_t bits, uint16_t *out);
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _RICE_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,138 @@
+/*******************************************************************************
+  SH/ICG Timing Source File
+
+  File Name:
+    timing.c
+
+  Summary:
+    Frame and integration time schedule in Timer 3 ticks.
+
+  Description:
+    TIMING_Schedule runs when the times change (a few divisions),
+    TIMING_Events and TIMING_Next in the Timer 3 interrupt at the start of
+    every segment.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "timing.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Local Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Splits an SH period of length ticks (at least CCD_INTEGRATION_MIN) into timer segments
+static void TIMING_Period(TIMING_PERIOD *p, uint32_t length)
+{
+    p->length=length;
+    if(length<2*TIMING_SH_TICKS)        //one segment, every other one would be too short
+    {
+        p->first=length;
+        p->segment=0;
+        p->count=0;
+        p->extra=0;
+        return;
+    }
+    uint32_t rest=length-TIMING_SH_TICKS;
+    p->first=TIMING_SH_TICKS;
+    p->count=rest/TIMING_SEGMENT_MAX+(rest%TIMING_SEGMENT_MAX?1:0);
+    p->segment=rest/p->count;
+    p->extra=rest%p->count;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//framePeriod 0 runs free, readouts at CCD clock mode clock. Returns CCD_TIMING_OK
+//or why the combination is impossible, the schedule is unchanged then.
+uint8_t TIMING_Schedule(TIMING_SCHEDULE *schedule, uint32_t integrationTime, uint32_t framePeriod, uint8_t clock)
+{
+    uint32_t flushes, flush, rest;
+
+    if(integrationTime<CCD_INTEGRATION_MIN)return CCD_TIMING_EXPOSURE_SHORT;
+    if(!framePeriod)                    //whole integration periods, more than a readout
+    {
+        flushes=TIMING_ICG_MIN(clock)/integrationTime;
+        flush=integrationTime;
+        rest=flushes*integrationTime;
+        framePeriod=rest+integrationTime;
+    }
+    else
+    {
+        if(framePeriod<=TIMING_ICG_MIN(clock))return CCD_TIMING_PERIOD_SHORT;
+        if(integrationTime>framePeriod)return CCD_TIMING_EXPOSURE_LONG;
+        rest=framePeriod-integrationTime;
+        if(rest&&rest<CCD_INTEGRATION_MIN)return CCD_TIMING_FLUSH_SHORT;
+        //flush periods no longer than the integration time, none below the minimum
+        flushes=rest/integrationTime+(rest%integrationTime?1:0);
+        if(flushes>rest/CCD_INTEGRATION_MIN)flushes=rest/CCD_INTEGRATION_MIN;
+        flush=flushes?rest/flushes:0;
+    }
+
+    schedule->framePeriod=framePeriod;
+    schedule->clock=clock;
+    schedule->flushes=flushes;
+    TIMING_Period(&schedule->integration,integrationTime);
+    if(flushes)
+    {
+        TIMING_Period(&schedule->flush,flush);
+        TIMING_Period(&schedule->firstFlush,rest-(flushes-1)*flush);
+    }
+    else
+    {
+        schedule->flush=schedule->integration;
+        schedule->firstFlush=schedule->integration;
+    }
+    return CCD_TIMING_OK;
+}
+/******************************************************************************/
+//Nearest integration time up to integrationTime that fits framePeriod (0: free running)
+uint32_t TIMING_Fit(uint32_t integrationTime, uint32_t framePeriod)
+{
+    if(integrationTime<CCD_INTEGRATION_MIN)integrationTime=CCD_INTEGRATION_MIN;
+    if(!framePeriod||integrationTime>=framePeriod)return framePeriod?framePeriod:integrationTime;
+    if(framePeriod-integrationTime<CCD_INTEGRATION_MIN)return framePeriod-CCD_INTEGRATION_MIN;
+    return integrationTime;
+}
+/******************************************************************************/
+//The first segment after the reset starts a frame with SH and ICG pulses
+void TIMING_Reset(TIMING_STATE *s, const TIMING_SCHEDULE *schedule)
+{
+    s->active=*schedule;
+    s->period=&s->active.integration;
+    s->flush=s->active.flushes;
+    s->index=s->period->count;
+}
+/******************************************************************************/
+//Returns the ticks of the segment starting now. A frame started here
+//takes its schedule from next.
+uint32_t TIMING_Next(TIMING_STATE *s, const TIMING_SCHEDULE *next)
+{
+    uint8_t events=TIMING_Events(s);
+
+    if(!events)return s->period->segment+(s->index++<s->period->extra?1:0);
+
+    if(events&TIMING_ICG)
+    {
+        s->active=*next;
+        s->flush=0;
+    }
+    else s->flush++;
+    if(s->flush>=s->active.flushes)s->period=&s->active.integration;
+    else s->period=s->flush?&s->active.flush:&s->active.firstFlush;
+    s->index=0;
+    return s->period->first;
+}
+
+/*******************************************************************************
+ End of File
+ */
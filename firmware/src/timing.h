@@ -0,0 +1,149 @@
+/*******************************************************************************
+  SH/ICG Timing Header File
+
+  File Name:
+    timing.h
+
+  Summary:
+    Frame and integration time schedule in Timer 3 ticks.
+
+  Description:
+    Times are 32-bit counts of the Timer 3 clock (CCD_TIMER_HZ, 80ns).
+
+    A frame runs from one ICG pulse to the next (frame period) and is a
+    sequence of SH periods: flush periods, whose charge is dumped by the
+    next SH pulse, then the integration period, which ends with the SH
+    pulse inside the ICG pulse and is the exposure read out. Flush periods
+    are as close to the integration time as possible but at least
+    CCD_INTEGRATION_MIN, the first one takes the remainder, so the frame
+    period is exact. Without a frame period the frame is the smallest
+    number of integration periods longer than TIMING_ICG_MIN (free running).
+
+    The timer period register is 16 bits, so every SH period is split into
+    timer periods (segments): the first one starts with the SH pulse
+    (Output Compare 4, ticks 64..114 of the segment) and is TIMING_SH_TICKS
+    long, the rest of the SH period is divided into equal segments of at
+    most 65536 ticks, the remainder spread one tick each over the first of
+    them. SH periods below 2*TIMING_SH_TICKS are a single segment. The
+    timer interrupt loads the length of every segment as it starts.
+
+    ICG is low for the first segment of a frame and the readout starts with
+    the next one, so the readout start can move by up to 124 ticks between
+    frames; TIMING_ICG_MIN covers that on top of a readout. The readout takes
+    longer at lower CCD master clocks, the schedule carries the clock mode
+    (CCD_CLOCK_xxx) that the firmware switches to at its first ICG pulse.
+
+    A new schedule takes effect with the next ICG pulse, so no frame is a
+    mix of two schedules. The module has no hardware dependencies, the host
+    tools simulate the schedule with the same code.
+ *******************************************************************************/
+
+#ifndef _TIMING_H
+#define _TIMING_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#define TIMING_SEGMENT_MAX      65536u  //ticks, 16-bit period register
+#define TIMING_SH_TICKS         125u    //segment with the SH pulse, 10us (ICG low time)
+#define TIMING_SH_END           115u    //SH pulse ends at this tick of its segment (OC4RS+1)
+#define TIMING_READOUT_TICKS(clock) (CCD_DATA_SIZE*CCD_CLOCK_DIVIDER(clock)/2u) //3694 outputs, 18.47ms at 0.8MHz
+#define TIMING_ICG_MIN(clock)   (TIMING_READOUT_TICKS(clock)+TIMING_SH_TICKS-1) //frame periods are longer than this
+
+#define TIMING_SH               0x01    //segment starts with an SH pulse
+#define TIMING_ICG              0x02    //and ICG is low during it, ending the frame exposure
+
+typedef struct
+{
+    uint32_t    length;             //SH period, ticks
+    uint32_t    first;              //ticks of the segment starting with the SH pulse
+    uint32_t    segment;            //ticks of the other segments
+    uint32_t    count;              //other segments
+    uint32_t    extra;              //of these, the first extra are one tick longer
+}TIMING_PERIOD;
+
+typedef struct
+{
+    uint32_t    framePeriod;        //ICG to ICG, ticks
+    uint8_t     clock;              //CCD_CLOCK_xxx of the readouts
+    uint32_t    flushes;            //SH periods before the integration period
+    TIMING_PERIOD firstFlush;       //first flush period, takes the remainder
+    TIMING_PERIOD flush;            //other flush periods
+    TIMING_PERIOD integration;      //exposure read out
+}TIMING_SCHEDULE;
+
+typedef struct
+{
+    TIMING_SCHEDULE active;         //of the current frame
+    const TIMING_PERIOD *period;    //current SH period
+    uint32_t    flush;              //SH periods of the frame before the current one
+    uint32_t    index;              //other segments started in the current SH period
+}TIMING_STATE;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+uint8_t TIMING_Schedule(TIMING_SCHEDULE *schedule, uint32_t integrationTime, uint32_t framePeriod, uint8_t clock);
+uint32_t TIMING_Fit(uint32_t integrationTime, uint32_t framePeriod);
+void TIMING_Reset(TIMING_STATE *s, const TIMING_SCHEDULE *schedule);
+uint32_t TIMING_Next(TIMING_STATE *s, const TIMING_SCHEDULE *next);
+
+//Called at the start of every segment, before TIMING_Next: TIMING_xxx of the segment
+static inline uint8_t TIMING_Events(const TIMING_STATE *s)
+{
+    if(s->index<s->period->count)return 0;
+    return s->flush>=s->active.flushes?TIMING_SH|TIMING_ICG:TIMING_SH;
+}
+
+//Largest oversampling 2^n up to shift whose conversion slots (2^n/cores, at least one)
+//divide the output period at clock into whole CCD_CLOCK_BASE_HZ cycles and stay within
+//CCD_CAPTURE_RATE_MAX, as n
+static inline uint8_t TIMING_Oversampling(uint8_t clock, uint8_t shift, uint8_t cores)
+{
+    uint32_t period=4u*CCD_CLOCK_DIVIDER(clock);
+    uint8_t coreShift=cores>1?1:0;
+    uint8_t slotShift=shift>coreShift?shift-coreShift:0;
+    while(slotShift&&(period%(1u<<slotShift)||(CCD_CLOCK_BASE_HZ/period<<slotShift)>CCD_CAPTURE_RATE_MAX))slotShift--;
+    return slotShift+coreShift;
+}
+
+//Integration time in the x10us unit of "SET", rounded and limited to 16 bits
+static inline uint16_t TIMING_Time10us(uint32_t ticks)
+{
+    uint32_t t=ticks/CCD_TICKS_PER_10US+((ticks%CCD_TICKS_PER_10US)*2>=CCD_TICKS_PER_10US?1:0);
+    return t>0xFFFF?0xFFFF:(uint16_t)t;
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _TIMING_H */
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,98 @@
+/*******************************************************************************
+  Event Trace Source File
+
+  File Name:
+    trace.c
+
+  Summary:
+    Ring of timestamped events from the interrupts and the main loop.
+
+  Description:
+    The ring is only read while it is stopped, so READ needs no interrupt
+    lock. Blocks are taken from the oldest entry still in the ring on, once
+    more than CCD_TRACE_SIZE events were written the first ones are gone.
+ *******************************************************************************/
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "trace.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data Definitions
+// *****************************************************************************
+// *****************************************************************************
+CCD_TRACE_ENTRY traceRing[CCD_TRACE_SIZE];
+uint32_t traceHead=0;
+volatile uint16_t traceMask=0;
+
+static uint16_t traceLastMask=0;        //of the last START
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+
+//Clears the ring and records the events of mask (0: CCD_TRACE_DEFAULT)
+uint8_t TRACE_Start(uint16_t mask)
+{
+    if(!TRACE_ENABLED)return CCD_TRACE_DISABLED;
+    traceMask=0;
+    traceHead=0;
+    traceLastMask=(mask?mask:CCD_TRACE_DEFAULT)&((1u<<CCD_TRACE_EVENTS)-1);
+    traceMask=traceLastMask;
+    return CCD_TRACE_OK;
+}
+/******************************************************************************/
+void TRACE_Stop(void)
+{
+    traceMask=0;
+}
+/******************************************************************************/
+//"TRC" request, READ copies block of the stopped ring
+void TRACE_Command(uint8_t operation, uint8_t block, uint16_t mask, CCD_TRACE_REPLY *reply)
+{
+    reply->operation=operation;
+    reply->block=block;
+    reply->count=0;
+    switch(operation)
+    {
+        case CCD_TRACE_START:
+            reply->status=TRACE_Start(mask);
+            break;
+        case CCD_TRACE_STOP:
+            TRACE_Stop();
+            reply->status=TRACE_ENABLED?CCD_TRACE_OK:CCD_TRACE_DISABLED;
+            break;
+        case CCD_TRACE_READ:
+            if(traceMask)reply->status=CCD_TRACE_RUNNING;
+            else if(block>=CCD_TRACE_BLOCKS)reply->status=CCD_TRACE_BAD_REQUEST;
+            else
+            {
+                uint32_t kept=traceHead<CCD_TRACE_SIZE?traceHead:CCD_TRACE_SIZE;
+                uint32_t skip=(uint32_t)block*CCD_TRACE_BLOCK;         //of the kept entries, oldest first
+                for(uint32_t i=skip;i<kept&&reply->count<CCD_TRACE_BLOCK;i++)
+                    reply->entry[reply->count++]=traceRing[(traceHead-kept+i)&(CCD_TRACE_SIZE-1)];
+                reply->status=CCD_TRACE_OK;
+            }
+            break;
+        case CCD_TRACE_QUERY:
+            reply->status=TRACE_ENABLED?CCD_TRACE_OK:CCD_TRACE_DISABLED;
+            break;
+        default:
+            reply->status=CCD_TRACE_BAD_REQUEST;
+            break;
+    }
+    reply->running=traceMask!=0;
+    reply->mask=traceLastMask;
+    reply->written=traceHead;
+}
+
+/*******************************************************************************
+ End of File
+ */
@@ -0,0 +1,98 @@
+/*******************************************************************************
+  Event Trace Header File
+
+  File Name:
+    trace.h
+
+  Summary:
+    Ring of timestamped events from the interrupts and the main loop.
+
+  Description:
+    Trace points record an event (CCD_TRACE_xxx) with the CORETIMER and a
+    16-bit argument into a RAM ring, read out with the "TRC" command and
+    turned into a timeline on the host (ccdtool trace). A trace point is a
+    mask test while its event is off, and a mask test, an atomic slot
+    reservation and an 8-byte store while it is on; interrupts of any
+    priority can record without disabling interrupts.
+
+    TRACE_ENABLED 0 (e.g. -DTRACE_ENABLED=0) compiles every trace point
+    away, the "TRC" command then answers CCD_TRACE_DISABLED.
+ *******************************************************************************/
+
+#ifndef _TRACE_H
+#define _TRACE_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "device.h"
+#include "ccd_protocol.h"
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Type Definitions
+// *****************************************************************************
+// *****************************************************************************
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED           1
+#endif
+
+extern CCD_TRACE_ENTRY traceRing[CCD_TRACE_SIZE];
+extern uint32_t traceHead;              //events written since START
+extern volatile uint16_t traceMask;     //events recorded, 0 while stopped
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Functions
+// *****************************************************************************
+// *****************************************************************************
+uint8_t TRACE_Start(uint16_t mask);
+void TRACE_Stop(void);
+void TRACE_Command(uint8_t operation, uint8_t block, uint16_t mask, CCD_TRACE_REPLY *reply);
+
+//Records event at CORETIMER timestamp, for handlers that already read it
+static inline void TRACE_EventAt(uint8_t event, uint8_t phase, uint16_t arg, uint32_t timestamp)
+{
+#if TRACE_ENABLED
+    if(traceMask&(1u<<event))
+    {
+        CCD_TRACE_ENTRY *e=&traceRing[__atomic_fetch_add(&traceHead,1,__ATOMIC_RELAXED)&(CCD_TRACE_SIZE-1)];
+        e->timestamp=timestamp;
+        e->event=event;
+        e->phase=phase;
+        e->arg=arg;
+    }
+#endif
+}
+
+static inline void TRACE_Event(uint8_t event, uint8_t phase, uint16_t arg)
+{
+#if TRACE_ENABLED
+    TRACE_EventAt(event,phase,arg,_CP0_GET_COUNT());
+#endif
+}
+
+//DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+//DOM-IGNORE-END
+
+#endif /* _TRACE_H */
+
+/*******************************************************************************
+ End of File
+ */
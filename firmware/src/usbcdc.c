@@ -27,16 +27,33 @@
 // *****************************************************************************
 // *****************************************************************************
 
+#include <string.h>
 #include "usbcdc.h"
+#include "trace.h"
+#include "dmabuf.h"
+#include "arena.h"
 
 // *****************************************************************************
 // *****************************************************************************
 // Section: Global Data Definitions
 // *****************************************************************************
 // *****************************************************************************
-uint8_t CACHE_ALIGN cdcReadBuffer[USBCDC_READ_BUFFER_SIZE];
-uint8_t CACHE_ALIGN cdcWriteBuffer[USBCDC_READ_BUFFER_SIZE];
-uint8_t setupData[SETUP_DATA_SIZE];
+//read buffer coherent, write buffer cached in the frame arena and written through either view (dmabuf.h)
+uint8_t DMABUF_COHERENT cdcReadBuffer[USBCDC_READ_BUFFER_SIZE];
+uint8_t *cdcWriteBuffer;
+uint8_t setupData[SETUP_EXT_DATA_SIZE];
+uint8_t modeData[SETUP_DATA_SIZE];
+uint8_t calibrationData[SETUP_DATA_SIZE];
+uint8_t exposureData[SETUP_DATA_SIZE];
+uint8_t timingData[SETUP_EXT_DATA_SIZE];
+uint8_t clockData[SETUP_DATA_SIZE];
+uint8_t adcData[SETUP_DATA_SIZE];
+uint8_t phaseData[SETUP_DATA_SIZE];
+uint8_t linearityData[LINEARITY_DATA_SIZE];
+uint8_t irqData[SETUP_DATA_SIZE];
+uint8_t traceData[SETUP_DATA_SIZE];
+uint8_t bufData[SETUP_DATA_SIZE];
+uint8_t memData[SETUP_DATA_SIZE];
 
 // *****************************************************************************
 /* Application Data
@@ -76,6 +93,7 @@ USB_DEVICE_CDC_EVENT_RESPONSE USBCDC_USBDeviceCDCEventHandler
     USBCDC_DATA * usbcdcDataObject;
     USB_CDC_CONTROL_LINE_STATE * controlLineStateData;
     USB_DEVICE_CDC_EVENT_DATA_READ_COMPLETE * eventDataRead;
+    USB_DEVICE_CDC_EVENT_DATA_WRITE_COMPLETE * eventDataWrite;
     
     usbcdcDataObject = (USBCDC_DATA *)userData;
 
@@ -138,9 +156,13 @@ USB_DEVICE_CDC_EVENT_RESPONSE USBCDC_USBDeviceCDCEventHandler
             
             if(eventDataRead->status != USB_DEVICE_CDC_RESULT_ERROR)
             {
+                usbcdcDataObject->readTimestamp = CORETIMER_CounterGet();
                 usbcdcDataObject->isReadComplete = true;
                 
                 usbcdcDataObject->numBytesRead = eventDataRead->length; 
+                usbcdcDataObject->bytesReceived += eventDataRead->length;
+                usbcdcDataObject->commands++;
+                TRACE_Event(CCD_TRACE_USB_READ,CCD_TRACE_INSTANT,(uint16_t)eventDataRead->length);
             }
             break;
 
@@ -162,7 +184,18 @@ USB_DEVICE_CDC_EVENT_RESPONSE USBCDC_USBDeviceCDCEventHandler
 
             /* This means that the data write got completed. We can schedule
              * the next read. */
-
+            eventDataWrite = (USB_DEVICE_CDC_EVENT_DATA_WRITE_COMPLETE *)pData;
+
+            if(eventDataWrite->status != USB_DEVICE_CDC_RESULT_ERROR)
+                usbcdcDataObject->bytesSent += eventDataWrite->length;
+            TRACE_Event(CCD_TRACE_USB_WRITE,CCD_TRACE_END,(uint16_t)eventDataWrite->length);
+            if(usbcdcDataObject->writesPending&&--usbcdcDataObject->writesPending)
+                break;                          //the payload sent in place follows
+            if(usbcdcDataObject->zeroCopyData)  //no longer read, its owner may reuse it
+            {
+                usbcdcDataObject->zeroCopyData = NULL;
+                usbcdcDataObject->zeroCopySent();
+            }
             usbcdcDataObject->isWriteComplete = true;
             break;
 
@@ -276,6 +309,12 @@ bool USBCDC_StateReset(void)
         usbcdcData.writeTransferHandle = USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID;
         usbcdcData.isReadComplete = true;
         usbcdcData.isWriteComplete = true;
+        usbcdcData.writesPending = 0;
+        if(usbcdcData.zeroCopyData)        //write aborted, the payload is not read any more
+        {
+            usbcdcData.zeroCopyData = NULL;
+            usbcdcData.zeroCopySent();
+        }
         retVal = true;
     }
     else
@@ -334,30 +373,102 @@ void USBCDC_Initialize ( void )
     usbcdcData.cdcReadBuffer = &cdcReadBuffer[0];
 
     /* Set up the read buffer */
-    usbcdcData.cdcWriteBuffer = &cdcWriteBuffer[0];    
+    cdcWriteBuffer = ARENA_Alloc(CCD_MEM_TX, USBCDC_WRITE_BUFFER_SIZE);
+    usbcdcData.cdcWriteBuffer = DMABUF_Uncached(cdcWriteBuffer);
+    usbcdcData.writeCached = false;    
     
     /* Initialize number of bytes to send to Host */ 
     usbcdcData.numBytesToWrite = 0;
     
+    /* No payload sent in place, no write queued */ 
+    usbcdcData.zeroCopyData = NULL;
+    usbcdcData.zeroCopyLength = 0;
+    usbcdcData.zeroCopySent = NULL;
+    usbcdcData.zeroCopyTransferHandle = USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID;
+    usbcdcData.writesPending = 0;
+    
     /* Initialize the read request flag */
     usbcdcData.readRequest = false; 
     
     /* Initialize the setup request flag */ 
     usbcdcData.setupRequest = false;     
     
+    /* Initialize the frame request flag */ 
+    usbcdcData.frameRequest = false;     
+    
+    /* Initialize the mode request flag */ 
+    usbcdcData.modeRequest = false;     
+    
+    /* Initialize the calibration request flag */ 
+    usbcdcData.calibrationRequest = false;     
+    
+    /* Initialize the exposure request flag */ 
+    usbcdcData.exposureRequest = false;     
+    
+    /* Initialize the timing request flag */ 
+    usbcdcData.timingRequest = false;     
+    
+    /* Initialize the clock request flag */ 
+    usbcdcData.clockRequest = false;     
+    
+    /* Initialize the ADC request flag */ 
+    usbcdcData.adcRequest = false;     
+    
+    /* Initialize the phase request flag */ 
+    usbcdcData.phaseRequest = false;     
+    
+    /* Initialize the linearity request flag */ 
+    usbcdcData.linearityRequest = false;     
+    
+    /* Initialize the interrupt statistics request flag */ 
+    usbcdcData.irqRequest = false;     
+    
+    /* Initialize the status request flag */ 
+    usbcdcData.statusRequest = false;     
+    
+    /* Initialize the trace request flag */ 
+    usbcdcData.traceRequest = false;     
+    
+    /* Initialize the buffer placement request flag */ 
+    usbcdcData.bufRequest = false;     
+    
+    /* Initialize the memory request flag */ 
+    usbcdcData.memRequest = false;     
+    
+    /* Initialize the link counters */ 
+    usbcdcData.bytesSent = 0; 
+    usbcdcData.bytesReceived = 0; 
+    usbcdcData.commands = 0; 
+    
     /* Initialize the data ready  flag */ 
     usbcdcData.dataReady = false; 
     
     /* Initialize setup data */ 
     usbcdcData.setupData = &setupData[0]; 
+    usbcdcData.setupLength = SETUP_DATA_SIZE; 
+    usbcdcData.modeData = &modeData[0]; 
+    usbcdcData.calibrationData = &calibrationData[0]; 
+    usbcdcData.exposureData = &exposureData[0]; 
+    usbcdcData.timingData = &timingData[0]; 
+    usbcdcData.clockData = &clockData[0]; 
+    usbcdcData.adcData = &adcData[0]; 
+    usbcdcData.phaseData = &phaseData[0]; 
+    usbcdcData.linearityData = &linearityData[0]; 
+    usbcdcData.linearityLength = 0; 
+    usbcdcData.irqData = &irqData[0]; 
+    usbcdcData.traceData = &traceData[0]; 
+    usbcdcData.bufData = &bufData[0]; 
+    usbcdcData.memData = &memData[0]; 
 }
 /******************************************************************************/
-void USBCDC_GetSetupData(uint8_t *data)
+//Returns the number of setup bytes, SETUP_EXT_DATA_SIZE for the extended command
+uint8_t USBCDC_GetSetupData(uint8_t *data)
 {
-    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received setup data 
+    for(uint8_t i=0;i<usbcdcData.setupLength;i++)  //transfer received setup data 
         data[i]=usbcdcData.setupData[i];
     usbcdcData.setupRequest=0;              //setup request is processed, clear flag
     usbcdcData.dataReady=0;                 //invalidate data in cdcWriteBuffer
+    return usbcdcData.setupLength;
 }
 /******************************************************************************/
 uint8_t USBCDC_SetupRequest(void)
@@ -370,37 +481,342 @@ uint8_t USBCDC_ReadRequest(void)
     return usbcdcData.readRequest;
 }
 /******************************************************************************/
-void USBCDC_TrasferData(uint16_t *data, uint16_t len, uint8_t h_res, uint16_t v_res)
+uint8_t USBCDC_FrameRequest(void)
+{
+    return usbcdcData.frameRequest;
+}
+/******************************************************************************/
+void USBCDC_GetModeData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received mode data 
+        data[i]=usbcdcData.modeData[i];
+    usbcdcData.modeRequest=0;               //mode request is processed, clear flag
+    usbcdcData.dataReady=0;                 //invalidate data in cdcWriteBuffer
+}
+/******************************************************************************/
+uint8_t USBCDC_ModeRequest(void)
+{
+    return usbcdcData.modeRequest;
+}
+/******************************************************************************/
+void USBCDC_GetCalibrationData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received calibration data 
+        data[i]=usbcdcData.calibrationData[i];
+    usbcdcData.calibrationRequest=0;        //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_CalibrationRequest(void)
+{
+    return usbcdcData.calibrationRequest;
+}
+/******************************************************************************/
+void USBCDC_GetExposureData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received exposure data 
+        data[i]=usbcdcData.exposureData[i];
+    usbcdcData.exposureRequest=0;           //exposure request is processed, clear flag
+}
+/******************************************************************************/
+uint8_t USBCDC_ExposureRequest(void)
+{
+    return usbcdcData.exposureRequest;
+}
+/******************************************************************************/
+void USBCDC_GetTimingData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_EXT_DATA_SIZE;i++)  //transfer received timing data 
+        data[i]=usbcdcData.timingData[i];
+    usbcdcData.timingRequest=0;             //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_TimingRequest(void)
+{
+    return usbcdcData.timingRequest;
+}
+/******************************************************************************/
+void USBCDC_GetClockData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received clock data 
+        data[i]=usbcdcData.clockData[i];
+    usbcdcData.clockRequest=0;              //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_ClockRequest(void)
+{
+    return usbcdcData.clockRequest;
+}
+/******************************************************************************/
+void USBCDC_GetAdcData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received ADC data 
+        data[i]=usbcdcData.adcData[i];
+    usbcdcData.adcRequest=0;                //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_AdcRequest(void)
+{
+    return usbcdcData.adcRequest;
+}
+/******************************************************************************/
+void USBCDC_GetPhaseData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received phase data 
+        data[i]=usbcdcData.phaseData[i];
+    usbcdcData.phaseRequest=0;              //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_PhaseRequest(void)
+{
+    return usbcdcData.phaseRequest;
+}
+/******************************************************************************/
+//Returns the number of linearity bytes, LINEARITY_DATA_SIZE with a LOAD block
+uint16_t USBCDC_GetLinearityData(uint8_t *data)
+{
+    memcpy(data,usbcdcData.linearityData,usbcdcData.linearityLength);  //transfer received linearity data 
+    usbcdcData.linearityRequest=0;          //request is taken, reply follows with USBCDC_TrasferReply
+    return usbcdcData.linearityLength;
+}
+/******************************************************************************/
+uint8_t USBCDC_LinearityRequest(void)
+{
+    return usbcdcData.linearityRequest;
+}
+/******************************************************************************/
+void USBCDC_GetIrqData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received interrupt statistics data 
+        data[i]=usbcdcData.irqData[i];
+    usbcdcData.irqRequest=0;                //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_IrqRequest(void)
+{
+    return usbcdcData.irqRequest;
+}
+/******************************************************************************/
+//Adds the link counters to the "STA" reply, the main loop sends it with USBCDC_TrasferReply
+void USBCDC_StatusReport(CCD_STATUS_REPLY *reply)
+{
+    reply->usbBytesSent=usbcdcData.bytesSent;
+    reply->usbBytesReceived=usbcdcData.bytesReceived;
+    reply->usbCommands=usbcdcData.commands;
+    usbcdcData.statusRequest=0;             //request is taken
+}
+/******************************************************************************/
+uint8_t USBCDC_StatusRequest(void)
 {
+    return usbcdcData.statusRequest;
+}
+/******************************************************************************/
+void USBCDC_GetTraceData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received trace data 
+        data[i]=usbcdcData.traceData[i];
+    usbcdcData.traceRequest=0;              //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_TraceRequest(void)
+{
+    return usbcdcData.traceRequest;
+}
+/******************************************************************************/
+void USBCDC_GetBufData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received buffer placement data 
+        data[i]=usbcdcData.bufData[i];
+    usbcdcData.bufRequest=0;                //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_BufRequest(void)
+{
+    return usbcdcData.bufRequest;
+}
+/******************************************************************************/
+void USBCDC_GetMemoryData(uint8_t *data)
+{
+    for(uint8_t i=0;i<SETUP_DATA_SIZE;i++)  //transfer received memory data 
+        data[i]=usbcdcData.memData[i];
+    usbcdcData.memRequest=0;                //request is taken, reply follows with USBCDC_TrasferReply
+}
+/******************************************************************************/
+uint8_t USBCDC_MemoryRequest(void)
+{
+    return usbcdcData.memRequest;
+}
+/******************************************************************************/
+//Writes of cdcWriteBuffer go through the cached view (CCD_BUF_CACHED) or the
+//uncached alias (CCD_BUF_COHERENT). Only while no write is in flight, i.e. from
+//a deferred reply; the buffer is cleaned, so neither view leaves stale lines.
+uint8_t USBCDC_WritePlacement(uint8_t placement)
+{
+    if(placement!=CCD_BUF_COHERENT&&placement!=CCD_BUF_CACHED)return CCD_BUF_BAD_REQUEST;
+    DMABUF_Clean(cdcWriteBuffer,USBCDC_WRITE_BUFFER_SIZE);
+    usbcdcData.writeCached=placement==CCD_BUF_CACHED;
+    usbcdcData.cdcWriteBuffer=usbcdcData.writeCached?cdcWriteBuffer:DMABUF_Uncached(cdcWriteBuffer);
+    return CCD_BUF_OK;
+}
+/******************************************************************************/
+uint8_t USBCDC_WritePlacementGet(void)
+{
+    return usbcdcData.writeCached?CCD_BUF_CACHED:CCD_BUF_COHERENT;
+}
+/******************************************************************************/
+//Starts the USB write of the first len bytes of cdcWriteBuffer, a payload sent in
+//place is queued right behind them (cdcInit0.queueSizeWrite is 2)
+static void USBCDC_WriteStart(uint32_t len)
+{
+    if(usbcdcData.writeCached)DMABUF_Clean(cdcWriteBuffer,len);     //the DMA reads memory
+    usbcdcData.writesPending=usbcdcData.zeroCopyData?2:1;
+    TRACE_Event(CCD_TRACE_USB_WRITE,CCD_TRACE_BEGIN,(uint16_t)len);
+    USB_DEVICE_CDC_Write(USB_DEVICE_CDC_INDEX_0,
+    &usbcdcData.writeTransferHandle,
+    usbcdcData.cdcWriteBuffer, len,
+    USB_DEVICE_CDC_TRANSFER_FLAGS_DATA_COMPLETE);
+    if(usbcdcData.zeroCopyData==NULL)return;
+
+    TRACE_Event(CCD_TRACE_USB_WRITE,CCD_TRACE_BEGIN,usbcdcData.zeroCopyLength);
+    USB_DEVICE_CDC_Write(USB_DEVICE_CDC_INDEX_0,
+    &usbcdcData.zeroCopyTransferHandle,
+    usbcdcData.zeroCopyData, usbcdcData.zeroCopyLength,
+    USB_DEVICE_CDC_TRANSFER_FLAGS_DATA_COMPLETE);
+    if(usbcdcData.zeroCopyTransferHandle==USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID)
+    {
+        //not queued, the header goes alone and the host times out on the frame
+        bool state=SYS_INT_Disable();
+        usbcdcData.zeroCopyData=NULL;
+        usbcdcData.zeroCopySent();
+        if(--usbcdcData.writesPending==0)usbcdcData.isWriteComplete=true;
+        SYS_INT_Restore(state);
+    }
+}
+/******************************************************************************/
+//Reply to a deferred command (CAL, TIM, CLK, ADC, PHS, LIN, IRQ, STA, TRC, BUF, MEM)
+void USBCDC_TrasferReply(const void *data, uint16_t len)
+{
+    memcpy(usbcdcData.cdcWriteBuffer,data,len);
+    usbcdcData.numBytesToWrite=len;
+    usbcdcData.dataReady=1;
+}
+/******************************************************************************/
+//Formats CCD data into dst, returns number of bytes. fraction holds the low bits of
+//oversampled samples for v_res CCD_VRES_16BIT (NULL: none)
+static uint16_t USBCDC_PackData(uint8_t *dst, uint16_t *data, const uint8_t *fraction, uint16_t len, uint8_t h_res, uint16_t v_res)
+{
+    uint16_t n=0;
     switch(v_res)
     {
         case 0:
-            usbcdcData.numBytesToWrite=len>>h_res;
-            for(int i=0;i<usbcdcData.numBytesToWrite;i++)
-            usbcdcData.cdcWriteBuffer[i]=(uint8_t)(data[i<<h_res]>>6);
+            n=len>>h_res;
+            for(int i=0;i<n;i++)
+            dst[i]=(uint8_t)(data[i<<h_res]>>6);
             break;
         case 1:
-            usbcdcData.numBytesToWrite=len>>h_res;
-            for(int i=0;i<usbcdcData.numBytesToWrite;i++)
-            usbcdcData.cdcWriteBuffer[i]=(uint8_t)(data[i<<h_res]>>4);
+            n=len>>h_res;
+            for(int i=0;i<n;i++)
+            dst[i]=(uint8_t)(data[i<<h_res]>>4);
             break;
         case 2:
-            usbcdcData.numBytesToWrite=(len>>h_res)<<1;
-            for(int i=0;i<(usbcdcData.numBytesToWrite>>1);i++)
+            n=(len>>h_res)<<1;
+            for(int i=0;i<(n>>1);i++)
             {
-                usbcdcData.cdcWriteBuffer[(i<<1)]=(uint8_t)(data[i<<h_res]>>10);
-                usbcdcData.cdcWriteBuffer[(i<<1)+1]=(uint8_t)(data[i<<h_res]>>2);
+                dst[(i<<1)]=(uint8_t)(data[i<<h_res]>>10);
+                dst[(i<<1)+1]=(uint8_t)(data[i<<h_res]>>2);
             }
             break;
         case 3:
-            usbcdcData.numBytesToWrite=(len>>h_res)<<1;
-            for(int i=0;i<(usbcdcData.numBytesToWrite>>1);i++)
+            n=(len>>h_res)<<1;
+            for(int i=0;i<(n>>1);i++)
             {
-                usbcdcData.cdcWriteBuffer[(i<<1)]=(uint8_t)(data[i<<h_res]>>8);
-                usbcdcData.cdcWriteBuffer[(i<<1)+1]=(uint8_t)(data[i<<h_res]);
+                dst[(i<<1)]=(uint8_t)(data[i<<h_res]>>8);
+                dst[(i<<1)+1]=(uint8_t)(data[i<<h_res]);
             }
             break;         
+        case CCD_VRES_16BIT:
+            n=(len>>h_res)<<1;
+            for(int i=0;i<(n>>1);i++)
+            {
+                uint16_t v=(data[i<<h_res]<<CCD_FINE_SHIFT)|(fraction?fraction[i<<h_res]:0);
+                dst[(i<<1)]=(uint8_t)(v>>8);
+                dst[(i<<1)+1]=(uint8_t)v;
+            }
+            break;
+        case CCD_VRES_NATIVE:           //dst is 2-byte aligned
+            n=(len>>h_res)<<1;
+            for(int i=0;i<(n>>1);i++)
+                ((uint16_t *)dst)[i]=data[i<<h_res];
+            break;
     }
+    return n;
+}
+/******************************************************************************/
+void USBCDC_TrasferData(uint16_t *data, const uint8_t *fraction, uint16_t len, uint8_t h_res, uint16_t v_res)
+{
+    usbcdcData.numBytesToWrite=USBCDC_PackData(usbcdcData.cdcWriteBuffer,data,fraction,len,h_res,v_res);
+    usbcdcData.dataReady=1;
+}
+/******************************************************************************/
+void USBCDC_TrasferFrame(CCD_FRAME_HEADER *header, uint16_t *data, const uint8_t *fraction, uint16_t len)
+{
+    header->payloadLength=USBCDC_PackData(USBCDC_FramePayload(),data,fraction,len,header->hRes,header->vRes);
+    USBCDC_TrasferFramePayload(header);
+}
+/******************************************************************************/
+//CPU cycles to format a full frame of data at 12 bits into cdcWriteBuffer through
+//placement, cached including the clean; the fastest of a few runs. Only while no
+//write is in flight, what is packed is overwritten by the reply.
+uint32_t USBCDC_PackBench(uint16_t *data, uint8_t placement)
+{
+    uint8_t *dst=placement==CCD_BUF_CACHED?cdcWriteBuffer:DMABUF_Uncached(cdcWriteBuffer);
+    uint32_t best=UINT32_MAX;
+
+    DMABUF_Clean(cdcWriteBuffer,USBCDC_WRITE_BUFFER_SIZE);
+    for(uint8_t run=0;run<4;run++)
+    {
+        uint32_t start=CORETIMER_CounterGet();
+        uint16_t n=USBCDC_PackData(dst,data,NULL,CCD_DATA_SIZE,0,3);
+        if(placement==CCD_BUF_CACHED)DMABUF_Clean(cdcWriteBuffer,n);
+        uint32_t t=CORETIMER_CounterGet()-start;
+        if(t<best)best=t;
+    }
+    return best*2;      //CORETIMER runs at half the CPU clock
+}
+/******************************************************************************/
+//Payload area of the frame reply, 4-byte aligned, valid while a frame request is pending
+uint8_t *USBCDC_FramePayload(void)
+{
+    return usbcdcData.cdcWriteBuffer+sizeof(CCD_FRAME_HEADER);
+}
+/******************************************************************************/
+//Stores header at the start of cdcWriteBuffer
+static void USBCDC_FrameHeader(CCD_FRAME_HEADER *header)
+{
+    header->magic=CCD_FRAME_MAGIC;
+    header->version=CCD_FRAME_VERSION;
+    header->headerSize=sizeof(CCD_FRAME_HEADER);
+    memcpy(usbcdcData.cdcWriteBuffer,header,sizeof(CCD_FRAME_HEADER));
+}
+/******************************************************************************/
+//Sends header and header->payloadLength bytes already stored at USBCDC_FramePayload()
+void USBCDC_TrasferFramePayload(CCD_FRAME_HEADER *header)
+{
+    USBCDC_FrameHeader(header);
+    usbcdcData.numBytesToWrite=sizeof(CCD_FRAME_HEADER)+header->payloadLength;
+    usbcdcData.dataReady=1;
+}
+/******************************************************************************/
+//Sends header and the header->payloadLength bytes at payload without copying them.
+//payload starts on a cache line (dmabuf.h) and must not change until sent() is
+//called from the write-complete event; it is cleaned here, the USB DMA reads memory.
+void USBCDC_TrasferFrameZeroCopy(CCD_FRAME_HEADER *header, const void *payload, void (*sent)(void))
+{
+    DMABUF_Clean(payload,header->payloadLength);
+    USBCDC_FrameHeader(header);
+    usbcdcData.zeroCopyData=payload;
+    usbcdcData.zeroCopyLength=header->payloadLength;
+    usbcdcData.zeroCopySent=sent;
+    usbcdcData.numBytesToWrite=sizeof(CCD_FRAME_HEADER);
     usbcdcData.dataReady=1;
 }
 
@@ -413,6 +829,8 @@ void USBCDC_TrasferData(uint16_t *data, uint16_t len, uint8_t h_res, uint16_t v_
  */
 void USBCDC_Tasks ( void )
 {
+    static USBCDC_STATES traceState=USBCDC_STATE_INIT;
+
     /* Check the application's current state. */
     switch ( usbcdcData.state )
     {
@@ -500,6 +918,24 @@ void USBCDC_Tasks ( void )
                 usbcdcData.readRequest=1;       //initiate CCD data transfer to cdcWriteBuffer 
                 if(usbcdcData.dataReady)        //wait until CCD data transfer is finished
                 {
+                    usbcdcData.readRequest=0;   //cdcWriteBuffer must not change while it is sent
+                    usbcdcData.dataReady=0;
+                    usbcdcData.cdcReadBuffer[0]=0;
+
+                    usbcdcData.writeTransferHandle = USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID;
+                    usbcdcData.isWriteComplete = false;
+                    usbcdcData.state = USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE;
+
+                    USBCDC_WriteStart(usbcdcData.numBytesToWrite);
+                }
+            }
+            /* FRM -> read command, frame header and next new frame */
+            else if(usbcdcData.cdcReadBuffer[0]=='F'&&usbcdcData.cdcReadBuffer[1]=='R'&&usbcdcData.cdcReadBuffer[2]=='M')
+            {
+                usbcdcData.frameRequest=1;      //initiate frame transfer to cdcWriteBuffer 
+                if(usbcdcData.dataReady)        //wait until a new frame is transfered
+                {
+                    usbcdcData.frameRequest=0;
                     usbcdcData.dataReady=0;
                     usbcdcData.cdcReadBuffer[0]=0;
 
@@ -507,10 +943,7 @@ void USBCDC_Tasks ( void )
                     usbcdcData.isWriteComplete = false;
                     usbcdcData.state = USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE;
 
-                    USB_DEVICE_CDC_Write(USB_DEVICE_CDC_INDEX_0,
-                    &usbcdcData.writeTransferHandle,
-                    usbcdcData.cdcWriteBuffer, usbcdcData.numBytesToWrite,
-                    USB_DEVICE_CDC_TRANSFER_FLAGS_DATA_COMPLETE);
+                    USBCDC_WriteStart(usbcdcData.numBytesToWrite);
                 }
             }
             /* SET -> setup command */
@@ -525,18 +958,199 @@ void USBCDC_Tasks ( void )
                 usbcdcData.isWriteComplete = false;
                 usbcdcData.state = USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE;
 
-                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract setup data from cdcReadBuffer
+                //legacy SET carries 4 bytes, the extended one 8
+                usbcdcData.setupLength=usbcdcData.numBytesRead>=3+SETUP_EXT_DATA_SIZE?SETUP_EXT_DATA_SIZE:SETUP_DATA_SIZE;
+                for(uint8_t i=0;i<usbcdcData.setupLength;i++) //extract setup data from cdcReadBuffer
                 {
                     usbcdcData.setupData[i]=usbcdcData.cdcReadBuffer[i+3];
                     usbcdcData.cdcWriteBuffer[i]=usbcdcData.setupData[i];
                 }
 
-                USB_DEVICE_CDC_Write(USB_DEVICE_CDC_INDEX_0,
-                &usbcdcData.writeTransferHandle,
-                usbcdcData.cdcWriteBuffer, 4,
-                USB_DEVICE_CDC_TRANSFER_FLAGS_DATA_COMPLETE);
+                USBCDC_WriteStart(usbcdcData.setupLength);
 
             }
+            /* MOD -> output mode command */
+            else if(usbcdcData.cdcReadBuffer[0]=='M'&&usbcdcData.cdcReadBuffer[1]=='O'&&usbcdcData.cdcReadBuffer[2]=='D')
+            {
+
+                usbcdcData.modeRequest=1;
+
+                usbcdcData.cdcReadBuffer[0]=0;
+
+                usbcdcData.writeTransferHandle = USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID;
+                usbcdcData.isWriteComplete = false;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE;
+
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract mode data from cdcReadBuffer
+                {
+                    usbcdcData.modeData[i]=usbcdcData.cdcReadBuffer[i+3];
+                    usbcdcData.cdcWriteBuffer[i]=usbcdcData.modeData[i];
+                }
+
+                USBCDC_WriteStart(4);
+
+            }
+            /* EXP -> auto exposure command */
+            else if(usbcdcData.cdcReadBuffer[0]=='E'&&usbcdcData.cdcReadBuffer[1]=='X'&&usbcdcData.cdcReadBuffer[2]=='P')
+            {
+
+                usbcdcData.exposureRequest=1;
+
+                usbcdcData.cdcReadBuffer[0]=0;
+
+                usbcdcData.writeTransferHandle = USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID;
+                usbcdcData.isWriteComplete = false;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE;
+
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract exposure data from cdcReadBuffer
+                {
+                    usbcdcData.exposureData[i]=usbcdcData.cdcReadBuffer[i+3];
+                    usbcdcData.cdcWriteBuffer[i]=usbcdcData.exposureData[i];
+                }
+
+                USBCDC_WriteStart(4);
+
+            }
+            /* CAL -> calibration command, replied when the operation is done */
+            else if(usbcdcData.cdcReadBuffer[0]=='C'&&usbcdcData.cdcReadBuffer[1]=='A'&&usbcdcData.cdcReadBuffer[2]=='L')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract calibration data from cdcReadBuffer
+                    usbcdcData.calibrationData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.calibrationRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* TIM -> frame timing command, replied with the timing in effect */
+            else if(usbcdcData.cdcReadBuffer[0]=='T'&&usbcdcData.cdcReadBuffer[1]=='I'&&usbcdcData.cdcReadBuffer[2]=='M')
+            {
+                for(uint8_t i=0;i<SETUP_EXT_DATA_SIZE;i++) //extract timing data from cdcReadBuffer
+                    usbcdcData.timingData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.timingRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* CLK -> readout clock command, replied with the mode in effect */
+            else if(usbcdcData.cdcReadBuffer[0]=='C'&&usbcdcData.cdcReadBuffer[1]=='L'&&usbcdcData.cdcReadBuffer[2]=='K')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract clock data from cdcReadBuffer
+                    usbcdcData.clockData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.clockRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* ADC -> ADC cores command, replied when the operation is done */
+            else if(usbcdcData.cdcReadBuffer[0]=='A'&&usbcdcData.cdcReadBuffer[1]=='D'&&usbcdcData.cdcReadBuffer[2]=='C')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract ADC data from cdcReadBuffer
+                    usbcdcData.adcData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.adcRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* PHS -> sampling phase command, replied when the operation is done */
+            else if(usbcdcData.cdcReadBuffer[0]=='P'&&usbcdcData.cdcReadBuffer[1]=='H'&&usbcdcData.cdcReadBuffer[2]=='S')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract phase data from cdcReadBuffer
+                    usbcdcData.phaseData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.phaseRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* LIN -> ADC linearity table command, a LOAD carries a table block */
+            else if(usbcdcData.cdcReadBuffer[0]=='L'&&usbcdcData.cdcReadBuffer[1]=='I'&&usbcdcData.cdcReadBuffer[2]=='N')
+            {
+                usbcdcData.linearityLength=usbcdcData.numBytesRead<3+LINEARITY_DATA_SIZE?
+                                           (uint16_t)(usbcdcData.numBytesRead-3):LINEARITY_DATA_SIZE;
+                memcpy(usbcdcData.linearityData,&usbcdcData.cdcReadBuffer[3],usbcdcData.linearityLength);
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.linearityRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* IRQ -> interrupt latency histograms, replied from the main loop */
+            else if(usbcdcData.cdcReadBuffer[0]=='I'&&usbcdcData.cdcReadBuffer[1]=='R'&&usbcdcData.cdcReadBuffer[2]=='Q')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract interrupt statistics data from cdcReadBuffer
+                    usbcdcData.irqData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.irqRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* STA -> status counters, replied from the main loop */
+            else if(usbcdcData.cdcReadBuffer[0]=='S'&&usbcdcData.cdcReadBuffer[1]=='T'&&usbcdcData.cdcReadBuffer[2]=='A')
+            {
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.statusRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* TRC -> event trace, replied from the main loop */
+            else if(usbcdcData.cdcReadBuffer[0]=='T'&&usbcdcData.cdcReadBuffer[1]=='R'&&usbcdcData.cdcReadBuffer[2]=='C')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract trace data from cdcReadBuffer
+                    usbcdcData.traceData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.traceRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* BUF -> buffer placement, replied from the main loop */
+            else if(usbcdcData.cdcReadBuffer[0]=='B'&&usbcdcData.cdcReadBuffer[1]=='U'&&usbcdcData.cdcReadBuffer[2]=='F')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract buffer placement data from cdcReadBuffer
+                    usbcdcData.bufData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.bufRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* MEM -> frame arena use, replied from the main loop */
+            else if(usbcdcData.cdcReadBuffer[0]=='M'&&usbcdcData.cdcReadBuffer[1]=='E'&&usbcdcData.cdcReadBuffer[2]=='M')
+            {
+                for(uint8_t i=0;i<SETUP_DATA_SIZE;i++) //extract memory data from cdcReadBuffer
+                    usbcdcData.memData[i]=usbcdcData.cdcReadBuffer[i+3];
+
+                usbcdcData.cdcReadBuffer[0]=0;
+                usbcdcData.dataReady=0;
+                usbcdcData.memRequest=1;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_REPLY;
+            }
+            /* SYN -> time synchronization, host time echoed with receive and transmit timestamps */
+            else if(usbcdcData.cdcReadBuffer[0]=='S'&&usbcdcData.cdcReadBuffer[1]=='Y'&&usbcdcData.cdcReadBuffer[2]=='N')
+            {
+                CCD_SYNC_REPLY reply;
+
+                usbcdcData.cdcReadBuffer[0]=0;
+
+                usbcdcData.writeTransferHandle = USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID;
+                usbcdcData.isWriteComplete = false;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE;
+
+                //a short request echoes 0, not what an earlier command left in the buffer
+                if(usbcdcData.numBytesRead>=3+CCD_SYNC_DATA_SIZE)
+                    memcpy(&reply.hostTimestamp,&usbcdcData.cdcReadBuffer[3],CCD_SYNC_DATA_SIZE);
+                else reply.hostTimestamp=0;
+                reply.rxTimestamp=usbcdcData.readTimestamp;
+                reply.txTimestamp=CORETIMER_CounterGet();
+                memcpy(usbcdcData.cdcWriteBuffer,&reply,sizeof(reply));
+
+                USBCDC_WriteStart(sizeof(reply));
+            }
             else usbcdcData.state = USBCDC_STATE_SCHEDULE_READ;
 
             break;
@@ -553,17 +1167,41 @@ void USBCDC_Tasks ( void )
 
             if(usbcdcData.isWriteComplete == true)
             {
-                usbcdcData.readRequest=0; // clear read request flag
                 usbcdcData.state = USBCDC_STATE_SCHEDULE_READ;
             }
 
             break;
 
+        case USBCDC_STATE_WAIT_FOR_REPLY:
+
+            if(USBCDC_StateReset())
+            {
+                break;
+            }
+
+            if(usbcdcData.dataReady)            //reply stored by USBCDC_TrasferReply
+            {
+                usbcdcData.dataReady=0;
+
+                usbcdcData.writeTransferHandle = USB_DEVICE_CDC_TRANSFER_HANDLE_INVALID;
+                usbcdcData.isWriteComplete = false;
+                usbcdcData.state = USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE;
+
+                USBCDC_WriteStart(usbcdcData.numBytesToWrite);
+            }
+
+            break;
+
         case USBCDC_STATE_ERROR:
         default:
             
             break;
     }
+    if(usbcdcData.state!=traceState)   //state changes on the trace timeline
+    {
+        traceState=usbcdcData.state;
+        TRACE_Event(CCD_TRACE_USB_STATE,CCD_TRACE_INSTANT,traceState);
+    }
 }
 
 
@@ -33,6 +33,7 @@
 #include <stdlib.h>
 #include "configuration.h"
 #include "definitions.h"
+#include "ccd_protocol.h"
 // DOM-IGNORE-BEGIN
 #ifdef __cplusplus  // Provide C++ Compatibility
 
@@ -49,6 +50,8 @@ extern "C" {
 #define USBCDC_READ_BUFFER_SIZE                                8192
 #define USBCDC_WRITE_BUFFER_SIZE                               8192    
 #define SETUP_DATA_SIZE                                         4    
+#define SETUP_EXT_DATA_SIZE                                     8       //SET with the integration time in timer ticks
+#define LINEARITY_DATA_SIZE                                     (SETUP_DATA_SIZE+2*CCD_LIN_BLOCK)  //LIN with a LOAD block
 // *****************************************************************************
 /* Application states
 
@@ -83,6 +86,9 @@ typedef enum
     /* Wait for the write to complete */
     USBCDC_STATE_WAIT_FOR_WRITE_COMPLETE,
 
+    /* Wait for the application to prepare a deferred reply */
+    USBCDC_STATE_WAIT_FOR_REPLY,
+
     /* Application Error state*/
     USBCDC_STATE_ERROR
             
@@ -146,6 +152,9 @@ typedef struct
     /* Number of bytes read from Host */ 
     uint32_t numBytesRead; 
     
+    /* CORETIMER when the last read completed (SYN receive timestamp) */ 
+    uint32_t readTimestamp; 
+    
     /* Number of bytes to send to Host */ 
     uint16_t numBytesToWrite;
     
@@ -155,11 +164,118 @@ typedef struct
     /* Setup request flag (true if SET command is received from Host) */ 
     bool setupRequest;  
     
+    /* Frame request flag (true if FRM command is received from Host) */ 
+    bool frameRequest;  
+    
+    /* Mode request flag (true if MOD command is received from Host) */ 
+    bool modeRequest;  
+    
+    /* Calibration request flag (true if CAL command is received from Host) */ 
+    bool calibrationRequest;  
+    
+    /* Exposure request flag (true if EXP command is received from Host) */ 
+    bool exposureRequest;  
+    
+    /* Timing request flag (true if TIM command is received from Host) */ 
+    bool timingRequest;  
+    
+    /* Clock request flag (true if CLK command is received from Host) */ 
+    bool clockRequest;  
+    
+    /* ADC request flag (true if ADC command is received from Host) */ 
+    bool adcRequest;  
+    
+    /* Phase request flag (true if PHS command is received from Host) */ 
+    bool phaseRequest;  
+    
+    /* Linearity request flag (true if LIN command is received from Host) */ 
+    bool linearityRequest;  
+    
+    /* Interrupt statistics request flag (true if IRQ command is received from Host) */ 
+    bool irqRequest;  
+    
+    /* Status request flag (true if STA command is received from Host) */ 
+    bool statusRequest;  
+    
+    /* Trace request flag (true if TRC command is received from Host) */ 
+    bool traceRequest;  
+    
+    /* Buffer placement request flag (true if BUF command is received from Host) */ 
+    bool bufRequest;  
+    
+    /* Memory request flag (true if MEM command is received from Host) */ 
+    bool memRequest;  
+    
+    /* True while cdcWriteBuffer is the cached view, cleaned before every write */ 
+    bool writeCached;  
+    
     /* Data ready flag (true if CCD data are transfered to cdcWriteBuffer) */ 
     bool dataReady; 
     
      /* Data ready request flag (true if SET command is received from Host) */ 
     uint8_t *setupData;    
+    
+    /* Number of setup bytes received, SETUP_DATA_SIZE or SETUP_EXT_DATA_SIZE */ 
+    uint8_t setupLength;    
+    
+    /* Mode data received with MOD command */ 
+    uint8_t *modeData;    
+    
+    /* Calibration data received with CAL command */ 
+    uint8_t *calibrationData;    
+    
+    /* Exposure data received with EXP command */ 
+    uint8_t *exposureData;    
+    
+    /* Timing data received with TIM command */ 
+    uint8_t *timingData;    
+    
+    /* Clock data received with CLK command */ 
+    uint8_t *clockData;    
+    
+    /* ADC data received with ADC command */ 
+    uint8_t *adcData;    
+    
+    /* Phase data received with PHS command */ 
+    uint8_t *phaseData;    
+    
+    /* Linearity data received with LIN command, a table block after the 4 bytes */ 
+    uint8_t *linearityData;    
+    
+    /* Number of linearity bytes received, up to LINEARITY_DATA_SIZE */ 
+    uint16_t linearityLength;    
+    
+    /* Interrupt statistics data received with IRQ command */ 
+    uint8_t *irqData;    
+    
+    /* Trace data received with TRC command */ 
+    uint8_t *traceData;    
+    
+    /* Buffer placement data received with BUF command */ 
+    uint8_t *bufData;    
+    
+    /* Memory data received with MEM command */ 
+    uint8_t *memData;    
+    
+    /* Frame payload sent in place behind the header in cdcWriteBuffer, NULL if none */ 
+    const void *zeroCopyData;    
+    uint16_t zeroCopyLength;    
+    
+    /* Called from the write-complete event once zeroCopyData is sent */ 
+    void (*zeroCopySent)(void);    
+    
+    /* Writes queued and not complete yet, 2 while a frame is sent in place */ 
+    uint8_t writesPending;    
+    
+    /* Write Transfer Handle of the payload sent in place */
+    USB_DEVICE_CDC_TRANSFER_HANDLE zeroCopyTransferHandle;
+    
+    /* Bytes sent to and received from Host since power up ("STA") */ 
+    uint32_t bytesSent;    
+    uint32_t bytesReceived;    
+    
+    /* Reads completed since power up, a command each ("STA") */ 
+    uint32_t commands;    
      
 } USBCDC_DATA;
 
@@ -176,10 +292,45 @@ typedef struct
 // Section: Application Initialization and State Machine Functions
 // *****************************************************************************
 // *****************************************************************************
-void USBCDC_GetSetupData(uint8_t *data);
+uint8_t USBCDC_GetSetupData(uint8_t *data);
 uint8_t USBCDC_SetupRequest(void);
 uint8_t USBCDC_ReadRequest(void);
-void USBCDC_TrasferData(uint16_t *data, uint16_t len, uint8_t h_res, uint16_t v_res);
+uint8_t USBCDC_FrameRequest(void);
+void USBCDC_GetModeData(uint8_t *data);
+uint8_t USBCDC_ModeRequest(void);
+void USBCDC_GetCalibrationData(uint8_t *data);
+uint8_t USBCDC_CalibrationRequest(void);
+void USBCDC_TrasferReply(const void *data, uint16_t len);
+void USBCDC_GetExposureData(uint8_t *data);
+uint8_t USBCDC_ExposureRequest(void);
+void USBCDC_GetTimingData(uint8_t *data);
+uint8_t USBCDC_TimingRequest(void);
+void USBCDC_GetClockData(uint8_t *data);
+uint8_t USBCDC_ClockRequest(void);
+void USBCDC_GetAdcData(uint8_t *data);
+uint8_t USBCDC_AdcRequest(void);
+void USBCDC_GetPhaseData(uint8_t *data);
+uint8_t USBCDC_PhaseRequest(void);
+uint16_t USBCDC_GetLinearityData(uint8_t *data);
+uint8_t USBCDC_LinearityRequest(void);
+void USBCDC_GetIrqData(uint8_t *data);
+uint8_t USBCDC_IrqRequest(void);
+void USBCDC_StatusReport(CCD_STATUS_REPLY *reply);
+uint8_t USBCDC_StatusRequest(void);
+void USBCDC_GetTraceData(uint8_t *data);
+uint8_t USBCDC_TraceRequest(void);
+void USBCDC_GetBufData(uint8_t *data);
+uint8_t USBCDC_BufRequest(void);
+uint8_t USBCDC_WritePlacement(uint8_t placement);
+uint8_t USBCDC_WritePlacementGet(void);
+uint32_t USBCDC_PackBench(uint16_t *data, uint8_t placement);
+void USBCDC_GetMemoryData(uint8_t *data);
+uint8_t USBCDC_MemoryRequest(void);
+void USBCDC_TrasferData(uint16_t *data, const uint8_t *fraction, uint16_t len, uint8_t h_res, uint16_t v_res);
+void USBCDC_TrasferFrame(CCD_FRAME_HEADER *header, uint16_t *data, const uint8_t *fraction, uint16_t len);
+uint8_t *USBCDC_FramePayload(void);
+void USBCDC_TrasferFramePayload(CCD_FRAME_HEADER *header);
+void USBCDC_TrasferFrameZeroCopy(CCD_FRAME_HEADER *header, const void *payload, void (*sent)(void));
 /*******************************************************************************
   Function:
     void USBCDC_Initialize ( void )
@@ -0,0 +1,325 @@
+/*******************************************************************************
+  CCD Multi-Device Acquisition Source File
+
+  File Name:
+    ccd_acq.c
+
+  Summary:
+    Concurrent acquisition from several sensors with time-aligned frame sets.
+ *******************************************************************************/
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ccd_acq.h"
+#include "ccd_serial.h"
+
+/******************************************************************************/
+static void CCDACQ_Fail(CCDACQ_DEVICE *d)
+{
+    CCDACQ *a=d->acq;
+
+    pthread_mutex_lock(&a->lock);
+    d->error=errno;
+    pthread_cond_broadcast(&a->cond);
+    pthread_mutex_unlock(&a->lock);
+}
+/******************************************************************************/
+static int CCDACQ_Sync(CCDACQ_DEVICE *d)
+{
+    CCDACQ *a=d->acq;
+    CCD_SYNC_REPLY reply;
+    uint64_t tx, rx;
+
+    if(CCDSERIAL_Sync(d->fd,&tx,&reply,&rx))
+    {
+        //a lost or stale reply is drained, the next pass tries again
+        if((errno==ETIMEDOUT||errno==EPROTO)&&++d->syncFailures<CCDACQ_SYNC_RETRIES)return 0;
+        CCDACQ_Fail(d);
+        return -1;
+    }
+    CCDCLOCK_Sync(&d->clock,tx,&reply,rx);
+    d->nextSync=rx+CCDACQ_SYNC_INTERVAL_NS;
+    d->syncFailures=0;
+
+    pthread_mutex_lock(&a->lock);
+    d->stats.syncs++;
+    d->stats.clockError=d->clock.error;
+    d->stats.drift=d->clock.drift;
+    pthread_mutex_unlock(&a->lock);
+    return 0;
+}
+/******************************************************************************/
+static void *CCDACQ_Reader(void *arg)
+{
+    CCDACQ_DEVICE *d=arg;
+    CCDACQ *a=d->acq;
+    CCDACQ_FRAME *f=&d->rx;
+    int pending=0;                      //"FRM" sent, its reply not read yet
+    uint64_t interval=0;                //ns, between the last two frames
+
+    for(unsigned i=0;i<CCDACQ_SYNC_BURST&&!a->stop;i++)
+        if(CCDACQ_Sync(d))return NULL;
+
+    while(!a->stop)
+    {
+        if(!pending)
+        {
+            if(CCDSERIAL_TimeNs()>=d->nextSync&&CCDACQ_Sync(d))break;
+            if(CCDSERIAL_Write(d->fd,"FRM",CCD_COMMAND_SIZE))
+            {
+                CCDACQ_Fail(d);
+                break;
+            }
+            pending=1;
+        }
+        //the device replies whenever its next frame is done, frame periods and
+        //integration times may be longer than the timeout: nothing else goes out
+        //before the reply, the timeout only lets a stop through
+        if(CCDSERIAL_ReadFrame(d->fd,&f->header,f->payload,sizeof(f->payload),CCDSERIAL_FRAME_TIMEOUT_MS))
+        {
+            if(errno==ETIMEDOUT)continue;
+            CCDACQ_Fail(d);
+            break;
+        }
+        pending=0;
+        if(d->stats.frames)interval=CCDSERIAL_TimeNs()-f->rxTime;
+        f->rxTime=CCDSERIAL_TimeNs();
+        f->deviceTicks=CCDCLOCK_Unwrap(&d->clock,f->header.timestamp);
+        CCDCLOCK_Observe(&d->clock,f->deviceTicks,f->rxTime);
+        f->timestamp=CCDCLOCK_ToHost(&d->clock,f->deviceTicks,&f->timestampError);
+
+        pthread_mutex_lock(&a->lock);
+        d->stats.frames++;
+        d->stats.bytes+=f->header.payloadLength;
+        if(d->haveSequence)
+        {
+            uint32_t gap=f->header.sequence-d->lastSequence-1;
+            if(a->change)d->stats.unchanged+=gap;
+            else d->stats.sequenceDrops+=gap;
+        }
+        d->lastSequence=f->header.sequence;
+        d->haveSequence=1;
+        if(d->count==CCDACQ_QUEUE_DEPTH)
+            d->stats.queueDrops++;
+        else
+        {
+            CCDACQ_FRAME *q=&d->queue[(d->head+d->count)%CCDACQ_QUEUE_DEPTH];
+            memcpy(q,f,offsetof(CCDACQ_FRAME,payload)+f->header.payloadLength);
+            d->count++;
+            pthread_cond_broadcast(&a->cond);
+        }
+        pthread_mutex_unlock(&a->lock);
+    }
+    //a reply still owed would be taken for the reply to the next command on the link
+    if(pending&&!d->error)
+        CCDSERIAL_ReadFrame(d->fd,&f->header,f->payload,sizeof(f->payload),
+                            CCDSERIAL_FRAME_TIMEOUT_MS+(int)(interval/1000000u));
+    return NULL;
+}
+/******************************************************************************/
+int CCDACQ_Open(CCDACQ *a, const char *const *paths, unsigned count, uint64_t tolerance)
+{
+    memset(a,0,sizeof(*a));
+    if(!count||count>CCDACQ_MAX_DEVICES)
+    {
+        errno=EINVAL;
+        return -1;
+    }
+    a->device=calloc(count,sizeof(CCDACQ_DEVICE));
+    if(!a->device)return -1;
+    a->tolerance=tolerance;
+    pthread_mutex_init(&a->lock,NULL);
+    pthread_cond_init(&a->cond,NULL);
+    for(unsigned i=0;i<count;i++)a->device[i].fd=-1;
+
+    for(a->count=0;a->count<count;a->count++)
+    {
+        CCDACQ_DEVICE *d=&a->device[a->count];
+        d->acq=a;
+        d->path=paths[a->count];
+        d->index=a->count;
+        CCDCLOCK_Init(&d->clock);
+        d->fd=CCDSERIAL_Open(d->path);
+        if(d->fd<0)
+        {
+            int e=errno;
+            CCDACQ_Close(a);
+            errno=e;
+            return -1;
+        }
+    }
+    return 0;
+}
+/******************************************************************************/
+int CCDACQ_Setup(CCDACQ *a, uint32_t integrationTime, uint8_t hRes, uint8_t vRes)
+{
+    for(unsigned i=0;i<a->count;i++)
+        if(CCDSERIAL_Setup(a->device[i].fd,integrationTime,hRes,vRes))return -1;
+    return 0;
+}
+/******************************************************************************/
+//Same timing on every device, fails with EINVAL if one rejects it (reply tells why)
+int CCDACQ_Timing(CCDACQ *a, uint32_t integrationTime, uint32_t framePeriod, CCD_TIMING_REPLY *reply)
+{
+    for(unsigned i=0;i<a->count;i++)
+    {
+        if(CCDSERIAL_Timing(a->device[i].fd,integrationTime,framePeriod,reply))return -1;
+        if(reply->status!=CCD_TIMING_OK)
+        {
+            errno=EINVAL;
+            return -1;
+        }
+    }
+    return 0;
+}
+/******************************************************************************/
+int CCDACQ_Mode(CCDACQ *a, uint8_t mode, uint8_t options, uint16_t parameter)
+{
+    for(unsigned i=0;i<a->count;i++)
+        if(CCDSERIAL_Mode(a->device[i].fd,mode,options,parameter))return -1;
+    a->change=mode==CCD_MODE_CHANGE;
+    return 0;
+}
+/******************************************************************************/
+int CCDACQ_Exposure(CCDACQ *a, uint8_t options, uint16_t maximum, uint16_t setpoint)
+{
+    for(unsigned i=0;i<a->count;i++)
+        if(CCDSERIAL_Exposure(a->device[i].fd,options,maximum,setpoint))return -1;
+    return 0;
+}
+/******************************************************************************/
+int CCDACQ_Start(CCDACQ *a)
+{
+    for(unsigned i=0;i<a->count;i++)
+    {
+        int e=pthread_create(&a->device[i].thread,NULL,CCDACQ_Reader,&a->device[i]);
+        if(e)
+        {
+            errno=e;
+            return -1;
+        }
+        a->device[i].running=1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//Returns 1 with an aligned set, 0 on timeout, -1 if a device failed.
+int CCDACQ_Next(CCDACQ *a, CCDACQ_SET *set, int timeoutMs)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME,&deadline);
+    deadline.tv_sec+=timeoutMs/1000;
+    deadline.tv_nsec+=(long)(timeoutMs%1000)*1000000L;
+    if(deadline.tv_nsec>=1000000000L)
+    {
+        deadline.tv_sec++;
+        deadline.tv_nsec-=1000000000L;
+    }
+
+    pthread_mutex_lock(&a->lock);
+    for(;;)
+    {
+        unsigned ready=0;
+        uint64_t newest=0;
+
+        for(unsigned i=0;i<a->count;i++)
+        {
+            CCDACQ_DEVICE *d=&a->device[i];
+            if(d->error)
+            {
+                pthread_mutex_unlock(&a->lock);
+                errno=d->error;
+                return -1;
+            }
+            if(!d->count)continue;
+            ready++;
+            if(d->queue[d->head].timestamp>newest)newest=d->queue[d->head].timestamp;
+        }
+
+        if(ready==a->count)
+        {
+            /* Heads with no partner near the newest head are dropped */
+            unsigned dropped=0;
+            for(unsigned i=0;i<a->count;i++)
+            {
+                CCDACQ_DEVICE *d=&a->device[i];
+                if(d->queue[d->head].timestamp+a->tolerance<newest)
+                {
+                    d->head=(d->head+1)%CCDACQ_QUEUE_DEPTH;
+                    d->count--;
+                    d->stats.unmatched++;
+                    dropped++;
+                }
+            }
+            if(!dropped)break;
+            continue;
+        }
+
+        if(pthread_cond_timedwait(&a->cond,&a->lock,&deadline)==ETIMEDOUT)
+        {
+            pthread_mutex_unlock(&a->lock);
+            return 0;
+        }
+    }
+
+    uint64_t oldest=UINT64_MAX, newest=0, sum=0;
+    set->count=a->count;
+    for(unsigned i=0;i<a->count;i++)
+    {
+        CCDACQ_DEVICE *d=&a->device[i];
+        const CCDACQ_FRAME *f=&d->queue[d->head];
+        set->frame[i]=f;
+        if(f->timestamp<oldest)oldest=f->timestamp;
+        if(f->timestamp>newest)newest=f->timestamp;
+        sum+=f->timestamp-set->frame[0]->timestamp;
+    }
+    set->sequence=set->frame[0]->header.sequence;
+    set->timestamp=set->frame[0]->timestamp+sum/a->count;
+    set->spread=newest-oldest;
+
+    a->align.sets++;
+    a->align.spreadSum+=set->spread;
+    if(set->spread>a->align.spreadMax)a->align.spreadMax=set->spread;
+    pthread_mutex_unlock(&a->lock);
+    return 1;
+}
+/******************************************************************************/
+void CCDACQ_Release(CCDACQ *a, CCDACQ_SET *set)
+{
+    pthread_mutex_lock(&a->lock);
+    for(unsigned i=0;i<set->count;i++)
+    {
+        CCDACQ_DEVICE *d=&a->device[i];
+        d->head=(d->head+1)%CCDACQ_QUEUE_DEPTH;
+        d->count--;
+    }
+    set->count=0;
+    pthread_mutex_unlock(&a->lock);
+}
+/******************************************************************************/
+void CCDACQ_Stats(CCDACQ *a, CCDACQ_DEVICE_STATS *device, CCDACQ_ALIGN_STATS *align)
+{
+    pthread_mutex_lock(&a->lock);
+    if(device)
+        for(unsigned i=0;i<a->count;i++)device[i]=a->device[i].stats;
+    if(align)*align=a->align;
+    pthread_mutex_unlock(&a->lock);
+}
+/******************************************************************************/
+void CCDACQ_Close(CCDACQ *a)
+{
+    a->stop=1;
+    for(unsigned i=0;i<a->count;i++)
+        if(a->device[i].running)pthread_join(a->device[i].thread,NULL);
+    for(unsigned i=0;i<a->count;i++)
+        CCDSERIAL_Close(a->device[i].fd);
+    pthread_mutex_destroy(&a->lock);
+    pthread_cond_destroy(&a->cond);
+    free(a->device);
+    a->device=NULL;
+    a->count=0;
+}
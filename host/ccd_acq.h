@@ -0,0 +1,140 @@
+/*******************************************************************************
+  CCD Multi-Device Acquisition Header File
+
+  File Name:
+    ccd_acq.h
+
+  Summary:
+    Concurrent acquisition from several sensors with time-aligned frame sets.
+
+  Description:
+    Every device is served by its own reader thread that requests frames with
+    "FRM", maps the device timestamp into the host time domain (ccd_clock.h)
+    and queues the frame. Between frames the thread runs a "SYN" exchange
+    every CCDACQ_SYNC_INTERVAL_NS (a short burst at start) to track offset
+    and drift of the device clock. A "SYN" never goes out while a frame
+    reply is owed, however long the device takes to finish the frame.
+    CCDACQ_Next merges the queue heads of all devices into a set whose
+    timestamps agree within the alignment tolerance; a head that is older
+    than the newest head by more than the tolerance has no partner on the
+    other devices and is dropped.
+
+    Frames of a set returned by CCDACQ_Next stay valid until CCDACQ_Release,
+    the reader threads keep filling the queues meanwhile. When a queue is
+    full, incoming frames of that device are dropped and counted.
+ *******************************************************************************/
+
+#ifndef _CCD_ACQ_H
+#define _CCD_ACQ_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#include "ccd_clock.h"
+#include "ccd_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCDACQ_MAX_DEVICES      8
+#define CCDACQ_QUEUE_DEPTH      16
+#define CCDACQ_PAYLOAD_MAX      (CCD_DATA_SIZE*2)
+#define CCDACQ_SYNC_INTERVAL_NS 1000000000u
+#define CCDACQ_SYNC_BURST       8           //exchanges before the first frame
+#define CCDACQ_SYNC_RETRIES     8           //failed exchanges in a row that end the reader
+
+typedef struct
+{
+    CCD_FRAME_HEADER    header;
+    uint64_t            deviceTicks;        //unwrapped device timestamp
+    uint64_t            timestamp;          //ns, device timestamp mapped to host time
+    int64_t             timestampError;     //ns, bound of timestamp (CCDCLOCK_UNBOUNDED if not synced)
+    uint64_t            rxTime;             //ns, host time when the frame was received
+    uint8_t             payload[CCDACQ_PAYLOAD_MAX];
+} CCDACQ_FRAME;
+
+typedef struct
+{
+    uint64_t    frames;                     //frames received
+    uint64_t    bytes;                      //payload bytes received
+    uint64_t    sequenceDrops;              //frames skipped by the device (sequence gaps)
+    uint64_t    unchanged;                  //frames held back by CCD_MODE_CHANGE (its sequence gaps)
+    uint64_t    queueDrops;                 //frames dropped because the queue was full
+    uint64_t    unmatched;                  //frames dropped by the merger (no partner)
+    uint64_t    syncs;                      //time synchronization exchanges
+    int64_t     clockError;                 //ns, current bound of mapped timestamps
+    double      drift;                      //device clock rate error, see CCDCLOCK.drift
+} CCDACQ_DEVICE_STATS;
+
+typedef struct CCDACQ CCDACQ;
+
+typedef struct
+{
+    CCDACQ              *acq;
+    const char          *path;
+    int                 fd;
+    unsigned            index;
+    pthread_t           thread;
+    int                 running;            //reader thread was started
+    int                 error;              //errno of the failure that stopped the reader
+
+    /* Reader thread only */
+    CCDCLOCK            clock;
+    CCDACQ_FRAME        rx;
+    uint32_t            lastSequence;
+    int                 haveSequence;
+    uint64_t            nextSync;           //ns, host time of the next "SYN"
+    unsigned            syncFailures;       //exchanges in a row without a valid reply
+
+    /* Protected by CCDACQ.lock */
+    CCDACQ_FRAME        queue[CCDACQ_QUEUE_DEPTH];
+    unsigned            head;
+    unsigned            count;
+    CCDACQ_DEVICE_STATS stats;
+} CCDACQ_DEVICE;
+
+typedef struct
+{
+    const CCDACQ_FRAME  *frame[CCDACQ_MAX_DEVICES]; //indexed by device
+    unsigned            count;
+    uint32_t            sequence;           //sequence number of the first device's frame
+    uint64_t            timestamp;          //ns, mean of the frame timestamps
+    uint64_t            spread;             //ns, newest minus oldest frame timestamp
+} CCDACQ_SET;
+
+typedef struct
+{
+    uint64_t    sets;
+    uint64_t    spreadSum;                  //ns
+    uint64_t    spreadMax;                  //ns
+} CCDACQ_ALIGN_STATS;
+
+struct CCDACQ
+{
+    CCDACQ_DEVICE       *device;
+    unsigned            count;
+    uint64_t            tolerance;          //ns
+    volatile int        stop;
+    int                 change;             //CCD_MODE_CHANGE selected, gaps are unchanged frames
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    CCDACQ_ALIGN_STATS  align;
+};
+
+int CCDACQ_Open(CCDACQ *a, const char *const *paths, unsigned count, uint64_t tolerance);
+int CCDACQ_Setup(CCDACQ *a, uint32_t integrationTime, uint8_t hRes, uint8_t vRes);
+int CCDACQ_Timing(CCDACQ *a, uint32_t integrationTime, uint32_t framePeriod, CCD_TIMING_REPLY *reply);
+int CCDACQ_Mode(CCDACQ *a, uint8_t mode, uint8_t options, uint16_t parameter);
+int CCDACQ_Exposure(CCDACQ *a, uint8_t options, uint16_t maximum, uint16_t setpoint);
+int CCDACQ_Start(CCDACQ *a);
+int CCDACQ_Next(CCDACQ *a, CCDACQ_SET *set, int timeoutMs);
+void CCDACQ_Release(CCDACQ *a, CCDACQ_SET *set);
+void CCDACQ_Stats(CCDACQ *a, CCDACQ_DEVICE_STATS *device, CCDACQ_ALIGN_STATS *align);
+void CCDACQ_Close(CCDACQ *a);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_ACQ_H */
@@ -0,0 +1,132 @@
+/*******************************************************************************
+  CCD Clock Mapping Source File
+
+  File Name:
+    ccd_clock.c
+
+  Summary:
+    Maps device CORETIMER timestamps into the host time domain.
+ *******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "ccd_clock.h"
+
+/******************************************************************************/
+void CCDCLOCK_Init(CCDCLOCK *c)
+{
+    memset(c,0,sizeof(*c));
+}
+/******************************************************************************/
+uint64_t CCDCLOCK_Unwrap(CCDCLOCK *c, uint32_t raw)
+{
+    if(!c->started)
+    {
+        c->started=1;
+        c->ticks=raw;
+    }
+    else
+    {
+        //signed difference handles both wrap-around and slightly older stamps
+        c->ticks+=(int64_t)(int32_t)(raw-c->lastRaw);
+    }
+    c->lastRaw=raw;
+    return c->ticks;
+}
+/******************************************************************************/
+uint64_t CCDCLOCK_TicksToNs(uint64_t ticks)
+{
+    return ticks/CCD_TIMESTAMP_HZ*1000000000u+ticks%CCD_TIMESTAMP_HZ*1000000000u/CCD_TIMESTAMP_HZ;
+}
+/******************************************************************************/
+void CCDCLOCK_Observe(CCDCLOCK *c, uint64_t deviceTicks, uint64_t hostRxNs)
+{
+    int64_t sample=(int64_t)hostRxNs-(int64_t)CCDCLOCK_TicksToNs(deviceTicks);
+
+    c->window[c->windowNext]=sample;
+    c->windowNext=(c->windowNext+1)%CCDCLOCK_WINDOW;
+    if(c->windowCount<CCDCLOCK_WINDOW)c->windowCount++;
+
+    c->offset=c->window[0];
+    for(unsigned i=1;i<c->windowCount;i++)
+        if(c->window[i]<c->offset)c->offset=c->window[i];
+}
+/******************************************************************************/
+//Refits offset and drift to the exchanges with a round trip near the fastest one
+static void CCDCLOCK_Fit(CCDCLOCK *c)
+{
+    const CCDCLOCK_SYNC *last=&c->sync[(c->syncNext+CCDCLOCK_SYNC_WINDOW-1)%CCDCLOCK_SYNC_WINDOW];
+    int64_t limit, maxDelay=0;
+    double sx=0, sy=0, sxx=0, sxy=0, xMin=0, xMax=0, residual=0;
+    unsigned n=0;
+
+    c->minDelay=INT64_MAX;
+    for(unsigned i=0;i<c->syncCount;i++)
+        if(c->sync[i].delay<c->minDelay)c->minDelay=c->sync[i].delay;
+    //slow exchanges were delayed on one path only, they carry mostly asymmetry
+    limit=c->minDelay*2+10000;
+
+    c->syncRef=last->deviceNs;
+    c->syncOffset=last->offset;
+    for(unsigned i=0;i<c->syncCount;i++)
+    {
+        const CCDCLOCK_SYNC *s=&c->sync[i];
+        if(s->delay>limit)continue;
+        double x=(double)(s->deviceNs-c->syncRef), y=(double)(s->offset-c->syncOffset);
+        if(!n||x<xMin)xMin=x;
+        if(!n||x>xMax)xMax=x;
+        sx+=x; sy+=y; sxx+=x*x; sxy+=x*y;
+        if(s->delay>maxDelay)maxDelay=s->delay;
+        n++;
+    }
+
+    //drift needs a baseline long enough to rise above the delay jitter
+    if(n>=2&&xMax-xMin>=1e8)
+    {
+        double d=n*sxx-sx*sx;
+        c->drift=(n*sxy-sx*sy)/d;
+    }
+    c->fitOffset=(sy-c->drift*sx)/n;
+
+    for(unsigned i=0;i<c->syncCount;i++)
+    {
+        const CCDCLOCK_SYNC *s=&c->sync[i];
+        if(s->delay>limit)continue;
+        double x=(double)(s->deviceNs-c->syncRef), y=(double)(s->offset-c->syncOffset);
+        double r=fabs(y-(c->fitOffset+c->drift*x));
+        if(r>residual)residual=r;
+    }
+    c->error=maxDelay/2+(int64_t)ceil(residual);
+    c->synced=1;
+}
+/******************************************************************************/
+void CCDCLOCK_Sync(CCDCLOCK *c, uint64_t hostTxNs, const CCD_SYNC_REPLY *reply, uint64_t hostRxNs)
+{
+    int64_t rx=(int64_t)CCDCLOCK_TicksToNs(CCDCLOCK_Unwrap(c,reply->rxTimestamp));
+    int64_t tx=(int64_t)CCDCLOCK_TicksToNs(CCDCLOCK_Unwrap(c,reply->txTimestamp));
+    CCDCLOCK_SYNC *s=&c->sync[c->syncNext];
+
+    s->deviceNs=rx+(tx-rx)/2;
+    s->offset=(((int64_t)hostTxNs-rx)+((int64_t)hostRxNs-tx))/2;
+    s->delay=((int64_t)hostRxNs-(int64_t)hostTxNs)-(tx-rx);
+    if(s->delay<0)s->delay=0;
+
+    c->syncNext=(c->syncNext+1)%CCDCLOCK_SYNC_WINDOW;
+    if(c->syncCount<CCDCLOCK_SYNC_WINDOW)c->syncCount++;
+    CCDCLOCK_Fit(c);
+}
+/******************************************************************************/
+//Maps a device time to host time, error receives the bound (CCDCLOCK_UNBOUNDED without sync)
+uint64_t CCDCLOCK_ToHost(const CCDCLOCK *c, uint64_t deviceTicks, int64_t *error)
+{
+    int64_t deviceNs=(int64_t)CCDCLOCK_TicksToNs(deviceTicks);
+
+    if(!c->synced)
+    {
+        if(error)*error=CCDCLOCK_UNBOUNDED;
+        return (uint64_t)(deviceNs+c->offset);
+    }
+    if(error)*error=c->error;
+    return (uint64_t)(deviceNs+c->syncOffset+llround(c->fitOffset+c->drift*(double)(deviceNs-c->syncRef)));
+}
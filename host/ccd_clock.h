@@ -0,0 +1,96 @@
+/*******************************************************************************
+  CCD Clock Mapping Header File
+
+  File Name:
+    ccd_clock.h
+
+  Summary:
+    Maps device CORETIMER timestamps into the host time domain.
+
+  Description:
+    Device timestamps are 32-bit CORETIMER counts (CCD_TIMESTAMP_HZ) and wrap
+    every ~43 s; they are unwrapped against the previous value, so consecutive
+    observations must be less than half a wrap apart.
+
+    The preferred mapping comes from "SYN" exchanges (CCD_SYNC_REPLY). Each
+    exchange gives an NTP style offset sample
+
+      offset = ((hostTx-deviceRx)+(hostRx-deviceTx))/2
+      delay  = (hostRx-hostTx)-(deviceTx-deviceRx)
+
+    whose error is at most delay/2. Samples with a round trip close to the
+    fastest one in the window are fitted with a straight line, giving the
+    offset and the drift of the device crystal against the host clock. The
+    error bound of a mapped timestamp is the worst delay/2 of the fitted
+    samples plus the largest fit residual.
+
+    Until the first exchange the offset is estimated from frame
+    arrivals: the host receive time minus the device timestamp is the true
+    offset plus a non-negative latency (readout, USB transfer, scheduling),
+    so the minimum over a sliding window is used. This has no error bound
+    (the latency floor is unknown) but it is the same for devices running
+    the same settings, so it cancels when frames of several devices are
+    aligned.
+ *******************************************************************************/
+
+#ifndef _CCD_CLOCK_H
+#define _CCD_CLOCK_H
+
+#include <stdint.h>
+
+#include "ccd_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCDCLOCK_WINDOW         64          //frames in the minimum filter
+#define CCDCLOCK_SYNC_WINDOW    32          //sync exchanges kept for the fit
+#define CCDCLOCK_UNBOUNDED      INT64_MAX   //error of a mapping without sync
+
+typedef struct
+{
+    int64_t     deviceNs;                   //midpoint of device receive and transmit
+    int64_t     offset;                     //host_ns - device_ns
+    int64_t     delay;                      //round trip without device turnaround
+} CCDCLOCK_SYNC;
+
+typedef struct
+{
+    /* Unwrapping */
+    uint32_t    lastRaw;
+    uint64_t    ticks;                      //unwrapped device time of lastRaw
+    int         started;
+
+    /* Offset estimate from frame arrivals (host_ns - device_ns) */
+    int64_t     window[CCDCLOCK_WINDOW];
+    unsigned    windowCount;
+    unsigned    windowNext;
+    int64_t     offset;
+
+    /* Sync exchanges and fitted model:
+       host_ns = device_ns + syncOffset + fitOffset + drift*(device_ns-syncRef) */
+    CCDCLOCK_SYNC   sync[CCDCLOCK_SYNC_WINDOW];
+    unsigned        syncCount;
+    unsigned        syncNext;
+    int             synced;
+    int64_t         syncRef;
+    int64_t         syncOffset;
+    double          fitOffset;
+    double          drift;                  //d(host-device)/d(device), negative if the device runs fast
+    int64_t         error;                  //ns, bound of mapped timestamps
+    int64_t         minDelay;               //ns, fastest round trip in the window
+} CCDCLOCK;
+
+void CCDCLOCK_Init(CCDCLOCK *c);
+uint64_t CCDCLOCK_Unwrap(CCDCLOCK *c, uint32_t raw);
+uint64_t CCDCLOCK_TicksToNs(uint64_t ticks);
+void CCDCLOCK_Observe(CCDCLOCK *c, uint64_t deviceTicks, uint64_t hostRxNs);
+void CCDCLOCK_Sync(CCDCLOCK *c, uint64_t hostTxNs, const CCD_SYNC_REPLY *reply, uint64_t hostRxNs);
+uint64_t CCDCLOCK_ToHost(const CCDCLOCK *c, uint64_t deviceTicks, int64_t *error);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_CLOCK_H */
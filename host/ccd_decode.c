@@ -0,0 +1,162 @@
+/*******************************************************************************
+  CCD Payload Decoder Source File
+
+  File Name:
+    ccd_decode.c
+
+  Summary:
+    Scalar reference kernels and run time dispatch.
+ *******************************************************************************/
+
+#include "ccd_decode.h"
+
+const uint8_t ccddecShift[CCDDEC_FORMATS]={6,4,2,0,0,0};
+const float ccddecScale[CCDDEC_FORMATS]={1.0f/63.0f,1.0f/255.0f,1.0f/1023.0f,1.0f/4095.0f,1.0f/65520.0f,1.0f/4095.0f};
+
+extern const CCDDEC_KERNELS ccddecSSE2;
+extern const CCDDEC_KERNELS ccddecAVX2;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Scalar kernels
+// *****************************************************************************
+// *****************************************************************************
+
+static void CCDDEC_U8ToU16(const uint8_t *in, size_t n, uint16_t *out, unsigned shift)
+{
+    for(size_t i=0;i<n;i++)
+        out[i]=(uint16_t)(in[i]<<shift);
+}
+static void CCDDEC_BE16ToU16(const uint8_t *in, size_t n, uint16_t *out, unsigned shift)
+{
+    for(size_t i=0;i<n;i++)
+        out[i]=(uint16_t)(((in[2*i]<<8)|in[2*i+1])<<shift);
+}
+static void CCDDEC_LE16ToU16(const uint8_t *in, size_t n, uint16_t *out)
+{
+    for(size_t i=0;i<n;i++)
+        out[i]=(uint16_t)(in[2*i]|(in[2*i+1]<<8));
+}
+static void CCDDEC_U8ToF32(const uint8_t *in, size_t n, float *out, float scale)
+{
+    for(size_t i=0;i<n;i++)
+        out[i]=(float)in[i]*scale;
+}
+static void CCDDEC_BE16ToF32(const uint8_t *in, size_t n, float *out, float scale)
+{
+    for(size_t i=0;i<n;i++)
+        out[i]=(float)((in[2*i]<<8)|in[2*i+1])*scale;
+}
+static void CCDDEC_LE16ToF32(const uint8_t *in, size_t n, float *out, float scale)
+{
+    for(size_t i=0;i<n;i++)
+        out[i]=(float)(in[2*i]|(in[2*i+1]<<8))*scale;
+}
+
+static void CCDDEC_U16_0(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_U8ToU16(in,n,out,6);}
+static void CCDDEC_U16_1(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_U8ToU16(in,n,out,4);}
+static void CCDDEC_U16_2(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_BE16ToU16(in,n,out,2);}
+static void CCDDEC_U16_3(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_BE16ToU16(in,n,out,0);}
+static void CCDDEC_U16_4(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_BE16ToU16(in,n,out,0);}
+static void CCDDEC_U16_5(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_LE16ToU16(in,n,out);}
+static void CCDDEC_F32_0(const uint8_t *in, size_t n, float *out){CCDDEC_U8ToF32(in,n,out,1.0f/63.0f);}
+static void CCDDEC_F32_1(const uint8_t *in, size_t n, float *out){CCDDEC_U8ToF32(in,n,out,1.0f/255.0f);}
+static void CCDDEC_F32_2(const uint8_t *in, size_t n, float *out){CCDDEC_BE16ToF32(in,n,out,1.0f/1023.0f);}
+static void CCDDEC_F32_3(const uint8_t *in, size_t n, float *out){CCDDEC_BE16ToF32(in,n,out,1.0f/4095.0f);}
+static void CCDDEC_F32_4(const uint8_t *in, size_t n, float *out){CCDDEC_BE16ToF32(in,n,out,1.0f/65520.0f);}
+static void CCDDEC_F32_5(const uint8_t *in, size_t n, float *out){CCDDEC_LE16ToF32(in,n,out,1.0f/4095.0f);}
+
+const CCDDEC_KERNELS ccddecScalar=
+{
+    "scalar",
+    {CCDDEC_U16_0,CCDDEC_U16_1,CCDDEC_U16_2,CCDDEC_U16_3,CCDDEC_U16_4,CCDDEC_U16_5},
+    {CCDDEC_F32_0,CCDDEC_F32_1,CCDDEC_F32_2,CCDDEC_F32_3,CCDDEC_F32_4,CCDDEC_F32_5},
+};
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Dispatch
+// *****************************************************************************
+// *****************************************************************************
+
+static const CCDDEC_KERNELS *ccddecActive=NULL;
+
+/******************************************************************************/
+int CCDDEC_Supported(CCDDEC_IMPL impl)
+{
+    switch(impl)
+    {
+        case CCDDEC_IMPL_SCALAR:
+            return 1;
+#if defined(__x86_64__)||defined(__i386__)
+        case CCDDEC_IMPL_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case CCDDEC_IMPL_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return 0;
+    }
+}
+/******************************************************************************/
+const CCDDEC_KERNELS *CCDDEC_Kernels(CCDDEC_IMPL impl)
+{
+    if(!CCDDEC_Supported(impl))return NULL;
+    switch(impl)
+    {
+#if defined(__x86_64__)||defined(__i386__)
+        case CCDDEC_IMPL_SSE2: return &ccddecSSE2;
+        case CCDDEC_IMPL_AVX2: return &ccddecAVX2;
+#endif
+        default: return &ccddecScalar;
+    }
+}
+/******************************************************************************/
+int CCDDEC_Select(CCDDEC_IMPL impl)
+{
+    if(impl==CCDDEC_IMPL_AUTO)
+    {
+        //widest supported implementation
+        for(int i=CCDDEC_IMPL_COUNT-1;i>=0;i--)
+        {
+            if(CCDDEC_Supported((CCDDEC_IMPL)i))
+            {
+                ccddecActive=CCDDEC_Kernels((CCDDEC_IMPL)i);
+                return 0;
+            }
+        }
+    }
+    const CCDDEC_KERNELS *k=CCDDEC_Kernels(impl);
+    if(!k)return -1;
+    ccddecActive=k;
+    return 0;
+}
+/******************************************************************************/
+const char *CCDDEC_ImplName(void)
+{
+    if(!ccddecActive)CCDDEC_Select(CCDDEC_IMPL_AUTO);
+    return ccddecActive->name;
+}
+/******************************************************************************/
+size_t CCDDEC_Samples(uint8_t vRes, size_t payloadLength)
+{
+    return vRes>=2?payloadLength>>1:payloadLength;
+}
+/******************************************************************************/
+long CCDDEC_ToU16(const uint8_t *payload, size_t len, uint8_t vRes, uint16_t *out)
+{
+    if(vRes>=CCDDEC_FORMATS)return -1;
+    if(!ccddecActive)CCDDEC_Select(CCDDEC_IMPL_AUTO);
+    size_t n=CCDDEC_Samples(vRes,len);
+    ccddecActive->u16[vRes](payload,n,out);
+    return (long)n;
+}
+/******************************************************************************/
+long CCDDEC_ToFloat(const uint8_t *payload, size_t len, uint8_t vRes, float *out)
+{
+    if(vRes>=CCDDEC_FORMATS)return -1;
+    if(!ccddecActive)CCDDEC_Select(CCDDEC_IMPL_AUTO);
+    size_t n=CCDDEC_Samples(vRes,len);
+    ccddecActive->f32[vRes](payload,n,out);
+    return (long)n;
+}
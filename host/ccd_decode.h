@@ -0,0 +1,77 @@
+/*******************************************************************************
+  CCD Payload Decoder Header File
+
+  File Name:
+    ccd_decode.h
+
+  Summary:
+    Converts frame payloads into uint16 or normalized float samples.
+
+  Description:
+    Payload layouts follow USBCDC_TrasferData (vertical resolution code):
+
+      0 -> 1 byte per point, ADC>>6 (6 bits)
+      1 -> 1 byte per point, ADC>>4 (8 bits)
+      2 -> 2 bytes per point, big-endian ADC>>2 (10 bits)
+      3 -> 2 bytes per point, big-endian ADC (12 bits)
+      4 -> 2 bytes per point, big-endian oversampled ADC x16 (16 bits)
+      5 -> 2 bytes per point, little-endian ADC as stored (12 bits)
+
+    uint16 output undoes the resolution shift so formats 0-3 and 5 land in
+    the 12-bit ADC range, format 4 keeps its 16 bits (12-bit range x16).
+    Float output is normalized to 0..1 of the format's full scale.
+    Vectorized kernels (SSE2, AVX2) are selected at run time; the scalar
+    kernels are the reference and handle any tail samples.
+ *******************************************************************************/
+
+#ifndef _CCD_DECODE_H
+#define _CCD_DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCDDEC_FORMATS      6
+
+typedef enum
+{
+    CCDDEC_IMPL_SCALAR=0,
+    CCDDEC_IMPL_SSE2,
+    CCDDEC_IMPL_AVX2,
+    CCDDEC_IMPL_COUNT,
+    CCDDEC_IMPL_AUTO=CCDDEC_IMPL_COUNT
+} CCDDEC_IMPL;
+
+typedef void (*CCDDEC_U16_FN)(const uint8_t *in, size_t n, uint16_t *out);
+typedef void (*CCDDEC_F32_FN)(const uint8_t *in, size_t n, float *out);
+
+typedef struct
+{
+    const char      *name;
+    CCDDEC_U16_FN   u16[CCDDEC_FORMATS];
+    CCDDEC_F32_FN   f32[CCDDEC_FORMATS];
+} CCDDEC_KERNELS;
+
+/* Per format constants, shared by all kernels so results are bit identical */
+extern const uint8_t ccddecShift[CCDDEC_FORMATS];      //left shift back to 12-bit ADC range (16-bit for format 4)
+extern const float ccddecScale[CCDDEC_FORMATS];        //1/full scale
+extern const CCDDEC_KERNELS ccddecScalar;              //reference, also used for vector tails
+
+size_t CCDDEC_Samples(uint8_t vRes, size_t payloadLength);
+int CCDDEC_Select(CCDDEC_IMPL impl);
+const char *CCDDEC_ImplName(void);
+int CCDDEC_Supported(CCDDEC_IMPL impl);
+const CCDDEC_KERNELS *CCDDEC_Kernels(CCDDEC_IMPL impl);
+
+/* Return number of samples written, -1 on unknown format */
+long CCDDEC_ToU16(const uint8_t *payload, size_t len, uint8_t vRes, uint16_t *out);
+long CCDDEC_ToFloat(const uint8_t *payload, size_t len, uint8_t vRes, float *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_DECODE_H */
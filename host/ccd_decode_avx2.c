@@ -0,0 +1,124 @@
+/*******************************************************************************
+  CCD Payload Decoder, AVX2 Kernels
+
+  File Name:
+    ccd_decode_avx2.c
+
+  Summary:
+    32 bytes per iteration, scalar kernels finish the tail. This file is the
+    only one built with -mavx2; it is called only after a CPUID check.
+ *******************************************************************************/
+
+#include "ccd_decode.h"
+
+#if defined(__x86_64__)||defined(__i386__)
+
+#include <immintrin.h>
+
+/******************************************************************************/
+static void CCDDEC_AVX2_U8ToU16(const uint8_t *in, size_t n, uint16_t *out, int fmt)
+{
+    const __m128i shift=_mm_cvtsi32_si128(ccddecShift[fmt]);
+    size_t i=0;
+
+    for(;i+32<=n;i+=32)
+    {
+        __m128i a=_mm_loadu_si128((const __m128i *)(in+i));
+        __m128i b=_mm_loadu_si128((const __m128i *)(in+i+16));
+        _mm256_storeu_si256((__m256i *)(out+i),   _mm256_sll_epi16(_mm256_cvtepu8_epi16(a),shift));
+        _mm256_storeu_si256((__m256i *)(out+i+16),_mm256_sll_epi16(_mm256_cvtepu8_epi16(b),shift));
+    }
+    ccddecScalar.u16[fmt](in+i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_AVX2_BE16ToU16(const uint8_t *in, size_t n, uint16_t *out, int fmt)
+{
+    const __m128i shift=_mm_cvtsi32_si128(ccddecShift[fmt]);
+    const __m256i swap=_mm256_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14,
+                                        1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+    size_t i=0;
+
+    for(;i+16<=n;i+=16)
+    {
+        __m256i v=_mm256_loadu_si256((const __m256i *)(in+2*i));
+        _mm256_storeu_si256((__m256i *)(out+i),_mm256_sll_epi16(_mm256_shuffle_epi8(v,swap),shift));
+    }
+    ccddecScalar.u16[fmt](in+2*i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_AVX2_LE16ToU16(const uint8_t *in, size_t n, uint16_t *out, int fmt)
+{
+    size_t i=0;
+
+    for(;i+16<=n;i+=16)
+        _mm256_storeu_si256((__m256i *)(out+i),_mm256_loadu_si256((const __m256i *)(in+2*i)));
+    ccddecScalar.u16[fmt](in+2*i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_AVX2_U8ToF32(const uint8_t *in, size_t n, float *out, int fmt)
+{
+    const __m256 scale=_mm256_set1_ps(ccddecScale[fmt]);
+    size_t i=0;
+
+    for(;i+16<=n;i+=16)
+    {
+        __m128i a=_mm_loadl_epi64((const __m128i *)(in+i));
+        __m128i b=_mm_loadl_epi64((const __m128i *)(in+i+8));
+        _mm256_storeu_ps(out+i,  _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(a)),scale));
+        _mm256_storeu_ps(out+i+8,_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(b)),scale));
+    }
+    ccddecScalar.f32[fmt](in+i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_AVX2_BE16ToF32(const uint8_t *in, size_t n, float *out, int fmt)
+{
+    const __m256 scale=_mm256_set1_ps(ccddecScale[fmt]);
+    const __m128i swap=_mm_setr_epi8(1,0,3,2,5,4,7,6,9,8,11,10,13,12,15,14);
+    size_t i=0;
+
+    for(;i+16<=n;i+=16)
+    {
+        __m128i a=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in+2*i)),swap);
+        __m128i b=_mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(in+2*i+16)),swap);
+        _mm256_storeu_ps(out+i,  _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(a)),scale));
+        _mm256_storeu_ps(out+i+8,_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(b)),scale));
+    }
+    ccddecScalar.f32[fmt](in+2*i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_AVX2_LE16ToF32(const uint8_t *in, size_t n, float *out, int fmt)
+{
+    const __m256 scale=_mm256_set1_ps(ccddecScale[fmt]);
+    size_t i=0;
+
+    for(;i+16<=n;i+=16)
+    {
+        __m128i a=_mm_loadu_si128((const __m128i *)(in+2*i));
+        __m128i b=_mm_loadu_si128((const __m128i *)(in+2*i+16));
+        _mm256_storeu_ps(out+i,  _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(a)),scale));
+        _mm256_storeu_ps(out+i+8,_mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(b)),scale));
+    }
+    ccddecScalar.f32[fmt](in+2*i,n-i,out+i);
+}
+
+static void CCDDEC_AVX2_U16_0(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_AVX2_U8ToU16(in,n,out,0);}
+static void CCDDEC_AVX2_U16_1(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_AVX2_U8ToU16(in,n,out,1);}
+static void CCDDEC_AVX2_U16_2(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_AVX2_BE16ToU16(in,n,out,2);}
+static void CCDDEC_AVX2_U16_3(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_AVX2_BE16ToU16(in,n,out,3);}
+static void CCDDEC_AVX2_U16_4(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_AVX2_BE16ToU16(in,n,out,4);}
+static void CCDDEC_AVX2_U16_5(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_AVX2_LE16ToU16(in,n,out,5);}
+static void CCDDEC_AVX2_F32_0(const uint8_t *in, size_t n, float *out){CCDDEC_AVX2_U8ToF32(in,n,out,0);}
+static void CCDDEC_AVX2_F32_1(const uint8_t *in, size_t n, float *out){CCDDEC_AVX2_U8ToF32(in,n,out,1);}
+static void CCDDEC_AVX2_F32_2(const uint8_t *in, size_t n, float *out){CCDDEC_AVX2_BE16ToF32(in,n,out,2);}
+static void CCDDEC_AVX2_F32_3(const uint8_t *in, size_t n, float *out){CCDDEC_AVX2_BE16ToF32(in,n,out,3);}
+static void CCDDEC_AVX2_F32_4(const uint8_t *in, size_t n, float *out){CCDDEC_AVX2_BE16ToF32(in,n,out,4);}
+static void CCDDEC_AVX2_F32_5(const uint8_t *in, size_t n, float *out){CCDDEC_AVX2_LE16ToF32(in,n,out,5);}
+
+const CCDDEC_KERNELS ccddecAVX2=
+{
+    "avx2",
+    {CCDDEC_AVX2_U16_0,CCDDEC_AVX2_U16_1,CCDDEC_AVX2_U16_2,CCDDEC_AVX2_U16_3,CCDDEC_AVX2_U16_4,CCDDEC_AVX2_U16_5},
+    {CCDDEC_AVX2_F32_0,CCDDEC_AVX2_F32_1,CCDDEC_AVX2_F32_2,CCDDEC_AVX2_F32_3,CCDDEC_AVX2_F32_4,CCDDEC_AVX2_F32_5},
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*******************************************************************************
+  CCD Payload Decoder, SSE2 Kernels
+
+  File Name:
+    ccd_decode_sse2.c
+
+  Summary:
+    16 bytes per iteration, scalar kernels finish the tail.
+ *******************************************************************************/
+
+#include "ccd_decode.h"
+
+#if defined(__x86_64__)||defined(__i386__)
+
+#include <emmintrin.h>
+
+/******************************************************************************/
+static void CCDDEC_SSE2_U8ToU16(const uint8_t *in, size_t n, uint16_t *out, int fmt)
+{
+    const __m128i zero=_mm_setzero_si128();
+    const __m128i shift=_mm_cvtsi32_si128(ccddecShift[fmt]);
+    size_t i=0;
+
+    for(;i+16<=n;i+=16)
+    {
+        __m128i v=_mm_loadu_si128((const __m128i *)(in+i));
+        _mm_storeu_si128((__m128i *)(out+i),_mm_sll_epi16(_mm_unpacklo_epi8(v,zero),shift));
+        _mm_storeu_si128((__m128i *)(out+i+8),_mm_sll_epi16(_mm_unpackhi_epi8(v,zero),shift));
+    }
+    ccddecScalar.u16[fmt](in+i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_SSE2_BE16ToU16(const uint8_t *in, size_t n, uint16_t *out, int fmt)
+{
+    const __m128i shift=_mm_cvtsi32_si128(ccddecShift[fmt]);
+    size_t i=0;
+
+    for(;i+8<=n;i+=8)
+    {
+        __m128i v=_mm_loadu_si128((const __m128i *)(in+2*i));
+        v=_mm_or_si128(_mm_slli_epi16(v,8),_mm_srli_epi16(v,8));    //byte swap
+        _mm_storeu_si128((__m128i *)(out+i),_mm_sll_epi16(v,shift));
+    }
+    ccddecScalar.u16[fmt](in+2*i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_SSE2_LE16ToU16(const uint8_t *in, size_t n, uint16_t *out, int fmt)
+{
+    size_t i=0;
+
+    for(;i+8<=n;i+=8)
+        _mm_storeu_si128((__m128i *)(out+i),_mm_loadu_si128((const __m128i *)(in+2*i)));
+    ccddecScalar.u16[fmt](in+2*i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_SSE2_U8ToF32(const uint8_t *in, size_t n, float *out, int fmt)
+{
+    const __m128i zero=_mm_setzero_si128();
+    const __m128 scale=_mm_set1_ps(ccddecScale[fmt]);
+    size_t i=0;
+
+    for(;i+16<=n;i+=16)
+    {
+        __m128i v=_mm_loadu_si128((const __m128i *)(in+i));
+        __m128i lo=_mm_unpacklo_epi8(v,zero), hi=_mm_unpackhi_epi8(v,zero);
+        _mm_storeu_ps(out+i,   _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo,zero)),scale));
+        _mm_storeu_ps(out+i+4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo,zero)),scale));
+        _mm_storeu_ps(out+i+8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi,zero)),scale));
+        _mm_storeu_ps(out+i+12,_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi,zero)),scale));
+    }
+    ccddecScalar.f32[fmt](in+i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_SSE2_BE16ToF32(const uint8_t *in, size_t n, float *out, int fmt)
+{
+    const __m128i zero=_mm_setzero_si128();
+    const __m128 scale=_mm_set1_ps(ccddecScale[fmt]);
+    size_t i=0;
+
+    for(;i+8<=n;i+=8)
+    {
+        __m128i v=_mm_loadu_si128((const __m128i *)(in+2*i));
+        v=_mm_or_si128(_mm_slli_epi16(v,8),_mm_srli_epi16(v,8));
+        _mm_storeu_ps(out+i,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v,zero)),scale));
+        _mm_storeu_ps(out+i+4,_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v,zero)),scale));
+    }
+    ccddecScalar.f32[fmt](in+2*i,n-i,out+i);
+}
+/******************************************************************************/
+static void CCDDEC_SSE2_LE16ToF32(const uint8_t *in, size_t n, float *out, int fmt)
+{
+    const __m128i zero=_mm_setzero_si128();
+    const __m128 scale=_mm_set1_ps(ccddecScale[fmt]);
+    size_t i=0;
+
+    for(;i+8<=n;i+=8)
+    {
+        __m128i v=_mm_loadu_si128((const __m128i *)(in+2*i));
+        _mm_storeu_ps(out+i,  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v,zero)),scale));
+        _mm_storeu_ps(out+i+4,_mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v,zero)),scale));
+    }
+    ccddecScalar.f32[fmt](in+2*i,n-i,out+i);
+}
+
+static void CCDDEC_SSE2_U16_0(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_SSE2_U8ToU16(in,n,out,0);}
+static void CCDDEC_SSE2_U16_1(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_SSE2_U8ToU16(in,n,out,1);}
+static void CCDDEC_SSE2_U16_2(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_SSE2_BE16ToU16(in,n,out,2);}
+static void CCDDEC_SSE2_U16_3(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_SSE2_BE16ToU16(in,n,out,3);}
+static void CCDDEC_SSE2_U16_4(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_SSE2_BE16ToU16(in,n,out,4);}
+static void CCDDEC_SSE2_U16_5(const uint8_t *in, size_t n, uint16_t *out){CCDDEC_SSE2_LE16ToU16(in,n,out,5);}
+static void CCDDEC_SSE2_F32_0(const uint8_t *in, size_t n, float *out){CCDDEC_SSE2_U8ToF32(in,n,out,0);}
+static void CCDDEC_SSE2_F32_1(const uint8_t *in, size_t n, float *out){CCDDEC_SSE2_U8ToF32(in,n,out,1);}
+static void CCDDEC_SSE2_F32_2(const uint8_t *in, size_t n, float *out){CCDDEC_SSE2_BE16ToF32(in,n,out,2);}
+static void CCDDEC_SSE2_F32_3(const uint8_t *in, size_t n, float *out){CCDDEC_SSE2_BE16ToF32(in,n,out,3);}
+static void CCDDEC_SSE2_F32_4(const uint8_t *in, size_t n, float *out){CCDDEC_SSE2_BE16ToF32(in,n,out,4);}
+static void CCDDEC_SSE2_F32_5(const uint8_t *in, size_t n, float *out){CCDDEC_SSE2_LE16ToF32(in,n,out,5);}
+
+const CCDDEC_KERNELS ccddecSSE2=
+{
+    "sse2",
+    {CCDDEC_SSE2_U16_0,CCDDEC_SSE2_U16_1,CCDDEC_SSE2_U16_2,CCDDEC_SSE2_U16_3,CCDDEC_SSE2_U16_4,CCDDEC_SSE2_U16_5},
+    {CCDDEC_SSE2_F32_0,CCDDEC_SSE2_F32_1,CCDDEC_SSE2_F32_2,CCDDEC_SSE2_F32_3,CCDDEC_SSE2_F32_4,CCDDEC_SSE2_F32_5},
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*******************************************************************************
+  CCD Firmware Memory Map Source File
+
+  File Name:
+    ccd_map.c
+
+  Summary:
+    Reads RAM and flash use per object file from an XC32 linker map.
+ *******************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "ccd_map.h"
+
+/******************************************************************************/
+//Object file or library of an input section, "path/ccd.o" -> "ccd",
+//"path/libc.a(printf.o)" -> "libc.a"
+static void CCDMAP_Name(const char *file, char *name)
+{
+    const char *end=strchr(file,'(');
+    if(!end)end=file+strlen(file);
+    const char *start=end;
+    while(start>file&&start[-1]!='/'&&start[-1]!='\\')start--;
+    size_t n=end-start;
+    if(n>2&&!strncmp(end-2,".o",2))n-=2;
+    if(n>=CCDMAP_NAME_SIZE)n=CCDMAP_NAME_SIZE-1;
+    memcpy(name,start,n);
+    name[n]=0;
+}
+/******************************************************************************/
+static CCDMAP_OBJECT *CCDMAP_Object(CCDMAP *map, const char *file)
+{
+    char name[CCDMAP_NAME_SIZE];
+
+    CCDMAP_Name(file,name);
+    for(unsigned i=0;i<map->objects;i++)
+        if(!strcmp(map->object[i].name,name))return &map->object[i];
+    if(map->objects==CCDMAP_OBJECTS)
+    {
+        CCDMAP_OBJECT *rest=&map->object[CCDMAP_OBJECTS-1];
+        strcpy(rest->name,"(other)");
+        return rest;
+    }
+    CCDMAP_OBJECT *o=&map->object[map->objects++];
+    strcpy(o->name,name);
+    return o;
+}
+/******************************************************************************/
+//Adds an input section, by its physical address
+static void CCDMAP_Section(CCDMAP *map, const char *section, unsigned long address, unsigned long size, const char *file)
+{
+    unsigned long physical=address&0x1FFFFFFFul;
+    size_t n=strlen(section);
+
+    if(!size)return;
+    if(physical<0x10000000ul)
+    {
+        map->ram+=size;
+        if(n>=10&&!strcmp(section+n-10,".arenaPool"))   //the arena is reported on its own
+        {
+            map->arena+=size;
+            return;
+        }
+        CCDMAP_Object(map,file)->ram+=size;
+    }
+    else if(physical>=0x1D000000ul&&physical<0x1FC80000ul)
+    {
+        map->flash+=size;
+        CCDMAP_Object(map,file)->flash+=size;
+    }
+}
+/******************************************************************************/
+//Returns 0, -1 with errno set if the file cannot be read or is no linker map
+int CCDMAP_Read(const char *path, CCDMAP *map)
+{
+    FILE *f=fopen(path,"r");
+    char line[1024], pending[256]="", name[256], file[512];
+    unsigned long address, size;
+    int started=0, configuration=0;
+
+    if(!f)return -1;
+    memset(map,0,sizeof(*map));
+    while(fgets(line,sizeof(line),f))
+    {
+        if(!started)
+        {
+            if(strstr(line,"Memory Configuration"))configuration=1;
+            else if(strstr(line,"Linker script and memory map"))started=1;
+            else if(configuration&&sscanf(line,"%255s %lx %lx",name,&address,&size)==3)
+            {
+                if(!strcmp(name,"kseg0_data_mem"))map->ramSize=size;
+                else if(!strcmp(name,"kseg0_program_mem"))map->flashSize=size;
+            }
+            continue;
+        }
+        if(line[0]!=' ')        //output section, only those the linker fills itself count
+        {
+            pending[0]=0;
+            if(sscanf(line,"%255s %lx %lx",name,&address,&size)!=3)continue;
+            if(!strcmp(name,".heap")){map->heap=size;map->ram+=size;}
+            else if(!strcmp(name,".stack")){map->stack=size;map->ram+=size;}
+            continue;
+        }
+        if(line[1]!=' ')        //input section, the rest of it may be on the next line
+        {
+            int n=sscanf(line,"%255s %lx %lx %511s",name,&address,&size,file);
+            if(n<1||!strcmp(name,"*fill*"))continue;
+            if(n==1){strcpy(pending,name);continue;}
+            pending[0]=0;
+            if(n==4)CCDMAP_Section(map,name,address,size,file);
+        }
+        else if(pending[0])
+        {
+            if(sscanf(line,"%lx %lx %511s",&address,&size,file)==3)
+                CCDMAP_Section(map,pending,address,size,file);
+            pending[0]=0;
+        }
+    }
+    fclose(f);
+    if(!started)
+    {
+        errno=EINVAL;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+/*******************************************************************************
+  CCD Firmware Memory Map Header File
+
+  File Name:
+    ccd_map.h
+
+  Summary:
+    Reads RAM and flash use per object file from an XC32 linker map.
+
+  Description:
+    Input sections of the "Linker script and memory map" part are summed
+    per object file (archives per library) by their address: physical
+    0x00000000-0x0007FFFF is RAM, 0x1D000000 and up program and boot
+    flash, KSEG0 and KSEG1 alike. Sections the linker made itself (.heap,
+    .stack) are counted apart, and the frame arena (arenaPool, one section
+    with -fdata-sections) is taken out of its object file. The sizes of
+    RAM and program flash come from the "Memory Configuration" table.
+ *******************************************************************************/
+
+#ifndef _CCD_MAP_H
+#define _CCD_MAP_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCDMAP_OBJECTS      128
+#define CCDMAP_NAME_SIZE    48
+
+typedef struct
+{
+    char            name[CCDMAP_NAME_SIZE];     //object file without .o, or library
+    unsigned long   ram;
+    unsigned long   flash;
+} CCDMAP_OBJECT;
+
+typedef struct
+{
+    CCDMAP_OBJECT   object[CCDMAP_OBJECTS];     //the rest is added to the last one
+    unsigned        objects;
+    unsigned long   ramSize, flashSize;         //kseg0_data_mem, kseg0_program_mem
+    unsigned long   ram, flash;                 //everything, heap, stack and arena included
+    unsigned long   heap, stack;
+    unsigned long   arena;                      //bytes of arenaPool, 0 if none
+} CCDMAP;
+
+int CCDMAP_Read(const char *path, CCDMAP *map);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_MAP_H */
@@ -0,0 +1,486 @@
+/*******************************************************************************
+  CCD Frame Recorder Source File
+
+  File Name:
+    ccd_record.c
+
+  Summary:
+    Chunked frame recording format with a trailing index.
+
+  Description:
+    The writer fills one chunk buffer in memory while a background thread
+    writes the previous one to disk, so memory use is bounded by
+    CCDREC_WRITE_BUFFERS chunks regardless of recording length. The only
+    structure that grows with the recording is the chunk directory (one
+    48 byte entry per chunk).
+
+    The reader maps the file read-only. Lookups go through the chunk directory
+    (binary search) and then the per-chunk frame table, which is indexed
+    directly when the chunk holds a gap-free run of sequence numbers.
+ *******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccd_record.h"
+
+#define CCDREC_ALIGN(x)     (((x)+7u)&~7u)
+
+struct CCDREC_WRITER
+{
+    int                 fd;
+    uint32_t            chunkSize;
+
+    /* Chunk being filled */
+    uint8_t             *buffer[CCDREC_WRITE_BUFFERS];
+    int                 active;
+    uint32_t            used;           //bytes used in the active buffer, including chunk header
+    uint32_t            *table;         //frame offsets of the active chunk
+    uint32_t            tableCapacity;
+    CCDREC_CHUNK_HEADER chunk;
+
+    /* Chunk directory (trailing index) */
+    CCDREC_CHUNK_ENTRY  *directory;
+    uint32_t            directoryCount;
+    uint32_t            directoryCapacity;
+    uint64_t            fileOffset;     //offset of the next chunk
+    uint64_t            frameCount;
+
+    /* Background writer */
+    pthread_t           thread;
+    pthread_mutex_t     lock;
+    pthread_cond_t      cond;
+    int                 queued;         //buffer index waiting to be written, -1 if none
+    uint32_t            queuedBytes;
+    int                 stop;
+    int                 error;          //errno of the first failed write
+};
+
+/******************************************************************************/
+static int CCDREC_WriteAll(int fd, const void *data, size_t len)
+{
+    const uint8_t *p=data;
+    while(len)
+    {
+        ssize_t n=write(fd,p,len);
+        if(n<0)
+        {
+            if(errno==EINTR)continue;
+            return -1;
+        }
+        p+=n;
+        len-=(size_t)n;
+    }
+    return 0;
+}
+/******************************************************************************/
+static void *CCDREC_WriterThread(void *arg)
+{
+    CCDREC_WRITER *w=arg;
+
+    pthread_mutex_lock(&w->lock);
+    for(;;)
+    {
+        while(w->queued<0&&!w->stop)
+            pthread_cond_wait(&w->cond,&w->lock);
+        if(w->queued<0)
+            break;                          //stop requested and nothing left to write
+
+        int b=w->queued;
+        uint32_t len=w->queuedBytes;
+        pthread_mutex_unlock(&w->lock);
+
+        int rc=CCDREC_WriteAll(w->fd,w->buffer[b],len);
+
+        pthread_mutex_lock(&w->lock);
+        if(rc&&!w->error)w->error=errno;
+        w->queued=-1;
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+    return NULL;
+}
+/******************************************************************************/
+static void CCDREC_ChunkReset(CCDREC_WRITER *w)
+{
+    memset(&w->chunk,0,sizeof(w->chunk));
+    w->chunk.magic=CCDREC_CHUNK_MAGIC;
+    w->chunk.flags=CCDREC_CHUNK_DENSE;
+    w->used=sizeof(CCDREC_CHUNK_HEADER);
+}
+/******************************************************************************/
+static int CCDREC_ChunkSeal(CCDREC_WRITER *w)
+{
+    uint8_t *buf=w->buffer[w->active];
+    uint32_t tableBytes=w->chunk.frameCount*sizeof(uint32_t);
+
+    if(!w->chunk.frameCount)return 0;
+
+    /* Append frame table and finalize chunk header */
+    w->chunk.tableOffset=w->used;
+    memcpy(buf+w->used,w->table,tableBytes);
+    w->used=CCDREC_ALIGN(w->used+tableBytes);
+    w->chunk.chunkBytes=w->used;
+    memcpy(buf,&w->chunk,sizeof(w->chunk));
+
+    /* Grow directory if needed */
+    if(w->directoryCount==w->directoryCapacity)
+    {
+        uint32_t cap=w->directoryCapacity?w->directoryCapacity*2:64;
+        CCDREC_CHUNK_ENTRY *d=realloc(w->directory,cap*sizeof(*d));
+        if(!d)return -1;
+        w->directory=d;
+        w->directoryCapacity=cap;
+    }
+    CCDREC_CHUNK_ENTRY *e=&w->directory[w->directoryCount++];
+    memset(e,0,sizeof(*e));
+    e->offset=w->fileOffset;
+    e->chunkBytes=w->chunk.chunkBytes;
+    e->frameCount=w->chunk.frameCount;
+    e->firstSequence=w->chunk.firstSequence;
+    e->lastSequence=w->chunk.lastSequence;
+    e->firstTimestamp=w->chunk.firstTimestamp;
+    e->lastTimestamp=w->chunk.lastTimestamp;
+    e->flags=w->chunk.flags;
+    w->fileOffset+=w->chunk.chunkBytes;
+
+    /* Hand the buffer over to the writer thread, waiting for the previous one */
+    pthread_mutex_lock(&w->lock);
+    while(w->queued>=0)
+        pthread_cond_wait(&w->cond,&w->lock);
+    w->queued=w->active;
+    w->queuedBytes=w->chunk.chunkBytes;
+    pthread_cond_broadcast(&w->cond);
+    int err=w->error;
+    pthread_mutex_unlock(&w->lock);
+
+    w->active=(w->active+1)%CCDREC_WRITE_BUFFERS;
+    CCDREC_ChunkReset(w);
+
+    if(err){errno=err;return -1;}
+    return 0;
+}
+/******************************************************************************/
+CCDREC_WRITER *CCDREC_Create(const char *path, uint32_t chunkSize)
+{
+    CCDREC_WRITER *w;
+    CCDREC_FILE_HEADER fh;
+    struct timespec ts;
+
+    if(!chunkSize)chunkSize=CCDREC_CHUNK_SIZE_DEFAULT;
+    if(chunkSize<CCDREC_CHUNK_SIZE_MIN)chunkSize=CCDREC_CHUNK_SIZE_MIN;
+    chunkSize=CCDREC_ALIGN(chunkSize);
+
+    w=calloc(1,sizeof(*w));
+    if(!w)return NULL;
+    w->fd=-1;
+    w->queued=-1;
+    w->chunkSize=chunkSize;
+    w->tableCapacity=chunkSize/(sizeof(CCDREC_FRAME)+sizeof(uint32_t));
+    w->table=malloc(w->tableCapacity*sizeof(uint32_t));
+    for(int i=0;i<CCDREC_WRITE_BUFFERS;i++)
+        w->buffer[i]=malloc(chunkSize);
+    for(int i=0;i<CCDREC_WRITE_BUFFERS;i++)
+        if(!w->buffer[i])goto fail;
+    if(!w->table)goto fail;
+
+    w->fd=open(path,O_WRONLY|O_CREAT|O_TRUNC,0644);
+    if(w->fd<0)goto fail;
+
+    memset(&fh,0,sizeof(fh));
+    memcpy(fh.magic,CCDREC_FILE_MAGIC,sizeof(fh.magic));
+    fh.version=CCDREC_VERSION;
+    fh.headerSize=sizeof(fh);
+    fh.chunkSize=chunkSize;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    fh.createdNs=(uint64_t)ts.tv_sec*1000000000u+(uint64_t)ts.tv_nsec;
+    if(CCDREC_WriteAll(w->fd,&fh,sizeof(fh)))goto fail;
+    w->fileOffset=sizeof(fh);
+
+    CCDREC_ChunkReset(w);
+    pthread_mutex_init(&w->lock,NULL);
+    pthread_cond_init(&w->cond,NULL);
+    if(pthread_create(&w->thread,NULL,CCDREC_WriterThread,w))
+    {
+        pthread_mutex_destroy(&w->lock);
+        pthread_cond_destroy(&w->cond);
+        goto fail;
+    }
+    return w;
+
+fail:
+    if(w->fd>=0)close(w->fd);
+    for(int i=0;i<CCDREC_WRITE_BUFFERS;i++)
+        free(w->buffer[i]);
+    free(w->table);
+    free(w);
+    return NULL;
+}
+/******************************************************************************/
+int CCDREC_Append(CCDREC_WRITER *w, const CCDREC_FRAME *frame, const void *payload)
+{
+    uint32_t recordBytes=CCDREC_ALIGN(sizeof(CCDREC_FRAME)+frame->payloadLength);
+
+    //a single frame must fit into an empty chunk together with its table entry
+    if(sizeof(CCDREC_CHUNK_HEADER)+recordBytes+2*sizeof(uint32_t)>w->chunkSize)
+    {
+        errno=EMSGSIZE;
+        return -1;
+    }
+
+    //seal the chunk if this frame and the grown table would not fit
+    uint32_t tableBytes=CCDREC_ALIGN((w->chunk.frameCount+1)*sizeof(uint32_t));
+    if(w->used+recordBytes+tableBytes>w->chunkSize||w->chunk.frameCount>=w->tableCapacity)
+    {
+        if(CCDREC_ChunkSeal(w))return -1;
+    }
+
+    uint8_t *dst=w->buffer[w->active]+w->used;
+    memcpy(dst,frame,sizeof(CCDREC_FRAME));
+    memcpy(dst+sizeof(CCDREC_FRAME),payload,frame->payloadLength);
+    memset(dst+sizeof(CCDREC_FRAME)+frame->payloadLength,0,recordBytes-sizeof(CCDREC_FRAME)-frame->payloadLength);
+
+    if(!w->chunk.frameCount)
+    {
+        w->chunk.firstSequence=frame->sequence;
+        w->chunk.firstTimestamp=frame->timestamp;
+    }
+    else if(frame->sequence!=w->chunk.lastSequence+1)
+    {
+        w->chunk.flags&=~CCDREC_CHUNK_DENSE;
+    }
+    w->chunk.lastSequence=frame->sequence;
+    w->chunk.lastTimestamp=frame->timestamp;
+    w->table[w->chunk.frameCount++]=w->used;
+    w->used+=recordBytes;
+    w->frameCount++;
+    return 0;
+}
+/******************************************************************************/
+int CCDREC_Close(CCDREC_WRITER *w)
+{
+    CCDREC_TRAILER tr;
+    int rc=0, err;
+
+    if(CCDREC_ChunkSeal(w))rc=-1;
+
+    pthread_mutex_lock(&w->lock);
+    w->stop=1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread,NULL);
+    err=w->error;
+
+    /* Trailing index */
+    memset(&tr,0,sizeof(tr));
+    memcpy(tr.magic,CCDREC_TRAILER_MAGIC,sizeof(tr.magic));
+    tr.indexOffset=w->fileOffset;
+    tr.chunkCount=w->directoryCount;
+    tr.frameCount=w->frameCount;
+    if(!err&&w->directoryCount&&CCDREC_WriteAll(w->fd,w->directory,w->directoryCount*sizeof(CCDREC_CHUNK_ENTRY)))err=errno;
+    if(!err&&CCDREC_WriteAll(w->fd,&tr,sizeof(tr)))err=errno;
+    if(close(w->fd)&&!err)err=errno;
+
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
+    for(int i=0;i<CCDREC_WRITE_BUFFERS;i++)
+        free(w->buffer[i]);
+    free(w->table);
+    free(w->directory);
+    free(w);
+
+    if(err){errno=err;rc=-1;}
+    return rc;
+}
+/******************************************************************************/
+uint64_t CCDREC_BytesWritten(const CCDREC_WRITER *w)
+{
+    return w->fileOffset+(w->chunk.frameCount?w->used:0);
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Reader
+// *****************************************************************************
+// *****************************************************************************
+
+static int CCDREC_Rebuild(CCDREC_READER *r)
+{
+    uint64_t off=r->fileHeader->headerSize;
+    uint32_t cap=64;
+
+    r->rebuilt=malloc(cap*sizeof(CCDREC_CHUNK_ENTRY));
+    if(!r->rebuilt)return -1;
+
+    while(off+sizeof(CCDREC_CHUNK_HEADER)<=r->size)
+    {
+        const CCDREC_CHUNK_HEADER *ch=(const CCDREC_CHUNK_HEADER *)(r->base+off);
+        if(ch->magic!=CCDREC_CHUNK_MAGIC||ch->chunkBytes<sizeof(*ch)||off+ch->chunkBytes>r->size)
+            break;                          //torn or missing chunk, stop here
+        if(ch->tableOffset+(uint64_t)ch->frameCount*sizeof(uint32_t)>ch->chunkBytes)
+            break;
+        if(r->chunkCount==cap)
+        {
+            CCDREC_CHUNK_ENTRY *d=realloc(r->rebuilt,2*cap*sizeof(*d));
+            if(!d)return -1;
+            r->rebuilt=d;
+            cap*=2;
+        }
+        CCDREC_CHUNK_ENTRY *e=&r->rebuilt[r->chunkCount++];
+        memset(e,0,sizeof(*e));
+        e->offset=off;
+        e->chunkBytes=ch->chunkBytes;
+        e->frameCount=ch->frameCount;
+        e->firstSequence=ch->firstSequence;
+        e->lastSequence=ch->lastSequence;
+        e->firstTimestamp=ch->firstTimestamp;
+        e->lastTimestamp=ch->lastTimestamp;
+        e->flags=ch->flags;
+        r->frameCount+=ch->frameCount;
+        off+=ch->chunkBytes;
+    }
+    r->chunks=r->rebuilt;
+    return 0;
+}
+/******************************************************************************/
+int CCDREC_ReaderOpen(CCDREC_READER *r, const char *path)
+{
+    struct stat st;
+
+    memset(r,0,sizeof(*r));
+    r->fd=open(path,O_RDONLY);
+    if(r->fd<0)return -1;
+    if(fstat(r->fd,&st)||st.st_size<(off_t)sizeof(CCDREC_FILE_HEADER))
+    {
+        close(r->fd);
+        errno=EINVAL;
+        return -1;
+    }
+    r->size=(size_t)st.st_size;
+    r->base=mmap(NULL,r->size,PROT_READ,MAP_SHARED,r->fd,0);
+    if(r->base==MAP_FAILED)
+    {
+        close(r->fd);
+        return -1;
+    }
+    madvise((void *)r->base,r->size,MADV_RANDOM);
+
+    r->fileHeader=(const CCDREC_FILE_HEADER *)r->base;
+    if(memcmp(r->fileHeader->magic,CCDREC_FILE_MAGIC,8)||!r->fileHeader->version||r->fileHeader->version>CCDREC_VERSION)
+    {
+        CCDREC_ReaderClose(r);
+        errno=EINVAL;
+        return -1;
+    }
+
+    /* Prefer the trailing index, fall back to walking the chunks */
+    if(r->size>=sizeof(CCDREC_FILE_HEADER)+sizeof(CCDREC_TRAILER))
+    {
+        const CCDREC_TRAILER *tr=(const CCDREC_TRAILER *)(r->base+r->size-sizeof(CCDREC_TRAILER));
+        if(!memcmp(tr->magic,CCDREC_TRAILER_MAGIC,8)&&
+           tr->indexOffset+(uint64_t)tr->chunkCount*sizeof(CCDREC_CHUNK_ENTRY)+sizeof(*tr)==r->size)
+        {
+            r->chunks=(const CCDREC_CHUNK_ENTRY *)(r->base+tr->indexOffset);
+            r->chunkCount=tr->chunkCount;
+            r->frameCount=tr->frameCount;
+            return 0;
+        }
+    }
+    if(CCDREC_Rebuild(r))
+    {
+        CCDREC_ReaderClose(r);
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+void CCDREC_ReaderClose(CCDREC_READER *r)
+{
+    if(r->base&&r->base!=MAP_FAILED)munmap((void *)r->base,r->size);
+    if(r->fd>=0)close(r->fd);
+    free(r->rebuilt);
+    memset(r,0,sizeof(*r));
+    r->fd=-1;
+}
+/******************************************************************************/
+int CCDREC_FrameAt(const CCDREC_READER *r, uint32_t chunk, uint32_t index, CCDREC_VIEW *view)
+{
+    if(chunk>=r->chunkCount||index>=r->chunks[chunk].frameCount)return -1;
+
+    const uint8_t *c=r->base+r->chunks[chunk].offset;
+    const CCDREC_CHUNK_HEADER *ch=(const CCDREC_CHUNK_HEADER *)c;
+    const uint32_t *table=(const uint32_t *)(c+ch->tableOffset);
+
+    view->header=(const CCDREC_FRAME *)(c+table[index]);
+    view->payload=(const uint8_t *)(view->header+1);
+    return 0;
+}
+/******************************************************************************/
+int CCDREC_SeekSequence(const CCDREC_READER *r, uint32_t sequence, CCDREC_VIEW *view)
+{
+    uint32_t lo=0, hi=r->chunkCount;
+
+    //first chunk whose last sequence is not below the requested one
+    while(lo<hi)
+    {
+        uint32_t mid=lo+(hi-lo)/2;
+        if(r->chunks[mid].lastSequence<sequence)lo=mid+1;
+        else hi=mid;
+    }
+    if(lo==r->chunkCount||r->chunks[lo].firstSequence>sequence)return -1;
+
+    const CCDREC_CHUNK_ENTRY *e=&r->chunks[lo];
+    if(e->flags&CCDREC_CHUNK_DENSE)
+        return CCDREC_FrameAt(r,lo,sequence-e->firstSequence,view);
+
+    uint32_t a=0, b=e->frameCount;
+    while(a<b)
+    {
+        uint32_t mid=a+(b-a)/2;
+        CCDREC_FrameAt(r,lo,mid,view);
+        if(view->header->sequence<sequence)a=mid+1;
+        else b=mid;
+    }
+    if(a==e->frameCount)return -1;
+    CCDREC_FrameAt(r,lo,a,view);
+    return view->header->sequence==sequence?0:-1;
+}
+/******************************************************************************/
+int CCDREC_SeekTime(const CCDREC_READER *r, uint64_t timestamp, CCDREC_VIEW *view)
+{
+    uint32_t lo=0, hi=r->chunkCount;
+
+    //first frame with timestamp >= requested time
+    while(lo<hi)
+    {
+        uint32_t mid=lo+(hi-lo)/2;
+        if(r->chunks[mid].lastTimestamp<timestamp)lo=mid+1;
+        else hi=mid;
+    }
+    if(lo==r->chunkCount)return -1;
+
+    const CCDREC_CHUNK_ENTRY *e=&r->chunks[lo];
+    uint32_t a=0, b=e->frameCount;
+    while(a<b)
+    {
+        uint32_t mid=a+(b-a)/2;
+        CCDREC_FrameAt(r,lo,mid,view);
+        if(view->header->timestamp<timestamp)a=mid+1;
+        else b=mid;
+    }
+    return CCDREC_FrameAt(r,lo,a,view);
+}
+/******************************************************************************/
+//Integration time of a frame of this recording in device timer ticks
+uint64_t CCDREC_IntegrationTicks(const CCDREC_READER *r, const CCDREC_FRAME *frame)
+{
+    if(r->fileHeader->version<2)return (uint64_t)frame->integrationTime*CCDREC_TICKS_PER_10US;
+    return frame->integrationTime;
+}
@@ -0,0 +1,161 @@
+/*******************************************************************************
+  CCD Frame Recorder Header File
+
+  File Name:
+    ccd_record.h
+
+  Summary:
+    Chunked frame recording format with a trailing index.
+
+  Description:
+    Frames are appended to fixed-capacity chunks. Every chunk carries its own
+    frame offset table, and a directory of all chunks is written at the end of
+    the file when the recording is closed. Readers map the whole file and hand
+    out zero-copy views into it.
+
+    File layout (all fields little-endian):
+
+      [CCDREC_FILE_HEADER]
+      [chunk 0] [chunk 1] ... [chunk N-1]
+      [CCDREC_CHUNK_ENTRY x N]            chunk directory (trailing index)
+      [CCDREC_TRAILER]
+
+    Chunk layout:
+
+      [CCDREC_CHUNK_HEADER]
+      [CCDREC_FRAME + payload, padded to 8 bytes] x frameCount
+      [uint32_t offset x frameCount]      frame table, relative to chunk start
+
+    If a recording was not closed (power loss, crash) the trailer is missing;
+    the reader then rebuilds the directory by walking the chunk headers.
+ *******************************************************************************/
+
+#ifndef _CCD_RECORD_H
+#define _CCD_RECORD_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCDREC_FILE_MAGIC           "CCDREC01"
+#define CCDREC_TRAILER_MAGIC        "CCDRIDX1"
+#define CCDREC_CHUNK_MAGIC          0x4B4E4843u     //"CHNK"
+#define CCDREC_VERSION              2               //1: integrationTime in x10us
+#define CCDREC_TICKS_PER_10US       125             //integrationTime ticks per x10us
+
+#define CCDREC_CHUNK_SIZE_DEFAULT   (4u<<20)        //4 MiB
+#define CCDREC_CHUNK_SIZE_MIN       (64u<<10)       //must hold at least a few full frames
+#define CCDREC_WRITE_BUFFERS        2               //chunk buffers in flight (memory bound = 2 chunks)
+
+#define CCDREC_CHUNK_DENSE          0x0001          //sequence numbers inside the chunk have no gaps
+
+// *****************************************************************************
+/* On-disk structures */
+
+typedef struct
+{
+    char        magic[8];           //CCDREC_FILE_MAGIC
+    uint32_t    version;
+    uint32_t    headerSize;         //sizeof(CCDREC_FILE_HEADER)
+    uint32_t    chunkSize;          //chunk capacity used by the writer
+    uint32_t    reserved0;
+    uint64_t    createdNs;          //host CLOCK_REALTIME at creation
+    uint8_t     reserved[32];
+} CCDREC_FILE_HEADER;               //64 bytes
+
+typedef struct
+{
+    uint32_t    magic;              //CCDREC_CHUNK_MAGIC
+    uint32_t    chunkBytes;         //header + frames + frame table
+    uint32_t    frameCount;
+    uint32_t    tableOffset;        //frame table offset from chunk start
+    uint32_t    firstSequence;
+    uint32_t    lastSequence;
+    uint64_t    firstTimestamp;     //ns
+    uint64_t    lastTimestamp;      //ns
+    uint16_t    flags;              //CCDREC_CHUNK_xxx
+    uint8_t     reserved[22];
+} CCDREC_CHUNK_HEADER;              //64 bytes
+
+typedef struct
+{
+    uint32_t    sequence;           //device (or host) frame sequence number
+    uint32_t    payloadLength;      //bytes following this record header
+    uint64_t    timestamp;          //ns, host time domain
+    uint32_t    integrationTime;    //device timer ticks (CCD_TIMER_HZ), x10us in version 1 files
+    uint32_t    deviceTimestamp;    //raw device tick count, 0 if unknown
+    uint8_t     hRes;               //horizontal resolution code (see main.c)
+    uint8_t     vRes;               //vertical resolution code (see main.c)
+    uint8_t     format;             //payload format, 0 = raw USBCDC_TrasferData output
+    uint8_t     deviceId;           //source device index for multi-sensor recordings
+    uint32_t    flags;
+} CCDREC_FRAME;                     //32 bytes
+
+typedef struct
+{
+    uint64_t    offset;             //chunk offset from start of file
+    uint32_t    chunkBytes;
+    uint32_t    frameCount;
+    uint32_t    firstSequence;
+    uint32_t    lastSequence;
+    uint64_t    firstTimestamp;
+    uint64_t    lastTimestamp;
+    uint16_t    flags;
+    uint8_t     reserved[6];
+} CCDREC_CHUNK_ENTRY;               //48 bytes
+
+typedef struct
+{
+    char        magic[8];           //CCDREC_TRAILER_MAGIC
+    uint64_t    indexOffset;        //offset of the first CCDREC_CHUNK_ENTRY
+    uint32_t    chunkCount;
+    uint32_t    reserved0;
+    uint64_t    frameCount;
+} CCDREC_TRAILER;                   //32 bytes
+
+// *****************************************************************************
+/* Writer */
+
+typedef struct CCDREC_WRITER CCDREC_WRITER;
+
+CCDREC_WRITER *CCDREC_Create(const char *path, uint32_t chunkSize);
+int CCDREC_Append(CCDREC_WRITER *w, const CCDREC_FRAME *frame, const void *payload);
+int CCDREC_Close(CCDREC_WRITER *w);
+uint64_t CCDREC_BytesWritten(const CCDREC_WRITER *w);
+
+// *****************************************************************************
+/* Reader */
+
+typedef struct
+{
+    const CCDREC_FRAME  *header;    //points into the mapping, valid until CCDREC_ReaderClose
+    const uint8_t       *payload;
+} CCDREC_VIEW;
+
+typedef struct
+{
+    int                         fd;
+    const uint8_t               *base;
+    size_t                      size;
+    const CCDREC_FILE_HEADER    *fileHeader;
+    const CCDREC_CHUNK_ENTRY    *chunks;        //directory, either in the mapping or rebuilt
+    CCDREC_CHUNK_ENTRY          *rebuilt;       //non-NULL if the trailer was missing
+    uint32_t                    chunkCount;
+    uint64_t                    frameCount;
+} CCDREC_READER;
+
+int CCDREC_ReaderOpen(CCDREC_READER *r, const char *path);
+void CCDREC_ReaderClose(CCDREC_READER *r);
+int CCDREC_FrameAt(const CCDREC_READER *r, uint32_t chunk, uint32_t index, CCDREC_VIEW *view);
+int CCDREC_SeekSequence(const CCDREC_READER *r, uint32_t sequence, CCDREC_VIEW *view);
+int CCDREC_SeekTime(const CCDREC_READER *r, uint64_t timestamp, CCDREC_VIEW *view);
+uint64_t CCDREC_IntegrationTicks(const CCDREC_READER *r, const CCDREC_FRAME *frame);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_RECORD_H */
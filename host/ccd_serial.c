@@ -0,0 +1,422 @@
+/*******************************************************************************
+  CCD Serial Link Source File
+
+  File Name:
+    ccd_serial.c
+
+  Summary:
+    Host side access to the USB CDC command interface (see usbcdc.c).
+ *******************************************************************************/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ccd_serial.h"
+
+/******************************************************************************/
+int CCDSERIAL_Open(const char *path)
+{
+    struct termios tio;
+    int fd=open(path,O_RDWR|O_NOCTTY);
+    if(fd<0)return -1;
+
+    //CDC ignores the line coding, but the tty layer must not cook the data
+    if(tcgetattr(fd,&tio)==0)
+    {
+        cfmakeraw(&tio);
+        cfsetspeed(&tio,B230400);
+        tio.c_cc[VMIN]=0;
+        tio.c_cc[VTIME]=0;
+        tcsetattr(fd,TCSANOW,&tio);
+    }
+    tcflush(fd,TCIOFLUSH);
+    return fd;
+}
+/******************************************************************************/
+void CCDSERIAL_Close(int fd)
+{
+    if(fd>=0)close(fd);
+}
+/******************************************************************************/
+int CCDSERIAL_Write(int fd, const void *data, size_t len)
+{
+    const uint8_t *p=data;
+    while(len)
+    {
+        ssize_t n=write(fd,p,len);
+        if(n<0)
+        {
+            if(errno==EINTR)continue;
+            return -1;
+        }
+        p+=n;
+        len-=(size_t)n;
+    }
+    return 0;
+}
+/******************************************************************************/
+int CCDSERIAL_Read(int fd, void *data, size_t len, int timeoutMs)
+{
+    uint8_t *p=data;
+    struct pollfd pfd={.fd=fd,.events=POLLIN};
+
+    while(len)
+    {
+        int rc=poll(&pfd,1,timeoutMs);
+        if(rc<0)
+        {
+            if(errno==EINTR)continue;
+            return -1;
+        }
+        if(rc==0)
+        {
+            errno=ETIMEDOUT;
+            return -1;
+        }
+        ssize_t n=read(fd,p,len);
+        if(n<0)
+        {
+            if(errno==EINTR||errno==EAGAIN)continue;
+            return -1;
+        }
+        if(n==0)
+        {
+            errno=EIO;                      //device went away
+            return -1;
+        }
+        p+=n;
+        len-=(size_t)n;
+    }
+    return 0;
+}
+/******************************************************************************/
+//integrationTime is in CCD_TIMER_HZ ticks. Whole x10us up to 655.35ms go out as
+//the 4 byte "SET" older firmware understands, other times as the 8 byte one.
+int CCDSERIAL_Setup(int fd, uint32_t integrationTime, uint8_t hRes, uint8_t vRes)
+{
+    uint32_t t10=integrationTime/CCD_TICKS_PER_10US;
+    int extended=integrationTime%CCD_TICKS_PER_10US||t10>0xFFFF;
+    if(t10>0xFFFF)t10=0xFFFF;
+    uint8_t cmd[11]={'S','E','T',(uint8_t)(t10>>8),(uint8_t)t10,hRes,vRes,
+                     (uint8_t)(integrationTime>>24),(uint8_t)(integrationTime>>16),
+                     (uint8_t)(integrationTime>>8),(uint8_t)integrationTime};
+    size_t len=extended?sizeof(cmd):7;
+    uint8_t echo[8];
+
+    if(CCDSERIAL_Write(fd,cmd,len))return -1;
+    if(CCDSERIAL_Read(fd,echo,len-3,CCDSERIAL_TIMEOUT_MS))return -1;
+    if(memcmp(echo,&cmd[3],len-3))
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"TIM", both times in ticks (framePeriod 0: free running). A rejected
+//combination is not an error here, reply->status tells.
+int CCDSERIAL_Timing(int fd, uint32_t integrationTime, uint32_t framePeriod, CCD_TIMING_REPLY *reply)
+{
+    uint8_t cmd[11]={'T','I','M',
+                     (uint8_t)(integrationTime>>24),(uint8_t)(integrationTime>>16),
+                     (uint8_t)(integrationTime>>8),(uint8_t)integrationTime,
+                     (uint8_t)(framePeriod>>24),(uint8_t)(framePeriod>>16),
+                     (uint8_t)(framePeriod>>8),(uint8_t)framePeriod};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    return CCDSERIAL_Read(fd,reply,sizeof(*reply),CCDSERIAL_TIMEOUT_MS);
+}
+/******************************************************************************/
+//"CLK", mode CCD_CLOCK_QUERY only reads the state. A refused mode is not an
+//error here, reply->status tells.
+int CCDSERIAL_Clock(int fd, uint8_t mode, CCD_CLOCK_REPLY *reply)
+{
+    uint8_t cmd[7]={'C','L','K',mode,0,0,0};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    return CCDSERIAL_Read(fd,reply,sizeof(*reply),CCDSERIAL_TIMEOUT_MS);
+}
+/******************************************************************************/
+int CCDSERIAL_Mode(int fd, uint8_t mode, uint8_t options, uint16_t parameter)
+{
+    uint8_t cmd[7]={'M','O','D',mode,options,(uint8_t)(parameter>>8),(uint8_t)parameter};
+    uint8_t echo[4];
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,echo,sizeof(echo),CCDSERIAL_TIMEOUT_MS))return -1;
+    if(memcmp(echo,&cmd[3],sizeof(echo)))
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//Auto exposure, maximum is the longest integration time in x10us (0: no limit)
+int CCDSERIAL_Exposure(int fd, uint8_t options, uint16_t maximum, uint16_t setpoint)
+{
+    uint8_t cmd[7]={'E','X','P',options,(uint8_t)(maximum>>8),(uint8_t)(setpoint>>8),(uint8_t)setpoint};
+    uint8_t echo[4];
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,echo,sizeof(echo),CCDSERIAL_TIMEOUT_MS))return -1;
+    if(memcmp(echo,&cmd[3],sizeof(echo)))
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+int CCDSERIAL_Get(int fd, uint8_t *data, size_t len)
+{
+    if(CCDSERIAL_Write(fd,"GET",3))return -1;
+    return CCDSERIAL_Read(fd,data,len,CCDSERIAL_TIMEOUT_MS);
+}
+/******************************************************************************/
+//Reads and drops whatever arrives until the link is quiet for CCDSERIAL_DRAIN_MS
+static void CCDSERIAL_Drain(int fd)
+{
+    uint8_t skip[256];
+    struct pollfd pfd={.fd=fd,.events=POLLIN};
+
+    while(poll(&pfd,1,CCDSERIAL_DRAIN_MS)>0)
+        if(read(fd,skip,sizeof(skip))<=0&&errno!=EINTR&&errno!=EAGAIN)break;
+}
+/******************************************************************************/
+//Reads the framed reply to an "FRM" sent before, the payload must fit into size
+//bytes. ETIMEDOUT only if nothing of it arrived within timeoutMs: the reply is
+//still owed then and may be waited for again, no other command may go out first.
+int CCDSERIAL_ReadFrame(int fd, CCD_FRAME_HEADER *header, uint8_t *payload, size_t size, int timeoutMs)
+{
+    uint8_t skip[256];
+
+    if(CCDSERIAL_Read(fd,header,1,timeoutMs))return -1;
+    if(CCDSERIAL_Read(fd,(uint8_t *)header+1,CCD_FRAME_HEADER_V1_SIZE-1,CCDSERIAL_TIMEOUT_MS))
+    {
+        if(errno==ETIMEDOUT)errno=EPROTO;   //cut short, not a reply still to come
+        return -1;
+    }
+    if(header->magic!=CCD_FRAME_MAGIC||header->headerSize<CCD_FRAME_HEADER_V1_SIZE||header->payloadLength>size)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    //older firmware sends a shorter header, the missing fields read as 0
+    size_t known=header->headerSize<sizeof(*header)?header->headerSize:sizeof(*header);
+    if(CCDSERIAL_Read(fd,(uint8_t *)header+CCD_FRAME_HEADER_V1_SIZE,known-CCD_FRAME_HEADER_V1_SIZE,CCDSERIAL_TIMEOUT_MS))
+        return -1;
+    memset((uint8_t *)header+known,0,sizeof(*header)-known);
+    if(known<CCD_FRAME_HEADER_V2_SIZE+sizeof(header->integrationTicks))
+        header->integrationTicks=(uint32_t)header->integrationTime*CCD_TICKS_PER_10US;
+    //fields appended by newer firmware are not known here
+    if(header->headerSize>sizeof(*header))
+        if(CCDSERIAL_Read(fd,skip,header->headerSize-sizeof(*header),CCDSERIAL_TIMEOUT_MS))return -1;
+    return CCDSERIAL_Read(fd,payload,header->payloadLength,CCDSERIAL_TIMEOUT_MS);
+}
+/******************************************************************************/
+//Requests and reads one frame, see CCDSERIAL_ReadFrame
+int CCDSERIAL_GetFrame(int fd, CCD_FRAME_HEADER *header, uint8_t *payload, size_t size)
+{
+    if(CCDSERIAL_Write(fd,"FRM",CCD_COMMAND_SIZE))return -1;
+    return CCDSERIAL_ReadFrame(fd,header,payload,size,CCDSERIAL_FRAME_TIMEOUT_MS);
+}
+/******************************************************************************/
+//One time synchronization exchange, host times are taken as close to the I/O as possible
+int CCDSERIAL_Sync(int fd, uint64_t *hostTx, CCD_SYNC_REPLY *reply, uint64_t *hostRx)
+{
+    uint8_t cmd[CCD_COMMAND_SIZE+CCD_SYNC_DATA_SIZE]={'S','Y','N'};
+
+    *hostTx=CCDSERIAL_TimeNs();
+    memcpy(&cmd[CCD_COMMAND_SIZE],hostTx,CCD_SYNC_DATA_SIZE);
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),CCDSERIAL_TIMEOUT_MS))
+    {
+        if(errno==ETIMEDOUT)CCDSERIAL_Drain(fd);    //a late reply must not be taken for the next one
+        return -1;
+    }
+    *hostRx=CCDSERIAL_TimeNs();
+    if(reply->hostTimestamp!=*hostTx)
+    {
+        CCDSERIAL_Drain(fd);                //stale reply of an earlier request, the rest of it too
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"CAL" operation, the device replies when it is done (DARK/FLAT after frames readouts)
+int CCDSERIAL_Calibrate(int fd, uint8_t operation, uint8_t frames, uint8_t options, CCD_CAL_REPLY *reply, int timeoutMs)
+{
+    uint8_t cmd[7]={'C','A','L',operation,frames,options,0};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),timeoutMs))return -1;
+    if(reply->operation!=operation)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"ADC", MATCH and CHECK reply after frames readouts. A refused request is not an
+//error here, reply->status tells.
+int CCDSERIAL_Adc(int fd, uint8_t operation, uint8_t cores, uint8_t frames, CCD_ADC_REPLY *reply, int timeoutMs)
+{
+    uint8_t cmd[7]={'A','D','C',operation,cores,frames,0};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),timeoutMs))return -1;
+    if(reply->operation!=operation)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"PHS", SWEEP replies after frames readouts at every phase. A refused request is
+//not an error here, reply->status tells.
+int CCDSERIAL_Phase(int fd, uint8_t operation, uint8_t frames, uint8_t phase, CCD_PHASE_REPLY *reply, int timeoutMs)
+{
+    uint8_t cmd[7]={'P','H','S',operation,frames,phase,0};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),timeoutMs))return -1;
+    if(reply->operation!=operation)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"IRQ", interrupt latency histograms since the last RESET
+int CCDSERIAL_Irq(int fd, uint8_t operation, CCD_IRQ_REPLY *reply)
+{
+    uint8_t cmd[7]={'I','R','Q',operation,0,0,0};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),CCDSERIAL_TIMEOUT_MS))return -1;
+    if(reply->operation!=operation)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"STA", counters a version 1 firmware does not send read as 0, counters of a later
+//firmware beyond CCD_STATUS_REPLY are read and dropped
+int CCDSERIAL_Status(int fd, CCD_STATUS_REPLY *reply)
+{
+    uint8_t cmd[7]={'S','T','A',0,0,0,0}, extra[255];
+    size_t known;
+
+    memset(reply,0,sizeof(*reply));
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,CCD_STATUS_V1_SIZE,CCDSERIAL_TIMEOUT_MS))return -1;
+    if(reply->version<1||reply->size<CCD_STATUS_V1_SIZE)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    known=reply->size<sizeof(*reply)?reply->size:sizeof(*reply);
+    if(known>CCD_STATUS_V1_SIZE&&
+       CCDSERIAL_Read(fd,(uint8_t *)reply+CCD_STATUS_V1_SIZE,known-CCD_STATUS_V1_SIZE,CCDSERIAL_TIMEOUT_MS))
+        return -1;
+    if(reply->size>known&&CCDSERIAL_Read(fd,extra,reply->size-known,CCDSERIAL_TIMEOUT_MS))
+        return -1;
+    return 0;
+}
+/******************************************************************************/
+//"TRC", mask applies to START (0: CCD_TRACE_DEFAULT), block to READ
+int CCDSERIAL_Trace(int fd, uint8_t operation, uint8_t block, uint16_t mask, CCD_TRACE_REPLY *reply)
+{
+    uint8_t cmd[7]={'T','R','C',operation,block,(uint8_t)(mask>>8),(uint8_t)mask};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),CCDSERIAL_TIMEOUT_MS))return -1;
+    if(reply->operation!=operation||reply->count>CCD_TRACE_BLOCK)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"BUF", placement applies to SET. A refused request is not an error here, reply->status tells.
+int CCDSERIAL_Buffers(int fd, uint8_t operation, uint8_t placement, CCD_BUF_REPLY *reply)
+{
+    uint8_t cmd[7]={'B','U','F',operation,placement,0,0};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),CCDSERIAL_TIMEOUT_MS))return -1;
+    if(reply->operation!=operation)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"MEM"
+int CCDSERIAL_Memory(int fd, CCD_MEM_REPLY *reply)
+{
+    uint8_t cmd[7]={'M','E','M',0,0,0,0};
+
+    if(CCDSERIAL_Write(fd,cmd,sizeof(cmd)))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),CCDSERIAL_TIMEOUT_MS))return -1;
+    if(reply->blockSize!=CCD_MEM_BLOCK_SIZE)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//"LIN", entries is the CCD_LIN_BLOCK entries of block for LOAD, NULL otherwise. A
+//refused request is not an error here, reply->status tells.
+int CCDSERIAL_Linearity(int fd, uint8_t operation, uint8_t block, uint8_t options, const uint16_t *entries,
+                        CCD_LIN_REPLY *reply, int timeoutMs)
+{
+    uint8_t cmd[7+2*CCD_LIN_BLOCK]={'L','I','N',operation,block,options,0};
+    size_t len=7;
+
+    if(entries)
+    {
+        for(unsigned i=0;i<CCD_LIN_BLOCK;i++)   //big-endian like the sample payload
+        {
+            cmd[len++]=(uint8_t)(entries[i]>>8);
+            cmd[len++]=(uint8_t)entries[i];
+        }
+    }
+    if(CCDSERIAL_Write(fd,cmd,len))return -1;
+    if(CCDSERIAL_Read(fd,reply,sizeof(*reply),timeoutMs))return -1;
+    if(reply->operation!=operation)
+    {
+        errno=EPROTO;
+        return -1;
+    }
+    return 0;
+}
+/******************************************************************************/
+size_t CCDSERIAL_PayloadSize(uint8_t hRes, uint8_t vRes)
+{
+    //same arithmetic as USBCDC_TrasferData: 1 byte per point for 6/8 bits, 2 otherwise
+    size_t points=(size_t)(CCDSERIAL_DATA_SIZE>>hRes);
+    return vRes>=2?points<<1:points;
+}
+/******************************************************************************/
+uint64_t CCDSERIAL_TimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME,&ts);
+    return (uint64_t)ts.tv_sec*1000000000u+(uint64_t)ts.tv_nsec;
+}
@@ -0,0 +1,66 @@
+/*******************************************************************************
+  CCD Serial Link Header File
+
+  File Name:
+    ccd_serial.h
+
+  Summary:
+    Host side access to the USB CDC command interface (see usbcdc.c).
+
+  Description:
+    The device accepts three letter ASCII commands (see ccd_protocol.h). "GET"
+    returns the current frame formatted by USBCDC_TrasferData, "FRM" returns
+    the next frame not yet sent prefixed by a CCD_FRAME_HEADER, "SET" takes
+    integration time, horizontal and vertical resolution and echoes the 4
+    setup bytes back, "SYN" returns device timestamps for clock mapping and
+    "MOD" selects what "FRM" sends.
+ *******************************************************************************/
+
+#ifndef _CCD_SERIAL_H
+#define _CCD_SERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "ccd_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CCDSERIAL_DATA_SIZE     CCD_DATA_SIZE
+#define CCDSERIAL_TIMEOUT_MS    1000
+#define CCDSERIAL_FRAME_TIMEOUT_MS  2000    //"FRM" waits for a new frame, up to one frame period
+#define CCDSERIAL_DRAIN_MS          50      //quiet time that ends a stale reply
+
+int CCDSERIAL_Open(const char *path);
+void CCDSERIAL_Close(int fd);
+int CCDSERIAL_Write(int fd, const void *data, size_t len);
+int CCDSERIAL_Read(int fd, void *data, size_t len, int timeoutMs);
+int CCDSERIAL_Setup(int fd, uint32_t integrationTime, uint8_t hRes, uint8_t vRes);
+int CCDSERIAL_Timing(int fd, uint32_t integrationTime, uint32_t framePeriod, CCD_TIMING_REPLY *reply);
+int CCDSERIAL_Clock(int fd, uint8_t mode, CCD_CLOCK_REPLY *reply);
+int CCDSERIAL_Mode(int fd, uint8_t mode, uint8_t options, uint16_t parameter);
+int CCDSERIAL_Exposure(int fd, uint8_t options, uint16_t maximum, uint16_t setpoint);
+int CCDSERIAL_Get(int fd, uint8_t *data, size_t len);
+int CCDSERIAL_GetFrame(int fd, CCD_FRAME_HEADER *header, uint8_t *payload, size_t size);
+int CCDSERIAL_ReadFrame(int fd, CCD_FRAME_HEADER *header, uint8_t *payload, size_t size, int timeoutMs);
+int CCDSERIAL_Sync(int fd, uint64_t *hostTx, CCD_SYNC_REPLY *reply, uint64_t *hostRx);
+int CCDSERIAL_Calibrate(int fd, uint8_t operation, uint8_t frames, uint8_t options, CCD_CAL_REPLY *reply, int timeoutMs);
+int CCDSERIAL_Adc(int fd, uint8_t operation, uint8_t cores, uint8_t frames, CCD_ADC_REPLY *reply, int timeoutMs);
+int CCDSERIAL_Phase(int fd, uint8_t operation, uint8_t frames, uint8_t phase, CCD_PHASE_REPLY *reply, int timeoutMs);
+int CCDSERIAL_Irq(int fd, uint8_t operation, CCD_IRQ_REPLY *reply);
+int CCDSERIAL_Status(int fd, CCD_STATUS_REPLY *reply);
+int CCDSERIAL_Trace(int fd, uint8_t operation, uint8_t block, uint16_t mask, CCD_TRACE_REPLY *reply);
+int CCDSERIAL_Buffers(int fd, uint8_t operation, uint8_t placement, CCD_BUF_REPLY *reply);
+int CCDSERIAL_Memory(int fd, CCD_MEM_REPLY *reply);
+int CCDSERIAL_Linearity(int fd, uint8_t operation, uint8_t block, uint8_t options, const uint16_t *entries,
+                        CCD_LIN_REPLY *reply, int timeoutMs);
+size_t CCDSERIAL_PayloadSize(uint8_t hRes, uint8_t vRes);
+uint64_t CCDSERIAL_TimeNs(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_SERIAL_H */
@@ -0,0 +1,102 @@
+/*******************************************************************************
+  CCD Event Trace Source File
+
+  File Name:
+    ccd_trace.c
+
+  Summary:
+    Turns a "TRC" event ring into a Chrome trace / Perfetto JSON timeline.
+ *******************************************************************************/
+
+#include <string.h>
+
+#include "ccd_clock.h"
+#include "ccd_trace.h"
+
+static const char *ccdtraceNames[CCD_TRACE_EVENTS]=
+{
+    "IRQ ADC","IRQ SH/ICG","IRQ USB","IRQ USB DMA","readout","frame","USB read","USB write",
+    "USBCDC state","SYS_Tasks","frame send","idle"
+};
+
+//"ph" of CCD_TRACE_INSTANT (thread scope), BEGIN and END
+static const char *ccdtracePhases[]={"\"i\",\"s\":\"t\"","\"B\"","\"E\""};
+
+//USBCDC_STATES in usbcdc.h order
+static const char *ccdtraceStates[]=
+{
+    "INIT","WAIT_FOR_CONFIGURATION","CHECK_SWITCH_PRESSED","SCHEDULE_READ","WAIT_FOR_READ_COMPLETE",
+    "SCHEDULE_WRITE","WAIT_FOR_WRITE_COMPLETE","WAIT_FOR_REPLY","ERROR"
+};
+
+/******************************************************************************/
+const char *CCDTRACE_EventName(uint8_t event)
+{
+    return event<CCD_TRACE_EVENTS?ccdtraceNames[event]:"unknown";
+}
+/******************************************************************************/
+//Microseconds of unwrapped ticks, relative to the first entry
+static double CCDTRACE_Us(uint64_t ticks, uint64_t origin)
+{
+    return (double)(int64_t)(ticks-origin)*1e6/CCD_TIMESTAMP_HZ;   //entries just before the first are negative
+}
+/******************************************************************************/
+//Writes the JSON timeline of n entries, oldest first. stats (NULL: none) receives
+//counts and span durations per event. Returns 0, -1 on a write error.
+int CCDTRACE_WriteJson(FILE *f, const CCD_TRACE_ENTRY *entry, unsigned n, CCDTRACE_STATS stats[CCD_TRACE_EVENTS])
+{
+    CCDCLOCK clock;
+    uint64_t open[CCD_TRACE_EVENTS], origin=0, stateStart=0;
+    int isOpen[CCD_TRACE_EVENTS]={0}, state=-1;
+    const char *sep="";
+
+    CCDCLOCK_Init(&clock);
+    if(stats)memset(stats,0,CCD_TRACE_EVENTS*sizeof(*stats));
+    fprintf(f,"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    for(unsigned k=0;k<CCD_TRACE_EVENTS;k++)
+    {
+        fprintf(f,"%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                sep,k,ccdtraceNames[k]);
+        sep=",\n";
+    }
+    for(unsigned i=0;i<n;i++)
+    {
+        const CCD_TRACE_ENTRY *e=&entry[i];
+        uint64_t t=CCDCLOCK_Unwrap(&clock,e->timestamp);
+        if(i==0)origin=t;
+        if(e->event>=CCD_TRACE_EVENTS||e->phase>CCD_TRACE_END)continue;
+        if(stats)stats[e->event].count++;
+
+        if(e->event==CCD_TRACE_USB_STATE)   //the state before runs up to here
+        {
+            if(state>=0)
+                fprintf(f,"%s{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.2f,\"dur\":%.2f,\"pid\":1,\"tid\":%u}",sep,
+                        state<(int)(sizeof(ccdtraceStates)/sizeof(ccdtraceStates[0]))?ccdtraceStates[state]:"?",
+                        CCDTRACE_Us(stateStart,origin),CCDTRACE_Us(t,stateStart),e->event);
+            state=e->arg;
+            stateStart=t;
+            continue;
+        }
+        if(e->phase==CCD_TRACE_BEGIN)
+        {
+            open[e->event]=t;
+            isOpen[e->event]=1;
+        }
+        else if(e->phase==CCD_TRACE_END)
+        {
+            if(!isOpen[e->event])continue;  //began before the ring
+            isOpen[e->event]=0;
+            if(stats)
+            {
+                uint64_t d=t>open[e->event]?t-open[e->event]:0;
+                stats[e->event].spans++;
+                stats[e->event].totalTicks+=d;
+                if(d>stats[e->event].maxTicks)stats[e->event].maxTicks=d;
+            }
+        }
+        fprintf(f,"%s{\"name\":\"%s\",\"ph\":%s,\"ts\":%.2f,\"pid\":1,\"tid\":%u,\"args\":{\"arg\":%u}}",sep,
+                ccdtraceNames[e->event],ccdtracePhases[e->phase],CCDTRACE_Us(t,origin),e->event,e->arg);
+    }
+    fprintf(f,"\n]}\n");
+    return ferror(f)?-1:0;
+}
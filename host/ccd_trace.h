@@ -0,0 +1,47 @@
+/*******************************************************************************
+  CCD Event Trace Header File
+
+  File Name:
+    ccd_trace.h
+
+  Summary:
+    Turns a "TRC" event ring into a Chrome trace / Perfetto JSON timeline.
+
+  Description:
+    Every event gets its own track (thread) of process 1: spans from their
+    BEGIN and END entries, instants as marks with their argument, and the
+    USBCDC_Tasks state changes as back to back spans named after the state.
+    An END whose BEGIN fell out of the ring is dropped, a BEGIN without END
+    runs to the end of the timeline. Timestamps are unwrapped against the
+    previous entry, so entries a few ticks out of order are placed right.
+    The file opens in chrome://tracing and ui.perfetto.dev.
+ *******************************************************************************/
+
+#ifndef _CCD_TRACE_H
+#define _CCD_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ccd_protocol.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct
+{
+    unsigned long   count;              //entries
+    unsigned long   spans;              //BEGIN with END
+    uint64_t        maxTicks;           //longest span
+    uint64_t        totalTicks;         //of all spans
+} CCDTRACE_STATS;
+
+const char *CCDTRACE_EventName(uint8_t event);
+int CCDTRACE_WriteJson(FILE *f, const CCD_TRACE_ENTRY *entry, unsigned n, CCDTRACE_STATS stats[CCD_TRACE_EVENTS]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CCD_TRACE_H */
@@ -0,0 +1,2972 @@
+/*******************************************************************************
+  CCD Host Tool
+
+  File Name:
+    ccdtool.c
+
+  Summary:
+    Command line front end for the host side libraries.
+
+  Description:
+    ccdtool <command> [options] [arguments]
+
+    record      acquire time-aligned frames from one or more devices into a
+                chunked recording
+    sync        measure device clock offset, drift and mapping error
+    stats       print per-frame statistics, optionally with auto exposure
+    timing      set integration time and frame period together
+    clock       select the CCD master clock, measure the frame rate per mode
+    adc         select one or two interleaved ADC cores, match and check them
+    phase       sweep the ADC sampling phase on a stable scene and keep the best
+    calibrate   capture, store and switch dark/flat-field correction
+    linearity   load, store and switch the ADC nonlinearity lookup table
+    irq         interrupt latency and duration histograms, missed samples
+                while frames stream
+    status      poll the device counters, frame, link and CPU rates per second
+    trace       record a device event trace, write a Chrome trace/Perfetto
+                timeline
+    buffers     select cached or uncached USB write buffer access, compare
+                both on a frame and against frames sent in place
+    memory      RAM and flash per module from the firmware map file, frame
+                arena use and burst frames per mode
+    info        print recording summary
+    dump        print one frame of a recording as text
+    bench-write measure sustained recorder write throughput (synthetic frames)
+    bench-read  measure random access throughput of a recording
+    bench-decode verify vector payload decoders and measure their throughput
+    bench-peaks check the device peak finder on synthetic spectral lines
+    bench-edges check the device edge finder on synthetic shadows
+    bench-exposure simulate the device auto exposure loop
+    bench-hdr   check the device HDR merge on a synthetic spectrum
+    bench-linearity check the ADC linearity lookup at every vertical
+                resolution
+    bench-timing simulate the device SH/ICG schedule over a sweep of
+                integration times and frame periods
+    bench-interleave check the ADC core match on a simulated core pair
+    bench-phase check the sampling phase sweep on a simulated front end
+    bench-change check the device change detection on a simulated monitoring
+                scene
+    bench-rice  check the device frame compression, ratio and speed on
+                synthetic and recorded frames
+
+    Integration times (-t) and frame periods (-f) are x10us, or with a
+    unit: 12.5us, 800ms, 30s.
+ *******************************************************************************/
+
+#include <errno.h>
+#include <math.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ccd_acq.h"
+#include "ccd_decode.h"
+#include "ccd_map.h"
+#include "ccd_record.h"
+#include "ccd_serial.h"
+#include "ccd_trace.h"
+#include "change.h"
+#include "edges.h"
+#include "exposure.h"
+#include "hdr.h"
+#include "interleave.h"
+#include "linearity.h"
+#include "phase.h"
+#include "peaks.h"
+#include "rice.h"
+#include "timing.h"
+
+#define CCDTOOL_FRAME_PERIOD_NS     3694000u    //TIMING_READOUT_TICKS at 4MHz (3694*1us), fastest device frame period
+
+static volatile sig_atomic_t ccdtoolStop=0;
+
+static void CCDTOOL_OnSignal(int sig)
+{
+    (void)sig;
+    ccdtoolStop=1;
+}
+/******************************************************************************/
+static double CCDTOOL_Seconds(uint64_t ns)
+{
+    return (double)ns*1e-9;
+}
+/******************************************************************************/
+static uint32_t CCDTOOL_Random(uint32_t *state)
+{
+    //xorshift32, reproducible lookup patterns across runs
+    uint32_t x=*state;
+    x^=x<<13;
+    x^=x>>17;
+    x^=x<<5;
+    return *state=x;
+}
+
+/******************************************************************************/
+static int CCDTOOL_Mode(const char *name, unsigned *mode)
+{
+    static const char *modes[]={"frame","peaks","edges","stats","hdr","change"};
+
+    for(unsigned i=0;i<sizeof(modes)/sizeof(modes[0]);i++)
+    {
+        if(strcmp(name,modes[i]))continue;
+        *mode=i;
+        return 0;
+    }
+    return -1;
+}
+/******************************************************************************/
+//Integration time argument in device timer ticks: x10us, or a number with us, ms or s
+static int CCDTOOL_Time(const char *arg, uint32_t *ticks)
+{
+    char *end;
+    double v=strtod(arg,&end), scale;
+
+    if(end==arg)return -1;
+    if(!*end)scale=CCD_TICKS_PER_10US;
+    else if(!strcmp(end,"us"))scale=CCD_TIMER_HZ/1e6;
+    else if(!strcmp(end,"ms"))scale=CCD_TIMER_HZ/1e3;
+    else if(!strcmp(end,"s"))scale=CCD_TIMER_HZ;
+    else return -1;
+    v=v*scale+0.5;
+    if(v<CCD_INTEGRATION_MIN||v>=4294967296.0)return -1;
+    *ticks=(uint32_t)v;
+    return 0;
+}
+
+/******************************************************************************/
+//Why "TIM" rejected a combination, with the bound it violated
+static void CCDTOOL_TimingError(const CCD_TIMING_REPLY *reply)
+{
+    double limit=reply->limit*1e6/CCD_TIMER_HZ;
+
+    switch(reply->status)
+    {
+        case CCD_TIMING_EXPOSURE_SHORT: fprintf(stderr,"TIM: integration time below %.2f us\n",limit); break;
+        case CCD_TIMING_PERIOD_SHORT:   fprintf(stderr,"TIM: frame period below %.2f us (one readout)\n",limit); break;
+        case CCD_TIMING_EXPOSURE_LONG:  fprintf(stderr,"TIM: integration time above the frame period, %.2f us\n",limit); break;
+        case CCD_TIMING_FLUSH_SHORT:    fprintf(stderr,"TIM: integration time leaves a flush period below %.2f us, "
+                                                "at most %.2f us or the whole frame period\n",
+                                                CCD_INTEGRATION_MIN*1e6/CCD_TIMER_HZ,limit); break;
+        default:                        fprintf(stderr,"TIM: rejected, status %u\n",reply->status); break;
+    }
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Recorder commands
+// *****************************************************************************
+// *****************************************************************************
+
+static void CCDTOOL_RecordReport(CCDACQ *acq, uint64_t elapsed, int final)
+{
+    CCDACQ_DEVICE_STATS st[CCDACQ_MAX_DEVICES];
+    CCDACQ_ALIGN_STATS al;
+    double t=CCDTOOL_Seconds(elapsed);
+
+    CCDACQ_Stats(acq,st,&al);
+    if(!final)
+    {
+        fprintf(stderr,"%llu sets  %.1f sets/s  align %.0f us mean\r",(unsigned long long)al.sets,al.sets/t,
+                al.sets?al.spreadSum/1e3/al.sets:0.0);
+        return;
+    }
+    fprintf(stderr,"\n");
+    for(unsigned i=0;i<acq->count;i++)
+    {
+        fprintf(stderr,"device %u %-16s %.1f fps  %.2f MB/s  %llu seq drops  %llu queue drops  %llu unmatched\n",
+                i,acq->device[i].path,st[i].frames/t,st[i].bytes/t/1e6,(unsigned long long)st[i].sequenceDrops,
+                (unsigned long long)st[i].queueDrops,(unsigned long long)st[i].unmatched);
+        fprintf(stderr,"         clock %llu syncs  error +-%.1f us  drift %+.2f ppm\n",
+                (unsigned long long)st[i].syncs,st[i].clockError/1e3,st[i].drift*1e6);
+        if(acq->change)
+            fprintf(stderr,"         %llu frames unchanged, %.1f%% of the device frames sent\n",
+                    (unsigned long long)st[i].unchanged,
+                    st[i].frames+st[i].unchanged?100.0*st[i].frames/(st[i].frames+st[i].unchanged):0.0);
+    }
+    if(acq->count>1)
+        fprintf(stderr,"alignment  %llu sets  mean %.1f us  max %.1f us\n",(unsigned long long)al.sets,
+                al.sets?al.spreadSum/1e3/al.sets:0.0,al.spreadMax/1e3);
+}
+/******************************************************************************/
+static int CCDTOOL_Record(int argc, char **argv)
+{
+    uint32_t integrationTime=CCD_INTEGRATION_MIN, framePeriod=0;
+    unsigned hRes=0, vRes=1, oversampling=1, chunkKiB=CCDREC_CHUNK_SIZE_DEFAULT>>10;
+    unsigned long frames=0, alignUs=0;
+    unsigned mode=CCD_MODE_FRAME, options=0, parameter=CCD_ADC_MAX/2, setpoint=0;
+    int opt;
+
+    while((opt=getopt(argc,argv,"t:f:x:y:s:n:c:a:m:o:p:e:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 't': if(CCDTOOL_Time(optarg,&integrationTime))return 2; break;
+            case 'f': if(CCDTOOL_Time(optarg,&framePeriod))return 2; break;
+            case 'x': hRes=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'y': vRes=(unsigned)strtoul(optarg,NULL,0); break;
+            case 's': oversampling=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            case 'c': chunkKiB=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'a': alignUs=strtoul(optarg,NULL,0); break;
+            case 'm': if(CCDTOOL_Mode(optarg,&mode))return 2; break;
+            case 'o': options=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'p': parameter=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'e': setpoint=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    int devices=argc-optind-1;
+    if(devices<1||devices>CCDACQ_MAX_DEVICES||hRes>5||vRes>CCD_VRES_NATIVE)return 2;
+    if(setpoint>CCD_ADC_MAX)return 2;
+    if(mode==CCD_MODE_CHANGE&&devices>1)       //sets need a frame of every device at once
+    {
+        fprintf(stderr,"record: -m change takes one device\n");
+        return 1;
+    }
+    switch(oversampling)                //v_res bits 4..5, the device lowers it to what its clock allows
+    {
+        case 1: break;
+        case 2: vRes|=1u<<4; break;
+        case 4: vRes|=2u<<4; break;
+        case 8: vRes|=3u<<4; break;
+        default: return 2;
+    }
+    const char *file=argv[argc-1];
+    if(!alignUs)alignUs=framePeriod?(unsigned long)(framePeriod*5e5/CCD_TIMER_HZ):CCDTOOL_FRAME_PERIOD_NS/2000;
+
+    /* One reader per device, sets are aligned on device timestamps */
+    CCDACQ acq;
+    if(CCDACQ_Open(&acq,(const char *const *)&argv[optind],(unsigned)devices,(uint64_t)alignUs*1000u))
+    {
+        perror("open");
+        return 1;
+    }
+    if(CCDACQ_Setup(&acq,integrationTime,(uint8_t)hRes,(uint8_t)vRes))
+    {
+        perror("SET");
+        CCDACQ_Close(&acq);
+        return 1;
+    }
+    CCD_TIMING_REPLY timing;
+    if(framePeriod&&CCDACQ_Timing(&acq,integrationTime,framePeriod,&timing))
+    {
+        if(errno==EINVAL)CCDTOOL_TimingError(&timing);
+        else perror("TIM");
+        CCDACQ_Close(&acq);
+        return 1;
+    }
+    if(CCDACQ_Mode(&acq,(uint8_t)mode,(uint8_t)options,(uint16_t)parameter))
+    {
+        perror("MOD");
+        CCDACQ_Close(&acq);
+        return 1;
+    }
+    if(CCDACQ_Exposure(&acq,setpoint?CCD_EXPOSURE_ENABLE:0,0,(uint16_t)setpoint))
+    {
+        perror("EXP");
+        CCDACQ_Close(&acq);
+        return 1;
+    }
+
+    CCDREC_WRITER *w=CCDREC_Create(file,chunkKiB<<10);
+    if(!w){perror(file);CCDACQ_Close(&acq);return 1;}
+
+    signal(SIGINT,CCDTOOL_OnSignal);
+    if(CCDACQ_Start(&acq)){perror("start");CCDREC_Close(w);CCDACQ_Close(&acq);return 1;}
+
+    uint64_t start=CCDSERIAL_TimeNs(), report=start;
+    unsigned long n=0;
+    int rc=0;
+    while(!ccdtoolStop&&(!frames||n<frames))
+    {
+        CCDACQ_SET set;
+        int got=CCDACQ_Next(&acq,&set,CCDSERIAL_TIMEOUT_MS);
+        if(got<0){perror("FRM");rc=1;break;}
+        if(got)
+        {
+            //all frames of a set share the set sequence so that seeking lands on the first device
+            for(unsigned i=0;i<set.count&&!rc;i++)
+            {
+                const CCDACQ_FRAME *af=set.frame[i];
+                CCDREC_FRAME f;
+                memset(&f,0,sizeof(f));
+                f.sequence=set.sequence;
+                f.payloadLength=af->header.payloadLength;
+                f.timestamp=af->timestamp;
+                f.integrationTime=af->header.integrationTicks;
+                f.deviceTimestamp=af->header.timestamp;
+                f.hRes=af->header.hRes;
+                f.vRes=af->header.vRes;
+                f.format=af->header.format;
+                f.deviceId=(uint8_t)i;
+                f.flags=af->header.flags;
+                //header-only frames keep their statistics as payload
+                const void *payload=af->payload;
+                if(f.format==CCD_FORMAT_STATS)
+                {
+                    payload=&af->header.stats;
+                    f.payloadLength=sizeof(af->header.stats);
+                }
+                if(CCDREC_Append(w,&f,payload)){perror("write");rc=1;}
+            }
+            CCDACQ_Release(&acq,&set);
+            if(rc)break;
+            n++;
+        }
+        uint64_t now=CCDSERIAL_TimeNs();
+        if(now-report>=1000000000u)
+        {
+            CCDTOOL_RecordReport(&acq,now-start,0);
+            report=now;
+        }
+    }
+    CCDTOOL_RecordReport(&acq,CCDSERIAL_TimeNs()-start,1);
+    if(CCDREC_Close(w)){perror("close");rc=1;}
+    CCDACQ_Close(&acq);
+    return rc;
+}
+/******************************************************************************/
+static int CCDTOOL_Info(int argc, char **argv)
+{
+    CCDREC_READER r;
+    uint32_t dense=0;
+
+    if(argc!=2)return 2;
+    if(CCDREC_ReaderOpen(&r,argv[1])){perror(argv[1]);return 1;}
+
+    for(uint32_t i=0;i<r.chunkCount;i++)
+        if(r.chunks[i].flags&CCDREC_CHUNK_DENSE)dense++;
+
+    printf("file        %s (%zu bytes)\n",argv[1],r.size);
+    printf("chunk size  %u\n",r.fileHeader->chunkSize);
+    printf("index       %s\n",r.rebuilt?"rebuilt (recording was not closed)":"trailer");
+    printf("chunks      %u (%u dense)\n",r.chunkCount,dense);
+    printf("frames      %llu\n",(unsigned long long)r.frameCount);
+    if(r.chunkCount)
+    {
+        const CCDREC_CHUNK_ENTRY *a=&r.chunks[0], *b=&r.chunks[r.chunkCount-1];
+        printf("sequence    %u .. %u\n",a->firstSequence,b->lastSequence);
+        printf("duration    %.3f s\n",CCDTOOL_Seconds(b->lastTimestamp-a->firstTimestamp));
+    }
+    CCDREC_ReaderClose(&r);
+    return 0;
+}
+/******************************************************************************/
+static int CCDTOOL_Dump(int argc, char **argv)
+{
+    CCDREC_READER r;
+    CCDREC_VIEW v;
+
+    if(argc!=3)return 2;
+    if(CCDREC_ReaderOpen(&r,argv[1])){perror(argv[1]);return 1;}
+    if(CCDREC_SeekSequence(&r,(uint32_t)strtoul(argv[2],NULL,0),&v))
+    {
+        fprintf(stderr,"sequence %s not found\n",argv[2]);
+        CCDREC_ReaderClose(&r);
+        return 1;
+    }
+    printf("# seq %u  dev %u  t %llu ns  itime %.2f us  h %u  v %u%s%s\n",v.header->sequence,v.header->deviceId,
+           (unsigned long long)v.header->timestamp,CCDREC_IntegrationTicks(&r,v.header)*1e6/CCD_TIMER_HZ,
+           v.header->hRes,v.header->vRes,
+           v.header->flags&CCD_FLAG_CORRECTED?"  corrected":"",
+           v.header->format==CCD_FORMAT_RICE?"  compressed":"");
+    if(v.header->format==CCD_FORMAT_PEAKS)
+    {
+        const CCD_PEAK *p=(const CCD_PEAK *)v.payload;
+        printf("# position height width%s\n",v.header->flags&CCD_FLAG_TRUNCATED?"  (truncated)":"");
+        for(uint32_t i=0;i<v.header->payloadLength/sizeof(CCD_PEAK);i++)
+            printf("%.3f %u %u\n",p[i].position/256.0,p[i].height,p[i].width);
+    }
+    else if(v.header->format==CCD_FORMAT_EDGES)
+    {
+        const CCD_EDGES *e=(const CCD_EDGES *)v.payload;
+        const CCD_EDGE *p=(const CCD_EDGE *)(e+1);
+        printf("# threshold %u  min %u  max %u%s\n",e->threshold,e->minimum,e->maximum,
+               v.header->flags&CCD_FLAG_TRUNCATED?"  (truncated)":"");
+        printf("# position slope edge\n");
+        for(uint32_t i=0;i<e->count;i++)
+            printf("%.3f %u %s\n",p[i].position/256.0,p[i].slope,p[i].rising?"rising":"falling");
+    }
+    else if(v.header->format==CCD_FORMAT_HDR)
+    {
+        const CCD_HDR *h=(const CCD_HDR *)v.payload;
+        const uint16_t *p=(const uint16_t *)(h+1);
+        printf("# hdr %u exposures  itime",h->exposures);
+        for(unsigned j=0;j<h->exposures&&j<CCD_HDR_MAX_EXPOSURES;j++)printf(" %u",h->integrationTime[j]);
+        printf("  dark %u  range %u (%.1f bits, %.1f dB)\n",h->dark,h->dynamicRange,
+               h->dynamicRange?log2(h->dynamicRange):0.0,h->dynamicRange?20*log10(h->dynamicRange):0.0);
+        for(uint32_t i=0;i<(v.header->payloadLength-sizeof(CCD_HDR))/sizeof(uint16_t);i++)
+            printf("%u\n",(unsigned)p[i]<<h->shift);
+    }
+    else if(v.header->format==CCD_FORMAT_STATS)
+    {
+        const CCD_FRAME_STATS *st=(const CCD_FRAME_STATS *)v.payload;
+        printf("# minimum maximum mean saturated(level)\n");
+        printf("%u %u %.1f %u(%u)\n",st->minimum,st->maximum,st->sum/(double)CCD_SIGNAL_COUNT,st->saturated,
+               st->saturationLevel);
+    }
+    else if(v.header->format==CCD_FORMAT_CHANGE)
+    {
+        const CCD_CHANGE *c=(const CCD_CHANGE *)v.payload;
+        printf("# keep-alive, compared with sequence %u\n",c->reference);
+        printf("# unchanged difference deviation peak_deviation minimum maximum mean saturated(level)\n");
+        printf("%u %.2f %u %u %u %u %.1f %u(%u)\n",c->unchanged,c->difference/16.0,c->deviation,c->peakDeviation,
+               c->stats.minimum,c->stats.maximum,c->stats.sum/(double)CCD_SIGNAL_COUNT,c->stats.saturated,
+               c->stats.saturationLevel);
+    }
+    else if(v.header->format==CCD_FORMAT_RICE)
+    {
+        static uint16_t value[CCD_DATA_SIZE];
+        uint16_t n=(uint16_t)(CCD_DATA_SIZE>>(v.header->hRes<=5?v.header->hRes:5));
+        if(v.header->vRes>CCD_VRES_NATIVE||
+           RICE_Decode(v.payload,v.header->payloadLength,n,CCD_RICE_BITS(v.header->vRes),value)<0)
+        {
+            fprintf(stderr,"sequence %s: compressed payload is corrupt\n",argv[2]);
+            CCDREC_ReaderClose(&r);
+            return 1;
+        }
+        for(uint16_t i=0;i<n;i++)printf("%u\n",value[i]);
+    }
+    else if(v.header->vRes==CCD_VRES_NATIVE)
+        for(uint32_t i=0;i+1<v.header->payloadLength;i+=2)
+            printf("%u\n",(unsigned)(v.payload[i]|v.payload[i+1]<<8));
+    else if(v.header->vRes>=2)
+        for(uint32_t i=0;i+1<v.header->payloadLength;i+=2)
+            printf("%u\n",(unsigned)(v.payload[i]<<8|v.payload[i+1]));
+    else
+        for(uint32_t i=0;i<v.header->payloadLength;i++)
+            printf("%u\n",v.payload[i]);
+    CCDREC_ReaderClose(&r);
+    return 0;
+}
+/******************************************************************************/
+static int CCDTOOL_BenchWrite(int argc, char **argv)
+{
+    unsigned long frames=100000;
+    unsigned chunkKiB=CCDREC_CHUNK_SIZE_DEFAULT>>10, vRes=3;
+    int opt;
+
+    while((opt=getopt(argc,argv,"n:c:y:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            case 'c': chunkKiB=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'y': vRes=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||vRes>CCD_VRES_NATIVE)return 2;
+
+    CCDREC_WRITER *w=CCDREC_Create(argv[optind],chunkKiB<<10);
+    if(!w){perror(argv[optind]);return 1;}
+
+    size_t len=CCDSERIAL_PayloadSize(0,(uint8_t)vRes);
+    uint8_t *payload=malloc(len);
+    uint32_t seed=1;
+    for(size_t i=0;i<len;i++)payload[i]=(uint8_t)CCDTOOL_Random(&seed);
+
+    CCDREC_FRAME f;
+    memset(&f,0,sizeof(f));
+    f.payloadLength=(uint32_t)len;
+    f.integrationTime=CCD_INTEGRATION_MIN;
+    f.vRes=(uint8_t)vRes;
+
+    uint64_t start=CCDSERIAL_TimeNs();
+    int rc=0;
+    for(unsigned long n=0;n<frames;n++)
+    {
+        f.sequence=(uint32_t)n;
+        f.timestamp=start+(uint64_t)n*CCDTOOL_FRAME_PERIOD_NS;
+        payload[n%len]^=(uint8_t)n;
+        if(CCDREC_Append(w,&f,payload)){perror("write");rc=1;break;}
+    }
+    uint64_t bytes=CCDREC_BytesWritten(w);
+    if(CCDREC_Close(w)){perror("close");rc=1;}
+    double t=CCDTOOL_Seconds(CCDSERIAL_TimeNs()-start);
+
+    double fps=frames/t;
+    printf("frames      %lu x %zu bytes\n",frames,len);
+    printf("elapsed     %.3f s\n",t);
+    printf("throughput  %.0f frames/s  %.1f MB/s\n",fps,bytes/t/1e6);
+    printf("headroom    %.0fx device full frame rate (%.1f fps)\n",fps*CCDTOOL_FRAME_PERIOD_NS*1e-9,1e9/CCDTOOL_FRAME_PERIOD_NS);
+    printf("memory      %u KiB chunk buffers\n",CCDREC_WRITE_BUFFERS*chunkKiB);
+    free(payload);
+    return rc;
+}
+/******************************************************************************/
+static int CCDTOOL_BenchRead(int argc, char **argv)
+{
+    unsigned long lookups=1000000;
+    int opt;
+
+    while((opt=getopt(argc,argv,"n:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': lookups=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1)return 2;
+
+    CCDREC_READER r;
+    if(CCDREC_ReaderOpen(&r,argv[optind])){perror(argv[optind]);return 1;}
+    if(!r.chunkCount){fprintf(stderr,"empty recording\n");CCDREC_ReaderClose(&r);return 1;}
+
+    uint32_t first=r.chunks[0].firstSequence, last=r.chunks[r.chunkCount-1].lastSequence;
+    uint64_t t0=r.chunks[0].firstTimestamp, t1=r.chunks[r.chunkCount-1].lastTimestamp;
+    uint32_t seed=12345;
+    uint64_t bytes=0, sum=0;
+    unsigned long found=0;
+    CCDREC_VIEW v;
+
+    /* Random seek by sequence, touching every payload byte */
+    uint64_t start=CCDSERIAL_TimeNs();
+    for(unsigned long i=0;i<lookups;i++)
+    {
+        uint32_t seq=first+CCDTOOL_Random(&seed)%(last-first+1);
+        if(CCDREC_SeekSequence(&r,seq,&v))continue;
+        found++;
+        bytes+=v.header->payloadLength;
+        for(uint32_t k=0;k<v.header->payloadLength;k++)sum+=v.payload[k];
+    }
+    double ts=CCDTOOL_Seconds(CCDSERIAL_TimeNs()-start);
+
+    /* Random seek by time, header only */
+    start=CCDSERIAL_TimeNs();
+    for(unsigned long i=0;i<lookups;i++)
+    {
+        uint64_t t=t0+(((uint64_t)CCDTOOL_Random(&seed)<<32|CCDTOOL_Random(&seed))%(t1-t0+1));
+        if(!CCDREC_SeekTime(&r,t,&v))sum+=v.header->sequence;
+    }
+    double tt=CCDTOOL_Seconds(CCDSERIAL_TimeNs()-start);
+
+    printf("frames      %llu in %u chunks\n",(unsigned long long)r.frameCount,r.chunkCount);
+    printf("by sequence %.2f M lookups/s  %.1f MB/s payload  (%lu/%lu found)\n",lookups/ts/1e6,bytes/ts/1e6,found,lookups);
+    printf("by time     %.2f M lookups/s\n",lookups/tt/1e6);
+    printf("checksum    %llu\n",(unsigned long long)sum);
+    CCDREC_ReaderClose(&r);
+    return 0;
+}
+
+static int CCDTOOL_Sync(int argc, char **argv)
+{
+    unsigned long count=20, intervalMs=100;
+    int opt;
+
+    while((opt=getopt(argc,argv,"n:i:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': count=strtoul(optarg,NULL,0); break;
+            case 'i': intervalMs=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||!count)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+
+    CCDCLOCK clock;
+    int64_t first=0;
+    CCDCLOCK_Init(&clock);
+    signal(SIGINT,CCDTOOL_OnSignal);
+    printf("%6s %14s %10s %10s %10s\n","n","d.offset ns","delay us","error us","drift ppm");
+    for(unsigned long n=0;n<count&&!ccdtoolStop;n++)
+    {
+        CCD_SYNC_REPLY reply;
+        uint64_t tx, rx;
+        if(CCDSERIAL_Sync(fd,&tx,&reply,&rx)){perror("SYN");CCDSERIAL_Close(fd);return 1;}
+        CCDCLOCK_Sync(&clock,tx,&reply,rx);
+
+        //offsets relative to the first exchange, the absolute value is the device uptime
+        const CCDCLOCK_SYNC *s=&clock.sync[(clock.syncNext+CCDCLOCK_SYNC_WINDOW-1)%CCDCLOCK_SYNC_WINDOW];
+        if(!n)first=s->offset;
+        printf("%6lu %14lld %10.1f %10.1f %10.2f\n",n,(long long)(s->offset-first),
+               s->delay/1e3,clock.error/1e3,clock.drift*1e6);
+        if(n+1<count)usleep((useconds_t)intervalMs*1000);
+    }
+    printf("fastest round trip %.1f us, mapping error +-%.1f us, drift %+.2f ppm\n",
+           clock.minDelay/1e3,clock.error/1e3,clock.drift*1e6);
+    CCDSERIAL_Close(fd);
+    return 0;
+}
+/******************************************************************************/
+static int CCDTOOL_Stats(int argc, char **argv)
+{
+    unsigned long count=100;
+    uint32_t integrationTime=0, framePeriod=0;
+    unsigned level=0, options=0, setpoint=0, maximum=0;
+    int opt;
+
+    while((opt=getopt(argc,argv,"n:t:f:l:ie:M:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': count=strtoul(optarg,NULL,0); break;
+            case 't': if(CCDTOOL_Time(optarg,&integrationTime))return 2; break;
+            case 'f': if(CCDTOOL_Time(optarg,&framePeriod))return 2; break;
+            case 'l': level=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'i': options|=CCD_STATS_INVERT; break;
+            case 'e': setpoint=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'M': maximum=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||level>CCD_ADC_MAX||setpoint>CCD_ADC_MAX||maximum>0xFFFF)return 2;
+    if(framePeriod&&!integrationTime)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+    if(integrationTime&&CCDSERIAL_Setup(fd,integrationTime,0,1)){perror("SET");CCDSERIAL_Close(fd);return 1;}
+    if(framePeriod)
+    {
+        CCD_TIMING_REPLY timing;
+        if(CCDSERIAL_Timing(fd,integrationTime,framePeriod,&timing)){perror("TIM");CCDSERIAL_Close(fd);return 1;}
+        if(timing.status!=CCD_TIMING_OK){CCDTOOL_TimingError(&timing);CCDSERIAL_Close(fd);return 1;}
+    }
+    if(CCDSERIAL_Mode(fd,CCD_MODE_STATS,(uint8_t)options,(uint16_t)level)){perror("MOD");CCDSERIAL_Close(fd);return 1;}
+    //the saturation option applies to the exposure peak too
+    uint8_t exposure=setpoint?CCD_EXPOSURE_ENABLE|(options&CCD_STATS_INVERT?CCD_EXPOSURE_INVERT:0):0;
+    if(CCDSERIAL_Exposure(fd,exposure,(uint16_t)maximum,(uint16_t)setpoint)){perror("EXP");CCDSERIAL_Close(fd);return 1;}
+
+    //header only, no payload expected
+    CCD_FRAME_HEADER h;
+    uint8_t payload[CCDSERIAL_DATA_SIZE*2];
+    uint64_t bytes=0;
+    signal(SIGINT,CCDTOOL_OnSignal);
+    printf("%10s %8s %8s %8s %10s %10s\n","sequence","minimum","maximum","mean","saturated","itime us");
+    for(unsigned long n=0;(!count||n<count)&&!ccdtoolStop;n++)
+    {
+        if(CCDSERIAL_GetFrame(fd,&h,payload,sizeof(payload))){perror("FRM");CCDSERIAL_Close(fd);return 1;}
+        if(h.version<2)
+        {
+            fprintf(stderr,"firmware sends no statistics (header version %u)\n",h.version);
+            CCDSERIAL_Close(fd);
+            return 1;
+        }
+        bytes+=h.headerSize+h.payloadLength;
+        printf("%10u %8u %8u %8.1f %10u %10.2f%s\n",h.sequence,h.stats.minimum,h.stats.maximum,
+               h.stats.sum/(double)CCD_SIGNAL_COUNT,h.stats.saturated,h.integrationTicks*1e6/CCD_TIMER_HZ,
+               h.flags&CCD_FLAG_AUTO_EXPOSURE?" auto":"");
+        if(count&&n+1==count)printf("%.1f bytes per frame\n",(double)bytes/count);
+    }
+    CCDSERIAL_Close(fd);
+    return 0;
+}
+/******************************************************************************/
+static int CCDTOOL_Timing(int argc, char **argv)
+{
+    uint32_t integrationTime=CCD_INTEGRATION_MIN, framePeriod=0;
+    int opt;
+
+    while((opt=getopt(argc,argv,"t:f:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 't': if(CCDTOOL_Time(optarg,&integrationTime))return 2; break;
+            case 'f': if(CCDTOOL_Time(optarg,&framePeriod))return 2; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+    CCD_TIMING_REPLY reply;
+    if(CCDSERIAL_Timing(fd,integrationTime,framePeriod,&reply)){perror("TIM");CCDSERIAL_Close(fd);return 1;}
+    CCDSERIAL_Close(fd);
+
+    int rc=0;
+    if(reply.status!=CCD_TIMING_OK)
+    {
+        CCDTOOL_TimingError(&reply);
+        fprintf(stderr,"kept:\n");
+        rc=1;
+    }
+    printf("integration time %12.2f us  (%u ticks)\n",reply.integrationTime*1e6/CCD_TIMER_HZ,reply.integrationTime);
+    printf("frame period     %12.2f us  (%u ticks)%s\n",reply.framePeriod*1e6/CCD_TIMER_HZ,reply.framePeriod,
+           reply.status==CCD_TIMING_OK&&!framePeriod?", free running":"");
+    printf("flush periods    %12u per frame",reply.flushes);
+    if(reply.framePeriod)printf(", %.3f frames/s",(double)CCD_TIMER_HZ/reply.framePeriod);
+    printf("\n");
+    return rc;
+}
+/******************************************************************************/
+//Master clock argument in MHz, one of the CCD_CLOCK_xxx modes
+static int CCDTOOL_ClockMode(const char *arg, uint8_t *mode)
+{
+    char *end;
+    double mhz=strtod(arg,&end);
+
+    if(end==arg||*end)return -1;
+    for(uint8_t m=0;m<CCD_CLOCK_MODES;m++)
+    {
+        if(fabs((double)CCD_CLOCK_BASE_HZ/CCD_CLOCK_DIVIDER(m)/1e6-mhz)>1e-3)continue;
+        *mode=m;
+        return 0;
+    }
+    return -1;
+}
+/******************************************************************************/
+static void CCDTOOL_ClockPrint(const CCD_CLOCK_REPLY *r)
+{
+    double readout=r->readoutTicks*1e3/CCD_TIMER_HZ, capture=r->captureTicks*1e3/CCD_TIMESTAMP_HZ;
+    double output=4e6/r->masterClock;
+    unsigned cores=r->cores?r->cores:1, slots=r->oversampling>cores?r->oversampling/cores:1;
+
+    printf("master clock  %8.3f MHz, %.2f us per output\n",r->masterClock/1e6,output);
+    printf("readout       %8.2f ms, shortest frame period %.2f ms (%.1f frames/s)\n",readout,
+           r->framePeriodMin*1e3/CCD_TIMER_HZ,(double)CCD_TIMER_HZ/r->framePeriodMin);
+    printf("ADC           %8u ns sampling and conversion, %u core%s triggered every %.0f ns, phase %u/%u\n",
+           r->adcConversion,cores,cores>1?"s":"",output*1000/slots,r->phase,CCD_PHASE_STEPS);
+    printf("oversampling  %8u conversions per output, %.3f Msamples/s during a readout\n",
+           r->oversampling,r->conversionRate/1e6);
+    printf("capture       %8.2f ms in the ADC interrupt per readout (%.1f %% CPU), %u overruns\n",
+           capture,readout>0?capture/readout*100:0.0,r->overruns);
+}
+/******************************************************************************/
+//Device frame rate from sequence numbers and timestamps of n header-only frames
+static int CCDTOOL_ClockRate(int fd, unsigned long n, double *fps)
+{
+    CCD_FRAME_HEADER h;
+    uint8_t payload[CCDSERIAL_DATA_SIZE*2];
+    uint32_t seq=0, ts=0;
+
+    for(unsigned long i=0;i<n+3;i++)
+    {
+        if(CCDSERIAL_GetFrame(fd,&h,payload,sizeof(payload)))return -1;
+        if(i==3)                        //the new schedule runs from the next ICG pulse on
+        {
+            seq=h.sequence;
+            ts=h.timestamp;
+        }
+    }
+    uint32_t dt=h.timestamp-ts;
+    *fps=dt?(h.sequence-seq)*(double)CCD_TIMESTAMP_HZ/dt:0;
+    return 0;
+}
+/******************************************************************************/
+static int CCDTOOL_Clock(int argc, char **argv)
+{
+    uint8_t mode=CCD_CLOCK_QUERY;
+    unsigned long frames=0;
+    int opt;
+
+    while((opt=getopt(argc,argv,"c:s:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'c': if(CCDTOOL_ClockMode(optarg,&mode))return 2; break;
+            case 's': frames=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+    CCD_CLOCK_REPLY reply;
+    if(CCDSERIAL_Clock(fd,mode,&reply)){perror("CLK");CCDSERIAL_Close(fd);return 1;}
+    if(reply.status==CCD_CLOCK_PERIOD_SHORT)
+        fprintf(stderr,"CLK: frame period in effect is too short for the readout, kept:\n");
+    else if(reply.status!=CCD_CLOCK_OK)fprintf(stderr,"CLK: refused, status %u, kept:\n",reply.status);
+    CCDTOOL_ClockPrint(&reply);
+    if(!frames||reply.status!=CCD_CLOCK_OK)
+    {
+        CCDSERIAL_Close(fd);
+        return reply.status==CCD_CLOCK_OK?0:1;
+    }
+
+    //every mode free running at the shortest integration time, header only frames
+    uint8_t kept=reply.mode;
+    int rc=0;
+    printf("\n%8s %9s %10s %8s %8s %9s %8s %9s\n","f_M MHz","output us","readout ms","max fps","fps",
+           "capture %","overruns","12b MB/s");
+    if(CCDSERIAL_Mode(fd,CCD_MODE_STATS,0,0)){perror("MOD");CCDSERIAL_Close(fd);return 1;}
+    for(uint8_t m=0;m<CCD_CLOCK_MODES&&!rc;m++)
+    {
+        CCD_CLOCK_REPLY before, after;
+        double fps;
+        if(CCDSERIAL_Setup(fd,CCD_INTEGRATION_MIN,0,3)||CCDSERIAL_Clock(fd,m,&before)||before.status!=CCD_CLOCK_OK||
+           CCDTOOL_ClockRate(fd,frames,&fps)||CCDSERIAL_Clock(fd,CCD_CLOCK_QUERY,&after))
+        {
+            perror("CLK");
+            rc=1;
+            break;
+        }
+        double readout=after.readoutTicks*1e3/CCD_TIMER_HZ, maxFps=(double)CCD_TIMER_HZ/after.framePeriodMin;
+        printf("%8.3f %9.2f %10.2f %8.1f %8.1f %9.1f %8u %9.2f\n",after.masterClock/1e6,4e6/after.masterClock,
+               readout,maxFps,fps,after.captureTicks*1e3/CCD_TIMESTAMP_HZ/readout*100,after.overruns-before.overruns,
+               CCDSERIAL_PayloadSize(0,3)*maxFps/1e6);
+    }
+    if(CCDSERIAL_Clock(fd,kept,&reply)||CCDSERIAL_Mode(fd,CCD_MODE_FRAME,0,0)){perror("CLK");rc=1;}
+    CCDSERIAL_Close(fd);
+    return rc;
+}
+/******************************************************************************/
+static int CCDTOOL_Calibrate(int argc, char **argv)
+{
+    static const char *operations[]={"dark","flat","save","clear","on","bench"};
+    static const char *status[]={"ok","bad request","no dark table","flash error"};
+    unsigned long frames=16;
+    uint8_t options=0;
+    int opt;
+
+    while((opt=getopt(argc,argv,"n:i"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            case 'i': options|=CCD_CAL_INVERT; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=2||!frames||frames>255)return 2;
+
+    //"off" is ENABLE without CCD_CAL_ON
+    const char *name=argv[optind];
+    unsigned op=0;
+    while(op<sizeof(operations)/sizeof(operations[0])&&strcmp(name,operations[op]))op++;
+    if(!strcmp(name,"off"))op=CCD_CAL_ENABLE;
+    else if(op==CCD_CAL_ENABLE)options=CCD_CAL_ON;
+    else if(op>=sizeof(operations)/sizeof(operations[0]))return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind+1]);
+    if(fd<0){perror(argv[optind+1]);return 1;}
+
+    //DARK and FLAT take frames readouts of up to 655 ms, SAVE erases and programs a flash page
+    CCD_CAL_REPLY reply;
+    int timeoutMs=CCDSERIAL_TIMEOUT_MS+(op<=CCD_CAL_FLAT?(int)frames*700:0);
+    if(CCDSERIAL_Calibrate(fd,(uint8_t)op,(uint8_t)frames,options,&reply,timeoutMs))
+    {
+        perror("CAL");
+        CCDSERIAL_Close(fd);
+        return 1;
+    }
+    CCDSERIAL_Close(fd);
+
+    printf("%s: %s",name,reply.status<sizeof(status)/sizeof(status[0])?status[reply.status]:"unknown status");
+    if(op<=CCD_CAL_FLAT&&reply.status==CCD_CAL_OK)printf(", %u frames averaged",reply.frames);
+    if(op==CCD_CAL_BENCH)
+        printf(", correction adds %u CPU cycles per frame (%.1f per sample)",reply.value,
+               reply.value/(double)CCD_DATA_SIZE);
+    printf("\n");
+    return reply.status==CCD_CAL_OK?0:1;
+}
+/******************************************************************************/
+static void CCDTOOL_AdcPrint(const CCD_ADC_REPLY *r)
+{
+    double f=1.0/(1<<INTERLEAVE_FINE_SHIFT);
+
+    printf("cores         %8u, %u conversions per output, %.3f Msamples/s during a readout\n",
+           r->cores,r->oversampling,r->conversionRate/1e6);
+    printf("pixel rate    %8.3f Mpixels/s at most with this oversampling\n",r->pixelRateMax/1e6);
+    printf("match         ADC1*%.5f%+.2f LSB\n",r->gain/(double)INTERLEAVE_GAIN_ONE,r->offset*f);
+    if(r->operation==CCD_ADC_MATCH||r->operation==CCD_ADC_CHECK)
+        printf("mismatch      %8.2f LSB mean, %.2f LSB rms over %u frames%s\n",r->mean*f,r->mismatch*f,r->frames,
+               r->operation==CCD_ADC_MATCH?" (before the match)":"");
+    if(r->operation==CCD_ADC_MATCH)
+        printf("residual      %8.2f LSB rms after the match\n",r->residual*f);
+}
+/******************************************************************************/
+//Selects the cores first, then matches and checks them. MATCH needs a scene with a
+//range of levels, CHECK is meant for the same or another scene afterwards.
+static int CCDTOOL_Adc(int argc, char **argv)
+{
+    static const char *status[]={"ok","bad request","needs two cores","flat scene, offset matched only"};
+    unsigned long cores=0, matchFrames=0, checkFrames=0;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"c:m:k:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'c': cores=strtoul(optarg,NULL,0); break;
+            case 'm': matchFrames=strtoul(optarg,NULL,0); break;
+            case 'k': checkFrames=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||cores>CCD_ADC_CORES_MAX||matchFrames>255||checkFrames>255)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+
+    //MATCH and CHECK take frames readouts of up to 655 ms, the new cores start at the next one
+    struct {uint8_t operation; unsigned long arg;} steps[]=
+    {
+        {CCD_ADC_CORES,cores},{CCD_ADC_MATCH,matchFrames},{CCD_ADC_CHECK,checkFrames},
+        {CCD_ADC_QUERY,!cores&&!matchFrames&&!checkFrames},
+    };
+    for(unsigned i=0;i<sizeof(steps)/sizeof(steps[0])&&!rc;i++)
+    {
+        CCD_ADC_REPLY reply;
+        if(!steps[i].arg)continue;
+        uint8_t frames=steps[i].operation==CCD_ADC_CORES?0:(uint8_t)steps[i].arg;
+        int timeoutMs=CCDSERIAL_TIMEOUT_MS+(int)frames*700+(frames?700:0);
+        if(CCDSERIAL_Adc(fd,steps[i].operation,(uint8_t)steps[i].arg,frames,&reply,timeoutMs))
+        {
+            perror("ADC");
+            rc=1;
+            break;
+        }
+        if(reply.status!=CCD_ADC_OK)
+        {
+            fprintf(stderr,"ADC: %s\n",reply.status<sizeof(status)/sizeof(status[0])?status[reply.status]:"unknown status");
+            if(reply.status!=CCD_ADC_FLAT){rc=1;break;}
+        }
+        if(steps[i].operation!=CCD_ADC_CORES||(!matchFrames&&!checkFrames))CCDTOOL_AdcPrint(&reply);
+    }
+    CCDSERIAL_Close(fd);
+    return rc;
+}
+/******************************************************************************/
+//Signal, noise and signal to noise ratio per phase, best and previous phase marked
+static void CCDTOOL_PhasePrint(const uint16_t *signal, const uint32_t *noise, double spacingNs,
+                               uint8_t best, uint8_t previous)
+{
+    printf("phase  trigger   signal    noise      SNR\n");
+    printf("          [ns]    [LSB] [LSB rms]    [dB]\n");
+    for(uint8_t k=0;k<CCD_PHASE_STEPS;k++)
+    {
+        double s=signal[k]/16.0, n=sqrt(noise[k]?noise[k]:1)/16.0;
+        printf("%5u %7.1f %8.2f %8.3f %8.2f%s%s\n",k,spacingNs*k/CCD_PHASE_STEPS,s,n,s>0?20*log10(s/n):0.0,
+               k==best?"  best":"",k==previous?"  previous":"");
+    }
+}
+/******************************************************************************/
+//Sweeps the sampling phase unless -p sets or -q queries it. -t sets a free running
+//integration time first, the shortest one gives the highest frame rate.
+static int CCDTOOL_Phase(int argc, char **argv)
+{
+    static const char *status[]={"ok","bad request","no signal, phase kept","not in HDR mode"};
+    unsigned long frames=8, phase=0;
+    uint32_t integrationTime=0;
+    uint8_t operation=CCD_PHASE_SWEEP;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:t:p:q"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            case 't': if(CCDTOOL_Time(optarg,&integrationTime))return 2; break;
+            case 'p': phase=strtoul(optarg,NULL,0); operation=CCD_PHASE_SET; break;
+            case 'q': operation=CCD_PHASE_QUERY; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||frames<2||frames>255||phase>=CCD_PHASE_STEPS)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+
+    //every phase takes its frames plus the one read out while it was switched
+    double framePeriod=0.7;
+    if(integrationTime)
+    {
+        CCD_TIMING_REPLY timing;
+        if(CCDSERIAL_Timing(fd,integrationTime,0,&timing)){perror("TIM");CCDSERIAL_Close(fd);return 1;}
+        if(timing.status!=CCD_TIMING_OK)
+        {
+            CCDTOOL_TimingError(&timing);
+            CCDSERIAL_Close(fd);
+            return 1;
+        }
+        framePeriod=(double)timing.framePeriod/CCD_TIMER_HZ;
+    }
+    int timeoutMs=CCDSERIAL_TIMEOUT_MS;
+    if(operation==CCD_PHASE_SWEEP)timeoutMs+=(int)(CCD_PHASE_STEPS*(frames+2)*framePeriod*1e3);
+
+    CCD_PHASE_REPLY reply;
+    uint64_t t0=CCDSERIAL_TimeNs();
+    if(CCDSERIAL_Phase(fd,operation,(uint8_t)frames,(uint8_t)phase,&reply,timeoutMs))
+    {
+        perror("PHS");
+        CCDSERIAL_Close(fd);
+        return 1;
+    }
+    double elapsed=(CCDSERIAL_TimeNs()-t0)/1e9;
+    CCDSERIAL_Close(fd);
+
+    if(reply.status!=CCD_PHASE_OK)
+    {
+        fprintf(stderr,"PHS: %s\n",reply.status<sizeof(status)/sizeof(status[0])?status[reply.status]:"unknown status");
+        rc=1;
+    }
+    if(operation==CCD_PHASE_SWEEP&&reply.status<=CCD_PHASE_DARK&&reply.frames)
+    {
+        CCDTOOL_PhasePrint(reply.signal,reply.noise,reply.spacing,reply.status==CCD_PHASE_OK?reply.phase:CCD_PHASE_STEPS,
+                           reply.previous);
+        printf("sweep         %u frames per phase in %.2f s\n",reply.frames,elapsed);
+        if(reply.status==CCD_PHASE_OK)
+        {
+            double nBefore=sqrt(reply.noise[reply.previous]?reply.noise[reply.previous]:1)/16;
+            double nAfter=sqrt(reply.noise[reply.phase]?reply.noise[reply.phase]:1)/16;
+            double snrBefore=reply.signal[reply.previous]/16.0/nBefore, snrAfter=reply.signal[reply.phase]/16.0/nAfter;
+            printf("noise         %.3f -> %.3f LSB rms, SNR %+.2f dB (phase %u -> %u)\n",nBefore,nAfter,
+                   snrBefore>0?20*log10(snrAfter/snrBefore):0.0,reply.previous,reply.phase);
+        }
+    }
+    printf("phase         %u of %u, trigger %.1f ns into every %u ns conversion spacing\n",reply.phase,
+           CCD_PHASE_STEPS,reply.spacing*(double)reply.phase/CCD_PHASE_STEPS,reply.spacing);
+    return rc;
+}
+/******************************************************************************/
+//Counts, maxima and histograms of every interrupt source, ticks are CORETIMER (10ns)
+static void CCDTOOL_IrqPrint(const CCD_IRQ_REPLY *r)
+{
+    static const char *names[CCD_IRQ_SOURCES]={"ADC","SH/ICG","USB","USB DMA"};
+    double seconds=r->elapsed/1e3, us=1e6/CCD_TIMESTAMP_HZ;
+
+    printf("source  ipl      count   per s  latency max  duration max\n");
+    for(unsigned k=0;k<CCD_IRQ_SOURCES;k++)
+    {
+        const CCD_IRQ_SOURCE *s=&r->source[k];
+        printf("%-7s %3u %10u %7.0f %9.2f us %10.2f us\n",names[k],r->priority[k],s->count,
+               seconds>0?s->count/seconds:0.0,s->latencyMax*us,s->durationMax*us);
+    }
+    printf("\n%-17s","ticks");
+    for(unsigned k=0;k<CCD_IRQ_SOURCES;k++)printf(" %8s lat %8s dur",names[k],names[k]);
+    printf("\n");
+    for(unsigned i=0;i<CCD_IRQ_BINS;i++)
+    {
+        unsigned used=0;
+        for(unsigned k=0;k<CCD_IRQ_SOURCES;k++)used|=r->source[k].latency[i]|r->source[k].duration[i];
+        if(!used)continue;
+        if(i==0)printf("%-17s","0");
+        else if(i==CCD_IRQ_BINS-1)printf("%6u and more    ",1u<<(i-1));
+        else printf("%6u..%-9u",1u<<(i-1),(1u<<i)-1);
+        for(unsigned k=0;k<CCD_IRQ_SOURCES;k++)
+            printf(" %12u %12u",r->source[k].latency[i],r->source[k].duration[i]);
+        printf("\n");
+    }
+    printf("\nover %.2f s: %u ADC conversions missed, %u readouts cut short since power up\n",seconds,
+           r->missed,r->overruns);
+}
+/******************************************************************************/
+//Without -s reports the histograms since the last reset (-r starts them over). -s
+//resets them, streams full frames for seconds and fails if a conversion was missed
+//or a readout cut short meanwhile.
+static int CCDTOOL_Irq(int argc, char **argv)
+{
+    double seconds=0;
+    int reset=0, opt;
+
+    while((opt=getopt(argc,argv,"s:r"))!=-1)
+    {
+        switch(opt)
+        {
+            case 's': seconds=strtod(optarg,NULL); break;
+            case 'r': reset=1; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||seconds<0||seconds>40)return 2;    //the device reports up to 42.9 s
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+
+    CCD_IRQ_REPLY before, reply;
+    if(seconds>0)
+    {
+        if(CCDSERIAL_Mode(fd,CCD_MODE_FRAME,0,0)||CCDSERIAL_Irq(fd,CCD_IRQ_RESET,&before))
+        {
+            perror("IRQ");
+            CCDSERIAL_Close(fd);
+            return 1;
+        }
+        CCD_FRAME_HEADER h;
+        static uint8_t payload[CCDSERIAL_DATA_SIZE*2];
+        uint64_t bytes=0, t0=CCDSERIAL_TimeNs(), t=t0;
+        unsigned long frames=0;
+        signal(SIGINT,CCDTOOL_OnSignal);
+        while(t-t0<(uint64_t)(seconds*1e9)&&!ccdtoolStop)
+        {
+            if(CCDSERIAL_GetFrame(fd,&h,payload,sizeof(payload))){perror("FRM");CCDSERIAL_Close(fd);return 1;}
+            bytes+=h.headerSize+h.payloadLength;
+            frames++;
+            t=CCDSERIAL_TimeNs();
+        }
+        printf("streamed      %lu frames, %.2f MB/s\n\n",frames,t>t0?bytes*1e3/(t-t0):0.0);
+    }
+    if(CCDSERIAL_Irq(fd,reset?CCD_IRQ_RESET:CCD_IRQ_QUERY,&reply))
+    {
+        perror("IRQ");
+        CCDSERIAL_Close(fd);
+        return 1;
+    }
+    CCDSERIAL_Close(fd);
+    CCDTOOL_IrqPrint(&reply);
+    if(seconds>0&&(reply.missed||reply.overruns!=before.overruns))
+    {
+        fprintf(stderr,"IRQ: samples lost while streaming\n");
+        return 1;
+    }
+    return 0;
+}
+/******************************************************************************/
+//One line of rates between two "STA" replies, counters wrap modulo 2^32
+static void CCDTOOL_StatusLine(const CCD_STATUS_REPLY *a, const CCD_STATUS_REPLY *b)
+{
+    uint32_t ticks=b->timestamp-a->timestamp, isr[CCD_IRQ_SOURCES], busy=0;
+    double s=(double)ticks/CCD_TIMESTAMP_HZ, pct=ticks?100.0/ticks:0.0;
+
+    if(s<=0)return;
+    for(unsigned k=0;k<CCD_IRQ_SOURCES;k++)busy+=isr[k]=b->isrTicks[k]-a->isrTicks[k];
+    uint32_t idle=b->idleTicks-a->idleTicks;
+    double main=100.0-(busy+idle)*pct;
+    printf("%6.1f %6.1f %6.1f %4u %4u %7.2f %6.0f %6.0f  %5.1f %5.1f %5.1f %5.1f %5.1f %5.1f %2u\n",
+           (b->framesCaptured-a->framesCaptured)/s,(b->framesSent-a->framesSent)/s,
+           (b->framesSkipped-a->framesSkipped)/s,b->overruns-a->overruns,b->samplesMissed-a->samplesMissed,
+           (b->usbBytesSent-a->usbBytesSent)/s/1e6,(b->usbCommands-a->usbCommands)/s,(b->loops-a->loops)/s,
+           isr[CCD_IRQ_ADC]*pct,isr[CCD_IRQ_SH]*pct,(isr[CCD_IRQ_USB]+isr[CCD_IRQ_USB_DMA])*pct,
+           main>0?main:0.0,idle*pct,busy*pct,b->framesQueued);
+}
+/******************************************************************************/
+//CCD_FRAME_RICE figures between two "STA" replies
+static void CCDTOOL_StatusCompression(const CCD_STATUS_REPLY *a, const CCD_STATUS_REPLY *b)
+{
+    uint32_t frames=b->compressFrames-a->compressFrames, values=b->compressValues-a->compressValues;
+    uint32_t coded=b->compressBytes-a->compressBytes;
+
+    if(!frames)return;
+    printf("compression   %u frames coded, %u sent raw, %.2f:1, %.1f CPU cycles per value\n",frames,
+           b->compressFallbacks-a->compressFallbacks,coded?(double)(b->compressRawBytes-a->compressRawBytes)/coded:0.0,
+           values?2.0*(b->compressTicks-a->compressTicks)/values:0.0);
+}
+/******************************************************************************/
+//Without -s prints the counters once. -s polls them at -r Hz (100) for seconds and
+//prints their rates every second, -f streams full frames in between so the load
+//is the one of an acquisition, -z compressed (CCD_FRAME_RICE).
+static int CCDTOOL_Status(int argc, char **argv)
+{
+    double seconds=0, rate=100;
+    int stream=0, compress=0, opt;
+
+    while((opt=getopt(argc,argv,"s:r:fz"))!=-1)
+    {
+        switch(opt)
+        {
+            case 's': seconds=strtod(optarg,NULL); break;
+            case 'r': rate=strtod(optarg,NULL); break;
+            case 'f': stream=1; break;
+            case 'z': stream=compress=1; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||seconds<0||rate<=0||rate>1000)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+
+    CCD_STATUS_REPLY first, last, cur;
+    if((stream&&CCDSERIAL_Mode(fd,CCD_MODE_FRAME,compress?CCD_FRAME_RICE:0,0))||CCDSERIAL_Status(fd,&first))
+    {
+        perror("STA");
+        CCDSERIAL_Close(fd);
+        return 1;
+    }
+    if(seconds==0)
+    {
+        CCDSERIAL_Close(fd);
+        printf("frames        %u captured, %u sent, %u skipped, %u queued\n",first.framesCaptured,
+               first.framesSent,first.framesSkipped,first.framesQueued);
+        printf("lost          %u readouts cut short, %u ADC conversions missed\n",first.overruns,first.samplesMissed);
+        printf("usb           %u bytes sent, %u received, %u commands\n",first.usbBytesSent,
+               first.usbBytesReceived,first.usbCommands);
+        printf("cpu ticks     ADC %u, SH %u, USB %u, USB DMA %u, idle %u (wrap at 2^32)\n",
+               first.isrTicks[CCD_IRQ_ADC],first.isrTicks[CCD_IRQ_SH],first.isrTicks[CCD_IRQ_USB],
+               first.isrTicks[CCD_IRQ_USB_DMA],first.idleTicks);
+        printf("main loop     %u passes\n",first.loops);
+        if(first.framesUnchanged)printf("unchanged     %u frames held back\n",first.framesUnchanged);
+        CCDTOOL_StatusCompression(&(CCD_STATUS_REPLY){0},&first);
+        return 0;
+    }
+
+    static uint8_t payload[CCDSERIAL_DATA_SIZE*2];
+    uint64_t period=(uint64_t)(1e9/rate), t0=CCDSERIAL_TimeNs(), next=t0+period, rttMax=0, rttSum=0;
+    unsigned long polls=0;
+    last=first;
+    signal(SIGINT,CCDTOOL_OnSignal);
+    printf("   fps   sent   skip over miss  USB MB/s  cmd/s loop/s    ADC%%   SH%%  USB%%  main%% idle%% isr%% q\n");
+    while(CCDSERIAL_TimeNs()-t0<(uint64_t)(seconds*1e9)&&!ccdtoolStop)
+    {
+        uint64_t now=CCDSERIAL_TimeNs();
+        if(stream)
+        {
+            CCD_FRAME_HEADER h;
+            if(CCDSERIAL_GetFrame(fd,&h,payload,sizeof(payload))){perror("FRM");CCDSERIAL_Close(fd);return 1;}
+            if(CCDSERIAL_TimeNs()<next)continue;
+        }
+        else if(now<next)
+        {
+            usleep((useconds_t)((next-now)/1000));
+            continue;
+        }
+        next+=period;
+        now=CCDSERIAL_TimeNs();
+        if(CCDSERIAL_Status(fd,&cur)){perror("STA");CCDSERIAL_Close(fd);return 1;}
+        uint64_t rtt=CCDSERIAL_TimeNs()-now;
+        rttSum+=rtt;
+        if(rtt>rttMax)rttMax=rtt;
+        polls++;
+        if(cur.timestamp-last.timestamp>=CCD_TIMESTAMP_HZ)     //a line per device second
+        {
+            CCDTOOL_StatusLine(&last,&cur);
+            last=cur;
+        }
+    }
+    CCDSERIAL_Close(fd);
+    if(polls)
+    {
+        printf("\ntotal\n");
+        CCDTOOL_StatusLine(&first,&cur);
+        CCDTOOL_StatusCompression(&first,&cur);
+        printf("%lu polls, round trip %.2f ms mean, %.2f ms max\n",polls,rttSum/1e6/polls,rttMax/1e6);
+    }
+    return 0;
+}
+/******************************************************************************/
+//Records the events of -m (hex, 0: device default) for -s seconds (1), -f streams
+//full frames meanwhile. The timeline goes to -o (stdout), a summary to stderr.
+static int CCDTOOL_Trace(int argc, char **argv)
+{
+    const char *out=NULL;
+    double seconds=1;
+    unsigned long mask=0;
+    int stream=0, opt;
+
+    while((opt=getopt(argc,argv,"m:s:o:f"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'm': mask=strtoul(optarg,NULL,16); break;
+            case 's': seconds=strtod(optarg,NULL); break;
+            case 'o': out=optarg; break;
+            case 'f': stream=1; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=1||seconds<0||mask>=(1u<<CCD_TRACE_EVENTS))return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind]);
+    if(fd<0){perror(argv[optind]);return 1;}
+
+    static CCD_TRACE_REPLY reply;
+    static CCD_TRACE_ENTRY entry[CCD_TRACE_SIZE];
+    unsigned n=0;
+    if((stream&&CCDSERIAL_Mode(fd,CCD_MODE_FRAME,0,0))||CCDSERIAL_Trace(fd,CCD_TRACE_START,0,(uint16_t)mask,&reply))
+    {
+        perror("TRC");
+        CCDSERIAL_Close(fd);
+        return 1;
+    }
+    if(reply.status!=CCD_TRACE_OK)
+    {
+        fprintf(stderr,"TRC: %s\n",reply.status==CCD_TRACE_DISABLED?"firmware built without trace points":"refused");
+        CCDSERIAL_Close(fd);
+        return 1;
+    }
+
+    static uint8_t payload[CCDSERIAL_DATA_SIZE*2];
+    uint64_t t0=CCDSERIAL_TimeNs();
+    signal(SIGINT,CCDTOOL_OnSignal);
+    while(CCDSERIAL_TimeNs()-t0<(uint64_t)(seconds*1e9)&&!ccdtoolStop)
+    {
+        CCD_FRAME_HEADER h;
+        if(!stream)usleep(10000);
+        else if(CCDSERIAL_GetFrame(fd,&h,payload,sizeof(payload))){perror("FRM");CCDSERIAL_Close(fd);return 1;}
+    }
+    if(CCDSERIAL_Trace(fd,CCD_TRACE_STOP,0,0,&reply)){perror("TRC");CCDSERIAL_Close(fd);return 1;}
+    for(uint8_t b=0;b<CCD_TRACE_BLOCKS;b++)
+    {
+        if(CCDSERIAL_Trace(fd,CCD_TRACE_READ,b,0,&reply)||reply.status!=CCD_TRACE_OK)
+        {
+            perror("TRC");
+            CCDSERIAL_Close(fd);
+            return 1;
+        }
+        memcpy(&entry[n],reply.entry,reply.count*sizeof(CCD_TRACE_ENTRY));
+        n+=reply.count;
+        if(reply.count<CCD_TRACE_BLOCK)break;
+    }
+    CCDSERIAL_Close(fd);
+
+    FILE *f=out?fopen(out,"w"):stdout;
+    CCDTRACE_STATS stats[CCD_TRACE_EVENTS];
+    if(!f){perror(out);return 1;}
+    int err=CCDTRACE_WriteJson(f,entry,n,stats);
+    if(out&&fclose(f))err=-1;
+    if(err){perror(out?out:"stdout");return 1;}
+
+    fprintf(stderr,"%u events written, last %u kept (mask %04x)\n",reply.written,n,reply.mask);
+    fprintf(stderr,"event          entries  spans  mean us   max us\n");
+    for(uint8_t k=0;k<CCD_TRACE_EVENTS;k++)
+    {
+        const CCDTRACE_STATS *s=&stats[k];
+        if(!s->count)continue;
+        fprintf(stderr,"%-14s %7lu %6lu",CCDTRACE_EventName(k),s->count,s->spans);
+        if(s->spans)
+            fprintf(stderr," %8.2f %8.2f",s->totalTicks*1e6/CCD_TIMESTAMP_HZ/s->spans,s->maxTicks*1e6/CCD_TIMESTAMP_HZ);
+        fprintf(stderr,"\n");
+    }
+    return 0;
+}
+/******************************************************************************/
+//Reads the ideal value of every 12-bit code in LSB, one per line in code order,
+//'#' starts a comment. Returns 0 with CCD_LIN_SIZE entries x16.
+static int CCDTOOL_LinearityRead(const char *path, uint16_t *entry)
+{
+    FILE *f=fopen(path,"r");
+    if(!f){perror(path);return -1;}
+
+    char line[256];
+    unsigned n=0, number=0;
+    int rc=0;
+    while(!rc&&fgets(line,sizeof(line),f))
+    {
+        char *end, *p=line;
+        number++;
+        if(strchr(p,'#'))*strchr(p,'#')=0;
+        while(*p==' '||*p=='\t')p++;
+        if(!*p||*p=='\n'||*p=='\r')continue;
+        double v=strtod(p,&end);
+        long fine=lround(v*16);
+        if(end==p||n>=CCD_LIN_SIZE||fine<0||fine>CCD_LIN_ENTRY_MAX)
+        {
+            fprintf(stderr,"%s:%u: %s\n",path,number,end==p?"not a number":n>=CCD_LIN_SIZE?"more than 4096 codes":
+                    "value outside 0..4095 LSB");
+            rc=-1;
+            break;
+        }
+        entry[n++]=(uint16_t)fine;
+    }
+    fclose(f);
+    if(!rc&&n!=CCD_LIN_SIZE)
+    {
+        fprintf(stderr,"%s: %u codes, %u needed\n",path,n,CCD_LIN_SIZE);
+        rc=-1;
+    }
+    return rc;
+}
+/******************************************************************************/
+static int CCDTOOL_MapCompare(const void *a, const void *b)
+{
+    const CCDMAP_OBJECT *x=a, *y=b;
+    if(x->ram!=y->ram)return x->ram<y->ram?1:-1;
+    return x->flash<y->flash?1:x->flash>y->flash?-1:0;
+}
+/******************************************************************************/
+//Frames of each kind that fit in free arena blocks
+static void CCDTOOL_MemoryBurst(const char *label, unsigned free)
+{
+    static const struct {const char *name; unsigned blocks;} kinds[]=
+    {
+        {"8-bit",       CCD_MEM_BLOCKS(CCD_DATA_SIZE)},
+        {"12-bit",      CCD_MEM_BLOCKS(CCD_DATA_SIZE*2)},
+        {"oversampled", CCD_MEM_BLOCKS(CCD_DATA_SIZE*2)+CCD_MEM_BLOCKS(CCD_DATA_SIZE)},
+        {"HDR sum",     CCD_MEM_BLOCKS(CCD_DATA_SIZE*4)+CCD_MEM_BLOCKS(CCD_DATA_SIZE)},
+    };
+    printf("%-13s",label);
+    for(unsigned i=0;i<sizeof(kinds)/sizeof(kinds[0]);i++)
+        printf("%s%s %u",i?", ":" ",kinds[i].name,free/kinds[i].blocks);
+    printf(" frames\n");
+}
+/******************************************************************************/
+//Build report from the map file (-m) and/or the arena of a running device
+static int CCDTOOL_Memory(int argc, char **argv)
+{
+    const char *path=NULL;
+    int all=0, opt;
+
+    while((opt=getopt(argc,argv,"am:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'a': all=1; break;
+            case 'm': path=optarg; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind>1||(!path&&argc-optind!=1))return 2;
+
+    if(path)
+    {
+        static CCDMAP map;
+        if(CCDMAP_Read(path,&map)){perror(path);return 1;}
+        qsort(map.object,map.objects,sizeof(map.object[0]),CCDTOOL_MapCompare);
+
+        unsigned shown=all||map.objects<20?map.objects:20;
+        printf("%-24s %9s %9s\n","module","RAM","flash");
+        if(map.arena)printf("%-24s %9lu %9s\n","frame arena",map.arena,"-");
+        for(unsigned i=0;i<shown;i++)
+            printf("%-24s %9lu %9lu\n",map.object[i].name,map.object[i].ram,map.object[i].flash);
+        if(shown<map.objects)
+        {
+            unsigned long ram=0, flash=0;
+            for(unsigned i=shown;i<map.objects;i++){ram+=map.object[i].ram;flash+=map.object[i].flash;}
+            char rest[32];
+            snprintf(rest,sizeof(rest),"(%u more)",map.objects-shown);
+            printf("%-24s %9lu %9lu\n",rest,ram,flash);
+        }
+        printf("%-24s %9lu %9s\n","heap",map.heap,"-");
+        printf("%-24s %9lu %9s\n\n","stack",map.stack,"-");
+
+        if(map.ramSize)printf("RAM           %lu of %lu bytes (%.1f%%), %ld left\n",map.ram,map.ramSize,
+                              100.0*map.ram/map.ramSize,(long)(map.ramSize-map.ram));
+        if(map.flashSize)printf("flash         %lu of %lu bytes (%.1f%%)\n",map.flash,map.flashSize,
+                                100.0*map.flash/map.flashSize);
+        if(map.arena)
+        {
+            unsigned blocks=map.arena/CCD_MEM_BLOCK_SIZE;
+            printf("arena         %u blocks of %u bytes, %u taken at start-up\n",blocks,CCD_MEM_BLOCK_SIZE,CCD_MEM_STARTUP_BLOCKS);
+            if(map.ramSize>map.ram)
+                printf("              %lu more fit in the RAM left (ARENA_BLOCKS=%lu), heap and stack kept\n",
+                       (map.ramSize-map.ram)/CCD_MEM_BLOCK_SIZE,blocks+(map.ramSize-map.ram)/CCD_MEM_BLOCK_SIZE);
+            CCDTOOL_MemoryBurst("burst",blocks>CCD_MEM_STARTUP_BLOCKS?blocks-CCD_MEM_STARTUP_BLOCKS:0);
+        }
+        else printf("arena         none in this map (arenaPool not found)\n");
+    }
+    if(optind<argc)
+    {
+        static const char *owners[CCD_MEM_OWNERS]={"transmit","frames","accumulator","scratch","burst","reference",
+                                                   "hdr"};
+        CCD_MEM_REPLY reply;
+        int fd=CCDSERIAL_Open(argv[optind]);
+        if(fd<0){perror(argv[optind]);return 1;}
+        int rc=CCDSERIAL_Memory(fd,&reply);
+        CCDSERIAL_Close(fd);
+        if(rc){perror("MEM");return 1;}
+
+        if(path)printf("\n");
+        printf("device arena  %u blocks, %u free (longest run %u), %u allocations refused\n",
+               reply.blocks,reply.free,reply.largestFree,reply.failures);
+        printf("taken        ");
+        for(unsigned k=0;k<CCD_MEM_OWNERS;k++)printf("%s %s %u",k?",":"",owners[k],reply.owned[k]);
+        printf(" blocks\n");
+        CCDTOOL_MemoryBurst("burst now",reply.free);
+    }
+    return 0;
+}
+/******************************************************************************/
+//query, or select the USB write buffer view, or bench both views on the newest frame
+//Frames per second received with FRM at vertical resolution vRes (full frames, the
+//shortest integration time), and the device frame rate from the headers
+static int CCDTOOL_BuffersRate(int fd, uint8_t vRes, unsigned long n, double *fps, double *deviceFps)
+{
+    CCD_FRAME_HEADER h;
+    uint8_t payload[CCDSERIAL_DATA_SIZE*2];
+    uint32_t seq=0, ts=0;
+    uint64_t start=0;
+
+    if(CCDSERIAL_Setup(fd,CCD_INTEGRATION_MIN,0,vRes))return -1;
+    for(unsigned long i=0;i<n+3;i++)
+    {
+        if(CCDSERIAL_GetFrame(fd,&h,payload,sizeof(payload)))return -1;
+        if(i==3)                        //the new setup runs from the next ICG pulse on
+        {
+            seq=h.sequence;
+            ts=h.timestamp;
+            start=CCDSERIAL_TimeNs();
+        }
+    }
+    double t=CCDTOOL_Seconds(CCDSERIAL_TimeNs()-start);
+    uint32_t dt=h.timestamp-ts;
+    *fps=t>0?n/t:0;
+    *deviceFps=dt?(h.sequence-seq)*(double)CCD_TIMESTAMP_HZ/dt:0;
+    return 0;
+}
+/******************************************************************************/
+//bench -n also streams n frames packed (12-bit big-endian) and sent in place
+//(CCD_VRES_NATIVE), the device is left in frame mode at 12 bits
+static int CCDTOOL_Buffers(int argc, char **argv)
+{
+    static const char *placements[]={"coherent","cached"};
+    CCD_BUF_REPLY reply;
+    uint8_t op, placement=0;
+    unsigned long frames=0;
+    int opt;
+
+    while((opt=getopt(argc,argv,"n:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=2)return 2;
+    const char *name=argv[optind];
+    if(!strcmp(name,"query"))op=CCD_BUF_QUERY;
+    else if(!strcmp(name,"bench"))op=CCD_BUF_BENCH;
+    else if(!strcmp(name,"coherent")||!strcmp(name,"cached"))
+    {
+        op=CCD_BUF_SET;
+        placement=strcmp(name,"cached")?CCD_BUF_COHERENT:CCD_BUF_CACHED;
+    }
+    else return 2;
+    if(frames&&op!=CCD_BUF_BENCH)return 2;
+
+    int fd=CCDSERIAL_Open(argv[optind+1]);
+    if(fd<0){perror(argv[optind+1]);return 1;}
+    if(CCDSERIAL_Buffers(fd,op,placement,&reply)){perror("BUF");CCDSERIAL_Close(fd);return 1;}
+    if(reply.status!=CCD_BUF_OK){fprintf(stderr,"BUF: bad request\n");CCDSERIAL_Close(fd);return 1;}
+
+    printf("USB write     %s\n",reply.placement<2?placements[reply.placement]:"unknown");
+    if(op==CCD_BUF_BENCH)
+    {
+        //CPU cycles per frame, the fastest of a few runs
+        const char *names[]={"capture","read","pack"};
+        uint32_t cached[]={reply.captureCached,reply.readCached,reply.packCached};
+        uint32_t coherent[]={reply.captureCoherent,reply.readCoherent,reply.packCoherent};
+        printf("\n%-9s %10s %10s %8s   CPU cycles per frame\n","","cached","coherent","ratio");
+        for(unsigned i=0;i<3;i++)
+        {
+            if(!cached[i]&&!coherent[i]){printf("%-9s %10s %10s\n",names[i],"-","-");continue;}    //no frame yet
+            printf("%-9s %10u %10u %7.2fx\n",names[i],cached[i],coherent[i],cached[i]?(double)coherent[i]/cached[i]:0.0);
+        }
+        printf("\nclean         %u CPU cycles per frame, part of the cached figures\n",reply.clean);
+
+        //a CCD_VRES_NATIVE frame is only cleaned, the write starts without packing it
+        uint32_t pack=reply.placement==CCD_BUF_CACHED?reply.packCached:reply.packCoherent;
+        if(pack&&reply.clean<pack)
+            printf("in place      %u CPU cycles per frame, %u (%.0f %%, %.1f us) saved against packing %s\n",
+                   reply.clean,pack-reply.clean,(pack-reply.clean)*100.0/pack,
+                   (pack-reply.clean)*1e6/(2.0*CCD_TIMESTAMP_HZ),placements[reply.placement&1]);  //CPU at 2x CORETIMER
+    }
+    int rc=0;
+    if(frames)
+    {
+        static const uint8_t vRes[]={3,CCD_VRES_NATIVE};
+        static const char *names[]={"packed","in place"};
+        double fps[2], deviceFps[2];
+
+        printf("\n%-9s %10s %10s %8s   %lu full frames, 12 bits\n","","frames/s","device","skipped",frames);
+        if(CCDSERIAL_Mode(fd,CCD_MODE_FRAME,0,0)){perror("MOD");rc=1;}
+        for(unsigned i=0;i<2&&!rc;i++)
+        {
+            if(CCDTOOL_BuffersRate(fd,vRes[i],frames,&fps[i],&deviceFps[i])){perror("FRM");rc=1;break;}
+            printf("%-9s %10.1f %10.1f %7.1f%%\n",names[i],fps[i],deviceFps[i],
+                   deviceFps[i]>fps[i]?(1-fps[i]/deviceFps[i])*100:0.0);
+        }
+        if(!rc)printf("gained    %+10.1f frames/s (%+.1f %%)\n",fps[1]-fps[0],fps[0]>0?(fps[1]/fps[0]-1)*100:0.0);
+        if(CCDSERIAL_Setup(fd,CCD_INTEGRATION_MIN,0,3)){perror("SET");rc=1;}
+    }
+    CCDSERIAL_Close(fd);
+    return rc;
+}
+/******************************************************************************/
+//load switches the table off, sends every block and switches it on again unless
+//-x keeps the uncorrected path
+static int CCDTOOL_Linearity(int argc, char **argv)
+{
+    static const char *operations[]={"load","on","save","clear","bench","query"};
+    static const char *status[]={"ok","bad request","switched on","blocks missing","entry out of range","flash error"};
+    const char *path=NULL;
+    int keepOff=0, opt;
+
+    while((opt=getopt(argc,argv,"f:x"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'f': path=optarg; break;
+            case 'x': keepOff=1; break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=2)return 2;
+
+    //"off" is ENABLE without CCD_LIN_ON
+    const char *name=argv[optind];
+    unsigned op=0;
+    while(op<sizeof(operations)/sizeof(operations[0])&&strcmp(name,operations[op]))op++;
+    if(!strcmp(name,"off"))op=CCD_LIN_ENABLE;
+    else if(op>=sizeof(operations)/sizeof(operations[0]))return 2;
+    if((op==CCD_LIN_LOAD)!=(path!=NULL))return 2;
+
+    static uint16_t entry[CCD_LIN_SIZE];
+    if(path&&CCDTOOL_LinearityRead(path,entry))return 1;
+
+    int fd=CCDSERIAL_Open(argv[optind+1]);
+    if(fd<0){perror(argv[optind+1]);return 1;}
+
+    typedef struct {uint8_t operation, block, options;} CCDTOOL_LIN_STEP;
+    CCDTOOL_LIN_STEP steps[CCD_LIN_BLOCKS+2];
+    unsigned n=0;
+    if(op==CCD_LIN_LOAD)
+    {
+        steps[n++]=(CCDTOOL_LIN_STEP){CCD_LIN_ENABLE,0,0};
+        for(unsigned b=0;b<CCD_LIN_BLOCKS;b++)steps[n++]=(CCDTOOL_LIN_STEP){CCD_LIN_LOAD,(uint8_t)b,0};
+        if(!keepOff)steps[n++]=(CCDTOOL_LIN_STEP){CCD_LIN_ENABLE,0,CCD_LIN_ON};
+    }
+    else steps[n++]=(CCDTOOL_LIN_STEP){(uint8_t)op,0,strcmp(name,"on")?0:CCD_LIN_ON};
+
+    //SAVE erases and programs a flash page
+    CCD_LIN_REPLY reply={0};
+    int rc=0;
+    for(unsigned i=0;i<n&&!rc;i++)
+    {
+        const uint16_t *block=steps[i].operation==CCD_LIN_LOAD?&entry[steps[i].block*CCD_LIN_BLOCK]:NULL;
+        if(CCDSERIAL_Linearity(fd,steps[i].operation,steps[i].block,steps[i].options,block,&reply,CCDSERIAL_TIMEOUT_MS))
+        {
+            perror("LIN");
+            rc=1;
+        }
+        else if(reply.status!=CCD_LIN_OK)
+        {
+            fprintf(stderr,"LIN: %s\n",reply.status<sizeof(status)/sizeof(status[0])?status[reply.status]:"unknown status");
+            rc=1;
+        }
+    }
+    CCDSERIAL_Close(fd);
+    if(rc&&reply.operation!=steps[0].operation)return rc;
+
+    unsigned blocks=0;
+    for(unsigned b=0;b<CCD_LIN_BLOCKS;b++)blocks+=reply.loaded>>b&1;
+    printf("table         %s, %u of %u blocks loaded\n",reply.enabled?"on":"off",blocks,CCD_LIN_BLOCKS);
+    if(op==CCD_LIN_BENCH)
+        printf("bench         lookup adds %u CPU cycles per frame (%.2f per pixel)\n",reply.value,
+               reply.value/(double)CCD_DATA_SIZE);
+    if(op==CCD_LIN_LOAD&&!rc)
+    {
+        double worst=0;
+        unsigned code=0;
+        for(unsigned i=0;i<CCD_LIN_SIZE;i++)
+        {
+            double inl=fabs(entry[i]/16.0-i);
+            if(inl>worst){worst=inl;code=i;}
+        }
+        printf("correction    %.2f LSB at most (code %u)\n",worst,code);
+    }
+    return rc;
+}
+
+/******************************************************************************/
+LIN_TABLE linTable;                     //the lookup of linearity.h, bench-linearity fills it
+
+//The ADC interrupt lookup with a table switched on, at every vertical resolution:
+//conversions are stored at the 12-bit scale, the table is indexed with them as
+//they are and the rounded sample is packed by the resolution shift. A sample
+//must stay within half an LSB of its table entry and the packed value within
+//the table's worst deviation of the code, full scale included.
+static int CCDTOOL_BenchLinearity(int argc, char **argv)
+{
+    static const char *names[]={"6-bit","8-bit","10-bit","12-bit"};
+    unsigned long frames=200;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||!frames)return 2;
+
+    //bowed INL with steps at the major carries, up to about 2.5 LSB
+    double worst=0;
+    for(unsigned c=0;c<CCD_LIN_SIZE;c++)
+    {
+        double ideal=c+1.5*sin(M_PI*c/CCD_LIN_SIZE)+0.8*((c>>10)&1)-0.4*((c>>9)&1);
+        long e=lround(ideal*(1<<CCD_FINE_SHIFT));
+        linTable.entry[c]=(uint16_t)(e<0?0:e>CCD_LIN_ENTRY_MAX?CCD_LIN_ENTRY_MAX:e);
+        if(fabs(linTable.entry[c]/16.0-c)>worst)worst=fabs(linTable.entry[c]/16.0-c);
+    }
+    linTable.flags=LIN_ENABLED;
+
+    printf("%-7s %9s %9s %10s %8s\n","vres","samples","deviation","full scale","ns/pixel");
+    for(uint8_t vRes=0;vRes<=3;vRes++)
+    {
+        uint8_t shift=(uint8_t)(2*(3-vRes));
+        uint16_t mask=(uint16_t)(CCD_ADC_MAX&~((1u<<shift)-1));
+        uint32_t seed=11, bad=0, deviation=0;
+        uint16_t data[CCD_DATA_SIZE], out[CCD_DATA_SIZE];
+        uint64_t ns=0;
+
+        for(unsigned long f=0;f<frames;f++)
+        {
+            for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+                data[i]=(uint16_t)(i<2?mask*i:CCDTOOL_Random(&seed)&mask);  //0 and full scale in every frame
+            uint64_t t0=CCDSERIAL_TimeNs();
+            for(unsigned i=0;i<CCD_DATA_SIZE;i++)out[i]=LIN_Round(LIN_Fine(data[i]));
+            ns+=CCDSERIAL_TimeNs()-t0;
+            for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+            {
+                int packed=out[i]>>shift, code=data[i]>>shift;
+                uint32_t d=(uint32_t)abs(packed-code);
+                if(fabs(out[i]-linTable.entry[data[i]]/16.0)>0.5||d>(uint32_t)ceil(worst)+1)bad++;
+                if(d>deviation)deviation=d;
+            }
+        }
+        uint16_t top=LIN_Round(LIN_Fine(mask))>>shift;
+        printf("%-7s %9lu %9u %5u of %-3u %8.2f\n",names[vRes],frames*CCD_DATA_SIZE,deviation,top,mask>>shift,
+               (double)ns/(frames*CCD_DATA_SIZE));
+        if(bad||top+1+(uint32_t)ceil(worst)<(uint32_t)(mask>>shift))
+        {
+            fprintf(stderr,"%s: %u samples off their table entry, full scale packs to %u\n",names[vRes],bad,top);
+            rc=1;
+        }
+    }
+    printf("table deviation %.2f LSB at most, packed deviation in codes of each resolution\n",worst);
+    return rc;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Decoder commands
+// *****************************************************************************
+// *****************************************************************************
+
+static int CCDTOOL_BenchDecode(int argc, char **argv)
+{
+    static const char *formats[CCDDEC_FORMATS]={"6-bit","8-bit","10-bit BE","12-bit BE","16-bit BE","12-bit LE"};
+    unsigned long frames=20000;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0)return 2;
+
+    size_t maxLen=CCDSERIAL_PayloadSize(0,3);
+    uint8_t *payload=malloc(maxLen);
+    uint16_t *ref16=malloc(CCDSERIAL_DATA_SIZE*sizeof(uint16_t)), *out16=malloc(CCDSERIAL_DATA_SIZE*sizeof(uint16_t));
+    float *refF=malloc(CCDSERIAL_DATA_SIZE*sizeof(float)), *outF=malloc(CCDSERIAL_DATA_SIZE*sizeof(float));
+    uint32_t seed=7;
+    for(size_t i=0;i<maxLen;i++)payload[i]=(uint8_t)CCDTOOL_Random(&seed);
+    for(size_t i=0;i<maxLen;i+=2)payload[i]&=0x0F;      //keep BE16 samples within 12 bits
+
+    printf("%-10s %-7s %10s %10s\n","format","impl","u16 GB/s","f32 GB/s");
+    for(int fmt=0;fmt<CCDDEC_FORMATS;fmt++)
+    {
+        size_t len=CCDSERIAL_PayloadSize(0,(uint8_t)fmt);
+        size_t n=CCDDEC_Samples((uint8_t)fmt,len);
+
+        for(int impl=0;impl<CCDDEC_IMPL_COUNT;impl++)
+        {
+            const CCDDEC_KERNELS *k=CCDDEC_Kernels((CCDDEC_IMPL)impl);
+            if(!k)continue;
+
+            /* Check against the scalar reference, including every tail length */
+            for(size_t m=0;m<=n;m=(m<80)?m+1:n+(m==n))
+            {
+                ccddecScalar.u16[fmt](payload,m,ref16);
+                ccddecScalar.f32[fmt](payload,m,refF);
+                k->u16[fmt](payload,m,out16);
+                k->f32[fmt](payload,m,outF);
+                if(memcmp(ref16,out16,m*sizeof(uint16_t))||memcmp(refF,outF,m*sizeof(float)))
+                {
+                    fprintf(stderr,"%s %s: mismatch against scalar reference at %zu samples\n",formats[fmt],k->name,m);
+                    rc=1;
+                    break;
+                }
+            }
+
+            uint64_t t=CCDSERIAL_TimeNs();
+            for(unsigned long f=0;f<frames;f++)k->u16[fmt](payload,n,out16);
+            double t16=CCDTOOL_Seconds(CCDSERIAL_TimeNs()-t);
+            t=CCDSERIAL_TimeNs();
+            for(unsigned long f=0;f<frames;f++)k->f32[fmt](payload,n,outF);
+            double tF=CCDTOOL_Seconds(CCDSERIAL_TimeNs()-t);
+
+            printf("%-10s %-7s %10.2f %10.2f\n",formats[fmt],k->name,
+                   (double)len*frames/t16/1e9,(double)len*frames/tF/1e9);
+        }
+    }
+    CCDDEC_Select(CCDDEC_IMPL_AUTO);
+    printf("selected    %s\n",CCDDEC_ImplName());
+    free(payload);
+    free(ref16);
+    free(out16);
+    free(refF);
+    free(outF);
+    return rc;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Device processing commands
+// *****************************************************************************
+// *****************************************************************************
+
+//Synthetic frame: dark level, noise and lines with gaussian profile, returns line positions
+static unsigned CCDTOOL_SyntheticLines(uint16_t *data, uint32_t *seed, double *position, unsigned lines)
+{
+    double sigma[CCD_PEAKS_MAX], height[CCD_PEAKS_MAX];
+
+    for(unsigned k=0;k<lines;k++)
+    {
+        //spread over the array, at least 20 pixels apart
+        position[k]=CCD_SIGNAL_FIRST+20+k*(CCD_SIGNAL_COUNT-40.0)/lines+(CCDTOOL_Random(seed)%1000)/100.0;
+        sigma[k]=1.0+(CCDTOOL_Random(seed)%300)/100.0;
+        height[k]=1000+CCDTOOL_Random(seed)%2500;
+    }
+    for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+    {
+        double v=200+(int)(CCDTOOL_Random(seed)%17)-8;
+        for(unsigned k=0;k<lines;k++)
+        {
+            double d=(i-position[k])/sigma[k];
+            if(fabs(d)<8)v+=height[k]*exp(-0.5*d*d);
+        }
+        data[i]=(uint16_t)(v>CCD_ADC_MAX?CCD_ADC_MAX:v);
+    }
+    return lines;
+}
+/******************************************************************************/
+static int CCDTOOL_BenchPeaks(int argc, char **argv)
+{
+    static const char *methods[]={"parabola","centroid"};
+    unsigned long frames=2000;
+    unsigned lines=4, threshold=600;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:l:p:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            case 'l': lines=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'p': threshold=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||!frames||!lines||lines>CCD_PEAKS_MAX)return 2;
+
+    uint16_t data[CCD_DATA_SIZE], inverted[CCD_DATA_SIZE];
+    CCD_PEAK peaks[CCD_PEAKS_MAX], check[CCD_PEAKS_MAX];
+    double truth[CCD_PEAKS_MAX];
+
+    printf("%-9s %8s %10s %10s %10s %9s\n","method","found","mean px","max px","us/frame","bytes");
+    for(unsigned m=0;m<2;m++)
+    {
+        PEAKS_CONFIG cfg={(uint16_t)threshold,(uint8_t)(m?CCD_PEAKS_CENTROID:0)};
+        PEAKS_CONFIG inv={(uint16_t)threshold,(uint8_t)(cfg.options|CCD_PEAKS_INVERT)};
+        uint32_t seed=99;
+        uint64_t found=0, bytes=0, ns=0;
+        double errSum=0, errMax=0;
+
+        for(unsigned long f=0;f<frames;f++)
+        {
+            bool truncated;
+            CCDTOOL_SyntheticLines(data,&seed,truth,lines);
+
+            uint64_t t=CCDSERIAL_TimeNs();
+            uint8_t n=PEAKS_Find(data,CCD_SIGNAL_FIRST,CCD_SIGNAL_COUNT,&cfg,peaks,CCD_PEAKS_MAX,&truncated);
+            ns+=CCDSERIAL_TimeNs()-t;
+
+            /* Inverted sensor polarity must give the same list */
+            for(unsigned i=0;i<CCD_DATA_SIZE;i++)inverted[i]=(uint16_t)(CCD_ADC_MAX-data[i]);
+            uint8_t k=PEAKS_Find(inverted,CCD_SIGNAL_FIRST,CCD_SIGNAL_COUNT,&inv,check,CCD_PEAKS_MAX,&truncated);
+            if(k!=n||memcmp(check,peaks,n*sizeof(CCD_PEAK)))
+            {
+                fprintf(stderr,"%s: inverted polarity result differs in frame %lu\n",methods[m],f);
+                rc=1;
+            }
+
+            found+=n;
+            bytes+=sizeof(CCD_FRAME_HEADER)+n*sizeof(CCD_PEAK);
+            for(uint8_t i=0;i<n&&i<lines;i++)
+            {
+                double e=fabs(peaks[i].position/256.0-truth[i]);
+                errSum+=e;
+                if(e>errMax)errMax=e;
+            }
+        }
+        if(found!=(uint64_t)frames*lines)
+        {
+            fprintf(stderr,"%s: %llu peaks found, %lu expected\n",methods[m],(unsigned long long)found,frames*lines);
+            rc=1;
+        }
+        printf("%-9s %8llu %10.4f %10.4f %10.2f %9.1f\n",methods[m],(unsigned long long)found,
+               errSum/found,errMax,ns/1e3/frames,(double)bytes/frames);
+    }
+    size_t full=sizeof(CCD_FRAME_HEADER)+CCDSERIAL_PayloadSize(0,3);
+    printf("full frame %zu bytes (12 bit), %zu bytes (8 bit)\n",full,sizeof(CCD_FRAME_HEADER)+CCDSERIAL_PayloadSize(0,1));
+    return rc;
+}
+
+/******************************************************************************/
+//Synthetic shadow of a wire: bright background, dark band with blurred edges
+static void CCDTOOL_SyntheticShadow(uint16_t *data, uint32_t *seed, double *edge)
+{
+    double blur=0.5+(CCDTOOL_Random(seed)%250)/100.0;
+
+    edge[0]=CCD_SIGNAL_FIRST+200+(CCDTOOL_Random(seed)%200000)/100.0;
+    edge[1]=edge[0]+100+(CCDTOOL_Random(seed)%100000)/100.0;
+    for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+    {
+        //erf profile: the mid level is crossed exactly at the edge
+        double shadow=0.5*(erf((i-edge[0])/blur)-erf((i-edge[1])/blur));
+        double v=3000-2700*shadow+(int)(CCDTOOL_Random(seed)%33)-16;
+        data[i]=(uint16_t)v;
+    }
+}
+/******************************************************************************/
+static int CCDTOOL_BenchEdges(int argc, char **argv)
+{
+    static const struct {const char *name; uint8_t options;} cases[]=
+    {
+        {"fixed",           0},
+        {"hysteresis 32",   2<<4},
+        {"auto+hyst 32",    CCD_EDGES_AUTO|(2<<4)},
+    };
+    unsigned long frames=5000;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||!frames)return 2;
+
+    uint16_t data[CCD_DATA_SIZE];
+    CCD_EDGE edge[CCD_EDGES_MAX];
+    double truth[2];
+
+    printf("%-14s %8s %8s %10s %10s %9s\n","threshold","frames","bad","mean px","max px","ns/sample");
+    for(unsigned c=0;c<sizeof(cases)/sizeof(cases[0]);c++)
+    {
+        EDGES_CONFIG cfg={1650,cases[c].options};
+        EDGES_STATE state={0};
+        uint32_t seed=5;
+        unsigned long bad=0, measured=0;
+        double errSum=0, errMax=0;
+        uint64_t ns=0;
+
+        for(unsigned long f=0;f<frames;f++)
+        {
+            CCD_EDGES summary;
+            bool truncated;
+            CCDTOOL_SyntheticShadow(data,&seed,truth);
+
+            uint64_t t=CCDSERIAL_TimeNs();
+            uint8_t n=EDGES_Find(&state,data,CCD_SIGNAL_FIRST,CCD_SIGNAL_COUNT,&cfg,&summary,edge,CCD_EDGES_MAX,&truncated);
+            ns+=CCDSERIAL_TimeNs()-t;
+
+            //a shadow gives exactly one falling and one rising edge
+            if(n!=2||edge[0].rising||!edge[1].rising)
+            {
+                bad++;
+                continue;
+            }
+            for(unsigned k=0;k<2;k++)
+            {
+                double e=fabs(edge[k].position/256.0-truth[k]);
+                errSum+=e;
+                if(e>errMax)errMax=e;
+            }
+            measured+=2;
+        }
+        if(bad)rc=1;
+        printf("%-14s %8lu %8lu %10.4f %10.4f %9.2f\n",cases[c].name,frames,bad,
+               measured?errSum/measured:0.0,errMax,(double)ns/frames/CCD_SIGNAL_COUNT);
+    }
+    printf("reply %zu bytes per frame with 2 edges\n",sizeof(CCD_FRAME_HEADER)+sizeof(CCD_EDGES)+2*sizeof(CCD_EDGE));
+    return rc;
+}
+
+/******************************************************************************/
+//Sensor model for the exposure loop: peak=dark+rate*t, clipped at full scale,
+//rate per 10us, t in ticks. A frame exposed across a change of integration
+//time sees the mean of both.
+static void CCDTOOL_ExposureFrame(CCD_FRAME_STATS *st, double rate, double t, uint32_t *seed)
+{
+    double peak=200+rate*t/CCD_TICKS_PER_10US+(int)(CCDTOOL_Random(seed)%33)-16;
+    st->minimum=200;
+    st->maximum=(uint16_t)(peak>CCD_ADC_MAX?CCD_ADC_MAX:peak);
+    st->sum=0;
+    st->saturated=peak>=CCD_ADC_MAX?(uint16_t)(1+(peak-CCD_ADC_MAX)/rate):0;
+    st->saturationLevel=CCD_ADC_MAX;
+}
+/******************************************************************************/
+static int CCDTOOL_BenchExposure(int argc, char **argv)
+{
+    unsigned setpoint=3000, limit=16;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"s:l:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 's': setpoint=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'l': limit=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||setpoint<400||setpoint>CCD_ADC_MAX-200)return 2;
+
+    //scene brightness in counts per 10us above dark, from full sun to dim room
+    static const double rates[]={3000,300,30,3,0.3,0.03};
+    static const uint32_t starts[]={CCD_INTEGRATION_MIN,100*CCD_TICKS_PER_10US,0xFFFF*CCD_TICKS_PER_10US};
+    const uint32_t maximum=0xFFFF*CCD_TICKS_PER_10US;  //limit with maximum 0
+    EXPOSURE_CONFIG cfg={(uint16_t)setpoint,0,CCD_EXPOSURE_ENABLE};
+
+    printf("%10s %8s %8s %10s %8s\n","counts/10us","start us","frames","itime us","peak");
+    for(unsigned r=0;r<sizeof(rates)/sizeof(rates[0]);r++)
+    {
+        for(unsigned k=0;k<sizeof(starts)/sizeof(starts[0]);k++)
+        {
+            EXPOSURE_STATE state;
+            CCD_FRAME_STATS st;
+            uint32_t seed=11;
+            double t=starts[k], previous=t;
+            unsigned settled=0, frames=0;
+
+            EXPOSURE_Reset(&state);
+            for(unsigned f=0;f<100;f++)
+            {
+                //the device changes the time while the next frame is already integrating
+                CCDTOOL_ExposureFrame(&st,rates[r],(t+previous)/2,&seed);
+                previous=t;
+                uint32_t error=abs((int)st.maximum-(int)setpoint);
+                //settled on the setpoint (within one tick step) or at a limit of the integration time
+                if(error<=setpoint/16||error<=rates[r]/CCD_TICKS_PER_10US||(t>=maximum&&st.maximum<setpoint)||
+                   (t<=CCD_INTEGRATION_MIN&&st.maximum>setpoint))
+                {
+                    if(!settled++)frames=f;
+                }
+                else settled=0;
+                if(settled>=5)break;
+                uint32_t next=EXPOSURE_Update(&state,&cfg,&st,(uint32_t)t);
+                if(next)t=next;
+            }
+            char result[16]="fail";
+            if(settled>=5)snprintf(result,sizeof(result),"%u",frames);
+            if(settled<5||frames>limit)rc=1;
+            printf("%10.2f %8.0f %8s %10.1f %8u\n",rates[r],starts[k]*1e6/CCD_TIMER_HZ,result,
+                   t*1e6/CCD_TIMER_HZ,st.maximum);
+        }
+    }
+    return rc;
+}
+
+/******************************************************************************/
+static int CCDTOOL_BenchHdr(int argc, char **argv)
+{
+    unsigned exposures=3, ratioShift=4, base=1000;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"e:r:t:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'e': exposures=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'r': ratioShift=(unsigned)strtoul(optarg,NULL,0); break;
+            case 't': base=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||!base||base>0xFFFF)return 2;
+
+    static HDR_STATE state;
+    static uint32_t merge[CCD_DATA_SIZE];
+    static uint8_t mergeSaturated[CCD_DATA_SIZE];
+    state.data=merge;
+    state.saturated=mergeSaturated;
+    HDR_CONFIG cfg={(uint8_t)exposures,(uint8_t)ratioShift,200,0};
+    if(!HDR_Setup(&state,&cfg,base*CCD_TICKS_PER_10US))
+    {
+        fprintf(stderr,"invalid HDR settings\n");
+        return 2;
+    }
+
+    //spectrum: weak and strong lines over a dark background, counts per 10us above dark
+    static double rate[CCD_DATA_SIZE];
+    for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+    {
+        rate[i]=0;
+        for(unsigned k=0;k<9;k++)
+        {
+            double d=(i-(CCD_SIGNAL_FIRST+200.0+k*400))/3.0;
+            if(fabs(d)<8)rate[i]+=0.01*pow(4,k)*exp(-0.5*d*d);
+        }
+    }
+
+    uint16_t data[CCD_DATA_SIZE];
+    uint8_t source[CCD_DATA_SIZE], saturated[CCD_DATA_SIZE];   //exposure each pixel must come from
+    CCD_HDR info;
+    uint32_t seed=3;
+    uint64_t ns=0;
+    bool done=false;
+    for(uint8_t j=HDR_Advance(&state);!done;j=HDR_Advance(&state))
+    {
+        uint32_t t=HDR_Time(&state,j);
+        HDR_Begin(&state,j,t);
+        uint64_t t0=CCDSERIAL_TimeNs();
+        for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+        {
+            double v=cfg.dark+rate[i]*t/CCD_TICKS_PER_10US+(int)(CCDTOOL_Random(&seed)%9)-4;
+            uint16_t raw=(uint16_t)(v>CCD_ADC_MAX?CCD_ADC_MAX:v);
+            data[i]=HDR_Sample(&state,(uint16_t)i,raw,raw>=CCD_ADC_MAX);
+            if(!j||saturated[i])
+            {
+                source[i]=j;
+                saturated[i]=raw>=CCD_ADC_MAX;
+            }
+        }
+        ns+=CCDSERIAL_TimeNs()-t0;
+        done=HDR_End(&state,&info);
+        printf("exposure %u  itime %9.2f us\n",j,t*1e6/CCD_TIMER_HZ);
+    }
+
+    //merged frame against the true signal of the longest exposure. The error
+    //beyond the output quantization (1<<shift) is measured in LSB of the
+    //exposure the pixel was taken from, where the +-4 noise scales with the
+    //integration time ratio.
+    unsigned clipped=0, longSaturated=0, from[CCD_HDR_MAX_EXPOSURES]={0};
+    double errMax=0;
+    for(unsigned i=CCD_SIGNAL_FIRST;i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT;i++)
+    {
+        double truth=rate[i]*base, merged=(double)((uint32_t)data[i]<<info.shift);
+        unsigned j=source[i];
+        if(saturated[i]){clipped++;continue;}
+        if(j)longSaturated++;
+        from[j]++;
+        double e=fabs(merged-truth)-(1u<<info.shift);
+        e=(e>0?e:0)/((double)state.integrationTime[0]/state.integrationTime[j]);
+        if(e>errMax)errMax=e;
+    }
+    if(clipped||errMax>6)rc=1;
+    printf("dynamic range   %u (%.1f bits, %.1f dB), output shift %u\n",info.dynamicRange,
+           log2(info.dynamicRange),20*log10(info.dynamicRange),info.shift);
+    printf("pixels from     ");
+    for(unsigned j=0;j<exposures;j++)printf("exposure %u: %u  ",j,from[j]);
+    printf("\n");
+    printf("saturated       %u pixels in the longest exposure, %u clipped after merge\n",longSaturated,clipped);
+    printf("max error       %.2f LSB of the source exposure\n",errMax);
+    printf("merge           %.2f ns/sample\n",(double)ns/exposures/CCD_DATA_SIZE);
+    return rc;
+}
+
+/******************************************************************************/
+//Device Timer 3 interrupt driven by the firmware schedule (timing.c)
+typedef struct
+{
+    TIMING_STATE state;
+    uint64_t    now;                //ticks, start of the current segment
+    uint64_t    lastSh;             //end of the last SH pulse (charge transfer)
+    uint64_t    lastIcg;            //end of the SH pulse of the last ICG pulse
+    uint64_t    lastReadout;        //start of the last readout
+    uint32_t    readoutLength;      //ticks of the last readout, at its clock
+    unsigned long shPulses, icgPulses, readouts, errors;
+    bool        icgLow;
+    bool        icg;                //this segment starts with an ICG pulse
+    uint32_t    ended;              //SH period that ended with this segment, 0 if none
+    uint32_t    exposure;           //integration time of the frame ended here, 0 if none
+    uint32_t    frame;              //ICG to ICG of the frame ended here, 0 if none
+    uint32_t    segments, maxSegments;  //timer periods of the current and the longest SH period
+} CCDTOOL_TIMING_SIM;
+
+static void CCDTOOL_TimingSegment(CCDTOOL_TIMING_SIM *sim, const TIMING_SCHEDULE *next)
+{
+    uint8_t events=TIMING_Events(&sim->state);
+
+    sim->ended=0;
+    sim->exposure=0;
+    sim->frame=0;
+    sim->icg=false;
+    if(sim->icgLow)                     //ICG back high, the readout starts
+    {
+        sim->icgLow=false;
+        if(sim->readouts&&sim->now-sim->lastReadout<=sim->readoutLength)sim->errors++;
+        sim->lastReadout=sim->now;
+        sim->readoutLength=TIMING_READOUT_TICKS(sim->state.active.clock);
+        sim->readouts++;
+    }
+    if(events&TIMING_SH)
+    {
+        uint64_t sh=sim->now+TIMING_SH_END;
+        if(sim->shPulses)
+        {
+            //measured against the period the schedule says has ended
+            sim->ended=(uint32_t)(sh-sim->lastSh);
+            if(sim->ended!=sim->state.period->length||sim->ended<CCD_INTEGRATION_MIN)sim->errors++;
+            if(sim->segments>sim->maxSegments)sim->maxSegments=sim->segments;
+        }
+        sim->lastSh=sh;
+        sim->shPulses++;
+        sim->segments=0;
+        if(events&TIMING_ICG)
+        {
+            sim->icgLow=true;
+            sim->icg=true;
+            sim->exposure=sim->ended;
+            if(sim->icgPulses)
+            {
+                sim->frame=(uint32_t)(sh-sim->lastIcg);
+                if(sim->frame!=sim->state.active.framePeriod)sim->errors++;
+            }
+            sim->lastIcg=sh;
+            sim->icgPulses++;
+        }
+    }
+    uint32_t ticks=TIMING_Next(&sim->state,next);
+    //16-bit period register, serviced within 10us, SH pulse inside the ICG low time
+    if(ticks<TIMING_SH_TICKS||ticks>TIMING_SEGMENT_MAX)sim->errors++;
+    sim->segments++;
+    sim->now+=ticks;
+}
+/******************************************************************************/
+static double CCDTOOL_RandomLog(uint32_t *seed, double low, double high)
+{
+    double u=(CCDTOOL_Random(seed)>>8)/16777216.0;
+    return exp(log(low)+u*(log(high)-log(low)));
+}
+/******************************************************************************/
+static int CCDTOOL_BenchTiming(int argc, char **argv)
+{
+    unsigned randomCount=200;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': randomCount=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0)return 2;
+
+    //sweep: every tick of short times, segment split boundaries, the x10us
+    //values of the 4 byte "SET", long times and random times over the range,
+    //all free running; then fixed frame periods with times around their
+    //limits and random combinations fitted with TIMING_Fit; last the same at every
+    //CCD clock mode, switching between slow and fast readouts
+    static const char *names[]={"10-80us every tick","segment boundaries","x10us decades","long",
+                                "random (log)","frame periods","random periods","clock modes"};
+    enum{CATEGORIES=sizeof(names)/sizeof(names[0])};
+    static const uint32_t fixed[]={TIMING_ICG_MIN(CCD_CLOCK_0M8)+1,250000,312500,1250000,CCD_TIMER_HZ,10*CCD_TIMER_HZ};
+    unsigned n=0, size=1024+2*randomCount+64;
+    uint32_t *times=malloc(size*sizeof(uint32_t)), *periods=malloc(size*sizeof(uint32_t));
+    uint8_t *category=malloc(size), *clocks=calloc(size,1);
+    if(!times||!periods||!category||!clocks){free(times);free(periods);free(category);free(clocks);return 1;}
+#define CCDTOOL_CASE(t,p,c) do{times[n]=(t);periods[n]=(p);category[n++]=(c);}while(0)
+    for(uint32_t t=CCD_INTEGRATION_MIN;t<=1000;t++)CCDTOOL_CASE(t,0,0);
+    for(uint32_t k=0;k<=4;k++)
+        for(int d=-3;d<=3;d++)
+            CCDTOOL_CASE((k?k*TIMING_SEGMENT_MAX:TIMING_SH_TICKS)+TIMING_SH_TICKS+(uint32_t)d,0,1);
+    for(uint32_t t=1;t<=0xFFFF;t=t*10>0xFFFF&&t<0xFFFF?0xFFFF:t*10)CCDTOOL_CASE(t*CCD_TICKS_PER_10US,0,2);
+    CCDTOOL_CASE(CCD_TIMER_HZ,0,3);
+    CCDTOOL_CASE(10*CCD_TIMER_HZ+1,0,3);
+    CCDTOOL_CASE(0xFFFFFFFFu,0,3);
+    uint32_t seed=7;
+    for(unsigned i=0;i<randomCount;i++)
+        CCDTOOL_CASE((uint32_t)CCDTOOL_RandomLog(&seed,CCD_INTEGRATION_MIN,4294967295.0),0,4);
+    for(unsigned i=0;i<sizeof(fixed)/sizeof(fixed[0]);i++)
+    {
+        uint32_t p=fixed[i];
+        const uint32_t t[]={CCD_INTEGRATION_MIN,CCD_INTEGRATION_MIN+1,2*TIMING_SH_TICKS-1,2*TIMING_SH_TICKS,
+                            p/3+1,p/2,p-CCD_INTEGRATION_MIN,p};
+        for(unsigned j=0;j<sizeof(t)/sizeof(t[0]);j++)CCDTOOL_CASE(t[j],p,5);
+    }
+    for(unsigned i=0;i<randomCount;i++)
+    {
+        uint32_t p=(uint32_t)CCDTOOL_RandomLog(&seed,TIMING_ICG_MIN(CCD_CLOCK_0M8)+1,10.0*CCD_TIMER_HZ);
+        CCDTOOL_CASE(TIMING_Fit((uint32_t)CCDTOOL_RandomLog(&seed,CCD_INTEGRATION_MIN,p),p),p,6);
+    }
+    for(unsigned k=0;k<2*CCD_CLOCK_MODES;k++)
+    {
+        uint8_t m=(uint8_t)(k&1?CCD_CLOCK_MODES-1-k/2:k/2);   //0.8, 4, 2, 2.5, ... MHz
+        uint32_t icg=TIMING_ICG_MIN(m);
+        const uint32_t t[]={CCD_INTEGRATION_MIN,CCD_INTEGRATION_MIN,1000,12500,CCD_INTEGRATION_MIN,icg+1-CCD_INTEGRATION_MIN};
+        const uint32_t p[]={0,icg+1,0,0,2*icg,icg+1};
+        for(unsigned j=0;j<sizeof(t)/sizeof(t[0]);j++)
+        {
+            clocks[n]=m;
+            CCDTOOL_CASE(t[j],p[j],7);
+        }
+    }
+#undef CCDTOOL_CASE
+
+    unsigned long count[CATEGORIES]={0}, shPeriods[CATEGORIES]={0}, frames[CATEGORIES]={0}, wrong[CATEGORIES]={0};
+    uint32_t maxSegments[CATEGORIES]={0};
+    CCDTOOL_TIMING_SIM sim;
+    TIMING_SCHEDULE next;
+    memset(&sim,0,sizeof(sim));
+    TIMING_Schedule(&next,CCD_INTEGRATION_MIN,0,CCD_CLOCK_0M8);
+    TIMING_Reset(&sim.state,&next);
+
+    for(unsigned i=0;i<n;i++)
+    {
+        unsigned c=category[i];
+        uint32_t t=times[i], p=periods[i];
+        unsigned long errors=sim.errors;
+        if(TIMING_Schedule(&next,t,p,clocks[i])!=CCD_TIMING_OK){fprintf(stderr,"%u/%u ticks rejected\n",t,p);rc=1;continue;}
+        if(p&&next.framePeriod!=p)wrong[c]++;
+        count[c]++;
+        sim.maxSegments=0;
+
+        //set while the previous schedule runs, takes effect with the next ICG pulse;
+        //every following frame must be exposed for exactly t, ICG pulses exactly
+        //the frame period apart
+        bool started=false;
+        unsigned long s=0, f=0;
+        while(s<3||f<2)
+        {
+            CCDTOOL_TimingSegment(&sim,&next);
+            if(!started){started=sim.icg;continue;}
+            if(sim.ended)s++;
+            if(sim.icg)
+            {
+                f++;
+                if(sim.exposure!=t||sim.frame!=next.framePeriod)wrong[c]++;
+            }
+        }
+        shPeriods[c]+=s;
+        frames[c]+=f;
+        if(sim.maxSegments>maxSegments[c])maxSegments[c]=sim.maxSegments;
+        wrong[c]+=sim.errors-errors;
+    }
+
+    printf("%-20s %8s %10s %8s %10s %8s\n","schedules","values","SH periods","frames","segments","errors");
+    for(unsigned c=0;c<CATEGORIES;c++)
+    {
+        printf("%-20s %8lu %10lu %8lu %10u %8lu\n",names[c],count[c],shPeriods[c],frames[c],maxSegments[c],wrong[c]);
+        if(wrong[c])rc=1;
+    }
+    printf("simulated %.1f s of device time, %lu SH pulses, %lu readouts\n",
+           (double)sim.now/CCD_TIMER_HZ,sim.shPulses,sim.readouts);
+
+    //impossible combinations are rejected with the reason "TIM" reports
+    static const struct{uint32_t t, p; uint8_t clock, status;} reject[]=
+    {
+        {CCD_INTEGRATION_MIN-1,0,CCD_CLOCK_0M8,CCD_TIMING_EXPOSURE_SHORT},
+        {0,312500,CCD_CLOCK_0M8,CCD_TIMING_EXPOSURE_SHORT},
+        {CCD_INTEGRATION_MIN,TIMING_ICG_MIN(CCD_CLOCK_0M8),CCD_CLOCK_0M8,CCD_TIMING_PERIOD_SHORT},
+        {CCD_INTEGRATION_MIN,TIMING_ICG_MIN(CCD_CLOCK_4M0)+1,CCD_CLOCK_2M5,CCD_TIMING_PERIOD_SHORT},
+        {CCD_INTEGRATION_MIN,TIMING_ICG_MIN(CCD_CLOCK_4M0),CCD_CLOCK_4M0,CCD_TIMING_PERIOD_SHORT},
+        {CCD_INTEGRATION_MIN,1,CCD_CLOCK_0M8,CCD_TIMING_PERIOD_SHORT},
+        {312501,312500,CCD_CLOCK_0M8,CCD_TIMING_EXPOSURE_LONG},
+        {312499,312500,CCD_CLOCK_0M8,CCD_TIMING_FLUSH_SHORT},
+        {312500-CCD_INTEGRATION_MIN+1,312500,CCD_CLOCK_0M8,CCD_TIMING_FLUSH_SHORT},
+    };
+    unsigned rejected=0;
+    for(unsigned i=0;i<sizeof(reject)/sizeof(reject[0]);i++)
+    {
+        if(TIMING_Schedule(&next,reject[i].t,reject[i].p,reject[i].clock)==reject[i].status)continue;
+        fprintf(stderr,"%u/%u ticks: expected status %u\n",reject[i].t,reject[i].p,reject[i].status);
+        rejected++;
+        rc=1;
+    }
+    printf("rejections           %8u %37u\n",(unsigned)(sizeof(reject)/sizeof(reject[0])),rejected);
+
+    //oversampling is the largest factor up to the request whose conversion slots (one per
+    //core) divide the output period exactly and stay within the capture rate limit
+    unsigned oversamplingWrong=0;
+    for(uint8_t cores=1;cores<=CCD_ADC_CORES_MAX;cores++)
+    {
+        uint8_t coreShift=cores>1?1:0;
+        printf("oversampling %u core%s",cores,cores>1?"s":" ");
+        for(uint8_t m=0;m<CCD_CLOCK_MODES;m++)
+        {
+            uint32_t period=4*CCD_CLOCK_DIVIDER(m);
+            for(uint8_t req=0;req<=3;req++)
+            {
+                uint8_t fit=TIMING_Oversampling(m,req,cores), best=coreShift;
+                for(uint8_t k=coreShift;k<=req;k++)
+                {
+                    uint32_t slots=1u<<(k-coreShift);
+                    if(!(period%slots)&&CCD_CLOCK_BASE_HZ/period*slots<=CCD_CAPTURE_RATE_MAX)best=k;
+                }
+                if(fit!=best)
+                {
+                    fprintf(stderr,"clock mode %u, %u cores: oversampling %u fitted to %u, expected %u\n",
+                            m,cores,1u<<req,1u<<fit,1u<<best);
+                    oversamplingWrong++;
+                    rc=1;
+                }
+            }
+            printf(" %.1fMHz %ux",CCD_CLOCK_BASE_HZ/1e6/CCD_CLOCK_DIVIDER(m),1u<<TIMING_Oversampling(m,3,cores));
+        }
+        if(cores<CCD_ADC_CORES_MAX)printf("\n");
+    }
+    printf(" %7u\n",oversamplingWrong);
+    free(times);
+    free(periods);
+    free(category);
+    free(clocks);
+    return rc;
+}
+/******************************************************************************/
+//Approximately normal noise of standard deviation sigma (sum of 4 uniform values)
+static double CCDTOOL_Noise(uint32_t *seed, double sigma)
+{
+    double v=0;
+    for(unsigned k=0;k<4;k++)v+=CCDTOOL_Random(seed)/4294967296.0-0.5;
+    return v*sigma*sqrt(3.0);
+}
+/******************************************************************************/
+//One simulated MATCH or CHECK: both cores convert the same outputs of a scene, ADC1
+//with offset and gain error, results go through the match like in the ADC interrupt
+static void CCDTOOL_InterleaveCollect(INTERLEAVE_SUMS *sums, const INTERLEAVE_MATCH *m, unsigned frames,
+                                      bool flat, double offset, double gainError, double noise, uint32_t *seed)
+{
+    INTERLEAVE_Reset(sums);
+    for(unsigned f=0;f<frames;f++)
+    {
+        for(unsigned i=CCD_SIGNAL_FIRST;i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT;i++)
+        {
+            double v=flat?1500:200+3600.0*(i-CCD_SIGNAL_FIRST)/CCD_SIGNAL_COUNT;
+            double y=v+CCDTOOL_Noise(seed,noise)+0.5, x=v*(1+gainError)+offset+CCDTOOL_Noise(seed,noise)+0.5;
+            uint16_t ry=(uint16_t)(y<0?0:y>CCD_ADC_MAX?CCD_ADC_MAX:y);
+            uint16_t rx=(uint16_t)(x<0?0:x>CCD_ADC_MAX?CCD_ADC_MAX:x);
+            INTERLEAVE_Add(sums,INTERLEAVE_Apply(m,rx),ry);
+        }
+    }
+}
+/******************************************************************************/
+static int CCDTOOL_BenchInterleave(int argc, char **argv)
+{
+    unsigned frames=4;
+    double offset=-6.3, gainError=-2500, noise=1.5;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:o:g:r:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'o': offset=strtod(optarg,NULL); break;
+            case 'g': gainError=strtod(optarg,NULL); break;
+            case 'r': noise=strtod(optarg,NULL); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||!frames||frames>255||fabs(offset)>100||fabs(gainError)>100000||noise<0)return 2;
+    gainError*=1e-6;
+
+    //ramp scene: MATCH from identity, then CHECK with the match applied. What is left
+    //is the noise of both cores and the rounding of the 12-bit result.
+    double f=1.0/(1<<INTERLEAVE_FINE_SHIFT), floor=sqrt(2*noise*noise+2/12.0);
+    INTERLEAVE_SUMS sums;
+    INTERLEAVE_MATCH m;
+    INTERLEAVE_REPORT before, after;
+    uint32_t seed=5;
+    INTERLEAVE_Identity(&m);
+    CCDTOOL_InterleaveCollect(&sums,&m,frames,false,offset,gainError,noise,&seed);
+    uint64_t t0=CCDSERIAL_TimeNs();
+    INTERLEAVE_Fit(&sums,&m,&before);
+    uint64_t fitNs=CCDSERIAL_TimeNs()-t0;
+    CCDTOOL_InterleaveCollect(&sums,&m,frames,false,offset,gainError,noise,&seed);
+    INTERLEAVE_Mismatch(&sums,&after);
+
+    double gain=m.gain/(double)INTERLEAVE_GAIN_ONE, expectGain=1/(1+gainError);
+    printf("scene         ramp 200..3800 LSB, %u frames, ADC1 %+.2f LSB %+.0f ppm, noise %.2f LSB rms\n",
+           frames,offset,gainError*1e6,noise);
+    printf("match         ADC1*%.5f%+.2f LSB (expected *%.5f%+.2f), fit %.1f us\n",gain,m.offset*f,
+           expectGain,-offset*expectGain,fitNs/1e3);
+    printf("before        %8.2f LSB mean, %.2f LSB rms\n",before.mean*f,before.rms*f);
+    printf("residual      %8.2f LSB rms (floor %.2f)\n",before.residual*f,floor);
+    printf("check         %8.2f LSB mean, %.2f LSB rms\n",after.mean*f,after.rms*f);
+    if(!before.gainFitted||fabs(gain-expectGain)>2e-4+1.0/INTERLEAVE_GAIN_ONE||fabs(after.mean*f)>0.15||
+       after.rms*f>floor*1.15+0.1||before.residual*f>floor*1.15+0.1)
+    {
+        fprintf(stderr,"ramp scene: match not recovered\n");
+        rc=1;
+    }
+
+    //flat scene: too little spread for the gain, the offset alone is matched
+    INTERLEAVE_Identity(&m);
+    CCDTOOL_InterleaveCollect(&sums,&m,frames,true,offset,gainError,noise,&seed);
+    INTERLEAVE_Fit(&sums,&m,&before);
+    CCDTOOL_InterleaveCollect(&sums,&m,frames,true,offset,gainError,noise,&seed);
+    INTERLEAVE_Mismatch(&sums,&after);
+    printf("flat scene    gain %s, ADC1%+.2f LSB, check %.2f LSB mean\n",before.gainFitted?"fitted":"kept",
+           m.offset*f,after.mean*f);
+    if(before.gainFitted||m.gain!=INTERLEAVE_GAIN_ONE||fabs(after.mean*f)>0.15)
+    {
+        fprintf(stderr,"flat scene: expected an offset-only match\n");
+        rc=1;
+    }
+
+    //pixel rate the capture path sustains per requested oversampling, capped by the sensor
+    printf("pixel rate    Mpixels/s at    1x     2x     4x     8x\n");
+    for(uint8_t cores=1;cores<=CCD_ADC_CORES_MAX;cores++)
+    {
+        printf("              %u core%s   ",cores,cores>1?"s":" ");
+        for(uint8_t k=0;k<=3;k++)
+        {
+            double rate=CCD_CAPTURE_RATE_MAX*cores/(double)(1u<<(k>cores-1?k:cores-1))/1e6;
+            printf(" %6.3f",rate<1.0?rate:1.0);
+        }
+        printf("\n");
+    }
+    return rc;
+}
+/******************************************************************************/
+//Simulated front end at 0.8MHz, one conversion per output: every output starts from
+//the reset level and settles exponentially after a delay, clock feedthrough adds
+//noise near every master clock edge. Returns the level above reset and the noise.
+static void CCDTOOL_PhaseModel(double t, double settlingNs, double noise, double *level, double *sigma)
+{
+    const double delayNs=150, edgeNs=625, edgeDelayNs=20, swing=1500;
+    double d=fmod(t-edgeDelayNs+edgeNs,edgeNs);
+    if(d>edgeNs/2)d=edgeNs-d;
+    *level=t>delayNs?swing*(1-exp(-(t-delayNs)/settlingNs)):0;
+    *sigma=noise+8*exp(-d/30);
+}
+/******************************************************************************/
+static int CCDTOOL_BenchPhase(int argc, char **argv)
+{
+    unsigned frames=8;
+    double settlingNs=400, noise=1.0;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:s:r:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=(unsigned)strtoul(optarg,NULL,0); break;
+            case 's': settlingNs=strtod(optarg,NULL); break;
+            case 'r': noise=strtod(optarg,NULL); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||frames<2||frames>255||settlingNs<=0||noise<0)return 2;
+
+    //the sweep is fed like the firmware feeds it: frames of the phase being swept
+    static PHASE_SWEEP sweep;
+    static uint16_t data[CCD_DATA_SIZE];
+    const double spacingNs=4e9/(CCD_CLOCK_BASE_HZ/CCD_CLOCK_DIVIDER(CCD_CLOCK_0M8)), dark=100;
+    double truth[CCD_PHASE_STEPS];
+    uint32_t seed=7;
+    uint64_t ns=0;
+    unsigned n=0;
+    PHASE_Start(&sweep,(uint8_t)frames);
+    for(bool done=false;!done;n++)
+    {
+        double level, sigma;
+        CCDTOOL_PhaseModel(spacingNs*sweep.step/CCD_PHASE_STEPS,settlingNs,noise,&level,&sigma);
+        truth[sweep.step]=level/sigma;
+        for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+        {
+            bool lit=i>=CCD_SIGNAL_FIRST&&i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT;
+            double v=dark+(lit?level:0)+CCDTOOL_Noise(&seed,sigma)+0.5;
+            data[i]=(uint16_t)(v<0?0:v>CCD_ADC_MAX?CCD_ADC_MAX:v);
+        }
+        uint64_t t0=CCDSERIAL_TimeNs();
+        done=PHASE_Frame(&sweep,data,NULL);
+        ns+=CCDSERIAL_TimeNs()-t0;
+    }
+
+    uint8_t best=PHASE_Best(&sweep), top=0;
+    for(uint8_t k=1;k<CCD_PHASE_STEPS;k++)if(truth[k]>truth[top])top=k;
+    CCDTOOL_PhasePrint(sweep.signalMean,sweep.noise,spacingNs,best,CCD_PHASE_DEFAULT);
+    printf("model         settling %.0f ns, noise %.2f LSB rms, best phase %u (SNR %.1f dB)\n",settlingNs,noise,
+           top,20*log10(truth[top]));
+    if(best<CCD_PHASE_STEPS)
+        printf("sweep         phase %u, SNR %+.2f dB over the default phase, %.1f us per frame scored\n",best,
+               20*log10(truth[best]/truth[CCD_PHASE_DEFAULT]),ns/1e3/n);
+    if(best>=CCD_PHASE_STEPS||truth[best]<0.9*truth[top])
+    {
+        fprintf(stderr,"sweep chose phase %u, the model's best is %u\n",best,top);
+        rc=1;
+    }
+
+    //sweep duration free running at the shortest integration time, one frame per
+    //phase is lost while it is switched
+    printf("sweep time   ");
+    for(uint8_t m=0;m<CCD_CLOCK_MODES;m++)
+    {
+        TIMING_SCHEDULE schedule;
+        TIMING_Schedule(&schedule,CCD_INTEGRATION_MIN,0,m);
+        printf(" %.1fMHz %.2f s",CCD_CLOCK_BASE_HZ/1e6/CCD_CLOCK_DIVIDER(m),
+               CCD_PHASE_STEPS*(frames+1)*(double)schedule.framePeriod/CCD_TIMER_HZ);
+    }
+    printf("\n");
+
+    //no light: nothing to score, the phase is kept
+    PHASE_Start(&sweep,2);
+    for(bool done=false;!done;)
+    {
+        for(unsigned i=0;i<CCD_DATA_SIZE;i++)data[i]=(uint16_t)(dark+CCDTOOL_Noise(&seed,noise)+0.5);
+        done=PHASE_Frame(&sweep,data,NULL);
+    }
+    if(PHASE_Best(&sweep)!=CCD_PHASE_STEPS)
+    {
+        fprintf(stderr,"dark scene: expected no phase\n");
+        rc=1;
+    }
+    return rc;
+}
+
+/******************************************************************************/
+//Monitoring scene for CCD_MODE_CHANGE: a static spectrum with fresh noise every
+//frame and an event every -e frames, alternately a new line (local) or 8% more
+//light (broad). Both thresholds are run the way the device runs them, with a
+//keep-alive every -k ms at a 10 ms frame period; the largest difference must find
+//every event and neither may send a frame without one.
+static int CCDTOOL_BenchChange(int argc, char **argv)
+{
+    static const char *methods[]={"mean","maximum"};
+    unsigned long frames=5000, every=100;
+    unsigned meanThreshold=112, maxThreshold=48, keepAliveMs=1000;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:e:m:x:k:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            case 'e': every=strtoul(optarg,NULL,0); break;
+            case 'm': meanThreshold=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'x': maxThreshold=(unsigned)strtoul(optarg,NULL,0); break;
+            case 'k': keepAliveMs=(unsigned)strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind!=0||!frames||every<2||meanThreshold>0xFFFF||maxThreshold>CCD_ADC_MAX)return 2;
+    if(keepAliveMs<CCD_CHANGE_KEEPALIVE_MS(0)||keepAliveMs>CCD_CHANGE_KEEPALIVE_MS(0xF0))return 2;
+
+    static double scene[CCD_DATA_SIZE];
+    static uint16_t frame[CCD_DATA_SIZE], reference[CCD_DATA_SIZE];
+    double position[CCD_PEAKS_MAX];
+    uint8_t keepAlive=(uint8_t)(((keepAliveMs+50)/100-1)<<4);
+    unsigned long keepAliveFrames=CCD_CHANGE_KEEPALIVE_MS(keepAlive)/10;
+    size_t raw=sizeof(CCD_FRAME_HEADER)+CCDSERIAL_PayloadSize(0,3);
+
+    printf("%-8s %9s %7s %6s %6s %6s %9s %9s %9s\n","method","threshold","sent","alive","missed","false",
+           "floor","MB","reduction");
+    for(unsigned m=0;m<2;m++)
+    {
+        CHANGE_CONFIG config={(uint16_t)(m?maxThreshold:meanThreshold),(uint8_t)((m?CCD_CHANGE_MAXIMUM:0)|keepAlive)};
+        unsigned long sent=0, alive=0, missed=0, wrong=0, quiet=0, events=0, longest=0, last=0;
+        uint32_t seed=5, floorMax=0;
+        uint64_t floorSum=0;
+        int haveReference=0, pending=0;
+
+        CCDTOOL_SyntheticLines(frame,&seed,position,4);
+        for(unsigned i=0;i<CCD_DATA_SIZE;i++)scene[i]=frame[i];
+        for(unsigned long f=0;f<frames;f++)
+        {
+            if(f&&f%every==0)
+            {
+                if(events++%2==0)
+                {
+                    //a line shows up somewhere
+                    double at=CCD_SIGNAL_FIRST+20+CCDTOOL_Random(&seed)%(CCD_SIGNAL_COUNT-40), sigma=2.5;
+                    for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+                    {
+                        double d=(i-at)/sigma;
+                        if(fabs(d)<8)scene[i]+=1000*exp(-0.5*d*d);
+                    }
+                }
+                else for(unsigned i=0;i<CCD_DATA_SIZE;i++)scene[i]*=1.08;
+                pending=1;
+            }
+            for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+            {
+                double v=scene[i]+(int)(CCDTOOL_Random(&seed)%17)-8;
+                frame[i]=(uint16_t)(v<0?0:v>CCD_ADC_MAX?CCD_ADC_MAX:v);
+            }
+
+            /* Streaming comparison as in the ADC interrupt, decision as in the main loop */
+            CHANGE_STATE st;
+            CHANGE_Begin(&st,reference);
+            for(uint16_t i=CCD_SIGNAL_FIRST;i<CCD_SIGNAL_FIRST+CCD_SIGNAL_COUNT;i++)CHANGE_Sample(&st,i,frame[i]);
+            int changed=!haveReference||CHANGE_Exceeds(&config,st.sum,st.maximum,CCD_SIGNAL_COUNT);
+            if(changed)
+            {
+                memcpy(reference,frame,sizeof(reference));
+                if(haveReference&&!pending)wrong++;
+                haveReference=1;
+                pending=0;
+                sent++;
+                last=f;
+            }
+            else
+            {
+                if(pending)
+                {
+                    missed++;
+                    pending=0;          //held back for good, the reference is stale now
+                }
+                else if(haveReference)
+                {
+                    uint32_t mean=CHANGE_Mean(st.sum,CCD_SIGNAL_COUNT);
+                    floorSum+=mean;
+                    quiet++;
+                    if((m?st.maximum:mean)>floorMax)floorMax=m?st.maximum:mean;
+                }
+                if(f-last>=keepAliveFrames)
+                {
+                    alive++;
+                    last=f;
+                }
+            }
+            if(f-last>longest)longest=f-last;
+        }
+        if(longest>=keepAliveFrames)
+        {
+            fprintf(stderr,"%s: %lu frames without a reply, keep-alive is every %lu\n",methods[m],longest,keepAliveFrames);
+            rc=1;
+        }
+        if(wrong||(m&&missed))
+        {
+            fprintf(stderr,"%s: %lu frames sent without a change, %lu of %lu changes missed\n",methods[m],wrong,missed,
+                    events);
+            rc=1;
+        }
+        double bytes=(double)sent*raw+(double)alive*(sizeof(CCD_FRAME_HEADER)+sizeof(CCD_CHANGE));
+        printf("%-8s %9u %7lu %6lu %6lu %6lu %9u %9.2f %8.1fx\n",methods[m],config.threshold,sent,alive,missed,wrong,
+               floorMax,bytes/1e6,bytes?(double)frames*raw/bytes:0.0);
+        if(!m&&quiet)printf("%-8s mean difference of unchanged frames %.2f LSB, threshold %.2f LSB\n","",
+                            floorSum/16.0/quiet,meanThreshold/16.0);
+    }
+    printf("%lu frames, %lu changes, streaming all %.2f MB (12 bit); floor: largest value of unchanged frames\n",
+           frames,(frames-1)/every,(double)frames*raw/1e6);
+    return rc;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Compression commands
+// *****************************************************************************
+// *****************************************************************************
+
+typedef struct
+{
+    unsigned long long  frames, values, raw, coded, fallbacks;
+    uint64_t            encodeNs, decodeNs;
+} CCDTOOL_RICE_SUM;
+
+//Values of a recorded CCD_FORMAT_RAW or CCD_FORMAT_RICE frame, returns their number or
+//0 if the frame has none
+static uint16_t CCDTOOL_RiceValues(const CCDREC_VIEW *v, uint16_t *value)
+{
+    const uint8_t *p=v->payload;
+    uint32_t len=v->header->payloadLength;
+    uint16_t n=0;
+
+    if(v->header->vRes>CCD_VRES_NATIVE||v->header->hRes>5)return 0;
+    if(v->header->format==CCD_FORMAT_RICE)
+    {
+        n=(uint16_t)(CCD_DATA_SIZE>>v->header->hRes);
+        return RICE_Decode(p,len,n,CCD_RICE_BITS(v->header->vRes),value)<0?0:n;
+    }
+    if(v->header->format!=CCD_FORMAT_RAW||len>CCDSERIAL_PayloadSize(0,v->header->vRes))return 0;
+    if(v->header->vRes==CCD_VRES_NATIVE)
+        for(;2u*n+1<len;n++)value[n]=(uint16_t)(p[2*n]|p[2*n+1]<<8);
+    else if(v->header->vRes>=2)
+        for(;2u*n+1<len;n++)value[n]=(uint16_t)(p[2*n]<<8|p[2*n+1]);
+    else
+        for(;n<len;n++)value[n]=p[n];
+    return n;
+}
+/******************************************************************************/
+//Codes n values of vRes at full resolution the way the device does, decodes them and
+//adds the figures to sum; -1 if the decoded values differ
+static int CCDTOOL_RiceFrame(const uint16_t *value, uint16_t n, uint8_t vRes, CCDTOOL_RICE_SUM *sum)
+{
+    static uint16_t data[CCD_DATA_SIZE], check[CCD_DATA_SIZE];
+    static uint8_t fraction[CCD_DATA_SIZE], code[CCD_DATA_SIZE*3];
+    uint16_t raw=(uint16_t)(vRes>=2?2*n:n), len;
+
+    //samples and fractions the values were made from
+    for(uint16_t i=0;i<n;i++)
+    {
+        data[i]=vRes==CCD_VRES_16BIT?value[i]>>CCD_FINE_SHIFT:vRes==CCD_VRES_NATIVE?value[i]:
+                (uint16_t)(value[i]<<(2*(3-vRes)));
+        fraction[i]=(uint8_t)(vRes==CCD_VRES_16BIT?value[i]&0x0F:0);
+    }
+    uint64_t t=CCDSERIAL_TimeNs();
+    len=RICE_Encode(data,fraction,n,0,vRes,code,raw-1);
+    sum->encodeNs+=CCDSERIAL_TimeNs()-t;
+    sum->frames++;
+    sum->values+=n;
+    sum->raw+=raw;
+    sum->coded+=len?len:raw;
+    if(!len)
+    {
+        //sent raw, the stream is still checked
+        sum->fallbacks++;
+        len=RICE_Encode(data,fraction,n,0,vRes,code,sizeof(code));
+    }
+    t=CCDSERIAL_TimeNs();
+    int32_t used=RICE_Decode(code,len,n,CCD_RICE_BITS(vRes),check);
+    sum->decodeNs+=CCDSERIAL_TimeNs()-t;
+    return used==len&&!memcmp(check,value,n*sizeof(uint16_t))?0:-1;
+}
+/******************************************************************************/
+static void CCDTOOL_RicePrint(const char *source, unsigned vRes, const CCDTOOL_RICE_SUM *sum)
+{
+    if(!sum->frames)return;
+    printf("%-10s %4u %7llu %8.2f %6.2f %9.1f %9.2f %9.2f\n",source,vRes,sum->frames,
+           (double)sum->coded/sum->frames,(double)sum->raw/sum->coded,100.0*sum->fallbacks/sum->frames,
+           (double)sum->encodeNs/sum->values,(double)sum->decodeNs/sum->values);
+}
+/******************************************************************************/
+//Compression ratio and speed of CCD_FRAME_RICE on synthetic spectra, shadows and
+//noise at every vRes, and on the frames of a recording
+static int CCDTOOL_BenchRice(int argc, char **argv)
+{
+    static const char *sources[]={"lines","shadow","noise"};
+    unsigned long frames=500;
+    int opt, rc=0;
+
+    while((opt=getopt(argc,argv,"n:"))!=-1)
+    {
+        switch(opt)
+        {
+            case 'n': frames=strtoul(optarg,NULL,0); break;
+            default: return 2;
+        }
+    }
+    if(argc-optind>1||!frames)return 2;
+
+    static uint16_t data[CCD_DATA_SIZE], value[CCD_DATA_SIZE];
+    double position[CCD_PEAKS_MAX];
+    printf("%-10s %4s %7s %8s %6s %9s %9s %9s\n","source","vres","frames","bytes","ratio","raw %","enc ns/v","dec ns/v");
+    for(unsigned src=0;src<sizeof(sources)/sizeof(sources[0]);src++)
+    {
+        for(uint8_t vRes=0;vRes<=CCD_VRES_NATIVE;vRes++)
+        {
+            CCDTOOL_RICE_SUM sum={0};
+            uint32_t seed=11;
+            for(unsigned long f=0;f<frames;f++)
+            {
+                if(src==0)CCDTOOL_SyntheticLines(data,&seed,position,4);
+                else if(src==1)CCDTOOL_SyntheticShadow(data,&seed,position);
+                else for(unsigned i=0;i<CCD_DATA_SIZE;i++)data[i]=(uint16_t)(CCDTOOL_Random(&seed)&CCD_ADC_MAX);
+                //fractions of an average of 16 conversions carry noise of their own
+                for(unsigned i=0;i<CCD_DATA_SIZE;i++)
+                    value[i]=vRes==CCD_VRES_16BIT?(uint16_t)(data[i]<<CCD_FINE_SHIFT|(CCDTOOL_Random(&seed)&0x0F)):
+                             vRes==CCD_VRES_NATIVE?data[i]:(uint16_t)(data[i]>>(2*(3-vRes)));
+                if(CCDTOOL_RiceFrame(value,CCD_DATA_SIZE,vRes,&sum))
+                {
+                    fprintf(stderr,"%s vres %u: decoded frame %lu differs\n",sources[src],vRes,f);
+                    rc=1;
+                    break;
+                }
+            }
+            //noise over every bit of a raw value cannot get shorter
+            if(src==2&&CCD_RICE_BITS(vRes)==(vRes>=2?16:8)&&sum.fallbacks!=sum.frames)
+            {
+                fprintf(stderr,"noise vres %u: %llu of %llu frames not sent raw\n",vRes,sum.fallbacks,sum.frames);
+                rc=1;
+            }
+            CCDTOOL_RicePrint(sources[src],vRes,&sum);
+        }
+    }
+    if(argc-optind==1)
+    {
+        CCDREC_READER r;
+        CCDTOOL_RICE_SUM sum[CCD_VRES_NATIVE+1]={{0}};
+        unsigned long long other=0;
+        if(CCDREC_ReaderOpen(&r,argv[optind])){perror(argv[optind]);return 1;}
+        for(uint32_t c=0;c<r.chunkCount&&!rc;c++)
+        {
+            for(uint32_t i=0;i<r.chunks[c].frameCount;i++)
+            {
+                CCDREC_VIEW v;
+                uint16_t n;
+                if(CCDREC_FrameAt(&r,c,i,&v)||!(n=CCDTOOL_RiceValues(&v,value)))
+                {
+                    other++;
+                    continue;
+                }
+                if(CCDTOOL_RiceFrame(value,n,v.header->vRes,&sum[v.header->vRes]))
+                {
+                    fprintf(stderr,"%s: decoded frame %u differs\n",argv[optind],v.header->sequence);
+                    rc=1;
+                    break;
+                }
+            }
+        }
+        CCDREC_ReaderClose(&r);
+        for(unsigned k=0;k<=CCD_VRES_NATIVE;k++)CCDTOOL_RicePrint("recording",k,&sum[k]);
+        if(other)printf("%llu frames of other formats skipped\n",other);
+    }
+    printf("bytes per frame include fallbacks at their raw size, device cycles per value: ccdtool status\n");
+    return rc;
+}
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Main Entry Point
+// *****************************************************************************
+// *****************************************************************************
+
+typedef struct
+{
+    const char  *name;
+    int         (*run)(int argc, char **argv);
+    const char  *usage;
+} CCDTOOL_COMMAND;
+
+static const CCDTOOL_COMMAND ccdtoolCommands[]=
+{
+    {"record",      CCDTOOL_Record,     "[-t itime] [-f period] [-x hres] [-y vres] [-s 1|2|4|8] [-n sets] [-c chunkKiB] [-a align_us] [-m frame|peaks|edges|stats|hdr|change] [-o options] [-p parameter] [-e setpoint] <tty>... <file>"},
+    {"sync",        CCDTOOL_Sync,       "[-n exchanges] [-i interval_ms] <tty>"},
+    {"stats",       CCDTOOL_Stats,      "[-n frames] [-t itime [-f period]] [-l saturation] [-i] [-e setpoint] [-M max_itime] <tty>"},
+    {"timing",      CCDTOOL_Timing,     "[-t itime] [-f period] <tty>"},
+    {"clock",       CCDTOOL_Clock,      "[-c 0.8|2|2.5|4] [-s frames_per_mode] <tty>"},
+    {"calibrate",   CCDTOOL_Calibrate,  "[-n frames] [-i] dark|flat|save|clear|on|off|bench <tty>"},
+    {"linearity",   CCDTOOL_Linearity,  "[-f file [-x]] load|on|off|save|clear|bench|query <tty>"},
+    {"irq",         CCDTOOL_Irq,        "[-s seconds] [-r] <tty>"},
+    {"status",      CCDTOOL_Status,     "[-s seconds] [-r rate] [-f|-z] <tty>"},
+    {"trace",       CCDTOOL_Trace,      "[-m mask] [-s seconds] [-f] [-o file.json] <tty>"},
+    {"buffers",     CCDTOOL_Buffers,    "[-n frames] query|cached|coherent|bench <tty>"},
+    {"memory",      CCDTOOL_Memory,     "[-a] [-m file.map] [<tty>]"},
+    {"adc",         CCDTOOL_Adc,        "[-c 1|2] [-m frames] [-k frames] <tty>"},
+    {"phase",       CCDTOOL_Phase,      "[-n frames_per_phase] [-t itime] [-p phase|-q] <tty>"},
+    {"info",        CCDTOOL_Info,       "<file>"},
+    {"dump",        CCDTOOL_Dump,       "<file> <sequence>"},
+    {"bench-write", CCDTOOL_BenchWrite, "[-n frames] [-c chunkKiB] [-y vres] <file>"},
+    {"bench-read",  CCDTOOL_BenchRead,  "[-n lookups] <file>"},
+    {"bench-decode",CCDTOOL_BenchDecode,"[-n frames]"},
+    {"bench-peaks", CCDTOOL_BenchPeaks, "[-n frames] [-l lines] [-p threshold]"},
+    {"bench-edges", CCDTOOL_BenchEdges, "[-n frames]"},
+    {"bench-exposure",CCDTOOL_BenchExposure,"[-s setpoint] [-l max_frames]"},
+    {"bench-hdr",   CCDTOOL_BenchHdr,   "[-e exposures] [-r ratio_shift] [-t itime]"},
+    {"bench-linearity",CCDTOOL_BenchLinearity,"[-n frames]"},
+    {"bench-timing",CCDTOOL_BenchTiming,"[-n random_values]"},
+    {"bench-interleave",CCDTOOL_BenchInterleave,"[-n frames] [-o offset_lsb] [-g gain_error_ppm] [-r noise_lsb]"},
+    {"bench-phase", CCDTOOL_BenchPhase, "[-n frames_per_phase] [-s settling_ns] [-r noise_lsb]"},
+    {"bench-change",CCDTOOL_BenchChange,"[-n frames] [-e event_interval] [-m mean_threshold] [-x max_threshold] [-k keepalive_ms]"},
+    {"bench-rice",  CCDTOOL_BenchRice,  "[-n frames] [<file>]"},
+};
+
+static void CCDTOOL_Usage(void)
+{
+    fprintf(stderr,"usage:\n");
+    for(size_t i=0;i<sizeof(ccdtoolCommands)/sizeof(ccdtoolCommands[0]);i++)
+        fprintf(stderr,"  ccdtool %s %s\n",ccdtoolCommands[i].name,ccdtoolCommands[i].usage);
+}
+
+int main(int argc, char **argv)
+{
+    if(argc<2)
+    {
+        CCDTOOL_Usage();
+        return 2;
+    }
+    for(size_t i=0;i<sizeof(ccdtoolCommands)/sizeof(ccdtoolCommands[0]);i++)
+    {
+        if(strcmp(argv[1],ccdtoolCommands[i].name))continue;
+        int rc=ccdtoolCommands[i].run(argc-1,argv+1);
+        if(rc==2)fprintf(stderr,"usage: ccdtool %s %s\n",ccdtoolCommands[i].name,ccdtoolCommands[i].usage);
+        return rc;
+    }
+    CCDTOOL_Usage();
+    return 2;
+}